@@ -0,0 +1,486 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __batch_dsp__
+#define __batch_dsp__
+
+#include <assert.h>
+#include <memory>
+#include <vector>
+
+#include "faust/dsp/dsp.h"
+#include "faust/dsp/poly-dsp.h"
+#include "faust/gui/DecoratorUI.h"
+
+/**
+ * A DSP compiled with '-batch <n>' computes <n> instances of the program together, each instance
+ * in one lane of the SIMD vectors. Its channels are the ones of the <n> instances in instance order
+ * (like <n> instances combined with dsp_parallelizer), and its user interface has one "LaneK" box
+ * by instance in a "Batch" tab box.
+ *
+ * dsp_batch_lane gives access to one instance of the batch as a regular DSP, and mydsp_batch_poly
+ * renders the voices of a polyphonic instrument with batches.
+ */
+
+#define BATCH_BUFFER_SIZE 4096
+
+// Counts the instance boxes in the "Batch" tab box
+struct BatchLanesUI : public GenericUI {
+
+    int fDepth;
+    int fLanes;
+
+    BatchLanesUI():fDepth(0), fLanes(0) {}
+
+    void openBox()
+    {
+        if (fDepth++ == 1) fLanes++;
+    }
+
+    virtual void openTabBox(const char* label) { openBox(); }
+    virtual void openHorizontalBox(const char* label) { openBox(); }
+    virtual void openVerticalBox(const char* label) { openBox(); }
+    virtual void closeBox() { fDepth--; }
+
+};
+
+// Only keeps the items of one instance box, without the "Batch" and "LaneK" boxes
+class BatchLaneUI : public DecoratorUI {
+
+    private:
+
+        int fLane;
+        int fDepth;
+        int fCurLane;
+
+        bool isActive() { return fDepth >= 2 && fCurLane == fLane; }
+
+        template <typename Fun>
+        void openBox(Fun fun, const char* label)
+        {
+            if (fDepth == 1) {
+                fCurLane++;
+            } else if (isActive()) {
+                (fUI->*fun)(label);
+            }
+            fDepth++;
+        }
+
+    public:
+
+        BatchLaneUI(UI* ui, int lane):DecoratorUI(ui), fLane(lane), fDepth(0), fCurLane(-1) {}
+        virtual ~BatchLaneUI() { fUI = nullptr; }
+
+        virtual void openTabBox(const char* label) { openBox(&UI::openTabBox, label); }
+        virtual void openHorizontalBox(const char* label) { openBox(&UI::openHorizontalBox, label); }
+        virtual void openVerticalBox(const char* label) { openBox(&UI::openVerticalBox, label); }
+        virtual void closeBox()
+        {
+            fDepth--;
+            if (isActive()) fUI->closeBox();
+        }
+
+        virtual void addButton(const char* label, FAUSTFLOAT* zone)
+        {
+            if (isActive()) fUI->addButton(label, zone);
+        }
+        virtual void addCheckButton(const char* label, FAUSTFLOAT* zone)
+        {
+            if (isActive()) fUI->addCheckButton(label, zone);
+        }
+        virtual void addVerticalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step)
+        {
+            if (isActive()) fUI->addVerticalSlider(label, zone, init, min, max, step);
+        }
+        virtual void addHorizontalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step)
+        {
+            if (isActive()) fUI->addHorizontalSlider(label, zone, init, min, max, step);
+        }
+        virtual void addNumEntry(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step)
+        {
+            if (isActive()) fUI->addNumEntry(label, zone, init, min, max, step);
+        }
+        virtual void addHorizontalBargraph(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max)
+        {
+            if (isActive()) fUI->addHorizontalBargraph(label, zone, min, max);
+        }
+        virtual void addVerticalBargraph(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max)
+        {
+            if (isActive()) fUI->addVerticalBargraph(label, zone, min, max);
+        }
+        virtual void addSoundfile(const char* label, const char* filename, Soundfile** sf_zone)
+        {
+            if (isActive()) fUI->addSoundfile(label, filename, sf_zone);
+        }
+        virtual void declare(FAUSTFLOAT* zone, const char* key, const char* val)
+        {
+            if (isActive()) fUI->declare(zone, key, val);
+        }
+
+};
+
+/**
+ * The batch shared by its lane views: the channels of each lane are collected here
+ * until the batch is computed.
+ */
+struct dsp_batch_state {
+
+    dsp* fBatch;
+    int fLanes;
+    int fNumInputs;     // By lane
+    int fNumOutputs;    // By lane
+    std::vector<int> fViews;    // Number of lane views, by lane
+
+    FAUSTFLOAT** fInputs;
+    FAUSTFLOAT** fOutputs;
+    FAUSTFLOAT* fSilence;   // Inputs of the lanes not computed in the current block
+    FAUSTFLOAT* fDiscard;   // Outputs of the lanes not computed in the current block
+
+    dsp_batch_state(dsp* batch):fBatch(batch)
+    {
+        BatchLanesUI lanes;
+        fBatch->buildUserInterface(&lanes);
+        fLanes = (lanes.fLanes > 0) ? lanes.fLanes : 1;
+        fNumInputs = fBatch->getNumInputs() / fLanes;
+        fNumOutputs = fBatch->getNumOutputs() / fLanes;
+        fViews.resize(fLanes, 0);
+        fInputs = new FAUSTFLOAT*[fBatch->getNumInputs()];
+        fOutputs = new FAUSTFLOAT*[fBatch->getNumOutputs()];
+        fSilence = new FAUSTFLOAT[BATCH_BUFFER_SIZE]();
+        fDiscard = new FAUSTFLOAT[BATCH_BUFFER_SIZE];
+        resetChannels();
+    }
+
+    virtual ~dsp_batch_state()
+    {
+        delete fBatch;
+        delete [] fInputs;
+        delete [] fOutputs;
+        delete [] fSilence;
+        delete [] fDiscard;
+    }
+
+    void resetChannels()
+    {
+        for (int chan = 0; chan < fBatch->getNumInputs(); chan++) {
+            fInputs[chan] = fSilence;
+        }
+        for (int chan = 0; chan < fBatch->getNumOutputs(); chan++) {
+            fOutputs[chan] = fDiscard;
+        }
+    }
+
+    // The batch is computed by the last lane having a view
+    bool isLastLane(int lane)
+    {
+        for (int i = lane + 1; i < fLanes; i++) {
+            if (fViews[i] > 0) return false;
+        }
+        return true;
+    }
+
+};
+
+/**
+ * One instance of a batch, seen as a regular DSP.
+ *
+ * The lanes of a batch are computed together: each lane view records its channels, and the batch is computed
+ * when the last lane is computed, so the lane views of a batch have to be computed in lane order in each block,
+ * with the same number of frames (like with dsp_parallelizer). The lanes without channels in the block compute
+ * silence. The lane 0 view initializes the whole batch.
+ */
+class dsp_batch_lane : public dsp {
+
+    private:
+
+        std::shared_ptr<dsp_batch_state> fState;
+        int fLane;
+
+    public:
+
+        dsp_batch_lane(std::shared_ptr<dsp_batch_state> state, int lane):fState(state), fLane(lane)
+        {
+            fState->fViews[fLane]++;
+        }
+
+        dsp_batch_lane(const dsp_batch_lane& lane):fState(lane.fState), fLane(lane.fLane)
+        {
+            fState->fViews[fLane]++;
+        }
+
+        virtual ~dsp_batch_lane()
+        {
+            fState->fViews[fLane]--;
+        }
+
+        /**
+         * Create the views of all lanes of a batch.
+         *
+         * @param batch - a DSP compiled with '-batch <n>'. Beware: the views will use and finally delete the pointer.
+         *
+         * @return the <n> lane views, in lane order.
+         */
+        static std::vector<dsp*> createLanes(dsp* batch)
+        {
+            std::shared_ptr<dsp_batch_state> state = std::make_shared<dsp_batch_state>(batch);
+            std::vector<dsp*> lanes;
+            for (int lane = 0; lane < state->fLanes; lane++) {
+                lanes.push_back(new dsp_batch_lane(state, lane));
+            }
+            return lanes;
+        }
+
+        std::shared_ptr<dsp_batch_state> getState() { return fState; }
+        int getLane() { return fLane; }
+
+        virtual int getNumInputs() { return fState->fNumInputs; }
+        virtual int getNumOutputs() { return fState->fNumOutputs; }
+
+        virtual void buildUserInterface(UI* ui_interface)
+        {
+            BatchLaneUI lane(ui_interface, fLane);
+            fState->fBatch->buildUserInterface(&lane);
+        }
+
+        virtual int getSampleRate() { return fState->fBatch->getSampleRate(); }
+
+        virtual void init(int sample_rate)
+        {
+            if (fLane == 0) fState->fBatch->init(sample_rate);
+        }
+
+        virtual void instanceInit(int sample_rate)
+        {
+            if (fLane == 0) fState->fBatch->instanceInit(sample_rate);
+        }
+
+        virtual void instanceConstants(int sample_rate)
+        {
+            if (fLane == 0) fState->fBatch->instanceConstants(sample_rate);
+        }
+
+        virtual void instanceResetUserInterface()
+        {
+            if (fLane == 0) fState->fBatch->instanceResetUserInterface();
+        }
+
+        virtual void instanceClear()
+        {
+            if (fLane == 0) fState->fBatch->instanceClear();
+        }
+
+        // The lane 0 view of a new batch (so that it initializes it), whose other lanes compute silence
+        virtual dsp_batch_lane* clone()
+        {
+            return new dsp_batch_lane(std::make_shared<dsp_batch_state>(fState->fBatch->clone()), 0);
+        }
+
+        virtual void metadata(Meta* m) { fState->fBatch->metadata(m); }
+
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            assert(count <= BATCH_BUFFER_SIZE);
+            for (int chan = 0; chan < fState->fNumInputs; chan++) {
+                fState->fInputs[fLane * fState->fNumInputs + chan] = inputs[chan];
+            }
+            for (int chan = 0; chan < fState->fNumOutputs; chan++) {
+                fState->fOutputs[fLane * fState->fNumOutputs + chan] = outputs[chan];
+            }
+            if (fState->isLastLane(fLane)) {
+                fState->fBatch->compute(count, fState->fInputs, fState->fOutputs);
+                fState->resetChannels();
+            }
+        }
+
+        virtual void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            compute(count, inputs, outputs);
+        }
+
+};
+
+/**
+ * Polyphonic DSP whose voices are the lanes of batches: each batch with at least one playing voice
+ * is computed once by block, in the calling thread, and the playing voices are then mixed as in mydsp_poly.
+ * The free voices of a computed batch also run (with their gate at 0), but are not mixed.
+ */
+class mydsp_batch_poly : public mydsp_poly {
+
+    private:
+
+        std::vector<std::shared_ptr<dsp_batch_state> > fBatches;
+        std::vector<FAUSTFLOAT**> fLaneBuffers;     // Outputs of each voice
+        int fLanes;
+
+        FAUSTFLOAT** fBatchInputs;
+        FAUSTFLOAT** fBatchOutputs;
+
+        static std::vector<dsp*> createVoices(dsp* batch, int nvoices)
+        {
+            std::vector<dsp*> voices = dsp_batch_lane::createLanes(batch);
+            while (int(voices.size()) < nvoices) {
+                std::vector<dsp*> next = dsp_batch_lane::createLanes(batch->clone());
+                voices.insert(voices.end(), next.begin(), next.end());
+            }
+            return voices;
+        }
+
+        mydsp_batch_poly(const std::vector<dsp*>& voices, bool control, bool group)
+        : mydsp_poly(new dsp_batch_lane(*static_cast<dsp_batch_lane*>(voices[0])), voices, control, group)
+        {
+            fLanes = static_cast<dsp_batch_lane*>(voices[0])->getState()->fLanes;
+            for (size_t i = 0; i < voices.size(); i += fLanes) {
+                fBatches.push_back(static_cast<dsp_batch_lane*>(voices[i])->getState());
+            }
+            for (size_t i = 0; i < voices.size(); i++) {
+                FAUSTFLOAT** buffer = new FAUSTFLOAT*[getNumOutputs()];
+                for (int chan = 0; chan < getNumOutputs(); chan++) {
+                    buffer[chan] = new FAUSTFLOAT[MIX_BUFFER_SIZE];
+                }
+                fLaneBuffers.push_back(buffer);
+            }
+            fBatchInputs = new FAUSTFLOAT*[getNumInputs() * fLanes];
+            fBatchOutputs = new FAUSTFLOAT*[getNumOutputs() * fLanes];
+        }
+
+        void computeBatch(int batch, int offset, int slice, FAUSTFLOAT** inputs)
+        {
+            if (slice > 0) {
+                for (int lane = 0; lane < fLanes; lane++) {
+                    for (int chan = 0; chan < getNumInputs(); chan++) {
+                        fBatchInputs[lane * getNumInputs() + chan] = &(inputs[chan][offset]);
+                    }
+                    for (int chan = 0; chan < getNumOutputs(); chan++) {
+                        fBatchOutputs[lane * getNumOutputs() + chan] = &(fLaneBuffers[batch * fLanes + lane][chan][offset]);
+                    }
+                }
+                fBatches[batch]->fBatch->compute(slice, fBatchInputs, fBatchOutputs);
+            }
+        }
+
+        // Triggered voices compute their first frame with the gate at 0, as in dsp_voice::trigger
+        void playBatch(int batch, int count, FAUSTFLOAT** inputs)
+        {
+            bool trigger = false;
+            for (int lane = 0; lane < fLanes; lane++) {
+                dsp_voice* voice = fVoiceTable[batch * fLanes + lane];
+                if (voice->fTrigger && voice->fNote != kFreeVoice) {
+                    voice->setParamValue(voice->fGatePath, FAUSTFLOAT(0));
+                    trigger = true;
+                }
+            }
+            if (trigger) {
+                computeBatch(batch, 0, 1, inputs);
+                for (int lane = 0; lane < fLanes; lane++) {
+                    dsp_voice* voice = fVoiceTable[batch * fLanes + lane];
+                    if (voice->fTrigger && voice->fNote != kFreeVoice) {
+                        voice->setParamValue(voice->fGatePath, FAUSTFLOAT(1));
+                        voice->fTrigger = false;
+                    }
+                }
+                computeBatch(batch, 1, count - 1, inputs);
+            } else {
+                computeBatch(batch, 0, count, inputs);
+            }
+        }
+
+    public:
+
+        /**
+         * Constructor.
+         *
+         * @param batch - a DSP compiled with '-batch <n>', computing <n> voices. Beware: mydsp_batch_poly will use and finally delete the pointer.
+         * @param nvoices - number of polyphony voices, rounded up to a multiple of <n>
+         * @param control - as in mydsp_poly
+         * @param group - as in mydsp_poly
+         */
+        mydsp_batch_poly(dsp* batch,
+                         int nvoices,
+                         bool control = false,
+                         bool group = true)
+        : mydsp_batch_poly(createVoices(batch, nvoices), control, group)
+        {}
+
+        virtual ~mydsp_batch_poly()
+        {
+            for (size_t i = 0; i < fLaneBuffers.size(); i++) {
+                for (int chan = 0; chan < getNumOutputs(); chan++) {
+                    delete [] fLaneBuffers[i][chan];
+                }
+                delete [] fLaneBuffers[i];
+            }
+            delete [] fBatchInputs;
+            delete [] fBatchOutputs;
+        }
+
+        virtual mydsp_batch_poly* clone()
+        {
+            return new mydsp_batch_poly(fBatches[0]->fBatch->clone(), int(fVoiceTable.size()), fVoiceControl, fGroupControl);
+        }
+
+        void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            assert(count < MIX_BUFFER_SIZE);
+
+            // First clear the outputs
+            clearOutput(count, outputs);
+
+            // Then apply the MIDI events received since the previous block
+            applyEvents();
+
+            for (size_t batch = 0; batch < fBatches.size(); batch++) {
+                bool playing = !fVoiceControl;
+                for (int lane = 0; lane < fLanes && !playing; lane++) {
+                    playing = (fVoiceTable[batch * fLanes + lane]->fNote != kFreeVoice);
+                }
+                if (!playing) continue;
+
+                playBatch(int(batch), count, inputs);
+
+                // Mix the playing voices
+                for (int lane = 0; lane < fLanes; lane++) {
+                    int index = int(batch) * fLanes + lane;
+                    dsp_voice* voice = fVoiceTable[index];
+                    if (!fVoiceControl) {
+                        mixVoice(count, fLaneBuffers[index], outputs);
+                    } else if (voice->fNote != kFreeVoice) {
+                        voice->fLevel = mixVoice(count, fLaneBuffers[index], outputs);
+                        // Check the level to possibly set the voice in kFreeVoice again, and give it back to the control thread
+                        if ((voice->fLevel < VOICE_STOP_LEVEL) && (voice->fNote == kReleaseVoice)) {
+                            voice->fNote = kFreeVoice;
+                            voice_event event = { kVoiceStop, index, kNoVoice, voice->fDate, 0.f };
+                            writeEvent(fFreeVoices, event);
+                        }
+                    }
+                }
+            }
+        }
+
+        void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            compute(count, inputs, outputs);
+        }
+
+};
+
+#endif
@@ -0,0 +1,222 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+ 
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __dsp_silence__
+#define __dsp_silence__
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "faust/dsp/dsp.h"
+#include "faust/gui/DecoratorUI.h"
+#include "faust/gui/meta.h"
+
+/**
+ * Bypass a DSP while it is idle: when its inputs stayed below the threshold, and its outputs also did for more
+ * than the 'tail' of the DSP (the time its state takes to decay), compute is skipped and zeros are written in
+ * the outputs, until the inputs go above the threshold again or one of the controls is changed.
+ *
+ * The tail (in seconds) is given to the constructor, or taken from the 'tail' metadata (in seconds) declared
+ * in the DSP source, or from the 'tail_samples' metadata computed by the compiler (with -ts) for the DSPs
+ * without recursion. A DSP without tail is never bypassed. Bargraphs are not updated while the DSP is bypassed.
+ */
+class dsp_silence : public decorator_dsp
+{
+
+    private:
+
+        // Detect the changes of the buttons, sliders and nentries
+        struct ControlsUI : public GenericUI
+        {
+            std::vector<FAUSTFLOAT*> fZones;
+            std::vector<FAUSTFLOAT> fValues;
+
+            void add(FAUSTFLOAT* zone)
+            {
+                fZones.push_back(zone);
+                fValues.push_back(*zone);
+            }
+
+            void addButton(const char* label, FAUSTFLOAT* zone) { add(zone); }
+            void addCheckButton(const char* label, FAUSTFLOAT* zone) { add(zone); }
+            void addVerticalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) { add(zone); }
+            void addHorizontalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) { add(zone); }
+            void addNumEntry(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) { add(zone); }
+
+            bool changed()
+            {
+                bool res = false;
+                for (size_t i = 0; i < fZones.size(); i++) {
+                    FAUSTFLOAT value = *fZones[i];
+                    if (value != fValues[i]) {
+                        fValues[i] = value;
+                        res = true;
+                    }
+                }
+                return res;
+            }
+        };
+
+        struct TailMeta : public Meta
+        {
+            double fTail;
+            int fTailSamples;
+
+            TailMeta():fTail(-1.), fTailSamples(-1) {}
+
+            void declare(const char* key, const char* value)
+            {
+                if (strcmp(key, "tail") == 0) {
+                    fTail = atof(value);
+                } else if (strcmp(key, "tail_samples") == 0) {
+                    fTailSamples = atoi(value);
+                }
+            }
+        };
+
+        FAUSTFLOAT fThreshold;
+        double fTail;
+        int fTailFrames;        // -1 when unknown
+        int fSilentFrames;      // frames computed with silent inputs and outputs
+        bool fSilentInputs;
+        ControlsUI fControls;
+
+        long long fComputedBlocks;
+        long long fSkippedBlocks;
+
+        bool isSilent(int count, int channels, FAUSTFLOAT** buffers)
+        {
+            for (int chan = 0; chan < channels; chan++) {
+                for (int frame = 0; frame < count; frame++) {
+                    if (std::fabs(buffers[chan][frame]) > fThreshold) return false;
+                }
+            }
+            return true;
+        }
+
+        void setTail(int sample_rate)
+        {
+            if (fTail >= 0.) {
+                fTailFrames = int(fTail * sample_rate);
+            } else {
+                TailMeta meta;
+                fDSP->metadata(&meta);
+                fTailFrames = std::max((meta.fTail >= 0.) ? int(meta.fTail * sample_rate) : -1, meta.fTailSamples);
+            }
+            fSilentFrames = 0;
+        }
+
+        // Returns true if the block has been skipped
+        bool bypass(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            fSilentInputs = isSilent(count, fDSP->getNumInputs(), inputs);
+            if (fControls.changed() || !fSilentInputs) {
+                fSilentFrames = 0;
+            } else if (fTailFrames >= 0 && fSilentFrames > fTailFrames) {
+                for (int chan = 0; chan < fDSP->getNumOutputs(); chan++) {
+                    memset(outputs[chan], 0, sizeof(FAUSTFLOAT) * count);
+                }
+                fSkippedBlocks++;
+                return true;
+            }
+            fComputedBlocks++;
+            return false;
+        }
+
+        // The inputs are checked before compute, since they may be overwritten by an in-place compute
+        void update(int count, FAUSTFLOAT** outputs)
+        {
+            if (fSilentInputs && isSilent(count, fDSP->getNumOutputs(), outputs)) {
+                fSilentFrames = std::min(fSilentFrames + count, fTailFrames + 1);
+            } else {
+                fSilentFrames = 0;
+            }
+        }
+
+    public:
+
+        dsp_silence(dsp* dsp, FAUSTFLOAT threshold = FAUSTFLOAT(0.000001), double tail = -1.)
+        :decorator_dsp(dsp), fThreshold(threshold), fTail(tail), fTailFrames(-1), fSilentFrames(0), fSilentInputs(false),
+        fComputedBlocks(0), fSkippedBlocks(0)
+        {
+            fDSP->buildUserInterface(&fControls);
+        }
+
+        virtual ~dsp_silence() {}
+
+        virtual void init(int sample_rate)
+        {
+            fDSP->init(sample_rate);
+            setTail(sample_rate);
+        }
+        virtual void instanceInit(int sample_rate)
+        {
+            fDSP->instanceInit(sample_rate);
+            setTail(sample_rate);
+        }
+        virtual void instanceConstants(int sample_rate)
+        {
+            fDSP->instanceConstants(sample_rate);
+            setTail(sample_rate);
+        }
+        virtual void instanceClear()
+        {
+            fDSP->instanceClear();
+            fSilentFrames = 0;
+        }
+
+        virtual dsp_silence* clone() { return new dsp_silence(fDSP->clone(), fThreshold, fTail); }
+
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            if (!bypass(count, inputs, outputs)) {
+                fDSP->compute(count, inputs, outputs);
+                update(count, outputs);
+            }
+        }
+        virtual void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            if (!bypass(count, inputs, outputs)) {
+                fDSP->compute(date_usec, count, inputs, outputs);
+                update(count, outputs);
+            }
+        }
+
+        long long getComputedBlocks() { return fComputedBlocks; }
+        long long getSkippedBlocks() { return fSkippedBlocks; }
+
+        void printStats()
+        {
+            std::cout << "-------------------------------" << std::endl;
+            std::cout << "Computed blocks: " << fComputedBlocks << std::endl;
+            std::cout << "Skipped blocks: " << fSkippedBlocks << std::endl;
+            std::cout << "-------------------------------" << std::endl;
+        }
+
+};
+
+#endif
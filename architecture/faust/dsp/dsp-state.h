@@ -0,0 +1,144 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __dsp_state__
+#define __dsp_state__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+
+//----------------------------------------------------------------
+//  State layout of a DSP instance: the fields of the DSP structure
+//  (delay lines, recursive state, IOTA, control zones...) with
+//  their name in the generated code. The layout is described the
+//  same way by the Interpreter and LLVM backends, so that the running
+//  state of an instance can be transferred in an instance compiled
+//  by another backend.
+//----------------------------------------------------------------
+
+#define kStateInt32     0
+#define kStateFloat     1
+#define kStateDouble    2
+
+struct dsp_state_field {
+
+    std::string fName;
+    int fType;      // kStateInt32, kStateFloat or kStateDouble
+    int fSize;      // Number of elements
+    void* fZone;    // Address of the first element in the instance memory
+
+};
+
+typedef std::vector<dsp_state_field> dsp_state_layout;
+
+/**
+ * Parse the layout description generated by the compiler, one 'name type size offset' line by field.
+ * The offset is in bytes, from 'int_base' for kStateInt32 fields, and from 'real_base' for the other ones.
+ */
+static inline dsp_state_layout parseDSPStateLayout(const std::string& description, char* int_base, char* real_base)
+{
+    dsp_state_layout layout;
+    std::stringstream reader(description);
+    dsp_state_field field;
+    long offset;
+    while (reader >> field.fName >> field.fType >> field.fSize >> offset) {
+        field.fZone = ((field.fType == kStateInt32) ? int_base : real_base) + offset;
+        layout.push_back(field);
+    }
+    return layout;
+}
+
+/**
+ * Copy the state of an instance into another one: the fields are matched by name and size
+ * when the transfer is prepared, then copied (with int/float/double conversion) without memory allocation,
+ * so that the transfer can be done by the audio thread between two blocks.
+ */
+class dsp_state_transfer {
+
+    private:
+
+        struct field_copy {
+            int fSrcType, fDstType, fSize;
+            void* fSrc;
+            void* fDst;
+        };
+
+        std::vector<field_copy> fCopies;
+        int fMissing;
+
+        static double read(int type, void* zone, int index)
+        {
+            switch (type) {
+                case kStateInt32: return double(static_cast<int*>(zone)[index]);
+                case kStateFloat: return double(static_cast<float*>(zone)[index]);
+                default: return static_cast<double*>(zone)[index];
+            }
+        }
+
+        static void write(int type, void* zone, int index, double value)
+        {
+            switch (type) {
+                case kStateInt32: static_cast<int*>(zone)[index] = int(value); break;
+                case kStateFloat: static_cast<float*>(zone)[index] = float(value); break;
+                default: static_cast<double*>(zone)[index] = value; break;
+            }
+        }
+
+    public:
+
+        dsp_state_transfer(const dsp_state_layout& src, const dsp_state_layout& dst):fMissing(0)
+        {
+            std::map<std::string, size_t> src_fields;
+            for (size_t i = 0; i < src.size(); i++) {
+                src_fields[src[i].fName] = i;
+            }
+            for (size_t i = 0; i < dst.size(); i++) {
+                std::map<std::string, size_t>::iterator it = src_fields.find(dst[i].fName);
+                if (it != src_fields.end() && src[(*it).second].fSize == dst[i].fSize) {
+                    const dsp_state_field& field = src[(*it).second];
+                    field_copy copy = { field.fType, dst[i].fType, dst[i].fSize, field.fZone, dst[i].fZone };
+                    fCopies.push_back(copy);
+                } else {
+                    fMissing++;
+                }
+            }
+        }
+
+        // Number of fields of the destination without a field of same name and size in the source
+        int getMissing() { return fMissing; }
+
+        void transfer()
+        {
+            for (size_t i = 0; i < fCopies.size(); i++) {
+                field_copy& copy = fCopies[i];
+                for (int j = 0; j < copy.fSize; j++) {
+                    write(copy.fDstType, copy.fDst, j, read(copy.fSrcType, copy.fSrc, j));
+                }
+            }
+        }
+
+};
+
+#endif
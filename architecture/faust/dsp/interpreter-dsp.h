@@ -31,6 +31,7 @@
 #include <string>
 #include <vector>
 #include "faust/dsp/dsp.h"
+#include "faust/dsp/dsp-state.h"
 #include "faust/gui/meta.h"
 
 /*!
@@ -81,6 +82,14 @@ class interpreter_dsp : public dsp {
         
         void compute(int count, FAUSTFLOAT** input, FAUSTFLOAT** output);
     
+        /**
+         * Return the state layout of the instance (delay lines, recursive state, IOTA, control zones...),
+         * to transfer its running state in another instance of the same DSP, possibly compiled by another backend.
+         *
+         * @return the fields of the DSP structure, with their address in the instance memory.
+         */
+        dsp_state_layout getStateLayout();
+    
 };
 
 /**
@@ -30,6 +30,7 @@
 
 #include <vector>
 #include "faust/dsp/dsp.h"
+#include "faust/dsp/dsp-state.h"
 #include "faust/gui/meta.h"
 
 /*!
@@ -80,6 +81,14 @@ class llvm_dsp : public dsp {
         
         void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs);
     
+        /**
+         * Return the state layout of the instance (delay lines, recursive state, IOTA, control zones...),
+         * to transfer its running state in another instance of the same DSP, possibly compiled by another backend.
+         *
+         * @return the fields of the DSP structure, with their address in the instance memory.
+         */
+        dsp_state_layout getStateLayout();
+    
 };
 
 /**
@@ -33,12 +33,27 @@
 #include <vector>
 #include <limits.h>
 #include <float.h>
+#include <atomic>
 
 #include "faust/dsp/dsp-combiner.h"
 #include "faust/gui/MidiUI.h"
 #include "faust/gui/MapUI.h"
+#include "faust/gui/ring-buffer.h"
 #include "faust/dsp/proxy-dsp.h"
 
+#ifdef POLY_THREADS
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#else
+#include <semaphore.h>
+#endif
+#endif
+
 #define kActiveVoice      0
 #define kFreeVoice        -1
 #define kReleaseVoice     -2
@@ -46,6 +61,7 @@
 
 #define VOICE_STOP_LEVEL  0.001
 #define MIX_BUFFER_SIZE   16384
+#define VOICE_EVENT_SIZE  1024      // Max number of MIDI events received between two audio blocks
 
 #define FLOAT_MAX(a, b) (((a) < (b)) ? (b) : (a))
 
@@ -352,6 +368,363 @@ struct dsp_voice_group {
 
 };
 
+/**
+ * Voice events sent by the control thread to the audio thread, applied at the beginning of the next audio block.
+ */
+
+#define kVoiceOn          0
+#define kVoiceOff         1
+#define kVoiceStop        2
+#define kAllVoices        -1
+
+struct voice_event {
+
+    int fType;          // kVoiceOn, kVoiceOff or kVoiceStop
+    int fVoice;         // Voice index or kAllVoices
+    int fPitch;         // MIDI pitch
+    int fDate;          // Allocation date of the voice
+    float fVelocity;    // Normalized MIDI velocity [0..1], or -1 to keep the voice controls
+
+};
+
+/**
+ * Voice allocation, owned by the control thread.
+ *
+ * Each voice is in the list of the free, released or playing voices, the playing voices being also
+ * in the list of their pitch. Lists are kept in allocation order and stored as preallocated indexes,
+ * so that all operations are done in constant time without memory allocation.
+ */
+
+struct voice_allocator {
+
+    enum { kFreeList, kReleaseList, kPlayingList };
+
+    struct link { int fPrev, fNext; };
+    struct list { int fHead, fTail; };
+
+    std::vector<int> fState;        // List of each voice
+    std::vector<int> fPitch;        // Pitch of each playing voice
+    std::vector<int> fDate;         // Allocation date of each voice
+    std::vector<link> fLinks;       // Links in the free, release or playing list
+    std::vector<link> fPitchLinks;  // Links in the pitch list
+    list fLists[3];
+    list fPitchLists[128];
+    int fCurDate;
+
+    voice_allocator(int nvoices)
+    :fState(nvoices, kFreeList), fPitch(nvoices, kNoVoice), fDate(nvoices, 0),
+    fLinks(nvoices), fPitchLinks(nvoices), fCurDate(0)
+    {
+        reset();
+    }
+
+    // All voices are free, and will be allocated in index order
+    void reset()
+    {
+        for (int i = 0; i < 3; i++) {
+            fLists[i].fHead = fLists[i].fTail = kNoVoice;
+        }
+        for (int i = 0; i < 128; i++) {
+            fPitchLists[i].fHead = fPitchLists[i].fTail = kNoVoice;
+        }
+        for (int i = 0; i < int(fState.size()); i++) {
+            fState[i] = kFreeList;
+            append(fLists[kFreeList], fLinks, i);
+        }
+    }
+
+    static void append(list& lst, std::vector<link>& links, int voice)
+    {
+        links[voice].fPrev = lst.fTail;
+        links[voice].fNext = kNoVoice;
+        if (lst.fTail != kNoVoice) {
+            links[lst.fTail].fNext = voice;
+        } else {
+            lst.fHead = voice;
+        }
+        lst.fTail = voice;
+    }
+
+    static void remove(list& lst, std::vector<link>& links, int voice)
+    {
+        if (links[voice].fPrev != kNoVoice) {
+            links[links[voice].fPrev].fNext = links[voice].fNext;
+        } else {
+            lst.fHead = links[voice].fNext;
+        }
+        if (links[voice].fNext != kNoVoice) {
+            links[links[voice].fNext].fPrev = links[voice].fPrev;
+        } else {
+            lst.fTail = links[voice].fPrev;
+        }
+    }
+
+    void setState(int voice, int state)
+    {
+        if (fState[voice] == kPlayingList && fPitch[voice] >= 0 && fPitch[voice] < 128) {
+            remove(fPitchLists[fPitch[voice]], fPitchLinks, voice);
+        }
+        remove(fLists[fState[voice]], fLinks, voice);
+        fState[voice] = state;
+        append(fLists[state], fLinks, voice);
+    }
+
+    // Always returns a voice : the first free one, otherwise steal the oldest released or playing one
+    int allocate(int pitch)
+    {
+        int voice = fLists[kFreeList].fHead;
+        if (voice == kNoVoice) voice = fLists[kReleaseList].fHead;
+        if (voice == kNoVoice) voice = fLists[kPlayingList].fHead;
+
+        setState(voice, kPlayingList);
+        fPitch[voice] = pitch;
+        fDate[voice] = fCurDate++;
+        if (pitch >= 0 && pitch < 128) {
+            append(fPitchLists[pitch], fPitchLinks, voice);
+        }
+        return voice;
+    }
+
+    // Returns the oldest voice playing 'pitch', or kNoVoice
+    int getPlayingVoice(int pitch)
+    {
+        return (pitch >= 0 && pitch < 128) ? fPitchLists[pitch].fHead : kNoVoice;
+    }
+
+    // The audio thread has finished the release of 'voice' (ignored if the voice has been allocated again since)
+    void freeVoice(int voice, int date)
+    {
+        if (fState[voice] == kReleaseList && fDate[voice] == date) {
+            setState(voice, kFreeList);
+        }
+    }
+
+};
+
+#ifdef POLY_THREADS
+
+/**
+ * Parallel voice rendering (compiled with -DPOLY_THREADS, and linked with -lpthread).
+ *
+ * Adapted from the DSPThread/TaskQueue design of architecture/scheduler.cpp: for each audio block, the audio thread
+ * publishes a list of tasks, wakes up the workers, takes tasks itself from the shared task counter until none is left,
+ * then waits for the tasks taken by the workers to be finished. The task counter is tagged with the block number,
+ * so that a worker woken up late can never take a task of the following block.
+ * Like the idle workers of the scheduler, the audio thread spins for a while on the finished tasks counter,
+ * then is parked on a semaphore posted by the worker finishing the last task.
+ */
+
+#define VOICE_THREAD_PRIORITY 60
+#define VOICE_MAX_SPIN 2048     // in pause loops
+#define VOICE_WAITING (1ULL << 32)
+
+// Hints the processor that the thread is spinning
+static inline void voice_pause()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__arm__) || defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+class voice_semaphore {
+
+    private:
+
+    #ifdef __APPLE__
+        semaphore_t fSemaphore;
+    #else
+        sem_t fSemaphore;
+    #endif
+
+    public:
+
+    #ifdef __APPLE__
+        voice_semaphore() { semaphore_create(mach_task_self(), &fSemaphore, SYNC_POLICY_FIFO, 0); }
+        ~voice_semaphore() { semaphore_destroy(mach_task_self(), fSemaphore); }
+        void post() { semaphore_signal(fSemaphore); }
+        void wait() { semaphore_wait(fSemaphore); }
+    #else
+        voice_semaphore() { sem_init(&fSemaphore, 0, 0); }
+        ~voice_semaphore() { sem_destroy(&fSemaphore); }
+        void post() { sem_post(&fSemaphore); }
+        void wait() { while (sem_wait(&fSemaphore) != 0 && errno == EINTR) {} }
+    #endif
+
+};
+
+typedef void (*voice_task)(int task, void* arg);
+
+class voice_thread_pool {
+
+    private:
+
+        struct worker {
+            voice_thread_pool* fPool;
+            pthread_t fThread;
+            voice_semaphore fSemaphore;
+            int fPriority;  // Scheduling priority already applied to the thread
+        };
+
+        std::vector<worker*> fWorkers;
+        voice_task fTask;
+        void* fArg;
+        std::atomic<bool> fRunning;
+
+        // Block number (32 bits), number of tasks (16 bits) and next task to take (16 bits)
+        std::atomic<unsigned long long> fWork;
+        std::atomic<int> fDone;
+
+        // Block number (32 bits) and VOICE_WAITING, set by the audio thread before being parked on 'fDoneSemaphore',
+        // cleared by the worker which posts it. A worker late from a previous block cannot match it.
+        std::atomic<unsigned long long> fWaiting;
+        voice_semaphore fDoneSemaphore;
+
+        // Scheduling of the audio thread, followed by the workers
+        std::atomic<int> fPolicy;
+        std::atomic<int> fPriority;
+
+        static void* run(void* arg)
+        {
+            worker* self = static_cast<worker*>(arg);
+            voice_thread_pool* pool = self->fPool;
+            AVOIDDENORMALS;
+            while (true) {
+                self->fSemaphore.wait();
+                if (!pool->fRunning.load(std::memory_order_acquire)) break;
+                int priority = pool->fPriority.load(std::memory_order_relaxed);
+                if (self->fPriority != priority) {
+                    // Same priority as the audio thread, so that it can yield to a worker running a task
+                    struct sched_param param;
+                    memset(&param, 0, sizeof(param));
+                    param.sched_priority = priority;
+                    pthread_setschedparam(pthread_self(), pool->fPolicy.load(std::memory_order_relaxed), &param);
+                    self->fPriority = priority;
+                }
+                pool->runTasks();
+            }
+            return NULL;
+        }
+
+        bool start(worker* self)
+        {
+            pthread_attr_t attributes;
+            struct sched_param param;
+            pthread_attr_init(&attributes);
+            pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_JOINABLE);
+            pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+            pthread_attr_setschedpolicy(&attributes, SCHED_FIFO);
+            memset(&param, 0, sizeof(param));
+            param.sched_priority = VOICE_THREAD_PRIORITY;
+            pthread_attr_setschedparam(&attributes, &param);
+            self->fPriority = VOICE_THREAD_PRIORITY;
+            int res = pthread_create(&self->fThread, &attributes, run, self);
+            pthread_attr_destroy(&attributes);
+            if (res != 0) {
+                // Real-time scheduling not allowed: use the default one
+                self->fPriority = 0;
+                res = pthread_create(&self->fThread, NULL, run, self);
+            }
+            return (res == 0);
+        }
+
+        void runTasks()
+        {
+            unsigned long long work = fWork.load(std::memory_order_acquire);
+            while (true) {
+                int next = int(work & 0xFFFF);
+                int count = int((work >> 16) & 0xFFFF);
+                if (next >= count) return;
+                if (fWork.compare_exchange_weak(work, work + 1, std::memory_order_acquire, std::memory_order_acquire)) {
+                    fTask(next, fArg);
+                    // The last finished task wakes up the audio thread if it is parked for this block
+                    if (fDone.fetch_add(1, std::memory_order_seq_cst) + 1 == count) {
+                        unsigned long long waiting = (work >> 32) | VOICE_WAITING;
+                        if (fWaiting.compare_exchange_strong(waiting, 0, std::memory_order_seq_cst)) {
+                            fDoneSemaphore.post();
+                        }
+                    }
+                    work = fWork.load(std::memory_order_acquire);
+                }
+            }
+        }
+
+    public:
+
+        // 'threads' workers are added to the audio thread
+        voice_thread_pool(int threads, voice_task task, void* arg)
+        : fTask(task), fArg(arg), fRunning(true), fWork(0), fDone(0), fWaiting(0), fPolicy(SCHED_OTHER), fPriority(0)
+        {
+            for (int i = 0; i < threads; i++) {
+                worker* self = new worker();
+                self->fPool = this;
+                if (start(self)) {
+                    fWorkers.push_back(self);
+                } else {
+                    delete self;
+                    break;
+                }
+            }
+        }
+
+        virtual ~voice_thread_pool()
+        {
+            fRunning.store(false, std::memory_order_release);
+            for (size_t i = 0; i < fWorkers.size(); i++) {
+                fWorkers[i]->fSemaphore.post();
+                pthread_join(fWorkers[i]->fThread, NULL);
+                delete fWorkers[i];
+            }
+        }
+
+        int getNumThreads() { return int(fWorkers.size()) + 1; }
+
+        // Audio thread : runs tasks [0..count-1] and returns when all of them are finished
+        void compute(int count)
+        {
+            if (count == 0) return;
+
+            // Follow the scheduling of the audio thread
+            int policy;
+            struct sched_param param;
+            if (pthread_getschedparam(pthread_self(), &policy, &param) == 0
+                && (policy == SCHED_FIFO || policy == SCHED_RR)) {
+                fPolicy.store(policy, std::memory_order_relaxed);
+                fPriority.store(param.sched_priority, std::memory_order_relaxed);
+            }
+
+            fDone.store(0, std::memory_order_relaxed);
+            unsigned long long work = fWork.load(std::memory_order_relaxed);
+            unsigned long long block = ((work >> 32) + 1) & 0xFFFFFFFF;
+            // The voices state is published to the workers (release)
+            fWork.store((block << 32) | ((unsigned long long)count << 16), std::memory_order_release);
+
+            int wake = std::min(int(fWorkers.size()), count - 1);
+            for (int i = 0; i < wake; i++) {
+                fWorkers[i]->fSemaphore.post();
+            }
+            runTasks();
+
+            // Bounded spin, then parked until the last task is finished
+            for (int spin = 0; spin < VOICE_MAX_SPIN; spin++) {
+                if (fDone.load(std::memory_order_acquire) == count) return;
+                voice_pause();
+            }
+            unsigned long long waiting = block | VOICE_WAITING;
+            fWaiting.store(waiting, std::memory_order_seq_cst);
+            // Either the last worker of this block sees 'fWaiting' and posts, or the tasks are seen finished here.
+            // If both happen, the worker has cleared 'fWaiting' and its post has to be consumed.
+            if (fDone.load(std::memory_order_seq_cst) < count
+                || !fWaiting.compare_exchange_strong(waiting, 0, std::memory_order_seq_cst)) {
+                fDoneSemaphore.wait();
+            }
+        }
+
+};
+
+#endif
+
 /**
  * Base class for MIDI controllable DSP.
  */
@@ -375,15 +748,112 @@ class dsp_poly : public decorator_dsp, public midi {
  * Polyphonic DSP: groups a set of DSP to be played together or triggered by MIDI.
  *
  * All voices are preallocated by cloning the single DSP voice given at creation time.
- * Dynamic voice allocation is done in 'getFreeVoice'
+ * Dynamic voice allocation is done by the control thread (typically the MIDI thread) in 'fAllocator',
+ * and the resulting voice events are sent to the audio thread with a lock-free ring buffer,
+ * to be applied at the beginning of the next audio block. The voices whose release is finished
+ * are given back to the control thread the same way. So the MIDI API has to be called from a single
+ * control thread, and the audio thread never waits or allocates memory.
+ * The "Panic" button is changed by the GUI thread: it only increments 'fPanicRequests', the audio thread
+ * then immediately stops all voices, and the control thread resets the allocator at its next call.
+ * Define POLY_DEBUG to trace the voice stealing.
  */
 
 class mydsp_poly : public dsp_voice_group, public dsp_poly {
 
-    private:
+    protected:
 
         FAUSTFLOAT** fMixBuffer;
-        int fDate;
+
+        voice_allocator fAllocator;
+        ringbuffer_t* fEvents;      // Voice events, from the control thread to the audio thread
+        ringbuffer_t* fFreeVoices;  // Voices whose release is finished, from the audio thread to the control thread
+
+        std::atomic<int> fPanicRequests;    // Incremented by the GUI thread
+        int fAudioPanics;               // Panic requests applied by the audio thread
+        int fControlPanics;             // Panic requests applied by the control thread
+
+    #ifdef POLY_THREADS
+        voice_thread_pool* fThreadPool;
+        std::vector<FAUSTFLOAT**> fVoiceBuffers;    // Each voice is rendered in its own buffer
+        std::vector<int> fTasks;                    // Voices to render in the current block, in voice order
+        int fTaskCount;
+        FAUSTFLOAT** fTaskInputs;
+
+        static void renderVoice(int task, void* arg)
+        {
+            mydsp_poly* poly = static_cast<mydsp_poly*>(arg);
+            int index = poly->fTasks[task];
+            dsp_voice* voice = poly->fVoiceTable[index];
+            FAUSTFLOAT** buffer = poly->fVoiceBuffers[index];
+            if (poly->fVoiceControl) {
+                voice->play(poly->fTaskCount, poly->fTaskInputs, buffer);
+                voice->fLevel = poly->voiceLevel(poly->fTaskCount, buffer);
+            } else {
+                voice->compute(poly->fTaskCount, poly->fTaskInputs, buffer);
+            }
+        }
+
+        inline FAUSTFLOAT voiceLevel(int count, FAUSTFLOAT** outputBuffer)
+        {
+            FAUSTFLOAT level = 0;
+            for (int i = 0; i < getNumOutputs(); i++) {
+                FAUSTFLOAT* outChannel = outputBuffer[i];
+                for (int j = 0; j < count; j++) {
+                    level = FLOAT_MAX(level, (FAUSTFLOAT)fabs(outChannel[j]));
+                }
+            }
+            return level;
+        }
+
+        // The voices are summed in voice order, so the result is the same as the serial rendering
+        inline void sumVoice(int count, FAUSTFLOAT** outputBuffer, FAUSTFLOAT** mixBuffer)
+        {
+            for (int i = 0; i < getNumOutputs(); i++) {
+                FAUSTFLOAT* mixChannel = mixBuffer[i];
+                FAUSTFLOAT* outChannel = outputBuffer[i];
+                for (int j = 0; j < count; j++) {
+                    mixChannel[j] += outChannel[j];
+                }
+            }
+        }
+
+        void computeParallel(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            fTasks.clear();
+            for (size_t i = 0; i < fVoiceTable.size(); i++) {
+                if (!fVoiceControl || fVoiceTable[i]->fNote != kFreeVoice) {
+                    fTasks.push_back(int(i));
+                }
+            }
+            fTaskCount = count;
+            fTaskInputs = inputs;
+            fThreadPool->compute(int(fTasks.size()));
+
+            for (size_t task = 0; task < fTasks.size(); task++) {
+                int i = fTasks[task];
+                dsp_voice* voice = fVoiceTable[i];
+                sumVoice(count, fVoiceBuffers[i], outputs);
+                if (fVoiceControl && (voice->fLevel < VOICE_STOP_LEVEL) && (voice->fNote == kReleaseVoice)) {
+                    voice->fNote = kFreeVoice;
+                    voice_event event = { kVoiceStop, i, kNoVoice, voice->fDate, 0.f };
+                    writeEvent(fFreeVoices, event);
+                }
+            }
+        }
+
+        void deleteThreads()
+        {
+            delete fThreadPool;
+            fThreadPool = NULL;
+            for (size_t i = 0; i < fVoiceBuffers.size(); i++) {
+                for (int chan = 0; chan < getNumOutputs(); chan++) {
+                    delete[] fVoiceBuffers[i][chan];
+                }
+                delete[] fVoiceBuffers[i];
+            }
+            fVoiceBuffers.clear();
+        }
+    #endif
 
         inline FAUSTFLOAT mixVoice(int count, FAUSTFLOAT** outputBuffer, FAUSTFLOAT** mixBuffer)
         {
@@ -405,89 +875,144 @@ class mydsp_poly : public dsp_voice_group, public dsp_poly {
                 memset(mixBuffer[i], 0, count * sizeof(FAUSTFLOAT));
             }
         }
-    
-        inline int getPlayingVoice(int pitch)
+
+        // Ring buffers are written by complete events, but possibly read in two parts
+        static inline bool writeEvent(ringbuffer_t* buffer, const voice_event& event)
         {
-            int voice_playing = kNoVoice;
-            int oldest_date_playing = INT_MAX;
-            
-            for (size_t i = 0; i < fVoiceTable.size(); i++) {
-                if (fVoiceTable[i]->fNote == pitch) {
-                    // Keeps oldest playing voice
-                    if (fVoiceTable[i]->fDate < oldest_date_playing) {
-                        oldest_date_playing = fVoiceTable[i]->fDate;
-                        voice_playing = i;
-                    }
-                }
+            if (ringbuffer_write_space(buffer) >= sizeof(voice_event)) {
+                ringbuffer_write(buffer, (const char*)&event, sizeof(voice_event));
+                return true;
+            } else {
+                return false;
             }
-            
-            return voice_playing;
         }
-    
-        // Always returns a voice
-        inline int getFreeVoice()
+
+        static inline bool readEvent(ringbuffer_t* buffer, voice_event& event)
         {
-            int voice = kNoVoice;
-            
-            // Looks for the first available voice
-            for (size_t i = 0; i < fVoiceTable.size(); i++) {
-                if (fVoiceTable[i]->fNote == kFreeVoice) {
-                    voice = i;
-                    goto result;
+            if (ringbuffer_read_space(buffer) >= sizeof(voice_event)) {
+                ringbuffer_read(buffer, (char*)&event, sizeof(voice_event));
+                return true;
+            } else {
+                return false;
+            }
+        }
+
+        // Control thread : takes back the voices whose release is finished, and applies a pending panic
+        inline void updateFreeVoices()
+        {
+            voice_event event;
+            while (readEvent(fFreeVoices, event)) {
+                fAllocator.freeVoice(event.fVoice, event.fDate);
+            }
+            int panic = fPanicRequests.load(std::memory_order_acquire);
+            if (panic != fControlPanics && stopVoices(true)) {
+                fControlPanics = panic;
+            }
+        }
+
+        // Control thread : sends a kAllVoices event, returns false if the event queue is full
+        inline bool stopVoices(bool hard)
+        {
+            voice_event event = { (hard) ? kVoiceStop : kVoiceOff, kAllVoices, kNoVoice, 0, 0.f };
+            if (!writeEvent(fEvents, event)) {
+                return false;
+            }
+            int voice;
+            if (hard) {
+                fAllocator.reset();
+            } else {
+                while ((voice = fAllocator.fLists[voice_allocator::kPlayingList].fHead) != kNoVoice) {
+                    fAllocator.setState(voice, voice_allocator::kReleaseList);
                 }
             }
+            return true;
+        }
 
-            {
-                // Otherwise steal one
-                int voice_release = kNoVoice;
-                int voice_playing = kNoVoice;
-                
-                int oldest_date_release = INT_MAX;
-                int oldest_date_playing = INT_MAX;
+        // Control thread : allocates a voice and sends its kVoiceOn event, returns kNoVoice if the event queue is full
+        inline int keyOnVoice(int pitch, float velocity)
+        {
+            updateFreeVoices();
+            if (ringbuffer_write_space(fEvents) < sizeof(voice_event)) {
+                return kNoVoice;
+            }
+        #ifdef POLY_DEBUG
+            if (fAllocator.fLists[voice_allocator::kFreeList].fHead == kNoVoice) {
+                int steal = fAllocator.fLists[voice_allocator::kReleaseList].fHead;
+                bool release = (steal != kNoVoice);
+                if (!release) steal = fAllocator.fLists[voice_allocator::kPlayingList].fHead;
+                std::cout << ((release) ? "Steal release voice" : "Steal playing voice") << " : voice_date " << fAllocator.fDate[steal] << " cur_date = " << fAllocator.fCurDate << " voice = " << steal << std::endl;
+            }
+        #endif
+            int voice = fAllocator.allocate(pitch);
+            voice_event event = { kVoiceOn, voice, pitch, fAllocator.fDate[voice], velocity };
+            writeEvent(fEvents, event);
+            return voice;
+        }
 
-                // Scan all voices
-                for (size_t i = 0; i < fVoiceTable.size(); i++) {
-                    if (fVoiceTable[i]->fNote == kReleaseVoice) {
-                        // Keeps oldest release voice
-                        if (fVoiceTable[i]->fDate < oldest_date_release) {
-                            oldest_date_release = fVoiceTable[i]->fDate;
-                            voice_release = i;
-                        }
+        // Control thread : releases a playing voice
+        inline void keyOffVoice(int voice)
+        {
+            voice_event event = { kVoiceOff, voice, fAllocator.fPitch[voice], fAllocator.fDate[voice], 0.f };
+            if (writeEvent(fEvents, event)) {
+                fAllocator.setState(voice, voice_allocator::kReleaseList);
+            }
+        }
+
+        // Audio thread : applies the events sent since the previous block
+        inline void applyEvent(int index, const voice_event& event)
+        {
+            dsp_voice* voice = fVoiceTable[index];
+            switch (event.fType) {
+                case kVoiceOn:
+                    voice->fDate = event.fDate;
+                    if (event.fVelocity >= 0.f) {
+                        voice->keyOn(event.fPitch, event.fVelocity, true);
                     } else {
-                        // Otherwise keeps oldest playing voice
-                        if (fVoiceTable[i]->fDate < oldest_date_playing) {
-                            oldest_date_playing = fVoiceTable[i]->fDate;
-                            voice_playing = i;
-                        }
+                        // Voice controlled with the polyphonic API
+                        voice->fNote = kActiveVoice;
+                        voice->fTrigger = true;
+                    }
+                    break;
+                case kVoiceOff:
+                    if (voice->fNote != kFreeVoice) {
+                        voice->keyOff();
+                        // keyOn and keyOff in the same block : the trigger would set the gate again
+                        voice->fTrigger = false;
+                    }
+                    break;
+                case kVoiceStop:
+                    voice->keyOff(true);
+                    break;
+            }
+        }
+
+        inline void applyEvents()
+        {
+            voice_event event;
+            while (readEvent(fEvents, event)) {
+                if (event.fVoice == kAllVoices) {
+                    for (size_t i = 0; i < fVoiceTable.size(); i++) {
+                        applyEvent(int(i), event);
                     }
-                }
-            
-                // Then decide which one to steal
-                if (oldest_date_release != INT_MAX) {
-                    std::cout << "Steal release voice : voice_date " << fVoiceTable[voice_release]->fDate << " cur_date = " << fDate << " voice = " << voice_release << std::endl;
-                    voice = voice_release;
-                    goto result;
-                } else if (oldest_date_playing != INT_MAX) {
-                    std::cout << "Steal playing voice : voice_date " << fVoiceTable[voice_playing]->fDate << " cur_date = " << fDate << " voice = " << voice_playing << std::endl;
-                    voice = voice_playing;
-                    goto result;
                 } else {
-                    assert(false);
-                    return kNoVoice;
+                    applyEvent(event.fVoice, event);
+                }
+            }
+            // The voices are given back to the control thread by 'fAllocator.reset' when it sees the same request
+            int panic = fPanicRequests.load(std::memory_order_acquire);
+            if (panic != fAudioPanics) {
+                fAudioPanics = panic;
+                for (size_t i = 0; i < fVoiceTable.size(); i++) {
+                    fVoiceTable[i]->keyOff(true);
                 }
             }
-            
-        result:
-            fVoiceTable[voice]->fDate = fDate++;
-            fVoiceTable[voice]->fTrigger = true;    // So that envelop is always re-initialized
-            fVoiceTable[voice]->fNote = kActiveVoice;
-            return voice;
         }
 
+        // GUI thread : 'fEvents' and 'fAllocator' belong to the control thread, so the panic is only requested here
         static void panic(FAUSTFLOAT val, void* arg)
         {
             if (val == FAUSTFLOAT(1)) {
-                static_cast<mydsp_poly*>(arg)->allNotesOff(true);
+                static_cast<mydsp_poly*>(arg)->fPanicRequests.fetch_add(1, std::memory_order_release);
             }
         }
 
@@ -520,13 +1045,49 @@ class mydsp_poly : public dsp_voice_group, public dsp_poly {
                    int nvoices,
                    bool control = false,
                    bool group = true)
-        : dsp_voice_group(panic, this, control, group), dsp_poly(dsp)
+        : dsp_voice_group(panic, this, control, group), dsp_poly(dsp), fAllocator(nvoices)
+        {
+            std::vector< ::dsp*> voices;
+            for (int i = 0; i < nvoices; i++) {
+                voices.push_back(dsp->clone());
+            }
+            createVoices(voices);
+        }
+
+    protected:
+
+        /**
+         * Constructor with already created voices, for subclasses whose voices are not clones of the DSP.
+         *
+         * @param dsp - the dsp describing one voice (inputs, outputs). Beware: mydsp_poly will use and finally delete the pointer.
+         * @param voices - the dsp of each voice. Beware: mydsp_poly will use and finally delete the pointers.
+         * @param control - as in the public constructor
+         * @param group - as in the public constructor
+         */
+        mydsp_poly(dsp* dsp,
+                   const std::vector< ::dsp*>& voices,
+                   bool control,
+                   bool group)
+        : dsp_voice_group(panic, this, control, group), dsp_poly(dsp), fAllocator(int(voices.size()))
+        {
+            createVoices(voices);
+        }
+
+        void createVoices(const std::vector<dsp*>& voices)
         {
-            fDate = 0;
+            fEvents = ringbuffer_create(VOICE_EVENT_SIZE * sizeof(voice_event));
+            fFreeVoices = ringbuffer_create(VOICE_EVENT_SIZE * sizeof(voice_event));
+            fPanicRequests.store(0);
+            fAudioPanics = fControlPanics = 0;
+        #ifdef POLY_THREADS
+            fThreadPool = NULL;
+            fTaskCount = 0;
+            fTaskInputs = NULL;
+        #endif
 
             // Create voices
-            for (int i = 0; i < nvoices; i++) {
-                addVoice(new dsp_voice(dsp->clone()));
+            for (size_t i = 0; i < voices.size(); i++) {
+                addVoice(new dsp_voice(voices[i]));
             }
 
             // Init audio output buffers
@@ -538,12 +1099,19 @@ class mydsp_poly : public dsp_voice_group, public dsp_poly {
             dsp_voice_group::init();
         }
 
+    public:
+
         virtual ~mydsp_poly()
         {
+        #ifdef POLY_THREADS
+            deleteThreads();
+        #endif
             for (int i = 0; i < getNumOutputs(); i++) {
                 delete[] fMixBuffer[i];
             }
             delete[] fMixBuffer;
+            ringbuffer_free(fEvents);
+            ringbuffer_free(fFreeVoices);
         }
 
         // DSP API
@@ -606,9 +1174,44 @@ class mydsp_poly : public dsp_voice_group, public dsp_poly {
 
         virtual mydsp_poly* clone()
         {
-            return new mydsp_poly(fDSP->clone(), int(fVoiceTable.size()), fVoiceControl, fGroupControl);
+            mydsp_poly* poly = new mydsp_poly(fDSP->clone(), int(fVoiceTable.size()), fVoiceControl, fGroupControl);
+        #ifdef POLY_THREADS
+            poly->setThreads(getThreads());
+        #endif
+            return poly;
+        }
+
+    #ifdef POLY_THREADS
+        /**
+         * Render the voices with 'threads' threads (the audio thread and 'threads - 1' workers),
+         * or serially if 'threads' is 1. A negative value uses all available processors.
+         * To be called when the audio is not running, like 'init'.
+         *
+         * @return the actual number of threads.
+         */
+        int setThreads(int threads)
+        {
+            deleteThreads();
+            if (threads < 0) {
+                threads = int(sysconf(_SC_NPROCESSORS_ONLN));
+            }
+            if (threads > 1) {
+                for (size_t i = 0; i < fVoiceTable.size(); i++) {
+                    FAUSTFLOAT** buffer = new FAUSTFLOAT*[getNumOutputs()];
+                    for (int chan = 0; chan < getNumOutputs(); chan++) {
+                        buffer[chan] = new FAUSTFLOAT[MIX_BUFFER_SIZE];
+                    }
+                    fVoiceBuffers.push_back(buffer);
+                }
+                fTasks.reserve(fVoiceTable.size());
+                fThreadPool = new voice_thread_pool(threads - 1, renderVoice, this);
+            }
+            return getThreads();
         }
 
+        int getThreads() { return (fThreadPool) ? fThreadPool->getNumThreads() : 1; }
+    #endif
+
         void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
         {
             assert(count < MIX_BUFFER_SIZE);
@@ -616,6 +1219,16 @@ class mydsp_poly : public dsp_voice_group, public dsp_poly {
             // First clear the outputs
             clearOutput(count, outputs);
 
+            // Then apply the MIDI events received since the previous block
+            applyEvents();
+
+        #ifdef POLY_THREADS
+            if (fThreadPool) {
+                computeParallel(count, inputs, outputs);
+                return;
+            }
+        #endif
+
             if (fVoiceControl) {
                 // Mix all playing voices
                 for (size_t i = 0; i < fVoiceTable.size(); i++) {
@@ -624,9 +1237,11 @@ class mydsp_poly : public dsp_voice_group, public dsp_poly {
                         voice->play(count, inputs, fMixBuffer);
                         // Mix it in result
                         voice->fLevel = mixVoice(count, fMixBuffer, outputs);
-                        // Check the level to possibly set the voice in kFreeVoice again
+                        // Check the level to possibly set the voice in kFreeVoice again, and give it back to the control thread
                         if ((voice->fLevel < VOICE_STOP_LEVEL) && (voice->fNote == kReleaseVoice)) {
                             voice->fNote = kFreeVoice;
+                            voice_event event = { kVoiceStop, int(i), kNoVoice, voice->fDate, 0.f };
+                            writeEvent(fFreeVoices, event);
                         }
                     }
                 }
@@ -647,22 +1262,26 @@ class mydsp_poly : public dsp_voice_group, public dsp_poly {
         // Terminate all active voices, gently or immediately (depending of 'hard' value)
         void allNotesOff(bool hard = false)
         {
-            for (size_t i = 0; i < fVoiceTable.size(); i++) {
-                fVoiceTable[i]->keyOff(hard);
-            }
+            updateFreeVoices();
+            stopVoices(hard);
         }
 
         // Additional polyphonic API
         MapUI* newVoice()
         {
-            return fVoiceTable[getFreeVoice()];
+            int voice = keyOnVoice(kNoVoice, -1.f);
+            return (voice != kNoVoice) ? fVoiceTable[voice] : 0;
         }
 
         void deleteVoice(MapUI* voice)
         {
             std::vector<dsp_voice*>::iterator it = find(fVoiceTable.begin(), fVoiceTable.end(), reinterpret_cast<dsp_voice*>(voice));
             if (it != fVoiceTable.end()) {
-                (*it)->keyOff();
+                int index = int(it - fVoiceTable.begin());
+                updateFreeVoices();
+                if (fAllocator.fState[index] == voice_allocator::kPlayingList) {
+                    keyOffVoice(index);
+                }
             } else {
                 std::cout << "Voice not found\n";
             }
@@ -675,9 +1294,8 @@ class mydsp_poly : public dsp_voice_group, public dsp_poly {
         MapUI* keyOn(int channel, int pitch, int velocity)
         {
             if (checkPolyphony()) {
-                int voice = getFreeVoice();
-                fVoiceTable[voice]->keyOn(pitch, velocity, true);
-                return fVoiceTable[voice];
+                int voice = keyOnVoice(pitch, float(velocity)/127.f);
+                return (voice != kNoVoice) ? fVoiceTable[voice] : 0;
             } else {
                 return 0;
             }
@@ -686,11 +1304,11 @@ class mydsp_poly : public dsp_voice_group, public dsp_poly {
         void keyOff(int channel, int pitch, int velocity = 127)
         {
             if (checkPolyphony()) {
-                int voice = getPlayingVoice(pitch);
+                updateFreeVoices();
+                // The voice may have been stolen
+                int voice = fAllocator.getPlayingVoice(pitch);
                 if (voice != kNoVoice) {
-                    fVoiceTable[voice]->keyOff();
-                } else {
-                    std::cout << "Playing pitch = " << pitch << " not found\n";
+                    keyOffVoice(voice);
                 }
             }
         }
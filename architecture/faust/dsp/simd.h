@@ -0,0 +1,472 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __faust_simd__
+#define __faust_simd__
+
+#include <string.h>
+#include <stdlib.h>
+#include <cmath>
+#include <algorithm>
+
+//----------------------------------------------------------------
+//  Portable vector types used by the code generated with the -simd
+//  option (C++ backend, vector mode):
+//
+//  - the vectorizable loops compute FAUST_SIMD_SIZE frames at once
+//  - the independent recursive loops of same structure compute one
+//    loop in each lane of a vec<T, N>
+//
+//  and by the -batch <N> option (C++ backend, scalar mode), where each
+//  lane of a vec<T, N> field holds the state of one of the N instances.
+//
+//  The GCC/Clang vector extensions are used when available, otherwise
+//  the operations are done lane by lane. The math functions are
+//  always computed lane by lane.
+//----------------------------------------------------------------
+
+#ifndef FAUST_SIMD_SIZE
+#if defined(__AVX512F__)
+#define FAUST_SIMD_SIZE 16
+#elif defined(__AVX__)
+#define FAUST_SIMD_SIZE 8
+#else
+#define FAUST_SIMD_SIZE 4
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FAUST_SIMD_NATIVE 1
+#define FAUST_SIMD_APPLY(native, lane) native
+#else
+#define FAUST_SIMD_NATIVE 0
+#define FAUST_SIMD_APPLY(native, lane) for (int k = 0; k < N; k++) { lane; }
+#endif
+
+namespace faust_simd {
+
+// Non deduced scalar parameter: in 'vec<float> * 0.5f' or 'vec<int> + 1', the vector gives the type
+template <typename T>
+struct scalar {
+    typedef T type;
+};
+
+// Integer type of the same size than T, used for masks
+template <typename T>
+struct mask_of {
+    typedef int type;
+};
+template <>
+struct mask_of<double> {
+    typedef long long type;
+};
+
+template <typename T, int N = FAUST_SIMD_SIZE>
+struct vec {
+#if FAUST_SIMD_NATIVE
+    // Aligned as T, so that vectors can be fields of a class allocated with 'new' (the alignment of 'new' being
+    // the one of the standard types before C++17)
+    typedef T type __attribute__((vector_size(N * sizeof(T)), aligned(sizeof(T))));
+    typedef typename mask_of<T>::type mask_elt;
+    typedef mask_elt mask __attribute__((vector_size(N * sizeof(mask_elt))));
+#else
+    struct type {
+        T fLanes[N];
+        T& operator[](int k) { return fLanes[k]; }
+        const T& operator[](int k) const { return fLanes[k]; }
+    };
+#endif
+
+    type v;
+
+    vec() {}
+    vec(T a) { FAUST_SIMD_APPLY(v = a - type{}, v[k] = a); }
+
+    T operator[](int k) const { return v[k]; }
+};
+
+// Arithmetic and bitwise operators
+#define FAUST_SIMD_BINOP(OP)                                                                                   \
+    template <typename T, int N>                                                                               \
+    inline vec<T, N> operator OP(const vec<T, N>& a, const vec<T, N>& b)                                       \
+    {                                                                                                          \
+        vec<T, N> r;                                                                                           \
+        FAUST_SIMD_APPLY(r.v = a.v OP b.v, r.v[k] = a.v[k] OP b.v[k]);                                         \
+        return r;                                                                                              \
+    }                                                                                                          \
+    template <typename T, int N>                                                                               \
+    inline vec<T, N> operator OP(const vec<T, N>& a, typename scalar<T>::type b)                               \
+    {                                                                                                          \
+        return a OP vec<T, N>(b);                                                                              \
+    }                                                                                                          \
+    template <typename T, int N>                                                                               \
+    inline vec<T, N> operator OP(typename scalar<T>::type a, const vec<T, N>& b)                               \
+    {                                                                                                          \
+        return vec<T, N>(a) OP b;                                                                              \
+    }
+
+FAUST_SIMD_BINOP(+)
+FAUST_SIMD_BINOP(-)
+FAUST_SIMD_BINOP(*)
+FAUST_SIMD_BINOP(/)
+FAUST_SIMD_BINOP(%)
+FAUST_SIMD_BINOP(&)
+FAUST_SIMD_BINOP(|)
+FAUST_SIMD_BINOP(^)
+FAUST_SIMD_BINOP(<<)
+FAUST_SIMD_BINOP(>>)
+
+template <typename T, int N>
+inline vec<T, N> operator-(const vec<T, N>& a)
+{
+    vec<T, N> r;
+    FAUST_SIMD_APPLY(r.v = -a.v, r.v[k] = -a.v[k]);
+    return r;
+}
+
+// Comparisons give 0 or 1 in each lane, like the scalar code
+#define FAUST_SIMD_CMPOP(OP)                                                                                   \
+    template <typename T, int N>                                                                               \
+    inline vec<int, N> operator OP(const vec<T, N>& a, const vec<T, N>& b)                                     \
+    {                                                                                                          \
+        vec<int, N> r;                                                                                         \
+        FAUST_SIMD_APPLY(r.v = -__builtin_convertvector(a.v OP b.v, typename vec<int, N>::type),               \
+                         r.v[k] = a.v[k] OP b.v[k]);                                                           \
+        return r;                                                                                              \
+    }                                                                                                          \
+    template <typename T, int N>                                                                               \
+    inline vec<int, N> operator OP(const vec<T, N>& a, typename scalar<T>::type b)                             \
+    {                                                                                                          \
+        return a OP vec<T, N>(b);                                                                              \
+    }                                                                                                          \
+    template <typename T, int N>                                                                               \
+    inline vec<int, N> operator OP(typename scalar<T>::type a, const vec<T, N>& b)                             \
+    {                                                                                                          \
+        return vec<T, N>(a) OP b;                                                                              \
+    }
+
+FAUST_SIMD_CMPOP(<)
+FAUST_SIMD_CMPOP(>)
+FAUST_SIMD_CMPOP(<=)
+FAUST_SIMD_CMPOP(>=)
+FAUST_SIMD_CMPOP(==)
+FAUST_SIMD_CMPOP(!=)
+
+// Type conversion, lane by lane
+template <typename R, typename T, int N>
+inline vec<R, N> cast(const vec<T, N>& a)
+{
+    vec<R, N> r;
+    FAUST_SIMD_APPLY(r.v = __builtin_convertvector(a.v, typename vec<R, N>::type), r.v[k] = R(a.v[k]));
+    return r;
+}
+template <typename R, typename T>
+inline R cast(T a)
+{
+    return R(a);
+}
+
+// 'c ? a : b' in each lane
+template <typename T, int N>
+inline vec<T, N> select(const vec<int, N>& c, const vec<T, N>& a, const vec<T, N>& b)
+{
+    vec<T, N> r;
+#if FAUST_SIMD_NATIVE
+    typedef typename vec<T, N>::mask mask;
+    mask m = __builtin_convertvector(c.v, mask) != 0;
+    r.v    = (typename vec<T, N>::type)((m & (mask)a.v) | (~m & (mask)b.v));
+#else
+    for (int k = 0; k < N; k++) r.v[k] = c.v[k] ? a.v[k] : b.v[k];
+#endif
+    return r;
+}
+template <typename T, int N>
+inline vec<T, N> select(const vec<int, N>& c, typename scalar<T>::type a, const vec<T, N>& b)
+{
+    return select(c, vec<T, N>(a), b);
+}
+template <typename T, int N>
+inline vec<T, N> select(const vec<int, N>& c, const vec<T, N>& a, typename scalar<T>::type b)
+{
+    return select(c, a, vec<T, N>(b));
+}
+template <typename T, int N>
+inline vec<T, N> select(const vec<int, N>& c, T a, typename scalar<T>::type b)
+{
+    return select(c, vec<T, N>(a), vec<T, N>(b));
+}
+template <typename T, int N>
+inline vec<T, N> select(int c, const vec<T, N>& a, const vec<T, N>& b)
+{
+    return c ? a : b;
+}
+template <typename T, int N>
+inline vec<T, N> select(int c, typename scalar<T>::type a, const vec<T, N>& b)
+{
+    return c ? vec<T, N>(a) : b;
+}
+template <typename T, int N>
+inline vec<T, N> select(int c, const vec<T, N>& a, typename scalar<T>::type b)
+{
+    return c ? a : vec<T, N>(b);
+}
+template <typename T>
+inline T select(int c, T a, T b)
+{
+    return c ? a : b;
+}
+
+// Memory access: contiguous (unaligned) frames, or indexed frames (tables, ring buffers)
+template <typename T>
+inline vec<T> load(const T* p)
+{
+    vec<T> r;
+    memcpy(&r.v, p, sizeof(r.v));
+    return r;
+}
+template <typename T, int N>
+inline void store(T* p, const vec<T, N>& a)
+{
+    memcpy(p, &a.v, sizeof(a.v));
+}
+template <typename T>
+inline void store(T* p, typename scalar<T>::type a)
+{
+    store(p, vec<T>(a));
+}
+template <typename T, int N>
+inline vec<T, N> gather(const T* p, const vec<int, N>& index)
+{
+    vec<T, N> r;
+    for (int k = 0; k < N; k++) r.v[k] = p[index.v[k]];
+    return r;
+}
+template <typename T, int N>
+inline void scatter(T* p, const vec<int, N>& index, const vec<T, N>& a)
+{
+    // In lane order, like the scalar loop when two frames write the same element
+    for (int k = 0; k < N; k++) p[index.v[k]] = a.v[k];
+}
+template <typename T, int N>
+inline void scatter(T* p, const vec<int, N>& index, typename scalar<T>::type a)
+{
+    scatter(p, index, vec<T, N>(a));
+}
+
+// Batched instances: 'lanes' is the table of the N channels of a same input or output, one by instance
+template <int N, typename T>
+inline vec<T, N> load_lanes(T* const* lanes, int index)
+{
+    vec<T, N> r;
+    for (int k = 0; k < N; k++) r.v[k] = lanes[k][index];
+    return r;
+}
+template <int N, typename T>
+inline void store_lanes(T* const* lanes, int index, const vec<T, N>& a)
+{
+    for (int k = 0; k < N; k++) lanes[k][index] = a.v[k];
+}
+template <int N, typename T>
+inline void store_lanes(T* const* lanes, int index, typename scalar<T>::type a)
+{
+    for (int k = 0; k < N; k++) lanes[k][index] = a;
+}
+
+// Batched instances: element 'index[k]' of the array of instance k (delay lines read at a different position by instance)
+template <typename T, int N>
+inline vec<T, N> lane_gather(const vec<T, N>* p, const vec<int, N>& index)
+{
+    vec<T, N> r;
+    for (int k = 0; k < N; k++) r.v[k] = p[index.v[k]].v[k];
+    return r;
+}
+template <typename T, int N>
+inline void lane_scatter(vec<T, N>* p, const vec<int, N>& index, const vec<T, N>& a)
+{
+    for (int k = 0; k < N; k++) p[index.v[k]].v[k] = a.v[k];
+}
+template <typename T, int N>
+inline void lane_scatter(vec<T, N>* p, const vec<int, N>& index, typename scalar<T>::type a)
+{
+    lane_scatter(p, index, vec<T, N>(a));
+}
+
+// Batched instances: the value of instance k, used as a control zone
+template <typename T, int N>
+inline T& lane(vec<T, N>& a, int k)
+{
+    return reinterpret_cast<T*>(&a.v)[k];
+}
+
+// Builds a vector from one value by lane
+template <typename T, int N, typename... Args>
+inline vec<T, N> make(Args... args)
+{
+    static_assert(sizeof...(Args) == N, "one value by lane is needed");
+    T         lanes[] = {T(args)...};
+    vec<T, N> r;
+    memcpy(&r.v, lanes, sizeof(r.v));
+    return r;
+}
+
+// The frame index of each lane, when the loop index is used as a value
+template <typename T>
+inline vec<T> ramp(T a)
+{
+    vec<T> r;
+    for (int k = 0; k < FAUST_SIMD_SIZE; k++) r.v[k] = a + T(k);
+    return r;
+}
+
+// Math functions, lane by lane
+#define FAUST_SIMD_FUN1(NAME)                                                                                  \
+    using std::NAME;                                                                                           \
+    template <typename T, int N>                                                                               \
+    inline vec<T, N> NAME(const vec<T, N>& a)                                                                  \
+    {                                                                                                          \
+        vec<T, N> r;                                                                                           \
+        for (int k = 0; k < N; k++) r.v[k] = std::NAME(a.v[k]);                                                \
+        return r;                                                                                              \
+    }
+
+#define FAUST_SIMD_FUN2(NAME)                                                                                  \
+    using std::NAME;                                                                                           \
+    template <typename T, int N>                                                                               \
+    inline vec<T, N> NAME(const vec<T, N>& a, const vec<T, N>& b)                                              \
+    {                                                                                                          \
+        vec<T, N> r;                                                                                           \
+        for (int k = 0; k < N; k++) r.v[k] = std::NAME(a.v[k], b.v[k]);                                       \
+        return r;                                                                                              \
+    }                                                                                                          \
+    template <typename T, int N>                                                                               \
+    inline vec<T, N> NAME(const vec<T, N>& a, typename scalar<T>::type b)                                      \
+    {                                                                                                          \
+        return NAME(a, vec<T, N>(b));                                                                          \
+    }                                                                                                          \
+    template <typename T, int N>                                                                               \
+    inline vec<T, N> NAME(typename scalar<T>::type a, const vec<T, N>& b)                                      \
+    {                                                                                                          \
+        return NAME(vec<T, N>(a), b);                                                                          \
+    }
+
+FAUST_SIMD_FUN1(abs)
+FAUST_SIMD_FUN1(fabs)
+FAUST_SIMD_FUN1(acos)
+FAUST_SIMD_FUN1(asin)
+FAUST_SIMD_FUN1(atan)
+FAUST_SIMD_FUN1(ceil)
+FAUST_SIMD_FUN1(cos)
+FAUST_SIMD_FUN1(exp)
+FAUST_SIMD_FUN1(exp2)
+FAUST_SIMD_FUN1(floor)
+FAUST_SIMD_FUN1(log)
+FAUST_SIMD_FUN1(log2)
+FAUST_SIMD_FUN1(log10)
+FAUST_SIMD_FUN1(rint)
+FAUST_SIMD_FUN1(round)
+FAUST_SIMD_FUN1(sin)
+FAUST_SIMD_FUN1(sqrt)
+FAUST_SIMD_FUN1(tan)
+
+FAUST_SIMD_FUN2(atan2)
+FAUST_SIMD_FUN2(fmod)
+FAUST_SIMD_FUN2(pow)
+FAUST_SIMD_FUN2(remainder)
+
+template <typename T>
+inline T exp10(T a)
+{
+    return std::pow(T(10), a);
+}
+template <typename T, int N>
+inline vec<T, N> exp10(const vec<T, N>& a)
+{
+    vec<T, N> r;
+    for (int k = 0; k < N; k++) r.v[k] = std::pow(T(10), a.v[k]);
+    return r;
+}
+
+// Other functions (generated or foreign ones), lane by lane
+template <typename R, typename A, int N>
+inline vec<R, N> apply(R (*fun)(A), const vec<A, N>& a)
+{
+    vec<R, N> r;
+    for (int k = 0; k < N; k++) r.v[k] = fun(a.v[k]);
+    return r;
+}
+template <typename R, typename A, typename B, int N>
+inline vec<R, N> apply(R (*fun)(A, B), const vec<A, N>& a, const vec<B, N>& b)
+{
+    vec<R, N> r;
+    for (int k = 0; k < N; k++) r.v[k] = fun(a.v[k], b.v[k]);
+    return r;
+}
+template <typename R, typename A, typename B, int N>
+inline vec<R, N> apply(R (*fun)(A, B), const vec<A, N>& a, typename scalar<B>::type b)
+{
+    return apply(fun, a, vec<B, N>(b));
+}
+template <typename R, typename A, typename B, int N>
+inline vec<R, N> apply(R (*fun)(A, B), typename scalar<A>::type a, const vec<B, N>& b)
+{
+    return apply(fun, vec<A, N>(a), b);
+}
+
+// min and max are computed with a comparison and a select
+using std::max;
+using std::min;
+
+template <typename T, int N>
+inline vec<T, N> min(const vec<T, N>& a, const vec<T, N>& b)
+{
+    return select(b < a, b, a);
+}
+template <typename T, int N>
+inline vec<T, N> min(const vec<T, N>& a, typename scalar<T>::type b)
+{
+    return min(a, vec<T, N>(b));
+}
+template <typename T, int N>
+inline vec<T, N> min(typename scalar<T>::type a, const vec<T, N>& b)
+{
+    return min(vec<T, N>(a), b);
+}
+template <typename T, int N>
+inline vec<T, N> max(const vec<T, N>& a, const vec<T, N>& b)
+{
+    return select(a < b, b, a);
+}
+template <typename T, int N>
+inline vec<T, N> max(const vec<T, N>& a, typename scalar<T>::type b)
+{
+    return max(a, vec<T, N>(b));
+}
+template <typename T, int N>
+inline vec<T, N> max(typename scalar<T>::type a, const vec<T, N>& b)
+{
+    return max(vec<T, N>(a), b);
+}
+
+}  // namespace faust_simd
+
+#endif
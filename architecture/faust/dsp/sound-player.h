@@ -25,16 +25,26 @@
 #define __sound_player__
 
 #include <sndfile.h>
+#include <string.h>
+#include <cmath>
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <vector>
+#include <atomic>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
 
 #include "faust/dsp/dsp.h"
-#include "faust/gui/ring-buffer.h"
+#include "faust/gui/meta.h"
 
 #define BUFFER_SIZE 512
-#define RING_BUFFER_SIZE BUFFER_SIZE * 32
-#define HALF_RING_BUFFER_SIZE RING_BUFFER_SIZE / 2
+#define RING_BUFFER_SIZE BUFFER_SIZE * 32       // Frames, a power of 2
+#define STREAM_READ_SIZE BUFFER_SIZE * 4        // Frames read at once by the I/O threads
+#define STREAM_THREADS 2                        // Number of I/O threads
+#define STREAM_PERIOD 1000                      // Wait of the I/O threads when no stream has to be read (usec)
 
 /**
  * LibSndfile based player
@@ -156,30 +166,33 @@ class sound_base_player : public dsp {
             m->declare("name", fFileName.c_str());
         }
         
-        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        // Plays 'count' frames from fCurFrames, possibly looping or stopping at the end of the file
+        void play(int count, FAUSTFLOAT** outputs)
         {
-            if (fPlayButton == FAUSTFLOAT(1) && fMutex.try_lock()) {
-                
-                int rcount = std::min(count, int(fInfo.frames - fCurFrames));
-                playSlice(rcount, fCurFrames, 0, outputs);
-                
-                if (rcount < count) {
-                    if (fLoopButton == FAUSTFLOAT(1)) {
-                        // Loop buffer
-                        playSlice(count - rcount, 0, rcount, outputs);
-                        fCurFrames = count - rcount;
-                    } else {
-                        // Otherwise clear end of buffer and stops
-                        clearSlice(count - rcount, rcount, outputs);
-                        fCurFrames =  FAUSTFLOAT(0);
-                        fPlayButton = 0;
-                    }
+            int rcount = std::min(count, int(fInfo.frames - fCurFrames));
+            playSlice(rcount, fCurFrames, 0, outputs);
+            
+            if (rcount < count) {
+                if (fLoopButton == FAUSTFLOAT(1)) {
+                    // Loop buffer
+                    playSlice(count - rcount, 0, rcount, outputs);
+                    fCurFrames = count - rcount;
                 } else {
-                    fCurFrames += count;
+                    // Otherwise clear end of buffer and stops
+                    clearSlice(count - rcount, rcount, outputs);
+                    fCurFrames =  FAUSTFLOAT(0);
+                    fPlayButton = 0;
                 }
-                
+            } else {
+                fCurFrames += count;
+            }
+        }
+    
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            if (fPlayButton == FAUSTFLOAT(1) && fMutex.try_lock()) {
+                play(count, outputs);
                 fMutex.unlock();
-                
             } else {
                 // Clear output
                 clearSlice(count, 0, outputs);
@@ -273,42 +286,192 @@ class sound_memory_player : public sound_base_player {
 };
 
 /**
- * DirectToDisk player
+ * A stream read by the I/O threads of sound_stream_pool.
  */
 
-class sound_dtd_player : public sound_base_player {
+struct sound_stream {
+
+    std::atomic<bool> fBusy;    // Set while an I/O thread reads the stream
+
+    sound_stream():fBusy(false) {}
+    virtual ~sound_stream() {}
+
+    // Whether the stream has to be read, and the time (in seconds) before its buffered frames run out
+    virtual bool needsRead(double& deadline) = 0;
+
+    // Called by a single I/O thread at a time
+    virtual void read() = 0;
+
+};
+
+/**
+ * The I/O threads shared by all DirectToDisk players: each thread reads the stream
+ * with the nearest deadline, or waits STREAM_PERIOD usec if no stream has to be read.
+ */
+
+class sound_stream_pool {
+
+    private:
+
+        std::vector<sound_stream*> fStreams;
+        std::vector<std::thread> fThreads;
+        std::mutex fMutex;
+        std::condition_variable fCond;
+        bool fRunning;
+
+        // Takes the stream with the nearest deadline, not already read by another thread
+        sound_stream* takeStream()
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            sound_stream* stream = nullptr;
+            double deadline = 0.;
+            for (size_t i = 0; i < fStreams.size(); i++) {
+                double cur_deadline;
+                if (!fStreams[i]->fBusy && fStreams[i]->needsRead(cur_deadline) && (!stream || cur_deadline < deadline)) {
+                    stream = fStreams[i];
+                    deadline = cur_deadline;
+                }
+            }
+            if (stream) stream->fBusy = true;
+            return stream;
+        }
+
+        void run()
+        {
+            while (true) {
+                sound_stream* stream = takeStream();
+                if (stream) {
+                    stream->read();
+                    stream->fBusy = false;
+                } else {
+                    std::unique_lock<std::mutex> lock(fMutex);
+                    if (!fRunning) break;
+                    fCond.wait_for(lock, std::chrono::microseconds(STREAM_PERIOD));
+                }
+            }
+        }
+
+        sound_stream_pool(int threads):fRunning(true)
+        {
+            for (int i = 0; i < threads; i++) {
+                fThreads.push_back(std::thread(&sound_stream_pool::run, this));
+            }
+        }
+
+    public:
+
+        virtual ~sound_stream_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(fMutex);
+                fRunning = false;
+            }
+            fCond.notify_all();
+            for (size_t i = 0; i < fThreads.size(); i++) {
+                fThreads[i].join();
+            }
+        }
+
+        static sound_stream_pool& getInstance()
+        {
+            static sound_stream_pool gPool(STREAM_THREADS);
+            return gPool;
+        }
+
+        void addStream(sound_stream* stream)
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fStreams.push_back(stream);
+        }
+
+        // Waits for the end of the current read of the stream
+        void removeStream(sound_stream* stream)
+        {
+            {
+                std::lock_guard<std::mutex> lock(fMutex);
+                fStreams.erase(std::find(fStreams.begin(), fStreams.end(), stream));
+            }
+            while (stream->fBusy) {
+                std::this_thread::yield();
+            }
+        }
+
+};
+
+/**
+ * DirectToDisk player: the file is read in planar ring buffers by the I/O threads of sound_stream_pool,
+ * and played in loop. The audio thread only copies the ring buffers to the outputs: it never locks,
+ * allocates or reads the file. Position changes are requests applied by the I/O threads,
+ * and the missing frames are counted (and played as silence).
+ */
+
+class sound_dtd_player : public sound_base_player, public sound_stream {
     
     private:
-        
-        ringbuffer_t* fBuffer;  // Ringbuffer written in setFrame and read in playSlice
     
+        // Planar ring buffers: fWrite and fRead are frame counters, only written by the I/O threads and the audio thread
+        FAUSTFLOAT** fRing;
+        std::atomic<size_t> fWrite;
+        std::atomic<size_t> fRead;
+    
+        FAUSTFLOAT* fReadBuffer;    // Interleaved frames read by the I/O threads
+    
+        // Position change requests, from the control thread to the I/O threads
+        std::atomic<int> fSeekFrame;
+        std::atomic<unsigned int> fSeekRequest;
+        unsigned int fSeekDone;
+    
+        // Applied position change, from the I/O threads to the audio thread: the frames before fFlushWrite are discarded
+        std::atomic<size_t> fFlushWrite;
+        std::atomic<int> fFlushFrame;
+        std::atomic<unsigned int> fFlush;
+        unsigned int fFlushDone;
+        bool fFlushed;              // Set in the block following a position change
+    
+        std::atomic<int> fStreamRate;   // Sample rate the frames are played at, read by the I/O threads
+    
+        // Statistics
+        std::atomic<long> fUnderruns;
+        std::atomic<long> fMissingFrames;
+        std::atomic<long> fMinFill;
+    
+        size_t getFill() { return fWrite.load(std::memory_order_acquire) - fRead.load(std::memory_order_acquire); }
+    
+        // Audio thread
         void playSlice(int count, int src, int dst, FAUSTFLOAT** outputs)
         {
-            size_t read_space_frames = convertToFrames(ringbuffer_read_space(fBuffer));
-            
-            if (read_space_frames >= count) {
-                
-                // Read from ringbuffer
-                FAUSTFLOAT buffer[count * fInfo.channels];
-                ringbuffer_read(fBuffer, (char*)buffer, convertFromFrames(count));
-                
-                // Deinterleave and write to output
-                for (int chan = 0; chan < fInfo.channels; chan++) {
-                    for (int frame = 0; frame < count; frame++) {
-                        outputs[chan][dst + frame] = buffer[frame * fInfo.channels + chan];
-                    }
+            size_t read = fRead.load(std::memory_order_relaxed);
+            int frames = int(std::min(size_t(count), fWrite.load(std::memory_order_acquire) - read));
+            size_t index = read & (RING_BUFFER_SIZE - 1);
+            int first = std::min(frames, int(RING_BUFFER_SIZE - index));
+            for (int chan = 0; chan < fInfo.channels; chan++) {
+                memcpy(&outputs[chan][dst], &fRing[chan][index], sizeof(FAUSTFLOAT) * first);
+                memcpy(&outputs[chan][dst + first], &fRing[chan][0], sizeof(FAUSTFLOAT) * (frames - first));
+            }
+            fRead.store(read + frames, std::memory_order_release);
+            if (frames < count) {
+                clearSlice(count - frames, dst + frames, outputs);
+                // The ring buffers are empty in the block following a position change, until the I/O threads read the new position
+                if (!fFlushed) {
+                    fUnderruns++;
+                    fMissingFrames += count - frames;
                 }
-                
-            } else {
-                std::cerr << "PlaySlice : missing " << (count - read_space_frames) << " frames\n";
             }
         }
     
-        size_t readAndwrite(FAUSTFLOAT* buffer, size_t size)
+        // Audio thread : skips the frames read before the last position change
+        void applyFlush()
         {
-            size_t nbf = fReaderFun(fFile, buffer, size);
-            ringbuffer_write(fBuffer, (char*)buffer, convertFromFrames(nbf));
-            return nbf;
+            unsigned int flush = fFlush.load(std::memory_order_acquire);
+            fFlushed = (flush != fFlushDone);
+            if (fFlushed) {
+                fFlushDone = flush;
+                size_t write = fFlushWrite.load(std::memory_order_relaxed);
+                if (write > fRead.load(std::memory_order_relaxed)) {
+                    fRead.store(write, std::memory_order_release);
+                }
+                fCurFrames = FAUSTFLOAT(fFlushFrame.load(std::memory_order_relaxed));
+            }
         }
     
         void setFrame(int frames)
@@ -317,54 +480,137 @@ class sound_dtd_player : public sound_base_player {
             if (fSetFrames != fLastSetFrames
                 && std::abs(fSetFrames - fLastSetFrames) > BUFFER_SIZE
                 && std::abs(fSetFrames - fCurFrames) > BUFFER_SIZE) {
-                fMutex.lock();
-                // Reset ringbuffer
-                ringbuffer_reset(fBuffer);
-                // Reset fCurFrames and seek in the file
                 fLastSetFrames = fSetFrames;
-                sf_seek(fFile, fSetFrames, SEEK_SET);
-                fCurFrames = fSetFrames;
-                fMutex.unlock();
+                seek(int(fSetFrames));
             }
-            
-            size_t write_space_frames = convertToFrames(ringbuffer_write_space(fBuffer));
-            
-            // If ringbuffer has to be filled
-            if (write_space_frames > HALF_RING_BUFFER_SIZE) {
-                FAUSTFLOAT buffer[HALF_RING_BUFFER_SIZE * fInfo.channels];
-                // Tries to read and write HALF_RING_BUFFER_SIZE frames
-                size_t nbf = readAndwrite(buffer, HALF_RING_BUFFER_SIZE);
-                // End of file is reached
-                if (nbf < HALF_RING_BUFFER_SIZE) {
-                    // Read RING_BUFFER_SIZE/2 - nbf frame from the beginning of file
-                    sf_seek(fFile, 0, SEEK_SET);
-                    readAndwrite(buffer, HALF_RING_BUFFER_SIZE - nbf);
+        }
+    
+        // I/O thread : reads 'frames' frames at most, looping at the end of the file
+        int readFrames(size_t write, int frames)
+        {
+            int nbf = int(fReaderFun(fFile, fReadBuffer, frames));
+            if (nbf < frames) {
+                sf_seek(fFile, 0, SEEK_SET);
+                nbf += int(fReaderFun(fFile, &fReadBuffer[nbf * fInfo.channels], frames - nbf));
+            }
+            // Deinterleave in the ring buffers
+            for (int chan = 0; chan < fInfo.channels; chan++) {
+                FAUSTFLOAT* ring = fRing[chan];
+                for (int frame = 0; frame < nbf; frame++) {
+                    ring[(write + frame) & (RING_BUFFER_SIZE - 1)] = fReadBuffer[frame * fInfo.channels + chan];
                 }
             }
+            return nbf;
         }
-    
-        size_t convertToFrames(size_t bytes) { return bytes / (sizeof(FAUSTFLOAT) * fInfo.channels); }
-        size_t convertFromFrames(size_t frames) { return frames * sizeof(FAUSTFLOAT) * fInfo.channels; }
   
     public:
         
-        sound_dtd_player(const std::string& filename):sound_base_player(filename)
+        sound_dtd_player(const std::string& filename)
+        :sound_base_player(filename), fWrite(0), fRead(0),
+        fSeekFrame(0), fSeekRequest(0), fSeekDone(0),
+        fFlushWrite(0), fFlushFrame(0), fFlush(0), fFlushDone(0), fFlushed(false), fStreamRate(0),
+        fUnderruns(0), fMissingFrames(0), fMinFill(RING_BUFFER_SIZE)
         {
-            // Create ringbuffer
-            fBuffer = ringbuffer_create(RING_BUFFER_SIZE * fInfo.channels * sizeof(FAUSTFLOAT));
+            // Create ringbuffers
+            fRing = new FAUSTFLOAT*[fInfo.channels];
+            for (int chan = 0; chan < fInfo.channels; chan++) {
+                fRing[chan] = new FAUSTFLOAT[RING_BUFFER_SIZE];
+            }
+            fReadBuffer = new FAUSTFLOAT[STREAM_READ_SIZE * fInfo.channels];
             
-            // Read first buffer
-            setFrame(0);
+            // Fill the ring buffers before playing
+            size_t fill;
+            do {
+                fill = getFill();
+                read();
+            } while (getFill() > fill);
+            sound_stream_pool::getInstance().addStream(this);
         }
         
         virtual ~sound_dtd_player()
         {
-            ringbuffer_free(fBuffer);
+            sound_stream_pool::getInstance().removeStream(this);
+            for (int chan = 0; chan < fInfo.channels; chan++) {
+                delete [] fRing[chan];
+            }
+            delete [] fRing;
+            delete [] fReadBuffer;
             sf_close(fFile);
         }
     
         sound_dtd_player* clone() { return new sound_dtd_player(fFileName); }
     
+        virtual void instanceConstants(int samplingRate)
+        {
+            sound_base_player::instanceConstants(samplingRate);
+            fStreamRate = samplingRate;
+        }
+    
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            applyFlush();
+            if (fPlayButton == FAUSTFLOAT(1)) {
+                fMinFill = std::min(fMinFill.load(std::memory_order_relaxed), long(getFill()));
+                play(count, outputs);
+            } else {
+                // Clear output
+                clearSlice(count, 0, outputs);
+            }
+        }
+    
+        // Position change request, applied by the I/O threads (can be called from any thread)
+        void seek(int frame)
+        {
+            fSeekFrame = std::max(0, std::min(frame, int(fInfo.frames) - 1));
+            fSeekRequest++;
+        }
+    
+        // Number of blocks with missing frames, and number of missing frames
+        long getUnderruns() { return fUnderruns; }
+        long getMissingFrames() { return fMissingFrames; }
+    
+        // Minimum number of frames in the ring buffers at the beginning of the played blocks
+        long getMinFill() { return fMinFill; }
+    
+        void resetStats()
+        {
+            fUnderruns = 0;
+            fMissingFrames = 0;
+            fMinFill = RING_BUFFER_SIZE;
+        }
+    
+        // sound_stream API
+    
+        bool needsRead(double& deadline)
+        {
+            size_t fill = getFill();
+            int sample_rate = (fStreamRate > 0) ? int(fStreamRate) : fInfo.samplerate;
+            deadline = (fSeekRequest != fSeekDone) ? 0. : double(fill) / double(sample_rate);
+            return (fSeekRequest != fSeekDone) || (RING_BUFFER_SIZE - fill >= STREAM_READ_SIZE);
+        }
+    
+        void read()
+        {
+            size_t write = fWrite.load(std::memory_order_relaxed);
+            
+            // Position change: the following frames will be read from the new position
+            unsigned int request = fSeekRequest.load(std::memory_order_acquire);
+            if (request != fSeekDone) {
+                fSeekDone = request;
+                int frame = fSeekFrame;
+                sf_seek(fFile, frame, SEEK_SET);
+                fFlushWrite.store(write, std::memory_order_relaxed);
+                fFlushFrame.store(frame, std::memory_order_relaxed);
+                fFlush.fetch_add(1, std::memory_order_release);
+            }
+            
+            // Read one chunk, so that the other streams can be read before this one is full
+            size_t space = RING_BUFFER_SIZE - (write - fRead.load(std::memory_order_acquire));
+            if (space > 0) {
+                fWrite.store(write + readFrames(write, int(std::min(space, size_t(STREAM_READ_SIZE)))), std::memory_order_release);
+            }
+        }
+    
 };
 
 /**
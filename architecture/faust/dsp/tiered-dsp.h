@@ -0,0 +1,324 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __tiered_dsp__
+#define __tiered_dsp__
+
+#include <pthread.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "faust/dsp/dsp.h"
+#include "faust/dsp/dsp-state.h"
+#include "faust/dsp/interpreter-dsp.h"
+#include "faust/dsp/llvm-dsp.h"
+#include "faust/gui/MapUI.h"
+
+/**
+ * Tiered execution: the DSP starts immediately on the Interpreter backend, while the LLVM backend
+ * compiles the same code in a background thread. When the JIT instance is ready, the running state
+ * (delay lines, recursive state, IOTA, control values...) is transferred at a block boundary
+ * and the JIT instance computes the following blocks, without any click.
+ *
+ * The user interface is always built on the Interpreter instance: after the swap, the controls are
+ * copied in the JIT instance before each block, and the bargraphs are copied back after each block.
+ * The Interpreter state layout and zones are collected by 'init', before the audio thread computes,
+ * so that the background thread only uses the JIT instance. The JIT instance is handed over with
+ * a release store of the state, read with an acquire load by the audio thread.
+ * DSPs using soundfiles stay on the Interpreter backend.
+ */
+
+class tiered_dsp : public decorator_dsp {
+
+    private:
+
+        // Collects the control zones by path, and the bargraph ones
+        struct ZoneCollectorUI : public MapUI {
+
+            std::set<std::string> fOutputs;
+            bool fSoundfile;
+
+            ZoneCollectorUI():fSoundfile(false) {}
+
+            void addHorizontalBargraph(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT fmin, FAUSTFLOAT fmax)
+            {
+                MapUI::addHorizontalBargraph(label, zone, fmin, fmax);
+                fOutputs.insert(buildPath(label));
+            }
+            void addVerticalBargraph(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT fmin, FAUSTFLOAT fmax)
+            {
+                MapUI::addVerticalBargraph(label, zone, fmin, fmax);
+                fOutputs.insert(buildPath(label));
+            }
+            void addSoundfile(const char* label, const char* filename, Soundfile** sf_zone)
+            {
+                fSoundfile = true;
+            }
+        };
+
+        enum { kInterpreter, kCompiling, kFailed, kReady, kJIT };
+
+        interpreter_dsp_factory* fInterpreterFactory;
+        llvm_dsp_factory* fJITFactory;
+        llvm_dsp* fJIT;
+
+        // Compilation parameters, kept for the background thread
+        std::string fName;
+        std::string fCode;
+        std::vector<std::string> fArgv;
+        std::string fTarget;
+        int fOptLevel;
+        std::atomic<int> fSampleRate;   // Of the last 'init', 'instanceInit' or 'instanceConstants' call
+
+        pthread_t fThread;
+        std::atomic<int> fState;
+
+        // Interpreter state layout and zones, collected before the compilation starts
+        dsp_state_layout fInterpreterLayout;
+        ZoneCollectorUI fInterpreterZones;
+
+        dsp_state_transfer* fTransfer;
+
+        // Interpreter and JIT zones, copied between the two instances after the swap
+        std::vector<std::pair<FAUSTFLOAT*, FAUSTFLOAT*> > fInputZones;
+        std::vector<std::pair<FAUSTFLOAT*, FAUSTFLOAT*> > fOutputZones;
+
+        tiered_dsp(interpreter_dsp_factory* factory,
+                   const std::string& name_app,
+                   const std::string& dsp_content,
+                   int argc, const char* argv[],
+                   const std::string& target,
+                   int opt_level)
+        :decorator_dsp(factory->createDSPInstance()),
+        fInterpreterFactory(factory), fJITFactory(nullptr), fJIT(nullptr),
+        fName(name_app), fCode(dsp_content), fTarget(target), fOptLevel(opt_level), fSampleRate(0),
+        fState(kInterpreter), fTransfer(nullptr)
+        {
+            for (int i = 0; i < argc; i++) {
+                fArgv.push_back(argv[i]);
+            }
+        }
+
+        static void* compileThread(void* arg)
+        {
+            static_cast<tiered_dsp*>(arg)->compileJIT();
+            return nullptr;
+        }
+
+        // Runs in the background thread: the swap itself is done by the audio thread in 'compute'
+        void compileJIT()
+        {
+            std::vector<const char*> argv;
+            for (size_t i = 0; i < fArgv.size(); i++) {
+                argv.push_back(fArgv[i].c_str());
+            }
+            std::string error_msg;
+            fJITFactory = createDSPFactoryFromString(fName, fCode, int(argv.size()), argv.data(), fTarget, error_msg, fOptLevel);
+            if (!fJITFactory) {
+                std::cerr << "tiered_dsp : " << error_msg;
+                fState.store(kFailed, std::memory_order_release);
+                return;
+            }
+            fJIT = static_cast<llvm_dsp*>(fJITFactory->createDSPInstance());
+            fJIT->init(fSampleRate.load(std::memory_order_relaxed));
+
+            // The state of both instances has to match: same fields, same sizes
+            dsp_state_layout dst = fJIT->getStateLayout();
+            fTransfer = new dsp_state_transfer(fInterpreterLayout, dst);
+            if (dst.size() == 0 || fInterpreterLayout.size() != dst.size() || fTransfer->getMissing() > 0) {
+                std::cerr << "tiered_dsp : the Interpreter and JIT state layouts differ, keep the Interpreter\n";
+                fState.store(kFailed, std::memory_order_release);
+                return;
+            }
+
+            ZoneCollectorUI jit_zones;
+            fJIT->buildUserInterface(&jit_zones);
+            if (jit_zones.fSoundfile) {
+                fState.store(kFailed, std::memory_order_release);
+                return;
+            }
+            std::map<std::string, FAUSTFLOAT*>& jit_map = jit_zones.getMap();
+            std::map<std::string, FAUSTFLOAT*>& interpreter_map = fInterpreterZones.getMap();
+            for (std::map<std::string, FAUSTFLOAT*>::iterator it = interpreter_map.begin(); it != interpreter_map.end(); it++) {
+                if (jit_map.find((*it).first) == jit_map.end()) continue;
+                if (fInterpreterZones.fOutputs.count((*it).first)) {
+                    fOutputZones.push_back(std::make_pair((*it).second, jit_map[(*it).first]));
+                } else {
+                    fInputZones.push_back(std::make_pair((*it).second, jit_map[(*it).first]));
+                }
+            }
+
+            // Publishes the JIT instance, the transfer and the zones to the audio thread
+            fState.store(kReady, std::memory_order_release);
+        }
+
+        // The compilation starts at the first 'init' call, when the sample rate is known
+        void startCompilation(int samplingRate)
+        {
+            fSampleRate.store(samplingRate, std::memory_order_relaxed);
+            if (fState.load(std::memory_order_relaxed) == kInterpreter) {
+                // The Interpreter instance is not computing yet
+                fInterpreterLayout = static_cast<interpreter_dsp*>(fDSP)->getStateLayout();
+                fDSP->buildUserInterface(&fInterpreterZones);
+                fState.store(kCompiling, std::memory_order_relaxed);
+                if (pthread_create(&fThread, nullptr, compileThread, this) != 0) {
+                    fState.store(kInterpreter, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Audio thread
+        void swapJIT()
+        {
+            // The sample rate may have been changed by 'init' during the compilation
+            int sample_rate = fDSP->getSampleRate();
+            if (fJIT->getSampleRate() != sample_rate) {
+                fJIT->instanceConstants(sample_rate);
+            }
+            fTransfer->transfer();
+            fState.store(kJIT, std::memory_order_relaxed);
+        }
+
+    public:
+
+        virtual ~tiered_dsp()
+        {
+            if (fState.load(std::memory_order_acquire) != kInterpreter) {
+                pthread_join(fThread, nullptr);
+            }
+            delete fTransfer;
+            delete fJIT;
+            if (fJITFactory) deleteDSPFactory(fJITFactory);
+            delete fDSP;
+            fDSP = nullptr;
+            deleteInterpreterDSPFactory(fInterpreterFactory);
+        }
+
+        /**
+         * Create a tiered DSP from a Faust program: the returned instance computes with the Interpreter backend
+         * until the LLVM backend has compiled the program, starting at the first 'init' call.
+         *
+         * @param name_app - the name of the Faust program
+         * @param dsp_content - the Faust program as a string
+         * @param argc - the number of parameters in argv array
+         * @param argv - the array of parameters
+         * @param target - the LLVM machine target (using empty string will take current machine settings)
+         * @param error_msg - the error string to be filled
+         * @param opt_level - LLVM IR to IR optimization level (from -1 to 4, -1 means 'maximum possible value')
+         *
+         * @return a DSP instance on success, otherwise a null pointer.
+         */
+        static tiered_dsp* create(const std::string& name_app,
+                                  const std::string& dsp_content,
+                                  int argc, const char* argv[],
+                                  const std::string& target,
+                                  std::string& error_msg,
+                                  int opt_level = -1)
+        {
+            // The LLVM factory is created in another thread
+            startMTDSPFactories();
+            interpreter_dsp_factory* factory = createInterpreterDSPFactoryFromString(name_app, dsp_content, argc, argv, error_msg);
+            return (factory) ? new tiered_dsp(factory, name_app, dsp_content, argc, argv, target, opt_level) : nullptr;
+        }
+
+        // Whether the JIT instance is computing
+        bool isJIT() { return fState.load(std::memory_order_acquire) == kJIT; }
+
+        // Whether the background compilation is running: otherwise the JIT instance is used from the next block, if any
+        bool isCompiling() { return fState.load(std::memory_order_acquire) == kCompiling; }
+
+        virtual void init(int samplingRate)
+        {
+            fDSP->init(samplingRate);
+            if (isJIT()) fJIT->init(samplingRate);
+            startCompilation(samplingRate);
+        }
+
+        virtual void instanceInit(int samplingRate)
+        {
+            fDSP->instanceInit(samplingRate);
+            if (isJIT()) fJIT->instanceInit(samplingRate);
+            startCompilation(samplingRate);
+        }
+
+        virtual void instanceConstants(int samplingRate)
+        {
+            fDSP->instanceConstants(samplingRate);
+            if (isJIT()) fJIT->instanceConstants(samplingRate);
+            fSampleRate.store(samplingRate, std::memory_order_relaxed);
+        }
+
+        virtual void instanceResetUserInterface()
+        {
+            fDSP->instanceResetUserInterface();
+            if (isJIT()) fJIT->instanceResetUserInterface();
+        }
+
+        virtual void instanceClear()
+        {
+            fDSP->instanceClear();
+            if (isJIT()) fJIT->instanceClear();
+        }
+
+        virtual tiered_dsp* clone()
+        {
+            std::vector<const char*> argv;
+            for (size_t i = 0; i < fArgv.size(); i++) {
+                argv.push_back(fArgv[i].c_str());
+            }
+            std::string error_msg;
+            return create(fName, fCode, int(argv.size()), argv.data(), fTarget, error_msg, fOptLevel);
+        }
+
+        virtual void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            int state = fState.load(std::memory_order_acquire);
+            if (state == kReady) {
+                swapJIT();
+                state = kJIT;
+            }
+            if (state == kJIT) {
+                for (size_t i = 0; i < fInputZones.size(); i++) {
+                    *fInputZones[i].second = *fInputZones[i].first;
+                }
+                fJIT->compute(count, inputs, outputs);
+                for (size_t i = 0; i < fOutputZones.size(); i++) {
+                    *fOutputZones[i].first = *fOutputZones[i].second;
+                }
+            } else {
+                fDSP->compute(count, inputs, outputs);
+            }
+        }
+
+        virtual void compute(double date_usec, int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs)
+        {
+            compute(count, inputs, outputs);
+        }
+
+};
+
+#endif
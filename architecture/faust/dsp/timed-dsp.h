@@ -25,6 +25,8 @@
 #define __timed_dsp__
 
 #include <set>
+#include <vector>
+#include <algorithm>
 #include <float.h>
 #include <assert.h>
 
@@ -71,20 +73,33 @@ inline double GetCurrentTimeInUsec(void)
 }
 
 /**
- * ZoneUI : this class collect zones in a set.
+ * ZoneUI : this class collect the timed zones in a set, and connects them to the queue of the timed_dsp.
  */
 
 struct ZoneUI : public GenericUI
 {
     
     std::set<FAUSTFLOAT*> fZoneSet;
+    timed_queue* fQueue;
     
-    ZoneUI():GenericUI() {}
-    virtual ~ZoneUI() {}
+    ZoneUI(timed_queue* queue):GenericUI(), fQueue(queue) {}
+    virtual ~ZoneUI()
+    {
+        // Disconnect the zones still in GUI::gTimedZoneMap (since MidiUI may have been desallocated)
+        std::set<FAUSTFLOAT*>::iterator it1;
+        for (it1 = fZoneSet.begin(); it1 != fZoneSet.end(); it1++) {
+            ztimedmap::iterator it2 = GUI::gTimedZoneMap.find(*it1);
+            if (it2 != GUI::gTimedZoneMap.end() && (*it2).second == fQueue) {
+                (*it2).second = 0;
+            }
+        }
+    }
     
     void insertZone(FAUSTFLOAT* zone) 
     { 
-        if (GUI::gTimedZoneMap.find(zone) != GUI::gTimedZoneMap.end()) {
+        ztimedmap::iterator it = GUI::gTimedZoneMap.find(zone);
+        if (it != GUI::gTimedZoneMap.end()) {
+            (*it).second = fQueue;
             fZoneSet.insert(zone);
         } 
     }
@@ -127,8 +142,14 @@ struct ZoneUI : public GenericUI
  * Timed signal processor that allows to handle the decorated DSP by 'slices'
  * that is, calling the 'compute' method several times and changing control
  * parameters between slices.
+ *
+ * Dated controls of all timed zones are received in a single queue, and moved at the beginning
+ * of each block in a heap sorted by date, so that finding the next control is done in O(log(controls)),
+ * whatever the number of timed zones.
  */
 
+#define TIMED_QUEUE_SIZE 8192
+
 class timed_dsp : public decorator_dsp {
 
     protected:
@@ -136,11 +157,20 @@ class timed_dsp : public decorator_dsp {
         double fDateUsec;       // Compute call date in usec
         double fOffsetUsec;     // Compute call offset in usec
         bool fFirstCallback;
+        timed_queue fQueue;
+        std::vector<DatedControl> fHeap;
+        unsigned int fOrder;
         ZoneUI fZoneUI;
     
         FAUSTFLOAT** fInputsSlice;
         FAUSTFLOAT** fOutputsSlice;
     
+        // Heap order : the first control has the smallest date, then the smallest arrival order
+        static bool laterControl(const DatedControl& a, const DatedControl& b)
+        {
+            return (a.fDate > b.fDate) || ((a.fDate == b.fDate) && (int(a.fOrder - b.fOrder) > 0));
+        }
+    
         void computeSlice(int offset, int slice, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs) 
         {
             if (slice > 0) {
@@ -158,56 +188,41 @@ class timed_dsp : public decorator_dsp {
         {
             return std::max<double>(0., (double(getSampleRate()) * (usec - fDateUsec)) / 1000000.);
         }
-        
-        ztimedmap::iterator getNextControl(DatedControl& res, bool convert_ts)
+    
+        // Move the received controls in the heap (preallocated, the remaining ones are kept for the next block)
+        void receiveControls()
         {
-            DatedControl date1(DBL_MAX, 0);
-            ztimedmap::iterator it1, it2 = GUI::gTimedZoneMap.end();
-            std::set<FAUSTFLOAT*>::iterator it3;
-              
-            // Find date of next audio slice to compute
-            for (it3 = fZoneUI.fZoneSet.begin(); it3 != fZoneUI.fZoneSet.end(); it3++) {
-                // If value list is not empty, get the date and keep the minimal one
-                it1 = GUI::gTimedZoneMap.find(*it3);
-                if (it1 != GUI::gTimedZoneMap.end()) { // Check if zone still in global GUI::gTimedZoneMap (since MidiUI may have been desallocated)
-                    DatedControl date2;
-                    if (ringbuffer_peek((*it1).second, (char*)&date2, sizeof(DatedControl)) == sizeof(DatedControl) 
-                        && date2.fDate < date1.fDate) {
-                        it2 = it1;
-                        date1 = date2;
-                    }
-                }
+            DatedControl control;
+            while (fHeap.size() < fHeap.capacity() && fQueue.pop(control)) {
+                control.fOrder = fOrder++;
+                fHeap.push_back(control);
+                std::push_heap(fHeap.begin(), fHeap.end(), laterControl);
             }
-            
-            // If needed, convert date1 in samples from begining of the buffer, possible moving to 0 (if negative)
-            if (convert_ts) {
-                date1.fDate = convertUsecToSample(date1.fDate);
-            }
-                
-            res = date1;
-            return it2;
         }
         
         virtual void computeAux(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs, bool convert_ts)
         {
             int slice, offset = 0;
-            ztimedmap::iterator it;
-            DatedControl next_control;
+            
+            receiveControls();
              
             // Do audio computation "slice" by "slice"
-            while ((it = getNextControl(next_control, convert_ts)) != GUI::gTimedZoneMap.end()) {
+            while (fHeap.size() > 0) {
+                
+                DatedControl& next_control = fHeap.front();
+                
+                // If needed, convert date in samples from begining of the buffer, possible moving to 0 (if negative)
+                double date = (convert_ts) ? convertUsecToSample(next_control.fDate) : next_control.fDate;
                      
                 // Compute audio slice
-                slice = int(next_control.fDate) - offset;
+                slice = std::max(offset, std::min(int(date), count)) - offset;
                 computeSlice(offset, slice, inputs, outputs);
                 offset += slice;
                
                 // Update control
-                ringbuffer_t* control_values = (*it).second;
-                *((*it).first) = next_control.fValue;
-                
-                // Move ringbuffer pointer
-                ringbuffer_read_advance(control_values, sizeof(DatedControl));
+                *(next_control.fZone) = next_control.fValue;
+                std::pop_heap(fHeap.begin(), fHeap.end(), laterControl);
+                fHeap.pop_back();
             } 
             
             // Compute last audio slice
@@ -217,8 +232,10 @@ class timed_dsp : public decorator_dsp {
 
     public:
 
-        timed_dsp(dsp* dsp):decorator_dsp(dsp), fDateUsec(0), fOffsetUsec(0), fFirstCallback(true)
+        timed_dsp(dsp* dsp):decorator_dsp(dsp), fDateUsec(0), fOffsetUsec(0), fFirstCallback(true),
+            fQueue(TIMED_QUEUE_SIZE), fOrder(0), fZoneUI(&fQueue)
         {
+            fHeap.reserve(TIMED_QUEUE_SIZE);
             fInputsSlice = new FAUSTFLOAT*[dsp->getNumInputs()];
             fOutputsSlice = new FAUSTFLOAT*[dsp->getNumOutputs()];
         }
@@ -236,7 +253,7 @@ class timed_dsp : public decorator_dsp {
         virtual void buildUserInterface(UI* ui_interface)   
         { 
             fDSP->buildUserInterface(ui_interface); 
-            // Only keep zones that are in GUI::gTimedZoneMap
+            // Only keep zones that are in GUI::gTimedZoneMap, and connect them to the queue
             fDSP->buildUserInterface(&fZoneUI);
         }
     
@@ -28,6 +28,7 @@
 #include <map>
 #include <vector>
 #include <iostream>
+#include <atomic>
 
 #ifdef _WIN32
 # pragma warning (disable: 4100)
@@ -60,7 +61,103 @@ class clist : public std::list<uiItemBase*>
 
 typedef std::map<FAUSTFLOAT*, clist*> zmap;
 
-typedef std::map<FAUSTFLOAT*, ringbuffer_t*> ztimedmap;
+//-------------------------
+// For timestamped control
+//-------------------------
+
+struct DatedControl {
+    
+    double fDate;
+    FAUSTFLOAT fValue;
+    FAUSTFLOAT* fZone;
+    unsigned int fOrder;    // Arrival order, to keep the values of a same date in order
+    
+    DatedControl(double d = 0., FAUSTFLOAT v = FAUSTFLOAT(0), FAUSTFLOAT* z = 0):fDate(d), fValue(v), fZone(z), fOrder(0) {}
+    
+};
+
+/**
+ * Lock-free bounded queue of dated controls: written by any number of control threads (MIDI, OSC...),
+ * read by the audio thread. Each cell has a sequence number telling if it is ready to be written or read.
+ */
+
+class timed_queue {
+
+    private:
+    
+        struct cell {
+            std::atomic<unsigned int> fSequence;
+            DatedControl fControl;
+        };
+    
+        cell* fCells;
+        unsigned int fMask;
+        std::atomic<unsigned int> fWritePos;
+        unsigned int fReadPos;
+
+    public:
+    
+        // 'size' is rounded to a power of 2
+        timed_queue(unsigned int size = 8192):fWritePos(0), fReadPos(0)
+        {
+            unsigned int power_of_two = 1;
+            while (power_of_two < size) power_of_two <<= 1;
+            fCells = new cell[power_of_two];
+            fMask = power_of_two - 1;
+            for (unsigned int i = 0; i < power_of_two; i++) {
+                fCells[i].fSequence.store(i, std::memory_order_relaxed);
+            }
+        }
+        virtual ~timed_queue()
+        {
+            delete [] fCells;
+        }
+    
+        // Control threads : returns false if the queue is full
+        bool push(const DatedControl& control)
+        {
+            unsigned int pos = fWritePos.load(std::memory_order_relaxed);
+            while (true) {
+                cell* cur = &fCells[pos & fMask];
+                // Acquire: the previous read of the cell by the audio thread is done
+                unsigned int seq = cur->fSequence.load(std::memory_order_acquire);
+                int diff = int(seq - pos);
+                if (diff == 0) {
+                    if (fWritePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        cur->fControl = control;
+                        // Release: publishes the control to the audio thread
+                        cur->fSequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                    // 'pos' has been reloaded by the failed compare_exchange
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = fWritePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+    
+        // Audio thread : returns false if the queue is empty
+        bool pop(DatedControl& control)
+        {
+            cell* cur = &fCells[fReadPos & fMask];
+            // Acquire: the control written by the control thread is visible
+            unsigned int seq = cur->fSequence.load(std::memory_order_acquire);
+            if (int(seq - (fReadPos + 1)) < 0) {
+                return false;
+            }
+            control = cur->fControl;
+            // Release: the cell can be written again once the control is read
+            cur->fSequence.store(fReadPos + fMask + 1, std::memory_order_release);
+            fReadPos++;
+            return true;
+        }
+    
+};
+
+// Timed zones, with the queue of the timed_dsp that handles them (or NULL)
+typedef std::map<FAUSTFLOAT*, timed_queue*> ztimedmap;
 
 class GUI : public UI
 {
@@ -272,19 +369,6 @@ struct uiCallbackItem : public uiItem {
  * Base class for timed items
  */
 
-//-------------------------
-// For timestamped control
-//-------------------------
-
-struct DatedControl {
-    
-    double fDate;
-    FAUSTFLOAT fValue;
-    
-    DatedControl(double d = 0., FAUSTFLOAT v = FAUSTFLOAT(0)):fDate(d), fValue(v) {}
-    
-};
-
 class uiTimedItem : public uiItem
 {
     
@@ -297,7 +381,7 @@ class uiTimedItem : public uiItem
         uiTimedItem(GUI* ui, FAUSTFLOAT* zone):uiItem(ui, zone)
         {
             if (GUI::gTimedZoneMap.find(fZone) == GUI::gTimedZoneMap.end()) {
-                GUI::gTimedZoneMap[fZone] = ringbuffer_create(8192);
+                GUI::gTimedZoneMap[fZone] = 0;
                 fDelete = true;
             } else {
                 fDelete = false;
@@ -308,17 +392,16 @@ class uiTimedItem : public uiItem
         {
             ztimedmap::iterator it;
             if (fDelete && ((it = GUI::gTimedZoneMap.find(fZone)) != GUI::gTimedZoneMap.end())) {
-                ringbuffer_free((*it).second);
                 GUI::gTimedZoneMap.erase(it);
             }
         }
         
         virtual void modifyZone(double date, FAUSTFLOAT v)
         {
-            size_t res;
-            DatedControl dated_val(date, v);
-            if ((res = ringbuffer_write(GUI::gTimedZoneMap[fZone], (const char*)&dated_val, sizeof(DatedControl))) != sizeof(DatedControl)) {
-                std::cerr << "ringbuffer_write error DatedControl" << std::endl;
+            // Values are only kept when a timed_dsp handles the zone
+            ztimedmap::iterator it = GUI::gTimedZoneMap.find(fZone);
+            if (it != GUI::gTimedZoneMap.end() && (*it).second && !(*it).second->push(DatedControl(date, v, fZone))) {
+                std::cerr << "timed_queue push error DatedControl" << std::endl;
             }
         }
     
@@ -0,0 +1,358 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+ ************************************************************************/
+
+#ifndef __MmapSoundfileReader__
+#define __MmapSoundfileReader__
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "faust/gui/Soundfile.h"
+
+/*
+ A soundfile reader backed by a memory mapped cache file (POSIX only).
+
+ The first time a list of soundfiles is loaded, it is converted by the READER (LibsndfileReader, JuceReader...)
+ in a cache file containing the raw FAUSTFLOAT samples, one channel after the other. This cache file is then mapped
+ read-only: the samples are only paged in when the DSP reads them (the heads of all parts are prefetched),
+ and the pages are shared by all the instances and processes mapping the same cache file.
+
+ The cache files are written in the FAUST_SOUNDFILE_CACHE directory, or by default in a per-user directory
+ created with mode 0700 ($XDG_CACHE_HOME/faust-soundfiles, $HOME/.cache/faust-soundfiles or /tmp/faust-soundfiles-<uid>),
+ with a name depending on the soundfile paths, sizes and modification dates, on the FAUSTFLOAT type and on max_chan,
+ so that a modified soundfile is converted again. A cache file is written in a file created with mkstemp, then renamed
+ into place, and its header is checked before being mapped. Old cache files are never removed.
+
+ To be used in SoundUI.h by defining MMAP_SOUNDFILE.
+ */
+
+#define MMAP_SOUNDFILE_MAGIC    "FAUSTSND"
+#define MMAP_SOUNDFILE_VERSION  1
+#define MMAP_SOUNDFILE_HEADER   4096    // Keeps the channels page aligned
+#define MMAP_SOUNDFILE_PREFETCH 8192    // Number of frames prefetched at the beginning of each part
+
+PRE_PACKED_STRUCTURE
+struct MmapSoundfileHeader {
+    char fMagic[8];
+    int fVersion;
+    int fSampleSize;    // sizeof(FAUSTFLOAT)
+    int fChannels;
+    int fLength;        // Total length of each channel
+    int fPartLength[MAX_SOUNDFILE_PARTS];
+    int fPartSampleRate[MAX_SOUNDFILE_PARTS];
+    int fPartOffset[MAX_SOUNDFILE_PARTS];
+} POST_PACKED_STRUCTURE;
+
+// Unmaps the cache file when the Soundfile is deleted
+struct MmapSoundfileMemory : public SoundfileMemory {
+
+    void* fAddress;
+    size_t fSize;
+
+    MmapSoundfileMemory(void* address, size_t size):fAddress(address), fSize(size) {}
+    virtual ~MmapSoundfileMemory() { munmap(fAddress, fSize); }
+
+};
+
+template <typename READER>
+struct MmapSoundfileReader : public READER {
+
+    std::string fCachePath;     // Temporary cache file written by 'create', a mkstemp template before
+    bool fCreated;
+    void* fAddress;
+    size_t fSize;
+
+    MmapSoundfileReader():fCreated(false), fAddress(MAP_FAILED), fSize(0) {}
+
+    static size_t fileSize(int channels, int length)
+    {
+        return MMAP_SOUNDFILE_HEADER + size_t(channels) * size_t(length) * sizeof(FAUSTFLOAT);
+    }
+
+    static Soundfile* makeSoundfile(char* address, size_t size, int channels, int length, int max_chan)
+    {
+        Soundfile* soundfile = new Soundfile();
+        soundfile->fBuffers = new FAUSTFLOAT*[max_chan];
+        FAUSTFLOAT* samples = reinterpret_cast<FAUSTFLOAT*>(address + MMAP_SOUNDFILE_HEADER);
+        for (int chan = 0; chan < channels; chan++) {
+            soundfile->fBuffers[chan] = samples + size_t(chan) * size_t(length);
+        }
+        soundfile->fChannels = channels;
+        soundfile->fMemory = new MmapSoundfileMemory(address, size);
+        return soundfile;
+    }
+
+    // The samples are converted in the mapped cache file, instead of being allocated
+    virtual Soundfile* create(int cur_chan, int length, int max_chan)
+    {
+        size_t size = fileSize(cur_chan, length);
+        // Created with O_EXCL and mode 0600, so never an existing file or symbolic link
+        std::vector<char> temp_path(fCachePath.begin(), fCachePath.end());
+        temp_path.push_back(0);
+        int fd = mkstemp(&temp_path[0]);
+        if (fd < 0) {
+            throw std::bad_alloc();
+        }
+        fCachePath = &temp_path[0];
+        fCreated = true;
+        if (ftruncate(fd, off_t(size)) != 0) {
+            ::close(fd);
+            throw std::bad_alloc();
+        }
+        fAddress = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (fAddress == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        fSize = size;
+        MmapSoundfileHeader* header = static_cast<MmapSoundfileHeader*>(fAddress);
+        memcpy(header->fMagic, MMAP_SOUNDFILE_MAGIC, 8);
+        header->fVersion = MMAP_SOUNDFILE_VERSION;
+        header->fSampleSize = int(sizeof(FAUSTFLOAT));
+        header->fChannels = cur_chan;
+        header->fLength = length;
+        return makeSoundfile(static_cast<char*>(fAddress), size, cur_chan, length, max_chan);
+    }
+
+    // FNV-1a hash of the soundfiles identity
+    static void hash(unsigned long long& key, const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            key = (key ^ bytes[i]) * 1099511628211ULL;
+        }
+    }
+
+    static std::string getCachePath(const std::vector<std::string>& path_name_list, int max_chan)
+    {
+        unsigned long long key = 14695981039346656037ULL;
+        int format[3] = { MMAP_SOUNDFILE_VERSION, int(sizeof(FAUSTFLOAT)), max_chan };
+        hash(key, format, sizeof(format));
+        for (size_t i = 0; i < path_name_list.size(); i++) {
+            const std::string& path_name = path_name_list[i];
+            hash(key, path_name.c_str(), path_name.size() + 1);
+            struct stat info;
+            if (stat(path_name.c_str(), &info) == 0) {
+                long long identity[2] = { (long long)info.st_size, (long long)info.st_mtime };
+                hash(key, identity, sizeof(identity));
+            }
+        }
+        std::string dir = getCacheDirectory();
+        if (dir == "") {
+            return "";
+        }
+        char name[64];
+        snprintf(name, 64, "/faust-%016llx.fsnd", key);
+        return dir + name;
+    }
+
+    // Creates the missing directories of 'path' with mode 0700
+    static bool makeDirectory(const std::string& path)
+    {
+        for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+            std::string dir = path.substr(0, pos);
+            if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+                return false;
+            }
+            if (pos == std::string::npos) {
+                return true;
+            }
+        }
+    }
+
+    // Returns the cache directory, or an empty string if the per-user directory cannot be safely used
+    static std::string getCacheDirectory()
+    {
+        const char* dir = getenv("FAUST_SOUNDFILE_CACHE");
+        if (dir) {
+            return dir;
+        }
+        std::string path;
+        const char* xdg_cache = getenv("XDG_CACHE_HOME");
+        const char* home = getenv("HOME");
+        if (xdg_cache && xdg_cache[0] == '/') {
+            path = std::string(xdg_cache) + "/faust-soundfiles";
+        } else if (home && home[0] == '/') {
+            path = std::string(home) + "/.cache/faust-soundfiles";
+        } else {
+            char name[64];
+            snprintf(name, 64, "/tmp/faust-soundfiles-%ld", long(getuid()));
+            path = name;
+        }
+        // The directory has to be a real directory only writable by the user (and not created by another user in /tmp)
+        struct stat info;
+        if (!makeDirectory(path)
+            || lstat(path.c_str(), &info) != 0
+            || !S_ISDIR(info.st_mode)
+            || info.st_uid != getuid()
+            || (info.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+            return "";
+        }
+        return path;
+    }
+
+    // Maps a cache file, returns NULL if it does not exist or does not match
+    static Soundfile* map(const std::string& cache_path, int max_chan)
+    {
+        int fd = ::open(cache_path.c_str(), O_RDONLY | O_NOFOLLOW);
+        if (fd < 0) {
+            return NULL;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0
+            || !S_ISREG(info.st_mode)
+            || info.st_uid != getuid()
+            || size_t(info.st_size) < MMAP_SOUNDFILE_HEADER) {
+            ::close(fd);
+            return NULL;
+        }
+        size_t size = size_t(info.st_size);
+        void* address = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            return NULL;
+        }
+        const MmapSoundfileHeader* header = static_cast<const MmapSoundfileHeader*>(address);
+        if (memcmp(header->fMagic, MMAP_SOUNDFILE_MAGIC, 8) != 0
+            || header->fVersion != MMAP_SOUNDFILE_VERSION
+            || header->fSampleSize != int(sizeof(FAUSTFLOAT))
+            || header->fChannels < 1 || header->fChannels > max_chan
+            || header->fLength < 0
+            || fileSize(header->fChannels, header->fLength) != size
+            || !checkParts(header)) {
+            munmap(address, size);
+            return NULL;
+        }
+
+        Soundfile* soundfile = makeSoundfile(static_cast<char*>(address), size, header->fChannels, header->fLength, max_chan);
+        for (int part = 0; part < MAX_SOUNDFILE_PARTS; part++) {
+            soundfile->fLength[part] = header->fPartLength[part];
+            soundfile->fSampleRate[part] = header->fPartSampleRate[part];
+            soundfile->fOffset[part] = header->fPartOffset[part];
+        }
+
+        // Share the same buffers for all other channels so that we have max_chan channels available
+        for (int chan = soundfile->fChannels; chan < max_chan; chan++) {
+            soundfile->fBuffers[chan] = soundfile->fBuffers[chan % soundfile->fChannels];
+        }
+
+        prefetch(soundfile);
+        return soundfile;
+    }
+
+    // The parts read by the DSP have to be inside the channels
+    static bool checkParts(const MmapSoundfileHeader* header)
+    {
+        for (int part = 0; part < MAX_SOUNDFILE_PARTS; part++) {
+            int offset = header->fPartOffset[part];
+            int length = header->fPartLength[part];
+            if (offset < 0 || length < 0 || (long long)offset + (long long)length > (long long)header->fLength) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Asks the kernel to page in the beginning of each part, the rest is paged in when played
+    static void prefetch(Soundfile* soundfile)
+    {
+        long page = sysconf(_SC_PAGESIZE);
+        for (int part = 0; part < MAX_SOUNDFILE_PARTS; part++) {
+            size_t frames = size_t(std::min(soundfile->fLength[part], MMAP_SOUNDFILE_PREFETCH));
+            for (int chan = 0; chan < soundfile->fChannels; chan++) {
+                uintptr_t begin = reinterpret_cast<uintptr_t>(&soundfile->fBuffers[chan][soundfile->fOffset[part]]);
+                uintptr_t aligned = begin - (begin % page);
+                madvise(reinterpret_cast<void*>(aligned), (begin - aligned) + frames * sizeof(FAUSTFLOAT), MADV_WILLNEED);
+            }
+        }
+    }
+
+    // Converts the soundfiles in the cache file, written in a temporary file renamed when complete
+    bool convert(const std::vector<std::string>& path_name_list, const std::string& cache_path, int max_chan)
+    {
+        fCachePath = cache_path + ".XXXXXX";
+        Soundfile* soundfile = this->read(path_name_list, max_chan);
+        if (!soundfile) {
+            if (fAddress != MAP_FAILED) munmap(fAddress, fSize);
+            if (fCreated) unlink(fCachePath.c_str());
+            return false;
+        }
+        MmapSoundfileHeader* header = static_cast<MmapSoundfileHeader*>(fAddress);
+        for (int part = 0; part < MAX_SOUNDFILE_PARTS; part++) {
+            header->fPartLength[part] = soundfile->fLength[part];
+            header->fPartSampleRate[part] = soundfile->fSampleRate[part];
+            header->fPartOffset[part] = soundfile->fOffset[part];
+        }
+        // Unmaps the writable mapping
+        delete soundfile;
+        if (rename(fCachePath.c_str(), cache_path.c_str()) != 0) {
+            unlink(fCachePath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    static Soundfile* createSoundfile(const std::vector<std::string>& path_name_list, int max_chan)
+    {
+        // Nothing to cache for empty soundfiles
+        bool empty = true;
+        for (size_t i = 0; i < path_name_list.size(); i++) {
+            empty = empty && (path_name_list[i] == "__empty_sound__");
+        }
+        if (empty) {
+            READER reader;
+            return reader.read(path_name_list, max_chan);
+        }
+
+        std::string cache_path = getCachePath(path_name_list, max_chan);
+        Soundfile* soundfile = (cache_path != "") ? map(cache_path, max_chan) : NULL;
+        if (!soundfile && cache_path != "") {
+            MmapSoundfileReader reader;
+            if (reader.convert(path_name_list, cache_path, max_chan)) {
+                soundfile = map(cache_path, max_chan);
+            }
+        }
+        if (!soundfile) {
+            std::cerr << "ERROR : cannot create the soundfile cache '" << cache_path << "', the soundfiles are loaded in memory" << std::endl;
+            READER reader;
+            soundfile = reader.read(path_name_list, max_chan);
+        }
+        return soundfile;
+    }
+
+};
+
+#endif
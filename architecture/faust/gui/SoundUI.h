@@ -27,6 +27,12 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <sstream>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
 
 #include "faust/gui/DecoratorUI.h"
 #include "faust/gui/SimpleParser.h"
@@ -44,6 +50,13 @@ Soundfile* createSoundfile(const std::vector<std::string>& path_name_list, int m
 {
     return JuceReader::createSoundfile(path_name_list, max_chan);
 }
+#elif defined(MMAP_SOUNDFILE)
+#include "faust/gui/LibsndfileReader.h"
+#include "faust/gui/MmapSoundfileReader.h"
+Soundfile* createSoundfile(const std::vector<std::string>& path_name_list, int max_chan)
+{
+    return MmapSoundfileReader<LibsndfileReader>::createSoundfile(path_name_list, max_chan);
+}
 #else
 #include "faust/gui/LibsndfileReader.h"
 Soundfile* createSoundfile(const std::vector<std::string>& path_name_list, int max_chan)
@@ -56,53 +69,244 @@ Soundfile* createSoundfile(const std::vector<std::string>& path_name_list, int m
 std::vector<std::string> path_name_list;
 extern "C" Soundfile* defaultsound = createSoundfile(path_name_list, MAX_CHAN);
 
+/*
+ Process-wide cache of the loaded soundfiles, shared by all SoundUI (so by all the DSP instances and factories).
+ A soundfile is identified by its list of resolved paths, the number of channels and the FAUSTFLOAT size,
+ counts the zones using it, and is deleted when the last one is released.
+
+ With asynchronous loading, the zones first get 'defaultsound' (empty parts) and are set to the soundfile
+ by the loading thread when it is ready: the DSP then uses it from its next block. The soundfile is published
+ to the audio thread by an atomic release store in the zone. The loading threads are owned by the cache,
+ and joined when it is deleted.
+ */
+
+struct SoundfileCacheStats {
+    int fSoundfiles;        // Number of loaded soundfiles
+    int fReferences;        // Number of zones using them
+    size_t fBytes;          // Memory used by the loaded soundfiles
+    size_t fSharedBytes;    // Memory that would have been used by additional copies without the cache
+};
+
+class SoundfileCache {
+
+    private:
+
+        struct Entry {
+            Soundfile* fSoundfile;
+            bool fReady;
+            size_t fBytes;
+            std::vector<Soundfile**> fZones;
+            Entry():fSoundfile(NULL), fReady(false), fBytes(0) {}
+        };
+
+        std::map<std::string, std::shared_ptr<Entry> > fEntries;
+        std::vector<std::pair<std::shared_ptr<Entry>, std::thread> > fLoaders;
+        std::mutex fMutex;
+
+        // The DSP zone is a plain 'Soundfile*' read by the audio thread, so it is written with a release store
+        static void setZone(Soundfile** sf_zone, Soundfile* soundfile)
+        {
+            static_assert(sizeof(std::atomic<Soundfile*>) == sizeof(Soundfile*), "std::atomic<Soundfile*> must have the layout of Soundfile*");
+            static_assert(ATOMIC_POINTER_LOCK_FREE == 2, "std::atomic<Soundfile*> must be lock free");
+            reinterpret_cast<std::atomic<Soundfile*>*>(sf_zone)->store(soundfile, std::memory_order_release);
+        }
+
+        // Called with the mutex locked, joins the loading threads which have finished
+        void joinLoaders()
+        {
+            for (size_t i = 0; i < fLoaders.size();) {
+                if (fLoaders[i].first->fReady) {
+                    // 'fReady' is set just before the thread releases the mutex and returns
+                    fLoaders[i].second.join();
+                    fLoaders.erase(fLoaders.begin() + i);
+                } else {
+                    i++;
+                }
+            }
+        }
+
+        static size_t getBytes(Soundfile* soundfile)
+        {
+            int length = soundfile->fOffset[MAX_SOUNDFILE_PARTS - 1] + soundfile->fLength[MAX_SOUNDFILE_PARTS - 1];
+            return size_t(soundfile->fChannels) * size_t(length) * sizeof(FAUSTFLOAT);
+        }
+
+        // Called with the mutex locked, the zones are set to the loaded soundfile
+        void setReady(std::shared_ptr<Entry> entry, Soundfile* soundfile)
+        {
+            // Keep 'defaultsound' if the soundfiles cannot be read
+            entry->fSoundfile = (soundfile) ? soundfile : defaultsound;
+            entry->fBytes = (soundfile) ? getBytes(soundfile) : 0;
+            entry->fReady = true;
+            for (size_t i = 0; i < entry->fZones.size(); i++) {
+                setZone(entry->fZones[i], entry->fSoundfile);
+            }
+        }
+
+        void deleteEntry(std::shared_ptr<Entry> entry)
+        {
+            if (entry->fSoundfile != defaultsound) delete entry->fSoundfile;
+            entry->fSoundfile = NULL;
+        }
+
+        void load(std::shared_ptr<Entry> entry, std::vector<std::string> path_name_list)
+        {
+            Soundfile* soundfile = createSoundfile(path_name_list, MAX_CHAN);
+            std::lock_guard<std::mutex> lock(fMutex);
+            setReady(entry, soundfile);
+            // All zones released during the loading
+            if (entry->fZones.empty()) {
+                deleteEntry(entry);
+            }
+        }
+
+        static std::string getKey(const std::vector<std::string>& path_name_list)
+        {
+            std::stringstream key;
+            key << MAX_CHAN << " " << sizeof(FAUSTFLOAT);
+            for (size_t i = 0; i < path_name_list.size(); i++) {
+                key << "\n" << path_name_list[i];
+            }
+            return key.str();
+        }
+
+    public:
+
+        // Waits for the loading threads, which use the cache
+        ~SoundfileCache()
+        {
+            for (size_t i = 0; i < fLoaders.size(); i++) {
+                fLoaders[i].second.join();
+            }
+        }
+
+        static SoundfileCache& getInstance()
+        {
+            static SoundfileCache gCache;
+            return gCache;
+        }
+
+        /**
+         * Set the zone to the soundfile, loaded if not already in the cache.
+         *
+         * @param path_name_list - the resolved paths of the soundfile parts
+         * @param sf_zone - the DSP zone, to be released with 'release'
+         * @param async - whether the soundfile is loaded in a background thread
+         */
+        void acquire(const std::vector<std::string>& path_name_list, Soundfile** sf_zone, bool async)
+        {
+            std::string key = getKey(path_name_list);
+            std::unique_lock<std::mutex> lock(fMutex);
+            std::shared_ptr<Entry> entry = fEntries[key];
+            bool created = !entry;
+            if (created) {
+                entry = std::make_shared<Entry>();
+                fEntries[key] = entry;
+            }
+            entry->fZones.push_back(sf_zone);
+            setZone(sf_zone, (entry->fReady) ? entry->fSoundfile : defaultsound);
+            if (created) {
+                if (async) {
+                    joinLoaders();
+                    fLoaders.push_back(std::make_pair(entry, std::thread(&SoundfileCache::load, this, entry, path_name_list)));
+                } else {
+                    // The soundfile is read without holding the lock
+                    lock.unlock();
+                    load(entry, path_name_list);
+                }
+            }
+        }
+
+        void release(const std::vector<std::string>& path_name_list, Soundfile** sf_zone)
+        {
+            std::string key = getKey(path_name_list);
+            std::lock_guard<std::mutex> lock(fMutex);
+            std::map<std::string, std::shared_ptr<Entry> >::iterator it = fEntries.find(key);
+            if (it == fEntries.end()) return;
+            std::shared_ptr<Entry> entry = (*it).second;
+            std::vector<Soundfile**>::iterator zone = std::find(entry->fZones.begin(), entry->fZones.end(), sf_zone);
+            if (zone != entry->fZones.end()) entry->fZones.erase(zone);
+            if (entry->fZones.empty()) {
+                fEntries.erase(it);
+                // Otherwise deleted by the loading thread
+                if (entry->fReady) deleteEntry(entry);
+            }
+        }
+
+        SoundfileCacheStats getStats()
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            SoundfileCacheStats stats = { 0, 0, 0, 0 };
+            std::map<std::string, std::shared_ptr<Entry> >::iterator it;
+            for (it = fEntries.begin(); it != fEntries.end(); it++) {
+                std::shared_ptr<Entry> entry = (*it).second;
+                stats.fSoundfiles++;
+                stats.fReferences += int(entry->fZones.size());
+                stats.fBytes += entry->fBytes;
+                stats.fSharedBytes += entry->fBytes * (entry->fZones.size() - 1);
+            }
+            return stats;
+        }
+
+};
+
 class SoundUI : public GenericUI
 {
 		
     private:
     
         std::vector<std::string> fSoundfileDir;             // The soundfile directories
-        std::map<std::string, Soundfile*> fSoundfileMap;    // Map to share loaded soundfiles
+        std::map<std::string, std::vector<std::string> > fPathNames;   // Resolved paths of each url
+        std::vector<std::pair<std::string, Soundfile**> > fZones;      // Zones acquired in the cache, with their url
+        bool fAsync;
     
      public:
-            
-        SoundUI(const std::string& sound_directory = "")
+    
+        /**
+         * Constructor.
+         *
+         * @param sound_directory - the directory where the soundfiles are searched
+         * @param async - if true, the soundfiles are loaded in background threads, the DSP playing empty soundfiles until they are ready
+         */
+        SoundUI(const std::string& sound_directory = "", bool async = false):fAsync(async)
         {
             fSoundfileDir.push_back(sound_directory);
         }
     
-        SoundUI(const std::vector<std::string>& sound_directories):fSoundfileDir(sound_directories)
+        SoundUI(const std::vector<std::string>& sound_directories, bool async = false):fSoundfileDir(sound_directories), fAsync(async)
         {}
     
+        /*
+         The soundfiles are released in the cache, so the DSP instances using this SoundUI must have stopped computing.
+         With asynchronous loading, they must not be deleted before this SoundUI (the loading threads set their zones).
+         */
         virtual ~SoundUI()
         {   
-            // Delete all soundfiles
-            std::map<std::string, Soundfile*>::iterator it;
-            for (it = fSoundfileMap.begin(); it != fSoundfileMap.end(); it++) {
-                delete (*it).second;
+            for (size_t i = 0; i < fZones.size(); i++) {
+                SoundfileCache::getInstance().release(fPathNames[fZones[i].first], fZones[i].second);
             }
         }
 
         // -- soundfiles
         virtual void addSoundfile(const char* label, const char* url, Soundfile** sf_zone)
         {
-            std::vector<std::string> file_name_list;
-            bool menu = parseMenuList2(url, file_name_list);
-            // If not a list, we have as single file
-            if (!menu) { file_name_list.push_back(url); }
-            
             // Parse the possible list
-            if (fSoundfileMap.find(url) == fSoundfileMap.end()) {
+            if (fPathNames.find(url) == fPathNames.end()) {
+                std::vector<std::string> file_name_list;
+                bool menu = parseMenuList2(url, file_name_list);
+                // If not a list, we have as single file
+                if (!menu) { file_name_list.push_back(url); }
                 // Check all files and get their complete path
-                std::vector<std::string> path_name_list = SoundfileReader::checkFiles(fSoundfileDir, file_name_list);
-                // Read them and create the Soundfile
-                fSoundfileMap[url] = createSoundfile(path_name_list, MAX_CHAN);
+                fPathNames[url] = SoundfileReader::checkFiles(fSoundfileDir, file_name_list);
             }
             
-            // Get the soundfile
-            *sf_zone = fSoundfileMap[url];
+            // Get the soundfile, read them and create the Soundfile if not already in the cache
+            SoundfileCache::getInstance().acquire(fPathNames[url], sf_zone, fAsync);
+            fZones.push_back(std::make_pair(std::string(url), sf_zone));
         }
     
+        static SoundfileCacheStats getCacheStats() { return SoundfileCache::getInstance().getStats(); }
+    
         static std::string getBinaryPath(std::string folder = "")
         {
             std::string bundle_path_str;
@@ -24,7 +24,10 @@
 #ifndef __Soundfile__
 #define __Soundfile__
 
+#include <string.h>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #ifndef FAUSTFLOAT
 #define FAUSTFLOAT float
@@ -59,6 +62,15 @@
     - idx(p,i) = fOffset[p] + max(0, min(i, fLength[p]));
 */
 
+/*
+ Owner of the channel buffers when they are not allocated by SoundfileReader::create
+ (like a memory mapped file), deleted with the Soundfile.
+ */
+
+struct SoundfileMemory {
+    virtual ~SoundfileMemory() {}
+};
+
 PRE_PACKED_STRUCTURE
 struct Soundfile {
     FAUSTFLOAT** fBuffers;
@@ -66,18 +78,24 @@ struct Soundfile {
     int fSampleRate[MAX_SOUNDFILE_PARTS];  // sample rate of each part
     int fOffset[MAX_SOUNDFILE_PARTS];      // offset of each part in the global buffer
     int fChannels;                         // max number of channels of all concatenated files
+    SoundfileMemory* fMemory;              // owner of the channel buffers, or NULL if allocated by 'create' (not used by the DSP code)
 
     Soundfile()
     {
         fBuffers  = NULL;
         fChannels = -1;
+        fMemory   = NULL;
     }
 
     ~Soundfile()
     {
-        // Free the real channels only
-        for (int chan = 0; chan < fChannels; chan++) {
-            delete fBuffers[chan];
+        if (fMemory) {
+            delete fMemory;
+        } else {
+            // Free the real channels only
+            for (int chan = 0; chan < fChannels; chan++) {
+                delete[] fBuffers[chan];
+            }
         }
         delete[] fBuffers;
     }
@@ -100,7 +118,7 @@ class SoundfileReader {
         offset += soundfile->fLength[part];
     }
 
-    Soundfile* create(int cur_chan, int length, int max_chan)
+    virtual Soundfile* create(int cur_chan, int length, int max_chan)
     {
         Soundfile* soundfile = new Soundfile();
         if (!soundfile) {
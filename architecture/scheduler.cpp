@@ -26,17 +26,27 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
 #include <semaphore.h>
 #include <sys/types.h>
+#ifdef __APPLE__
 #include <sys/sysctl.h>
+#endif
 #include <sys/stat.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <math.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 // For AVOIDDENORMALS
 #include "faust/dsp/dsp.h"
@@ -61,7 +71,7 @@ static int GetPID()
 
 #define MASTER_THREAD 0
 #define MAX_STEAL_DUR 50                        // in usec
-#define DEFAULT_CLOCKS_PER_SEC 2500000000       // in cycles (2,5 Ghz)
+#define MAX_SPIN 2048                           // in pause loops
 #define JACK_SCHED_POLICY SCHED_FIFO
 #define KDSPMESURE 50
 
@@ -282,104 +292,26 @@ inline bool Semaphore::try_wait()
 static void Yield();
 
 /**
- * Returns the number of clock cycles elapsed since the last reset
- * of the processor
+ * Hints the processor that the thread is spinning
  */
-static INLINE UInt64 DSP_rdtsc(void)
+static INLINE void Pause()
 {
-	union {
-		UInt32 i32[2];
-		UInt64 i64;
-	} count;
-	
-	__asm__ __volatile__("rdtsc" : "=a" (count.i32[0]), "=d" (count.i32[1]));
-    return count.i64;
-}
-
 #if defined(__i386__) || defined(__x86_64__)
-
-#define LOCK "lock ; "
-
-static INLINE void NOP(void)
-{
-    /*
-    #ifndef __APPLE__
-	__asm__ __volatile__("nop \n\t");
-    #endif
-    */
-}
-
-static INLINE char CAS1(volatile void* addr, volatile int value, int newvalue)
-{
-    return __sync_bool_compare_and_swap((int*)addr, value, newvalue);
-}
-
-static INLINE int atomic_xadd(volatile int* atomic, int val) 
-{ 
-     return __sync_add_and_fetch(atomic, val);
-} 
-
+    __builtin_ia32_pause();
+#elif defined(__arm__) || defined(__aarch64__)
+    __asm__ __volatile__("yield");
 #endif
-
-/*
-static INLINE int INC_ATOMIC(volatile int* val)
-{
-    int actual;
-    do {
-        actual = *val;
-    } while (!CAS1(val, actual, actual + 1));
-    return actual;
 }
 
-static INLINE int DEC_ATOMIC(volatile int* val)
+static uint64_t GetMicroSeconds()
 {
-    int actual;
-    do {
-        actual = *val;
-    } while (!CAS1(val, actual, actual - 1));
-    return actual;
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now().time_since_epoch()).count());
 }
-*/
 
-static INLINE int INC_ATOMIC(volatile int* val)
-{
-    return atomic_xadd(val, 1);
-}
- 
-static INLINE int DEC_ATOMIC(volatile int* val)
-{
-    return atomic_xadd(val, -1);
-}
- 
-// To be used in lock-free queue
-struct AtomicCounter 
-{
-    union {
-        struct {
-            short fHead;	
-            short fTail;	
-        } scounter;
-        int fValue;
-    } info;
-    
-    INLINE AtomicCounter()
-	{
-        info.fValue = 0;
-    }
-      
- 	INLINE AtomicCounter& operator=(AtomicCounter& obj)
-    {
-        info.fValue = obj.info.fValue;
-        return *this;
-    }
-    
-	INLINE AtomicCounter& operator=(volatile AtomicCounter& obj)
-	{
-        info.fValue = obj.info.fValue;
-        return *this;
-    }
-    
-};
+/* The real-time parameters of the first audio thread are read once (by GetRealTime), and given to the workers */
+static std::atomic<bool> gRealTimeReady(false);
+static pthread_mutex_t gRealTimeMutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* use 512KB stack per thread - the default is way too high to be feasible
  * with mlockall() on many systems */
@@ -530,35 +462,27 @@ static int GetParams(pthread_t thread, UInt64* period, UInt64* computation, UInt
 }
 
 
-static double gTimeRatio = 0;
 static UInt64 gPeriod = 0;
 static UInt64 gComputation = 0;
 static UInt64 gConstraint = 0;
 
-/* This should only be called ONCE per process. */
-static void InitTime()
-{
-	mach_timebase_info_data_t info;
-	mach_timebase_info(&info);
-	gTimeRatio = ((double)info.numer / (double)info.denom) / 1000;
-}
-
-UInt64 GetMicroSeconds(void)
-{
-    return UInt64(mach_absolute_time() * gTimeRatio);
-}
-
 void GetRealTime()
 {
-    if (gPeriod == 0) {
-        InitTime();
-        GetParams(pthread_self(), &gPeriod, &gComputation, &gConstraint);
+    if (!gRealTimeReady.load(std::memory_order_acquire)) {
+        pthread_mutex_lock(&gRealTimeMutex);
+        if (!gRealTimeReady.load(std::memory_order_relaxed)) {
+            GetParams(pthread_self(), &gPeriod, &gComputation, &gConstraint);
+            gRealTimeReady.store(true, std::memory_order_release);
+        }
+        pthread_mutex_unlock(&gRealTimeMutex);
     }
 }
 
 static void SetRealTime()
 {
-    SetThreadToPriority(pthread_self(), 96, true, gPeriod, gComputation, gConstraint);
+    if (gRealTimeReady.load(std::memory_order_acquire)) {
+        SetThreadToPriority(pthread_self(), 96, true, gPeriod, gComputation, gConstraint);
+    }
 }
 
 static void CancelThread(pthread_t fThread)
@@ -591,16 +515,25 @@ static struct sched_param faust_rt_param;
 
 void GetRealTime()
 {
-    if (faust_sched_policy == -1) {
-        memset(&faust_rt_param, 0, sizeof(faust_rt_param));
-    	pthread_getschedparam(pthread_self(), &faust_sched_policy, &faust_rt_param);
+    if (!gRealTimeReady.load(std::memory_order_acquire)) {
+        pthread_mutex_lock(&gRealTimeMutex);
+        if (!gRealTimeReady.load(std::memory_order_relaxed)) {
+            memset(&faust_rt_param, 0, sizeof(faust_rt_param));
+            pthread_getschedparam(pthread_self(), &faust_sched_policy, &faust_rt_param);
+            gRealTimeReady.store(true, std::memory_order_release);
+        }
+        pthread_mutex_unlock(&gRealTimeMutex);
     }
 }
 
 static void SetRealTime()
 {
-	faust_rt_param.sched_priority--;
-    pthread_setschedparam(pthread_self(), faust_sched_policy, &faust_rt_param);
+    // Workers run just below the audio thread
+    if (gRealTimeReady.load(std::memory_order_acquire)) {
+        struct sched_param rt_param = faust_rt_param;
+        rt_param.sched_priority--;
+        pthread_setschedparam(pthread_self(), faust_sched_policy, &rt_param);
+    }
 }
 
 static void CancelThread(pthread_t fThread)
@@ -611,13 +544,7 @@ static void CancelThread(pthread_t fThread)
 
 static void Yield()
 {
-    pthread_yield();
-}
-
-// TODO
-static UInt64 GetMicroSeconds(void)
-{	
-    return 0;
+    sched_yield();
 }
 
 static void get_affinity(pthread_t thread) {}
@@ -680,7 +607,6 @@ class DynThreadAdapter {
         INLINE void StartMeasure()
         {
             if (fDynAdapt) {
-                //fStart = DSP_rdtsc();
                 fStart = GetMicroSeconds();
             }
         }
@@ -691,7 +617,6 @@ class DynThreadAdapter {
                 return;
             }
             
-            //fStop = DSP_rdtsc();
             fStop = GetMicroSeconds();
             fCounter = (fCounter + 1) % KDSPMESURE;
             if (fCounter == 0) {
@@ -726,138 +651,123 @@ class DynThreadAdapter {
         }
 };
 
-#define Value(e) (e).info.fValue
-
-#define Head(e) (e).info.scounter.fHead
-#define IncHead(e) (e).info.scounter.fHead++
-#define DecHead(e) (e).info.scounter.fHead--
-
-#define Tail(e) (e).info.scounter.fTail
-#define IncTail(e) (e).info.scounter.fTail++
-#define DecTail(e) (e).info.scounter.fTail--
+/*
+    Chase-Lev work-stealing deque : the owner thread pushes and pops its tasks at the bottom,
+    the other threads steal them at the top. The indexes only grow, and the ring buffer is larger
+    than the task graph since a task is pushed at most once per buffer.
+*/
 
 class TaskQueue 
 {
     private:
     
-        int* fTaskList;
-        int fTaskQueueSize;
-        volatile AtomicCounter fCounter;
+        std::atomic<int>* fTaskList;
+        int64_t fTaskQueueMask;
+        std::atomic<int64_t> fTop;
+        std::atomic<int64_t> fBottom;
         
-        UInt64 fStealingStart;
-        UInt64 fMaxStealing;
+        uint64_t fStealingStart;
+        uint64_t fMaxStealing;
      
     public:
   
-        INLINE TaskQueue()
+        INLINE TaskQueue():fTaskList(NULL), fTaskQueueMask(0), fTop(0), fBottom(0)
         {}
         
         INLINE void Init(int task_queue_size)
         {
-            fTaskQueueSize = task_queue_size;
-            fTaskList = new int[fTaskQueueSize];
-            for (int i = 0; i < fTaskQueueSize; i++) {
-                fTaskList[i] = -1;
+            int64_t size = 1;
+            while (size <= task_queue_size) {
+                size <<= 1;
+            }
+            fTaskQueueMask = size - 1;
+            fTaskList = new std::atomic<int>[size];
+            for (int64_t i = 0; i < size; i++) {
+                fTaskList[i].store(-1, std::memory_order_relaxed);
             }
             fStealingStart = 0;
-             
-            int clock_per_microsec = (getenv("CLOCKSPERSEC") 
-                ? strtoll(getenv("CLOCKSPERSEC"), NULL, 10) 
-                : DEFAULT_CLOCKS_PER_SEC) / 1000000;
-                
-            fMaxStealing = getenv("OMP_STEALING_DUR") 
-                ? strtoll(getenv("OMP_STEALING_DUR"), NULL, 10) * clock_per_microsec 
-                : MAX_STEAL_DUR * clock_per_microsec;
+            fMaxStealing = getenv("OMP_STEALING_DUR")
+                ? strtoll(getenv("OMP_STEALING_DUR"), NULL, 10)
+                : MAX_STEAL_DUR;
         }
         
         INLINE ~TaskQueue()
         {
             delete[] fTaskList;
         }
-         
-        INLINE void InitOne()
-        {
-            for (int i = 0; i < fTaskQueueSize; i++) {
-                fTaskList[i] = -1;
-            }
-            fCounter.info.fValue = 0;
-            fStealingStart = 0;
-        }
         
+        // Owner thread only
         INLINE void PushHead(int item)
         {
-            fTaskList[Head(fCounter)] = item;
-            IncHead(fCounter);
+            int64_t bottom = fBottom.load(std::memory_order_relaxed);
+            fTaskList[bottom & fTaskQueueMask].store(item, std::memory_order_relaxed);
+            fBottom.store(bottom + 1, std::memory_order_release);
         }
         
+        // Owner thread only
         INLINE int PopHead()
         {
-            AtomicCounter old_val;
-            AtomicCounter new_val;
-            
-            do {
-                old_val = fCounter;
-                new_val = old_val;
-                if (Head(old_val) == Tail(old_val)) {
-                    return WORK_STEALING_INDEX;
-                } else {
-                    DecHead(new_val);
+            int64_t bottom = fBottom.load(std::memory_order_relaxed) - 1;
+            // The store of bottom is ordered before the load of top (seq_cst), so that a thief and the owner
+            // cannot both take the last task
+            fBottom.store(bottom, std::memory_order_seq_cst);
+            int64_t top = fTop.load(std::memory_order_seq_cst);
+            int item = WORK_STEALING_INDEX;
+            if (top <= bottom) {
+                item = fTaskList[bottom & fTaskQueueMask].load(std::memory_order_relaxed);
+                if (top == bottom) {
+                    // Last task : races with the thieves
+                    if (!fTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                        item = WORK_STEALING_INDEX;
+                    }
+                    fBottom.store(bottom + 1, std::memory_order_release);
                 }
-            } while (!CAS1(&fCounter, Value(old_val), Value(new_val)));
-            
-            return fTaskList[Head(old_val) - 1];
+            } else {
+                fBottom.store(bottom + 1, std::memory_order_release);
+            }
+            return item;
         }
         
         INLINE int PopTail()
-        {   
-            AtomicCounter old_val;
-            AtomicCounter new_val;
-
-            do {
-                old_val = fCounter;
-                new_val = old_val;
-                if (Head(old_val) == Tail(old_val)) {
-                    return WORK_STEALING_INDEX;
-                } else {
-                    IncTail(new_val);
+        {
+            int64_t top = fTop.load(std::memory_order_seq_cst);
+            int64_t bottom = fBottom.load(std::memory_order_seq_cst);
+            if (top < bottom) {
+                int item = fTaskList[top & fTaskQueueMask].load(std::memory_order_relaxed);
+                if (fTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    return item;
                 }
-            } while (!CAS1(&fCounter, Value(old_val), Value(new_val)));
-
-            return fTaskList[Tail(old_val)];
+            }
+            return WORK_STEALING_INDEX;
         }
 
-		INLINE void MeasureStealingDur()
-		{
+        INLINE void MeasureStealingDur()
+        {
             // Takes first timestamp
             if (fStealingStart == 0) {
-                fStealingStart = DSP_rdtsc();
-            } else if ((DSP_rdtsc() - fStealingStart) > fMaxStealing) {
+                fStealingStart = GetMicroSeconds();
+            } else if ((GetMicroSeconds() - fStealingStart) > fMaxStealing) {
                 Yield();
+                return;
             }
-		}
+            Pause();
+        }
 
-		INLINE void ResetStealingDur()
-		{
+        INLINE void ResetStealingDur()
+        {
             fStealingStart = 0;
-		}
+        }
            
         static INLINE int GetNextTask(TaskQueue* task_queue_list, int cur_thread, int num_threads)
         {
             int tasknum;
             for (int i = 0; i < num_threads; i++) {
                 if ((tasknum = task_queue_list[i].PopTail()) != WORK_STEALING_INDEX) {
-                #ifdef __linux__
-                    //if (cur_thread != MASTER_THREAD)
-                        task_queue_list[cur_thread].ResetStealingDur();
-                #endif
+                    task_queue_list[cur_thread].ResetStealingDur();
                     return tasknum;    // Task is found
                 }
             }
-            //NOP();
-        #ifdef __linux__
-			//if (cur_thread != MASTER_THREAD)
-                task_queue_list[cur_thread].MeasureStealingDur();
-        #endif
+            task_queue_list[cur_thread].MeasureStealingDur();
             return WORK_STEALING_INDEX;    // Otherwise will try "workstealing" again next cycle...
         }
          
@@ -878,13 +788,6 @@ class TaskQueue
                 }
             }
         }
-        
-        static INLINE void InitAll(TaskQueue* task_queue_list, int num_threads)
-        {
-            for (int i = 0; i < num_threads; i++) {
-                task_queue_list[i].InitOne();
-            }
-        }
      
 };
 
@@ -892,7 +795,7 @@ class TaskGraph
 {
     private:
     
-        volatile int* fTaskList;
+        std::atomic<int>* fTaskList;
         int fTaskQueueSize;
         
     public:
@@ -900,9 +803,9 @@ class TaskGraph
         TaskGraph(int task_queue_size)
         {
             fTaskQueueSize = task_queue_size;
-            fTaskList = new int[fTaskQueueSize];
+            fTaskList = new std::atomic<int>[fTaskQueueSize];
             for (int i = 0; i < fTaskQueueSize; i++) {
-                fTaskList[i] = 0;
+                fTaskList[i].store(0, std::memory_order_relaxed);
             } 
         }
         
@@ -911,21 +814,28 @@ class TaskGraph
             delete[] fTaskList;
         }
 
+        // The counters are set before the tasks are pushed (or the job opened), which publishes them
         INLINE void InitTask(int task, int val)
         {
-            fTaskList[task] = val;
+            fTaskList[task].store(val, std::memory_order_relaxed);
         }
         
         void Display()
         {
             for (int i = 0; i < fTaskQueueSize; i++) {
-                printf("Task = %d activation = %d\n", i, fTaskList[i]);
+                printf("Task = %d activation = %d\n", i, fTaskList[i].load(std::memory_order_relaxed));
             } 
         }
+        
+        // The last input of a task activates it, and sees the outputs of the other inputs (acq_rel)
+        INLINE bool Activate(int task)
+        {
+            return fTaskList[task].fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
           
         INLINE void ActivateOutputTask(TaskQueue& queue, int task, int* tasknum)
         {
-            if (DEC_ATOMIC(&fTaskList[task]) == 0) {
+            if (Activate(task)) {
                 if (*tasknum == WORK_STEALING_INDEX) {
                     *tasknum = task;
                 } else {
@@ -936,14 +846,14 @@ class TaskGraph
           
         INLINE void ActivateOutputTask(TaskQueue& queue, int task)
         {   
-            if (DEC_ATOMIC(&fTaskList[task]) == 0) {
+            if (Activate(task)) {
                 queue.PushHead(task);
             }
         }
          
         INLINE void ActivateOneOutputTask(TaskQueue& queue, int task, int* tasknum)
         {   
-            if (DEC_ATOMIC(&fTaskList[task]) == 0) {
+            if (Activate(task)) {
                 *tasknum = task;
             } else {
                 *tasknum = queue.PopHead(); 
@@ -959,36 +869,154 @@ class TaskGraph
         
 };
 
+#define MAX_SCHEDULERS 256
+#define JOB_SLOTS_SHIFT 16
+#define JOB_JOINED_MASK 0xffff
+
+/*
+    Idle workers : each wake-up is a token taken by one worker. A waiting worker spins for a while
+    (the next audio cycle is usually close), then is parked on a futex (Linux) or a semaphore.
+*/
+
+class Parking {
+
+    private:
+    
+        std::atomic<int> fTokens;
+        std::atomic<int> fSleepers;
+    #ifndef __linux__
+        Semaphore fSemaphore;
+    #endif
+    
+        INLINE bool TryTake()
+        {
+            int tokens = fTokens.load(std::memory_order_seq_cst);
+            while (tokens > 0) {
+                if (fTokens.compare_exchange_weak(tokens, tokens - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    
+        void Sleep()
+        {
+        #ifdef __linux__
+            // Only sleeps if no token has been posted since TryTake
+            syscall(SYS_futex, reinterpret_cast<int*>(&fTokens), FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+        #else
+            fSemaphore.wait();
+        #endif
+        }
+    
+        void Wake(int num)
+        {
+        #ifdef __linux__
+            syscall(SYS_futex, reinterpret_cast<int*>(&fTokens), FUTEX_WAKE_PRIVATE, num, NULL, NULL, 0);
+        #else
+            for (int i = 0; i < num; i++) {
+                fSemaphore.post();
+            }
+        #endif
+        }
+    
+    public:
+    
+    #ifdef __linux__
+        Parking():fTokens(0), fSleepers(0)
+        {}
+    #else
+        Parking():fTokens(0), fSleepers(0), fSemaphore(0)
+        {}
+    #endif
+    
+        void Post(int num)
+        {
+            if (num > 0) {
+                fTokens.fetch_add(num, std::memory_order_seq_cst);
+                // A worker going to sleep after this test sees the tokens
+                if (fSleepers.load(std::memory_order_seq_cst) > 0) {
+                    Wake(num);
+                }
+            }
+        }
+    
+        void Wait()
+        {
+            for (int spin = 0; spin < MAX_SPIN; spin++) {
+                if (TryTake()) {
+                    return;
+                }
+                Pause();
+            }
+            fSleepers.fetch_add(1, std::memory_order_seq_cst);
+            while (!TryTake()) {
+                Sleep();
+            }
+            fSleepers.fetch_sub(1, std::memory_order_relaxed);
+        }
+    
+};
+
 class DSPThread;
+class WorkStealingScheduler;
+
+/*
+    Process-wide pool of worker threads (one per core), shared by all the DSPs compiled with -sch.
+ 
+    At each audio cycle a DSP opens a job (see WorkStealingScheduler::SignalAll), that the workers
+    join to compute its task graph with the DSP own task queues: a joining worker gets a slot, which is
+    the index of its task queue in this DSP. Each job is given a fair share of the workers, and the
+    workers scan the DSPs from a rotating index, so that the independent DSP graphs computed at the
+    same time (by several audio threads) are interleaved instead of having their own threads.
+*/
 
 class DSPThreadPool {
     
     private:
     
         DSPThread** fThreadPool;
-        int fThreadCount; 
-        volatile int fCurThreadCount;
-      
-    public:
-        
+        int fThreadCount;
+        Parking fParking;
+        std::atomic<bool> fStopped;
+    
+        std::atomic<WorkStealingScheduler*> fSchedulers[MAX_SCHEDULERS];
+        std::atomic<int> fSchedulersSize;
+        std::atomic<int> fScanning;     // workers reading fSchedulers
+        std::atomic<int> fNextScan;
+        std::atomic<int> fActiveJobs;
+    
+        int fRefCount;
+    
         DSPThreadPool(int thread_pool_size);
         ~DSPThreadPool();
-    
-        void StartAll(int num_thread, bool realtime, void* dsp);
-       
-        void StopAll();
       
-        void SignalAll(int num_thread);
-        
-        void SignalOne()
+    public:
+    
+        // The pool is created by the first scheduler and deleted with the last one
+        static DSPThreadPool* Acquire();
+        static void Release();
+    
+        int GetThreadCount() { return fThreadCount; }
+    
+        bool Register(WorkStealingScheduler* scheduler);
+        void Unregister(WorkStealingScheduler* scheduler);
+    
+        // Counts the jobs in progress, and wakes 'num_thread' workers for a new one
+        int OpenJob()
         {
-            DEC_ATOMIC(&fCurThreadCount);
+            return fActiveJobs.fetch_add(1, std::memory_order_relaxed) + 1;
         }
-
-        bool IsFinished()
+    
+        void CloseJob()
         {
-            return (fCurThreadCount == 0);
+            fActiveJobs.fetch_sub(1, std::memory_order_relaxed);
         }
+    
+        void SignalAll(int num_thread);
+    
+        // Computes the open jobs, until none can be joined, returns false when the pool is deleted
+        bool Run();
 
 };
 
@@ -998,10 +1026,8 @@ class DSPThread {
     
         pthread_t fThread;
         DSPThreadPool* fThreadPool;
-        Semaphore fSemaphore;
         bool fRealTime;
         int fNumThread;
-        void* fDSP;
         
         static void* ThreadHandler(void* arg)
         {
@@ -1012,38 +1038,26 @@ class DSPThread {
 
             // One "dummy" cycle to setup thread
             if (thread->fRealTime) {
-                thread->Run();
+                if (!thread->fThreadPool->Run()) {
+                    return NULL;
+                }
                 SetRealTime();
             }
                       
-            while (true) {
-                thread->Run();
-            }
+            while (thread->fThreadPool->Run()) {}
             
             return NULL;
         }
     
     public: 
     
-        DSPThread(int num_thread, DSPThreadPool* pool, void* dsp)
-            :fThreadPool(pool), fSemaphore(0), fRealTime(false), fNumThread(num_thread), fDSP(dsp) 
+        DSPThread(int num_thread, DSPThreadPool* pool)
+            :fThreadPool(pool), fRealTime(false), fNumThread(num_thread)
         {}
 
         virtual ~DSPThread()
         {}
         
-        void Run()
-        {
-            fSemaphore.wait();
-            computeThreadExternal(fDSP, fNumThread + 1);
-            //fThreadPool->SignalOne();
-        }
-                
-        void Signal()
-        {
-            fSemaphore.post();
-        }
-        
         int Start(bool realtime)
         {
             pthread_attr_t attributes;
@@ -1121,56 +1135,6 @@ class DSPThread {
 
 };
 
-DSPThreadPool::DSPThreadPool(int thread_pool_size)
-{
-    fThreadPool = new DSPThread*[thread_pool_size];
-    for (int i = 0; i < thread_pool_size; i++) {
-        fThreadPool[i] = NULL;
-    }
-    fThreadCount = 0;
-    fCurThreadCount = 0;
-}
-
-DSPThreadPool::~DSPThreadPool()
-{
-    StopAll();
-    
-    for (int i = 0; i < fThreadCount; i++) {
-        delete(fThreadPool[i]);
-        fThreadPool[i] = NULL;
-    }
-    
-    fThreadCount = 0;
-    delete[] fThreadPool;
-}
-
-void DSPThreadPool::StartAll(int num_thread, bool realtime, void* dsp)
-{
-    if (fThreadCount == 0) {  // Protection for multiple call...  (like LADSPA plug-ins in Ardour)
-        for (int i = 0; i < num_thread; i++) {
-            fThreadPool[i] = new DSPThread(i, this, dsp);
-            fThreadPool[i]->Start(realtime);
-            fThreadCount++;
-        }
-    }
-}
-
-void DSPThreadPool::StopAll()
-{
-    for (int i = 0; i < fThreadCount; i++) {
-        fThreadPool[i]->Stop();
-    }
-}
-
-void DSPThreadPool::SignalAll(int num_thread)
-{
-    fCurThreadCount = num_thread;
-     
-    for (int i = 0; i < num_thread; i++) {  // Important : use local num here...
-        fThreadPool[i]->Signal();
-    }
-}
-
 /*
     Public C++ interface
 */
@@ -1192,14 +1156,23 @@ class WorkStealingScheduler {
         int fReadyTaskListSize;
         int fReadyTaskListIndex;
     
+        void* fDSP;
+        bool fRegistered;
+    
+        // Slots given to the current job (0 when closed) and number of joined workers
+        std::atomic<int> fJob;
+        std::atomic<int> fLeft;
+    
     public:
     
         WorkStealingScheduler(int task_queue_size, int init_task_list_size)
         {
-            fStaticNumThreads = get_max_cpu();
-            fDynamicNumThreads = getenv("OMP_NUM_THREADS") ? atoi(getenv("OMP_NUM_THREADS")) : fStaticNumThreads;
+            fThreadPool = DSPThreadPool::Acquire();
+            
+            // The DSP thread and the workers of the pool
+            fStaticNumThreads = fThreadPool->GetThreadCount() + 1;
+            fDynamicNumThreads = fStaticNumThreads;
             
-            fThreadPool = new DSPThreadPool(fStaticNumThreads);
             fTaskGraph = new TaskGraph(task_queue_size);
             fTaskQueueList = new TaskQueue[fStaticNumThreads];
             for (int i = 0; i < fStaticNumThreads; i++) {
@@ -1209,11 +1182,17 @@ class WorkStealingScheduler {
             fReadyTaskListSize = init_task_list_size;
             fReadyTaskList = new int[fReadyTaskListSize];
             fReadyTaskListIndex = 0;
+            
+            fDSP = NULL;
+            fRegistered = false;
+            fJob.store(0, std::memory_order_relaxed);
+            fLeft.store(0, std::memory_order_relaxed);
         }
         
         ~WorkStealingScheduler()
         {
-            delete fThreadPool;
+            StopAll();
+            DSPThreadPool::Release();
             delete fTaskGraph;
             delete[] fTaskQueueList;
             delete[] fReadyTaskList;
@@ -1226,26 +1205,68 @@ class WorkStealingScheduler {
         
         void StartAll(void* dsp)
         {
-            fThreadPool->StartAll(fStaticNumThreads - 1, true, dsp);
+            if (!fRegistered) {  // Protection for multiple call...  (like LADSPA plug-ins in Ardour)
+                fDSP = dsp;
+                fRegistered = fThreadPool->Register(this);
+            }
         }
         
         void StopAll()
         {
-            fThreadPool->StopAll();
+            if (fRegistered) {
+                fThreadPool->Unregister(this);
+                fRegistered = false;
+            }
         }
           
         void SignalAll()
         {
             GetRealTime();
             fDynThreadAdapter.StartMeasure();
-            fThreadPool->SignalAll(fDynamicNumThreads - 1);
+            
+            // Opens the job with a fair share of the workers
+            int jobs = fThreadPool->OpenJob();
+            int share = (fThreadPool->GetThreadCount() + jobs - 1) / jobs;
+            int slots = (fRegistered) ? ((share < fDynamicNumThreads - 1) ? share : fDynamicNumThreads - 1) : 0;
+            // The task graph and the DSP state are published to the joining workers (release)
+            fLeft.store(0, std::memory_order_relaxed);
+            fJob.store(slots << JOB_SLOTS_SHIFT, std::memory_order_release);
+            fThreadPool->SignalAll(slots);
         }
         
         void SyncAll()
         {
-            //while (!fThreadPool->IsFinished()) {}
+            // Closes the job and waits for the joined workers to leave it
+            int joined = fJob.fetch_and(JOB_JOINED_MASK, std::memory_order_acq_rel) & JOB_JOINED_MASK;
+            for (int spin = 0; fLeft.load(std::memory_order_acquire) != joined; spin++) {
+                if (spin < MAX_SPIN) {
+                    Pause();
+                } else {
+                    Yield();
+                }
+            }
+            fThreadPool->CloseJob();
             fDynThreadAdapter.StopMeasure(fStaticNumThreads, fDynamicNumThreads);
         }
+    
+        // Returns the slot of a worker joining the current job, 0 if the job cannot be joined
+        int JoinJob()
+        {
+            int job = fJob.load(std::memory_order_relaxed);
+            do {
+                if ((job & JOB_JOINED_MASK) >= (job >> JOB_SLOTS_SHIFT)) {
+                    return 0;
+                }
+            } while (!fJob.compare_exchange_weak(job, job + 1, std::memory_order_acquire, std::memory_order_relaxed));
+            return (job & JOB_JOINED_MASK) + 1;
+        }
+    
+        void RunJob(int slot)
+        {
+            computeThreadExternal(fDSP, slot);
+            // Last access of the worker, the DSP may be deleted once the job is closed
+            fLeft.fetch_add(1, std::memory_order_release);
+        }
         
         void PushHead(int cur_thread, int task_num)
         {
@@ -1284,10 +1305,10 @@ class WorkStealingScheduler {
         
         void InitTaskList(int cur_thread)
         {
-            TaskQueue::InitAll(fTaskQueueList, fDynamicNumThreads);
             if (cur_thread == -1) {
-                // Dispatch on all WSQ
+                // Dispatch on all WSQ (before the job is opened, the queues are not used by the workers)
                 for (int i = 0; i < fDynamicNumThreads; i++) {
+                    fTaskQueueList[i].ResetStealingDur();
                     fTaskQueueList[i].InitTaskList(fReadyTaskListSize, fReadyTaskList, fDynamicNumThreads, i);
                 }
             } else {
@@ -1300,6 +1321,132 @@ class WorkStealingScheduler {
 
 };
 
+static DSPThreadPool* gThreadPool = NULL;
+static pthread_mutex_t gThreadPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+
+DSPThreadPool::DSPThreadPool(int thread_pool_size):fStopped(false), fSchedulersSize(0), fScanning(0), fNextScan(0), fActiveJobs(0)
+{
+    fThreadPool = new DSPThread*[thread_pool_size];
+    fThreadCount = 0;
+    for (int i = 0; i < MAX_SCHEDULERS; i++) {
+        fSchedulers[i].store(NULL, std::memory_order_relaxed);
+    }
+    fRefCount = 0;
+    
+    for (int i = 0; i < thread_pool_size; i++) {
+        DSPThread* thread = new DSPThread(i, this);
+        // Workers are non real-time if the process is not allowed to create real-time threads
+        if (thread->Start(true) == 0 || thread->Start(false) == 0) {
+            fThreadPool[fThreadCount++] = thread;
+        } else {
+            delete thread;
+        }
+    }
+}
+
+DSPThreadPool::~DSPThreadPool()
+{
+    // Parked workers are not cancellable, they are woken to quit
+    fStopped.store(true, std::memory_order_release);
+    fParking.Post(fThreadCount);
+    for (int i = 0; i < fThreadCount; i++) {
+        fThreadPool[i]->Stop();
+        delete(fThreadPool[i]);
+    }
+    fThreadCount = 0;
+    delete[] fThreadPool;
+}
+
+DSPThreadPool* DSPThreadPool::Acquire()
+{
+    pthread_mutex_lock(&gThreadPoolMutex);
+    if (!gThreadPool) {
+        // One thread per core including the audio thread, OMP_NUM_THREADS sets the number of threads of each DSP
+        int num_threads = getenv("OMP_NUM_THREADS") ? atoi(getenv("OMP_NUM_THREADS")) : get_max_cpu();
+        gThreadPool = new DSPThreadPool((num_threads > 1) ? num_threads - 1 : 0);
+    }
+    gThreadPool->fRefCount++;
+    DSPThreadPool* pool = gThreadPool;
+    pthread_mutex_unlock(&gThreadPoolMutex);
+    return pool;
+}
+
+void DSPThreadPool::Release()
+{
+    pthread_mutex_lock(&gThreadPoolMutex);
+    if (--gThreadPool->fRefCount == 0) {
+        delete gThreadPool;
+        gThreadPool = NULL;
+    }
+    pthread_mutex_unlock(&gThreadPoolMutex);
+}
+
+bool DSPThreadPool::Register(WorkStealingScheduler* scheduler)
+{
+    pthread_mutex_lock(&gThreadPoolMutex);
+    bool res = false;
+    for (int i = 0; i < MAX_SCHEDULERS; i++) {
+        if (!fSchedulers[i].load(std::memory_order_relaxed)) {
+            fSchedulers[i].store(scheduler, std::memory_order_seq_cst);
+            if (i >= fSchedulersSize.load(std::memory_order_relaxed)) {
+                fSchedulersSize.store(i + 1, std::memory_order_release);
+            }
+            res = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&gThreadPoolMutex);
+    // Otherwise the DSP is only computed by its own thread
+    return res;
+}
+
+void DSPThreadPool::Unregister(WorkStealingScheduler* scheduler)
+{
+    pthread_mutex_lock(&gThreadPoolMutex);
+    for (int i = 0; i < fSchedulersSize.load(std::memory_order_relaxed); i++) {
+        if (fSchedulers[i].load(std::memory_order_relaxed) == scheduler) {
+            fSchedulers[i].store(NULL, std::memory_order_seq_cst);
+        }
+    }
+    pthread_mutex_unlock(&gThreadPoolMutex);
+    // Waits for the workers that may have read the scheduler (seq_cst : a worker incrementing
+    // fScanning after this test reads NULL)
+    while (fScanning.load(std::memory_order_seq_cst) > 0) {
+        Yield();
+    }
+}
+
+void DSPThreadPool::SignalAll(int num_thread)
+{
+    fParking.Post(num_thread);
+}
+
+bool DSPThreadPool::Run()
+{
+    fParking.Wait();
+    if (fStopped.load(std::memory_order_acquire)) {
+        return false;
+    }
+    
+    bool found;
+    do {
+        found = false;
+        int size = fSchedulersSize.load(std::memory_order_acquire);
+        unsigned int start = (unsigned int)fNextScan.fetch_add(1, std::memory_order_relaxed);
+        for (int i = 0; i < size; i++) {
+            fScanning.fetch_add(1, std::memory_order_seq_cst);
+            WorkStealingScheduler* scheduler = fSchedulers[(start + i) % size].load(std::memory_order_seq_cst);
+            int slot = (scheduler) ? scheduler->JoinJob() : 0;
+            fScanning.fetch_sub(1, std::memory_order_release);
+            if (slot > 0) {
+                scheduler->RunJob(slot);
+                found = true;
+            }
+        }
+    } while (found);
+    return true;
+}
+
 /*
 C scheduler interface
 */
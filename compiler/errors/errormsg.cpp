@@ -24,12 +24,13 @@
 #include "exception.hh"
 #include "export.hh"
 #include "global.hh"
+#include "librarycache.hh"
 #include "ppbox.hh"
 
 #include <iostream>
 using namespace std;
 
-const char* yyfilename = "????";
+thread_local const char* yyfilename = "????";
 
 void faustassertaux(bool cond, const string& file, int line)
 {
@@ -96,7 +97,9 @@ void evalremark(const char* filename, int linenum, const char* msg, Tree exp)
 
 void setDefProp(Tree sym, const char* filename, int lineno)
 {
-    setProperty(sym, gGlobal->DEFLINEPROP, cons(tree(filename), tree(lineno)));
+    Tree line = cons(tree(filename), tree(lineno));
+    setProperty(sym, gGlobal->DEFLINEPROP, line);
+    if (gGlobal->gLibraryRecorder) gGlobal->gLibraryRecorder->action(LibraryRecorder::kDefProp, sym, line);
 }
 
 bool hasDefProp(Tree sym)
@@ -127,7 +130,9 @@ int getDefLineProp(Tree sym)
 
 void setUseProp(Tree sym, const char* filename, int lineno)
 {
-    setProperty(sym, gGlobal->USELINEPROP, cons(tree(filename), tree(lineno)));
+    Tree line = cons(tree(filename), tree(lineno));
+    setProperty(sym, gGlobal->USELINEPROP, line);
+    if (gGlobal->gLibraryRecorder) gGlobal->gLibraryRecorder->action(LibraryRecorder::kUseProp, sym, line);
 }
 
 const char* getUseFileProp(Tree sym)
@@ -31,12 +31,12 @@
 #include "global.hh"
 #include "timing.hh"
 
-// Timing can be used outside of the scope of 'gGlobal'
-bool     gTimingSwitch;
-int      gTimingIndex;
-double   gStartTime[1024];
-double   gEndTime[1024];
-ostream* gTimingLog = 0;
+// Timing can be used outside of the scope of 'gGlobal' (and is kept per thread like 'gGlobal')
+thread_local bool     gTimingSwitch;
+thread_local int      gTimingIndex;
+thread_local double   gStartTime[1024];
+thread_local double   gEndTime[1024];
+thread_local ostream* gTimingLog = 0;
 
 #ifndef _WIN32
 double mysecond()
@@ -90,3 +90,16 @@ void endTiming(const char* msg)
         }
     }
 }
+
+void infoTiming(const char* msg)
+{
+    if (gTimingSwitch) {
+        if (gTimingLog) {
+            *gTimingLog << msg << endl;
+            gTimingLog->flush();
+        } else {
+            tab(gTimingIndex, cerr);
+            cerr << msg << endl;
+        }
+    }
+}
@@ -28,4 +28,7 @@
 void startTiming(const char* msg);
 void endTiming(const char* msg);
 
+// use infoTiming("foo") to display additional information (like memory usage) with the timings
+void infoTiming(const char* msg);
+
 #endif
@@ -34,6 +34,7 @@
 #include "compatibility.hh"
 #include "errormsg.hh"
 #include "eval.hh"
+#include "evalcache.hh"
 #include "exception.hh"
 #include "global.hh"
 #include "names.hh"
@@ -54,6 +55,8 @@ static Tree   eval(Tree exp, Tree visited, Tree localValEnv);
 static Tree   realeval(Tree exp, Tree visited, Tree localValEnv);
 static Tree   revEvalList(Tree lexp, Tree visited, Tree localValEnv);
 static Tree   applyList(Tree fun, Tree larg);
+static Tree   cachedApplyList(Tree fun, Tree larg);
+static void   writeEvalCache(EvalCache* cache, const string& key, Tree result);
 static Tree   iteratePar(Tree var, int num, Tree body, Tree visited, Tree localValEnv);
 static Tree   iterateSeq(Tree id, int num, Tree body, Tree visited, Tree localValEnv);
 static Tree   iterateSum(Tree id, int num, Tree body, Tree visited, Tree localValEnv);
@@ -92,8 +95,9 @@ static Tree boxSimplification(Tree box);
  */
 Tree evalprocess(Tree eqlist)
 {
-    Tree b = a2sb(eval(boxIdent(gGlobal->gProcessName.c_str()), gGlobal->nil,
-                       pushMultiClosureDefs(eqlist, gGlobal->nil, gGlobal->nil)));
+    Tree env = pushMultiClosureDefs(eqlist, gGlobal->nil, gGlobal->nil);
+    if (gGlobal->gEvalCache) gGlobal->gEvalCache->addLayer(env, gGlobal->gInputFiles);
+    Tree b = a2sb(eval(boxIdent(gGlobal->gProcessName.c_str()), gGlobal->nil, env));
 
     if (gGlobal->gSimplifyDiagrams) {
         b = boxSimplification(b);
@@ -267,12 +271,17 @@ static Tree eval(Tree exp, Tree visited, Tree localValEnv)
     if (!getEvalProperty(exp, localValEnv, result)) {
         gGlobal->gLoopDetector.detect(cons(exp, localValEnv));
         // cerr << "ENTER eval("<< *exp << ") with env " << *localValEnv << endl;
+        if (gGlobal->gEvalCache) gGlobal->gEvalCache->enter();
         result = realeval(exp, visited, localValEnv);
+        if (gGlobal->gEvalCache) gGlobal->gEvalCache->leave(exp, localValEnv);
         setEvalProperty(exp, localValEnv, result);
         // cerr << "EXIT eval(" << *exp << ") IS " << *result << " with env " << *localValEnv << endl;
         if (getDefNameProperty(exp, id)) {
             setDefNameProperty(result, id);  // propagate definition name property
         }
+    } else if (gGlobal->gEvalCache) {
+        // the side effects of the memoized evaluation are done again for the evaluation cache
+        gGlobal->gEvalCache->reuse(exp, localValEnv);
     }
     return result;
 }
@@ -405,8 +414,12 @@ static Tree realeval(Tree exp, Tree visited, Tree localValEnv)
     } else if (isBoxComponent(exp, label)) {
         const char* fname = tree2str(label);
         Tree        eqlst = gGlobal->gReader.expandList(gGlobal->gReader.getList(fname));
-        Tree        res   = closure(boxIdent("process"), gGlobal->nil, gGlobal->nil,
-                           pushMultiClosureDefs(eqlst, gGlobal->nil, gGlobal->nil));
+        Tree        env   = pushMultiClosureDefs(eqlst, gGlobal->nil, gGlobal->nil);
+        Tree        res   = closure(boxIdent("process"), gGlobal->nil, gGlobal->nil, env);
+        if (gGlobal->gEvalCache) {
+            gGlobal->gEvalCache->library(fname);
+            gGlobal->gEvalCache->addLayer(env, list<string>(1, fname));
+        }
         setDefNameProperty(res, label);
         // cerr << "component is " << boxpp(res) << endl;
         return res;
@@ -414,8 +427,12 @@ static Tree realeval(Tree exp, Tree visited, Tree localValEnv)
     } else if (isBoxLibrary(exp, label)) {
         const char* fname = tree2str(label);
         Tree        eqlst = gGlobal->gReader.expandList(gGlobal->gReader.getList(fname));
-        Tree        res   = closure(boxEnvironment(), gGlobal->nil, gGlobal->nil,
-                           pushMultiClosureDefs(eqlst, gGlobal->nil, gGlobal->nil));
+        Tree        env   = pushMultiClosureDefs(eqlst, gGlobal->nil, gGlobal->nil);
+        Tree        res   = closure(boxEnvironment(), gGlobal->nil, gGlobal->nil, env);
+        if (gGlobal->gEvalCache) {
+            gGlobal->gEvalCache->library(fname);
+            gGlobal->gEvalCache->addLayer(env, list<string>(1, fname));
+        }
         setDefNameProperty(res, label);
         // cerr << "component is " << boxpp(res) << endl;
         return res;
@@ -484,6 +501,7 @@ static Tree realeval(Tree exp, Tree visited, Tree localValEnv)
 
     } else if (isBoxMetadata(exp, e1, e2)) {
         gGlobal->gMetaDataSet[hd(e2)].insert(tl(e2));
+        if (gGlobal->gEvalCache) gGlobal->gEvalCache->metadata(hd(e2), tl(e2));
         return eval(e1, visited, localValEnv);
 
     } else if (isBoxVBargraph(exp, label, lo, hi)) {
@@ -503,7 +521,7 @@ static Tree realeval(Tree exp, Tree visited, Tree localValEnv)
         return eval(body, visited, pushMultiClosureDefs(expandedldef, visited, localValEnv));
 
     } else if (isBoxAppl(exp, fun, arg)) {
-        return applyList(eval(fun, visited, localValEnv), revEvalList(arg, visited, localValEnv));
+        return cachedApplyList(eval(fun, visited, localValEnv), revEvalList(arg, visited, localValEnv));
 
     } else if (isBoxAbstr(exp)) {
         // it is an abstraction : return a closure
@@ -1215,10 +1233,89 @@ static Tree evalIdDef(Tree id, Tree visited, Tree lenv)
         // XXXXXX setDefNameProperty(def, s.str());
     }
 
+    // a library definition without arguments may be in the evaluation cache
+    EvalCache* cache = gGlobal->gEvalCache;
+    Tree       result;
+    string     key;
+    bool       uncached;
+    if (cache && !getEvalProperty(def, gGlobal->nil, result) && cache->getDefinitionKey(id, lenv, key)) {
+        cache->enter();
+        bool hit = cache->read(key, result, uncached);
+        cache->leave(def, gGlobal->nil);
+        if (hit) {
+            setEvalProperty(def, gGlobal->nil, result);
+            return result;
+        } else if (uncached) {
+            return eval(def, addElement(p, visited), gGlobal->nil);
+        }
+        cache->begin();
+        result = eval(def, addElement(p, visited), gGlobal->nil);
+        writeEvalCache(cache, key, result);
+        return result;
+    }
+
     // return the evaluated definition
     return eval(def, addElement(p, visited), gGlobal->nil);
 }
 
+/**
+ * Write an evaluated result in the evaluation cache. Its remaining closures are
+ * transformed into symbolic boxes, as done for the evaluated process.
+ * @param cache the evaluation cache
+ * @param key the key of the evaluation
+ * @param result the evaluated result
+ */
+
+static void writeEvalCache(EvalCache* cache, const string& key, Tree result)
+{
+    size_t depth  = cache->depth();
+    int    errors = gGlobal->gErrorCount;
+    Tree   box    = nullptr;
+    Tree   abstr, genv, vis, lenv;
+    // a function is still to be applied, it cannot be cached as a symbolic box
+    if (!isClosure(result, abstr, genv, vis, lenv) && !isBoxPatternMatcher(result)) {
+        cache->suspend();
+        try {
+            box = a2sb(result);
+        } catch (faustexception& e) {
+            // the remaining closures can only be evaluated when applied, the result is not cached
+            cache->unwind(depth);
+            gGlobal->gErrorCount = errors;
+            box                  = nullptr;
+        }
+        cache->resume();
+    }
+    cache->write(key, box);
+}
+
+/**
+ * Apply a function to a list of arguments, using the evaluation cache
+ * for the library functions applied to constant arguments.
+ * @param fun the evaluated function
+ * @param larg the list of evaluated arguments
+ * @return the result of the application
+ */
+
+static Tree cachedApplyList(Tree fun, Tree larg)
+{
+    EvalCache* cache = gGlobal->gEvalCache;
+    Tree       result;
+    string     key;
+    bool       uncached;
+    if (!cache || !cache->getApplicationKey(fun, larg, key)) {
+        return applyList(fun, larg);
+    } else if (cache->read(key, result, uncached)) {
+        return result;
+    } else if (uncached) {
+        return applyList(fun, larg);
+    } else {
+        cache->begin();
+        result = applyList(fun, larg);
+        writeEvalCache(cache, key, result);
+        return result;
+    }
+}
+
 /**
  * Creates a list of n elements.
  * @param n number of elements
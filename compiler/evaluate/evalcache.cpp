@@ -0,0 +1,365 @@
+/************************************************************************
+ ************************************************************************
+    FAUST compiler
+    Copyright (C) 2003-2018 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ ************************************************************************
+ ************************************************************************/
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+
+#include "boxes.hh"
+#include "evalcache.hh"
+#include "exception.hh"
+#include "global.hh"
+#include "libfaust.h"
+#include "librarycache.hh"
+#include "timing.hh"
+
+#define EVAL_CACHE_EXT "feval"
+
+// A block diagram without user interface, free variable or closure, that can be rebuilt in another context
+// ('slots' accepts the symbolic boxes made by a2sb, where all the slots are bound)
+static bool isClosedBox(Tree box, set<Tree>& checked, bool slots)
+{
+    if (checked.find(box) != checked.end()) return true;
+
+    Tree x, y;
+    bool closed;
+    if (isBoxInt(box) || isBoxReal(box) || isBoxWire(box) || isBoxCut(box) || isBoxWaveform(box) ||
+        isBoxPrim0(box) || isBoxPrim1(box) || isBoxPrim2(box) || isBoxPrim3(box) || isBoxPrim4(box) ||
+        isBoxPrim5(box) || isBoxFFun(box) || isBoxFConst(box) || isBoxFVar(box) || getUserData(box)) {
+        closed = true;
+    } else if (isBoxSeq(box, x, y) || isBoxPar(box, x, y) || isBoxRec(box, x, y) || isBoxSplit(box, x, y) ||
+               isBoxMerge(box, x, y)) {
+        closed = isClosedBox(x, checked, slots) && isClosedBox(y, checked, slots);
+    } else if (isBoxMetadata(box, x, y)) {
+        closed = isClosedBox(x, checked, slots);
+    } else if (slots && isBoxSymbolic(box, x, y)) {
+        closed = isClosedBox(y, checked, slots);
+    } else if (slots && isBoxSlot(box)) {
+        closed = true;
+    } else {
+        closed = false;
+    }
+    if (closed) checked.insert(box);
+    return closed;
+}
+
+static void collectIdents(Tree t, set<Tree>& visited, set<Tree>& idents)
+{
+    if (!visited.insert(t).second) return;
+    if (isBoxIdent(t)) {
+        idents.insert(t);
+    } else {
+        for (int i = 0; i < t->arity(); i++) collectIdents(t->branch(i), visited, idents);
+    }
+}
+
+// The body of a definition, without its function metadata
+static Tree definitionBody(Tree def)
+{
+    Tree body, genv, vis, lenv, mdlist;
+    if (!isClosure(def, body, genv, vis, lenv)) return nullptr;
+    while (isBoxMetadata(body, body, mdlist)) {
+    }
+    return body;
+}
+
+// All the subtrees of t, in their creation order
+static void collectTrees(Tree t, set<Tree>& visited, vector<Tree>& trees)
+{
+    if (!visited.insert(t).second) return;
+    trees.push_back(t);
+    for (int i = 0; i < t->arity(); i++) collectTrees(t->branch(i), visited, trees);
+}
+
+void EvalCache::addFile(Layer& layer, const string& fname, set<string>& visited, set<string>& keys)
+{
+    if (!visited.insert(fname).second) return;
+
+    string key;
+    bool   cached = gGlobal->gReader.getKey(fname.c_str(), key);
+    if (cached) keys.insert(key);
+    for (Tree ldef = gGlobal->gReader.getList(fname.c_str()); !isNil(ldef); ldef = tl(ldef)) {
+        Tree d = hd(ldef);
+        Tree f;
+        if (isNil(d)) {
+            // null definitions produced by declarations
+        } else if (isImportFile(d, f)) {
+            addFile(layer, tree2str(f), visited, keys);
+        } else if (!cached) {
+            layer.fMaster.insert(hd(d));
+        }
+    }
+}
+
+void EvalCache::addLayer(Tree lenv, const list<string>& files)
+{
+    Layer&      layer = fLayers[lenv];
+    set<string> visited, keys;
+    for (list<string>::const_iterator it = files.begin(); it != files.end(); it++) {
+        addFile(layer, *it, visited, keys);
+    }
+    // The keys are sorted, since the order of the imports does not change the definitions
+    string key;
+    for (set<string>::iterator it = keys.begin(); it != keys.end(); it++) key += *it + '\n';
+    layer.fKey   = generateSHA1(key);
+    layer.fNamed = false;
+}
+
+bool EvalCache::isPure(Layer& layer, Tree lenv, Tree id)
+{
+    if (layer.fMaster.empty()) return true;
+    map<Tree, bool>::iterator it = layer.fPure.find(id);
+    if (it != layer.fPure.end()) return it->second;
+
+    // Recursive uses are conservatively impure
+    layer.fPure[id] = false;
+    Tree def, body;
+    bool pure = layer.fMaster.find(id) == layer.fMaster.end() && getProperty(lenv, id, def) &&
+                (body = definitionBody(def));
+    if (pure) {
+        // The identifiers of the body are an over-approximation of the definitions it uses
+        set<Tree> visited, idents;
+        collectIdents(body, visited, idents);
+        for (set<Tree>::iterator i = idents.begin(); pure && i != idents.end(); i++) {
+            Tree other;
+            pure = (*i == id) || !getProperty(lenv, *i, other) || isPure(layer, lenv, *i);
+        }
+    }
+    layer.fPure[id] = pure;
+    return pure;
+}
+
+bool EvalCache::getName(Layer& layer, Tree lenv, Tree body, Tree& id)
+{
+    if (!layer.fNamed) {
+        vector<Tree> ids, defs;
+        lenv->exportProperties(ids, defs);
+        for (size_t i = 0; i < ids.size(); i++) {
+            Tree b = (isBoxIdent(ids[i])) ? definitionBody(defs[i]) : nullptr;
+            if (b && layer.fNames.find(b) == layer.fNames.end()) layer.fNames[b] = ids[i];
+        }
+        layer.fNamed = true;
+    }
+    map<Tree, Tree>::iterator it = layer.fNames.find(body);
+    if (it == layer.fNames.end()) return false;
+    id = it->second;
+    return true;
+}
+
+bool EvalCache::getApplicationKey(Tree fun, Tree larg, string& key)
+{
+    Tree abstr, genv, vis, lenv, id, var, body;
+    if (fSuspended || !isClosure(fun, abstr, genv, vis, lenv) || !isBoxAbstr(abstr)) return false;
+
+    // A partial application is a closure
+    body = abstr;
+    for (Tree l = larg; !isNil(l); l = tl(l)) {
+        if (!isBoxAbstr(body, var, body)) break;
+    }
+    if (isBoxAbstr(body)) return false;
+
+    map<Tree, Layer>::iterator it = fLayers.find(lenv);
+    if (it == fLayers.end() || !getName(it->second, lenv, abstr, id) || !isPure(it->second, lenv, id)) {
+        return false;
+    }
+
+    TreeWriter args;
+    set<Tree>  checked;
+    for (Tree l = larg; !isNil(l); l = tl(l)) {
+        if (!isClosedBox(hd(l), checked, false)) return false;
+    }
+    if (!args.add(larg)) return false;
+
+    key = "apply\n" + it->second.fKey + '\n' + tree2str(id->branch(0)) + '\n';
+    args.write(key);
+    return true;
+}
+
+bool EvalCache::getDefinitionKey(Tree id, Tree lenv, string& key)
+{
+    if (fSuspended) return false;
+
+    map<Tree, Layer>::iterator it = fLayers.find(lenv);
+    Tree                       def, body;
+    // Functions are evaluated as closures, only their applications are cached
+    if (it == fLayers.end() || !getProperty(lenv, id, def) || !(body = definitionBody(def)) || isBoxAbstr(body) ||
+        !isPure(it->second, lenv, id)) {
+        return false;
+    }
+    key = "define\n" + it->second.fKey + '\n' + tree2str(id->branch(0));
+    return true;
+}
+
+/*
+ Encoding : the trees tables (see TreeWriter), the index of the result and the side effects (a kind,
+ then the key and value indexes of a metadata, or the name and key of a loaded library file).
+ Trees are encoded in their creation order, so that they are rebuilt in the same order.
+ An empty entry marks an evaluation that cannot be cached.
+*/
+void EvalCache::write(const string& key, Tree result)
+{
+    size_t start = fStarts.back();
+    fStarts.pop_back();
+    fMisses++;
+
+    string data;
+    if (!result || !encode(result, start, data)) data.clear();
+    LibraryCache::store(EVAL_CACHE_EXT, key, data);
+}
+
+bool EvalCache::encode(Tree result, size_t start, string& data)
+{
+    set<Tree> checked;
+    if (!isClosedBox(result, checked, true)) return false;
+
+    vector<Item>           items;
+    vector<string>         keys;
+    set<pair<Tree, Tree> > metadata;
+    set<string>            files;
+    vector<Tree>           trees;
+    set<Tree>              visited;
+    collectTrees(result, visited, trees);
+    for (size_t i = start; i < fItems.size(); i++) {
+        const Item& item = fItems[i];
+        if (item.fKind == kMetadata) {
+            if (metadata.insert(make_pair(item.fKey, item.fValue)).second) {
+                items.push_back(item);
+                collectTrees(item.fKey, visited, trees);
+                collectTrees(item.fValue, visited, trees);
+            }
+        } else if (files.insert(item.fFile).second) {
+            // The loaded files have to be unchanged to use the entry
+            string file_key;
+            if (!gGlobal->gReader.getKey(item.fFile.c_str(), file_key)) return false;
+            items.push_back(item);
+            keys.push_back(file_key);
+        }
+    }
+
+    sort(trees.begin(), trees.end(), CTreeComparator());
+    TreeWriter writer;
+    for (size_t i = 0; i < trees.size(); i++) {
+        if (!writer.add(trees[i])) return false;
+    }
+
+    writer.write(data);
+    writeCount(data, writer.index(result));
+    writeCount(data, items.size());
+    for (size_t i = 0, j = 0; i < items.size(); i++) {
+        data += char(items[i].fKind);
+        if (items[i].fKind == kMetadata) {
+            writeCount(data, writer.index(items[i].fKey));
+            writeCount(data, writer.index(items[i].fValue));
+        } else {
+            writeString(data, items[i].fFile);
+            writeString(data, keys[j++]);
+        }
+    }
+    return true;
+}
+
+bool EvalCache::read(const string& key, Tree& result, bool& uncached)
+{
+    shared_ptr<const string> data;
+    bool                     disk;
+    uncached = false;
+    if (!LibraryCache::load(EVAL_CACHE_EXT, key, data, disk)) return false;
+    if (data->empty()) {
+        uncached = true;
+        return false;
+    }
+
+    // The whole entry is checked before any tree is made
+    CacheReader    in(*data);
+    TreeReader     trees;
+    bool           valid = trees.read(in);
+    size_t         root  = in.readIndex(trees.size());
+    size_t         count = in.readCount();
+    vector<Item>   items;
+    vector<size_t> indexes;
+    for (size_t i = 0; i < count && !in.fFail; i++) {
+        Item item = {in.readByte(), nullptr, nullptr, ""};
+        if (item.fKind == kMetadata) {
+            indexes.push_back(in.readIndex(trees.size()));
+            indexes.push_back(in.readIndex(trees.size()));
+        } else if (item.fKind == kLibrary) {
+            item.fFile = in.readString();
+            string file_key = in.readString(), cur_key;
+            // An entry depending on a modified library file is evaluated again
+            if (!gGlobal->gReader.getKey(item.fFile.c_str(), cur_key) || cur_key != file_key) return false;
+        } else {
+            in.fFail = true;
+        }
+        items.push_back(item);
+    }
+    if (!valid || !in.end()) {
+        LibraryCache::forget(EVAL_CACHE_EXT, key);
+        return false;
+    }
+
+    trees.make();
+    for (size_t i = 0, j = 0; i < items.size(); i++) {
+        Item& item = items[i];
+        if (item.fKind == kMetadata) {
+            item.fKey   = trees.get(indexes[j++]);
+            item.fValue = trees.get(indexes[j++]);
+            gGlobal->gMetaDataSet[item.fKey].insert(item.fValue);
+        } else {
+            gGlobal->gReader.expandList(gGlobal->gReader.getList(item.fFile.c_str()));
+        }
+        fItems.push_back(item);
+    }
+    result = trees.get(root);
+    fHits++;
+    if (disk) fDiskHits++;
+    return true;
+}
+
+void EvalCache::enter()
+{
+    if (fSuspended && --fBudget < 0) {
+        throw faustexception("evaluation cache : conversion of the result abandoned\n");
+    }
+    fStarts.push_back(fItems.size());
+}
+
+void EvalCache::leave(Tree exp, Tree env)
+{
+    size_t start = fStarts.back();
+    fStarts.pop_back();
+    // The items stay in the evaluation in progress
+    if (fItems.size() > start) {
+        fEffects[make_pair(exp, env)].assign(fItems.begin() + start, fItems.end());
+    }
+}
+
+void EvalCache::reuse(Tree exp, Tree env)
+{
+    map<pair<Tree, Tree>, vector<Item> >::iterator it = fEffects.find(make_pair(exp, env));
+    if (it != fEffects.end()) fItems.insert(fItems.end(), it->second.begin(), it->second.end());
+}
+
+void EvalCache::printStats()
+{
+    stringstream stats;
+    stats << "evaluation cache : " << fHits << " hits (" << fDiskHits << " from disk), " << fMisses << " misses";
+    infoTiming(stats.str().c_str());
+}
@@ -0,0 +1,125 @@
+/************************************************************************
+ ************************************************************************
+    FAUST compiler
+    Copyright (C) 2003-2018 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ ************************************************************************
+ ************************************************************************/
+
+#ifndef __EVALCACHE__
+#define __EVALCACHE__
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "tree.hh"
+
+using namespace std;
+
+/**
+ * Evaluation cache (-ec) : the evaluations of the library definitions are kept across the compilations
+ * of a process (and on disk, in the FAUST_LIBRARY_CACHE directory, see LibraryCache).
+ *
+ * Only closed expressions are cached : a library function applied to constant arguments, or a library
+ * definition without arguments, when the result is a block diagram without user interface or free variable
+ * (its remaining closures being transformed into symbolic boxes by a2sb).
+ * A library definition is identified by its name and the keys of the library files defining its
+ * environment, and is only cached when it does not depend on a definition of the DSP itself.
+ *
+ * The side effects of an evaluation (metadata and loaded libraries) are kept with its result and replayed
+ * on a hit. Since they are also done by the evaluations memoized in the compilation context, they are
+ * kept for each evaluation (see enter, leave and reuse).
+ */
+class EvalCache {
+   private:
+    enum { kMetadata, kLibrary };
+
+    struct Item {
+        int    fKind;
+        Tree   fKey;
+        Tree   fValue;
+        string fFile;
+    };
+
+    struct Layer {
+        string           fKey;      ///< hash of the keys of the library files defining the environment
+        set<Tree>        fMaster;   ///< names defined by the files that are not cached (the DSP itself)
+        map<Tree, Tree>  fNames;    ///< definition body => name
+        map<Tree, bool>  fPure;     ///< names not depending on a definition of fMaster
+        bool             fNamed;
+    };
+
+    map<Tree, Layer>                      fLayers;
+    vector<Item>                          fItems;    ///< side effects of the evaluations in progress
+    vector<size_t>                        fStarts;   ///< first item of each evaluation in progress
+    map<pair<Tree, Tree>, vector<Item> >  fEffects;  ///< side effects of the memoized evaluations
+    int                                   fHits;
+    int                                   fDiskHits;
+    int                                   fMisses;
+    int                                   fSuspended;  ///< no key is given while a result is converted by 'write'
+    int                                   fBudget;     ///< evaluations left to convert the result
+
+    void addFile(Layer& layer, const string& fname, set<string>& visited, set<string>& keys);
+    bool isPure(Layer& layer, Tree lenv, Tree id);
+    bool getName(Layer& layer, Tree lenv, Tree body, Tree& id);
+    bool encode(Tree result, size_t start, string& data);
+
+   public:
+    EvalCache() : fHits(0), fDiskHits(0), fMisses(0), fSuspended(0), fBudget(0) {}
+
+    // Declares a top level environment : the global one, or one made by library() or component()
+    void addLayer(Tree lenv, const list<string>& files);
+
+    // The key of a closure applied to a list of arguments, false if the application is not cached
+    bool getApplicationKey(Tree fun, Tree larg, string& key);
+
+    // The key of a definition without arguments, false if its evaluation is not cached
+    bool getDefinitionKey(Tree id, Tree lenv, string& key);
+
+    // Retrieves a cached result and replays its side effects, 'uncached' is set when the evaluation cannot be cached
+    bool read(const string& key, Tree& result, bool& uncached);
+
+    // Starts the evaluation of a result to be cached by 'write' (NULL if it cannot be cached)
+    void begin() { enter(); }
+    void write(const string& key, Tree result);
+
+    // The closures evaluated while a result is converted are not cached themselves, and a conversion
+    // needing too many evaluations (a recursive function applied to a slot) is abandoned by 'enter'
+    void suspend()
+    {
+        if (fSuspended++ == 0) fBudget = 4096;
+    }
+    void resume() { fSuspended--; }
+
+    // Restores the evaluations in progress after an exception
+    size_t depth() { return fStarts.size(); }
+    void   unwind(size_t depth) { fStarts.resize(depth); }
+
+    // Side effects of the evaluations
+    void enter();
+    void leave(Tree exp, Tree env);
+    void reuse(Tree exp, Tree env);
+
+    void metadata(Tree key, Tree value) { fItems.push_back({kMetadata, key, value, ""}); }
+    void library(const char* fname) { fItems.push_back({kLibrary, nullptr, nullptr, fname}); }
+
+    void printStats();
+};
+
+#endif
@@ -24,6 +24,7 @@
 
 #include <stdio.h>
 #include <new>
+#include <vector>
 
 #include "exception.hh"
 
@@ -40,6 +41,46 @@ class Garbageable {
     static void cleanup();
 };
 
+/**
+ * Bump-pointer arena used to allocate the Garbageable objects (trees, symbols, FIR instructions...)
+ * of a compilation context. Each block is preceded by a header giving its owner and its index
+ * in the object table, so that deleting an object during the compilation is O(1).
+ * The destructors of the remaining objects are called in reverse allocation order by 'cleanup',
+ * then all chunks are released at once.
+ */
+class GarbageableArena {
+   private:
+    struct Header {
+        GarbageableArena* fArena;  ///< owner of the block, or NULL when allocated outside of a compilation context
+        size_t            fIndex;  ///< index in fObjects
+    };
+
+    static const size_t kChunkSize = 1 << 20;  ///< default chunk size, bigger blocks get their own chunk
+    static const size_t kAlignment = 16;
+
+    std::vector<char*>        fChunks;     ///< allocated chunks
+    char*                     fCurrent;    ///< next free byte in the current chunk
+    size_t                    fAvailable;  ///< free bytes in the current chunk
+    std::vector<Garbageable*> fObjects;    ///< allocated objects, NULL once deleted
+    bool                      fCleanup;    ///< true while 'cleanup' is running
+
+    // Statistics (displayed with -time)
+    size_t fAllocatedBytes;
+    size_t fDeletedObjects;
+
+    char* allocateChunk(size_t size);
+
+   public:
+    GarbageableArena();
+    virtual ~GarbageableArena();
+
+    static void* allocate(GarbageableArena* arena, size_t size);  ///< 'arena' may be NULL (uses malloc)
+    static void  release(void* ptr);
+
+    void cleanup();
+    void printStats();
+};
+
 template <class P>
 class GarbageablePtr : public virtual Garbageable {
    private:
@@ -24,6 +24,7 @@
 
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <sstream>
 
 #include "text_instructions.hh"
@@ -28,7 +28,7 @@
 
 using namespace std;
 
-map<string, bool> CInstVisitor::gFunctionSymbolTable;
+thread_local map<string, bool> CInstVisitor::gFunctionSymbolTable;
 
 dsp_factory_base* CCodeContainer::produceFactory()
 {
@@ -519,6 +519,8 @@ CWorkStealingCodeContainer::CWorkStealingCodeContainer(const string& name, int n
                                                        std::ostream* out)
     : WSSCodeContainer(numInputs, numOutputs, "dsp"), CCodeContainer(name, numInputs, numOutputs, out)
 {
+    // For the loop index shared by the threads
+    addIncludeFile("<stdatomic.h>");
 }
 
 CWorkStealingCodeContainer::~CWorkStealingCodeContainer()
@@ -33,7 +33,7 @@ class CInstVisitor : public TextInstVisitor {
      Global functions names table as a static variable in the visitor
      so that each function prototype is generated as most once in the module.
      */
-    static map<string, bool> gFunctionSymbolTable;
+    static thread_local map<string, bool> gFunctionSymbolTable;
 
    public:
     using TextInstVisitor::visit;
@@ -194,8 +194,15 @@ class CInstVisitor : public TextInstVisitor {
             *fOut << "static ";
         }
 
+        // The volatile fields (the loop index of the -sch mode) are shared by the threads of the scheduler
         if (inst->fAddress->getAccess() & Address::kVolatile) {
-            *fOut << "volatile ";
+            *fOut << "_Atomic(" << fTypeManager->generateType(inst->fType) << ") " << inst->fAddress->getName();
+            if (inst->fValue) {
+                *fOut << " = ";
+                inst->fValue->accept(this);
+            }
+            EndLine();
+            return;
         }
 
         *fOut << fTypeManager->generateType(inst->fType, inst->fAddress->getName());
@@ -242,6 +249,32 @@ class CInstVisitor : public TextInstVisitor {
         *fOut << named->fName;
     }
 
+    // The volatile fields are C11 atomics, accessed with acquire/release orders
+    virtual void visit(LoadVarInst* inst)
+    {
+        if (inst->fAddress->getAccess() & Address::kVolatile) {
+            *fOut << "atomic_load_explicit(&";
+            inst->fAddress->accept(this);
+            *fOut << ", memory_order_acquire)";
+        } else {
+            TextInstVisitor::visit(inst);
+        }
+    }
+
+    virtual void visit(StoreVarInst* inst)
+    {
+        if (inst->fAddress->getAccess() & Address::kVolatile) {
+            *fOut << "atomic_store_explicit(&";
+            inst->fAddress->accept(this);
+            *fOut << ", ";
+            inst->fValue->accept(this);
+            *fOut << ", memory_order_release)";
+            EndLine();
+        } else {
+            TextInstVisitor::visit(inst);
+        }
+    }
+
     virtual void visit(LoadVarAddressInst* inst)
     {
         *fOut << "&";
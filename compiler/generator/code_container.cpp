@@ -19,13 +19,17 @@
  ************************************************************************
  ************************************************************************/
 
+#include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <string>
 
 #include "code_container.hh"
+#include "exception.hh"
 #include "fir_to_fir.hh"
 #include "floats.hh"
 #include "global.hh"
+#include "instructions_complexity.hh"
 #include "recursivness.hh"
 #include "text_instructions.hh"
 #include "type_manager.hh"
@@ -186,12 +190,13 @@ void CodeContainer::printIncludeFile(ostream& fout)
 }
 
 /**
- * Print the loop graph in dot format
+ * Print the loop graph in dot format, with the estimated cost of each task
  */
 void CodeContainer::printGraphDotFormat(ostream& fout)
 {
     lclgraph G;
     CodeLoop::sortGraph(fCurLoop, G);
+    InstCostModel model(gGlobal->gTaskCostModelFile);
 
     fout << "strict digraph loopgraph {" << endl;
     fout << '\t' << "rankdir=LR;" << endl;
@@ -202,9 +207,13 @@ void CodeContainer::printGraphDotFormat(ostream& fout)
     for (int l = int(G.size() - 1); l >= 0; l--) {
         // for each task in the level
         for (lclset::const_iterator t = G[l].begin(); t != G[l].end(); t++) {
-            // print task label "Lxxx : 0xffffff"
-            fout << '\t' << 'L' << (*t) << "[label=<<font face=\"verdana,bold\">L" << lnum++ << "</font> : " << (*t)
-                 << ">];" << endl;
+            // print task label "Lxxx : nnn cycles (n loops)"
+            fout << '\t' << 'L' << (*t) << "[label=<<font face=\"verdana,bold\">L" << lnum++ << "</font> : "
+                 << int((*t)->getCost(model)) << " cycles";
+            if ((*t)->getLoopCount() > 1) {
+                fout << " (" << (*t)->getLoopCount() << " loops)";
+            }
+            fout << ">];" << endl;
             // for each source of the task
             for (lclset::const_iterator src = (*t)->fBackwardLoopDependencies.begin();
                  src != (*t)->fBackwardLoopDependencies.end(); src++) {
@@ -326,7 +335,7 @@ ValueInst* CodeContainer::pushFunction(const string& name, Typed::VarType result
     }
 }
 
-void CodeContainer::sortDeepFirstDAG(CodeLoop* l, set<CodeLoop*>& visited, list<CodeLoop*>& result)
+void CodeContainer::sortDeepFirstDAG(CodeLoop* l, lclset& visited, list<CodeLoop*>& result)
 {
     // Avoid printing already printed loops
     if (isElement(visited, l)) return;
@@ -657,7 +666,7 @@ void CodeContainer::generateDAGLoop(BlockInst* block, DeclareVarInst* count)
     int loop_num = 0;
 
     if (gGlobal->gDeepFirstSwitch) {
-        set<CodeLoop*>  visited;
+        lclset  visited;
         list<CodeLoop*> result;
         sortDeepFirstDAG(fCurLoop, visited, result);
         for (list<CodeLoop*>::const_iterator p = result.begin(); p != result.end(); p++) {
@@ -667,31 +676,374 @@ void CodeContainer::generateDAGLoop(BlockInst* block, DeclareVarInst* count)
         lclgraph G;
         CodeLoop::sortGraph(fCurLoop, G);
         for (int l = int(G.size() - 1); l >= 0; l--) {
-            for (lclset::const_iterator p = G[l].begin(); p != G[l].end(); p++) {
-                generateDAGLoopAux(*p, block, count, loop_num++);
+            if (gGlobal->gSIMDSwitch && !gGlobal->gFunTaskSwitch) {
+                generateDAGLevelInterleaved(G[l], block, count, loop_num);
+            } else {
+                for (lclset::const_iterator p = G[l].begin(); p != G[l].end(); p++) {
+                    generateDAGLoopAux(*p, block, count, loop_num++);
+                }
             }
         }
     }
 }
 
+/*
+ The loops of a level are independent: the recursive ones with the same shape (same code up to the variable names
+ and constants) have their compute loops grouped in a block following an 'Interleaved recursive loops' label
+ (after all the pre codes and before all the post codes),
+ so that the SIMD backend can compute them in the lanes of a vector. A backend that does not know the label
+ simply generates the compute loops one after the other.
+*/
+void CodeContainer::generateDAGLevelInterleaved(const lclset& level, BlockInst* block, DeclareVarInst* count,
+                                                int& loop_num)
+{
+    map<string, vector<CodeLoop*> > groups;
+    map<CodeLoop*, string>          keys;
+    for (lclset::const_iterator p = level.begin(); p != level.end(); p++) {
+        if ((*p)->fIsRecursive && (*p)->fExtraLoops.empty() && !(*p)->fComputeInst->fCode.empty()) {
+            InstShape shape;
+            (*p)->fComputeInst->accept(&shape);
+            keys[*p] = shape.getKey();
+            groups[keys[*p]].push_back(*p);
+        }
+    }
+
+    for (lclset::const_iterator p = level.begin(); p != level.end(); p++) {
+        if (keys.find(*p) == keys.end() || groups[keys[*p]].size() == 1) {
+            generateDAGLoopAux(*p, block, count, loop_num++);
+        } else if (groups[keys[*p]][0] == *p) {
+            vector<CodeLoop*>& group = groups[keys[*p]];
+            BlockInst*         loops = InstBuilder::genBlockInst();
+            for (size_t i = 0; i < group.size(); i++) {
+                group[i]->generateDAGPreCode(block, false);
+                loops->pushBackInst(group[i]->generateDAGComputeLoop(count));
+            }
+            block->pushBackInst(InstBuilder::genLabelInst(subst("/* Interleaved recursive loops $0 to $1 */",
+                                                                T(loop_num), T(loop_num + int(group.size()) - 1))));
+            block->pushBackInst(loops);
+            for (size_t i = 0; i < group.size(); i++) {
+                group[i]->generateDAGPostCode(block, false);
+            }
+            loop_num += int(group.size());
+        }
+    }
+}
+
 void CodeContainer::processFIR(void)
 {
     // Possibly add "fSamplingFreq" field
     generateSR();
 
     // Possibly groups tasks (used by VectorCodeContainer, OpenMPCodeContainer and WSSCodeContainer)
-    if (gGlobal->gGroupTaskSwitch) {
+    if (gGlobal->gGroupTaskSwitch || gGlobal->gMinTaskCost > 0) {
         CodeLoop::computeUseCount(fCurLoop);
-        set<CodeLoop*> visited;
+        lclset visited;
         CodeLoop::groupSeqLoops(fCurLoop, visited);
     }
 
+    // Then groups the cheap tasks
+    if (gGlobal->gMinTaskCost > 0) {
+        InstCostModel model(gGlobal->gTaskCostModelFile);
+        CodeLoop::groupCheapLoops(fCurLoop, gGlobal->gMinTaskCost, model);
+    }
+
     // Sort struct fields by size and type
     // 05/16/17 : deactivated since it slows down the code...
     /*
     fDeclarationInstructions->fCode.sort(sortArrayDeclarations);
     fDeclarationInstructions->fCode.sort(sortTypeDeclarations);
     */
+
+    // Sort struct fields by access pattern instead
+    if (gGlobal->gPGOLayoutFile != "") {
+        sortDeclarationsByProfile(gGlobal->gPGOLayoutFile);
+    }
+
+    // Compute the control code only when needed
+    if (gGlobal->gDirtyZones) {
+        guardControlCode();
+    }
+}
+
+/*
+ The control code computed before the DSP loop (fSlowN variables) is moved in the DSP structure, and only
+ recomputed when the zones it depends on have changed. Each zone is compared with its value in the previous
+ compute call (so that all controllers writing the zones are supported), the control variables depending on
+ the same zones are computed in the same 'if' block:
+
+    FAUSTFLOAT fHslider0Now = fHslider0;
+    int iHslider0Dirty = (iControlsDirty | (fHslider0Now != fHslider0Prev));
+    fHslider0Prev = fHslider0Now;
+    ...
+    if ((iHslider0Dirty | iHslider1Dirty) != 0) {
+        fSlow0 = ...;
+    }
+    iControlsDirty = 0;
+
+ The blocks are ordered by number of zones, so that a block only depends on the ones before. 'iControlsDirty' is
+ set in instanceConstants, so that everything is recomputed after init. The code reading the state of the DSP,
+ arguments of compute or soundfiles is kept as it is, after the blocks.
+*/
+void CodeContainer::guardControlCode()
+{
+    UIZonesCollector ui;
+    fUserInterfaceInstructions->accept(&ui);
+
+    // State variables (and bargraphs) possibly changed by compute or clear
+    StoredVariables stored;
+    fComputeBlockInstructions->accept(&stored);
+    fPostComputeBlockInstructions->accept(&stored);
+    fClearInstructions->accept(&stored);
+    transformDAG(&stored);
+    stored.fNames.insert(ui.fSoundfiles.begin(), ui.fSoundfiles.end());
+
+    // Zones read by each control variable (in order of first use), control blocks by set of zones, other code
+    map<string, set<string> > control_zones;
+    vector<string>            zones;
+    map<set<string>, int>     groups;
+    vector<set<string> >      group_zones;
+    vector<BlockInst*>        group_code;
+    list<StatementInst*>      others;
+
+    for (list<StatementInst*>::const_iterator it = fComputeBlockInstructions->fCode.begin();
+         it != fComputeBlockInstructions->fCode.end(); it++) {
+        DeclareVarInst* dec = dynamic_cast<DeclareVarInst*>(*it);
+        if (!dec || dec->fAddress->getAccess() != Address::kStack || !dec->fValue ||
+            stored.fNames.find(dec->fAddress->getName()) != stored.fNames.end()) {
+            others.push_back(*it);
+            continue;
+        }
+
+        LoadedVariables loaded;
+        dec->fValue->accept(&loaded);
+        set<string> deps;
+        bool        guarded = !loaded.fOther;
+        for (set<string>::const_iterator v = loaded.fStack.begin(); guarded && v != loaded.fStack.end(); v++) {
+            if (control_zones.find(*v) != control_zones.end()) {
+                deps.insert(control_zones[*v].begin(), control_zones[*v].end());
+            } else {
+                guarded = false;
+            }
+        }
+        for (set<string>::const_iterator v = loaded.fStruct.begin(); guarded && v != loaded.fStruct.end(); v++) {
+            if (stored.fNames.find(*v) != stored.fNames.end()) {
+                guarded = false;
+            } else if (ui.fZones.find(*v) != ui.fZones.end()) {
+                deps.insert(*v);
+            }
+        }
+        if (!guarded) {
+            others.push_back(*it);
+            continue;
+        }
+
+        string name         = dec->fAddress->getName();
+        control_zones[name] = deps;
+        for (set<string>::const_iterator z = deps.begin(); z != deps.end(); z++) {
+            if (find(zones.begin(), zones.end(), *z) == zones.end()) {
+                zones.push_back(*z);
+            }
+        }
+        if (groups.find(deps) == groups.end()) {
+            groups[deps] = int(group_code.size());
+            group_zones.push_back(deps);
+            group_code.push_back(InstBuilder::genBlockInst());
+        }
+        BasicCloneVisitor cloner;
+        pushDeclare(InstBuilder::genDecStructVar(name, dec->fType->clone(&cloner)));
+        group_code[groups[deps]]->pushBackInst(InstBuilder::genStoreStructVar(name, dec->fValue));
+    }
+
+    if (control_zones.empty()) {
+        return;
+    }
+
+    // The control variables are now read in the DSP structure
+    set<string> names;
+    for (map<string, set<string> >::const_iterator v = control_zones.begin(); v != control_zones.end(); v++) {
+        names.insert(v->first);
+    }
+    Stack2StructNamesRewriter rewriter(names);
+    for (size_t g = 0; g < group_code.size(); g++) {
+        group_code[g]->accept(&rewriter);
+    }
+    for (list<StatementInst*>::const_iterator it = others.begin(); it != others.end(); it++) {
+        (*it)->accept(&rewriter);
+    }
+    fPostComputeBlockInstructions->accept(&rewriter);
+    transformDAG(&rewriter);
+
+    BlockInst* block = InstBuilder::genBlockInst();
+
+    // Compare each zone with its previous value, read only once in case it is changed by another thread
+    pushDeclare(InstBuilder::genDecStructVar("iControlsDirty", InstBuilder::genBasicTyped(Typed::kInt32)));
+    pushInitMethod(InstBuilder::genStoreStructVar("iControlsDirty", InstBuilder::genInt32NumInst(1)));
+    map<string, string> dirty;
+    for (size_t z = 0; z < zones.size(); z++) {
+        string now  = zones[z] + "Now";
+        string prev = zones[z] + "Prev";
+        dirty[zones[z]] = "i" + zones[z].substr(1) + "Dirty";
+        pushDeclare(InstBuilder::genDecStructVar(prev, InstBuilder::genBasicTyped(Typed::kFloatMacro)));
+        pushInitMethod(InstBuilder::genStoreStructVar(prev, InstBuilder::genRealNumInst(Typed::kFloatMacro, 0)));
+        block->pushBackInst(InstBuilder::genDecStackVar(now, InstBuilder::genBasicTyped(Typed::kFloatMacro),
+                                                        InstBuilder::genLoadStructVar(zones[z])));
+        block->pushBackInst(InstBuilder::genDecStackVar(
+            dirty[zones[z]], InstBuilder::genBasicTyped(Typed::kInt32),
+            InstBuilder::genOr(InstBuilder::genLoadStructVar("iControlsDirty"),
+                               InstBuilder::genNotEqual(InstBuilder::genLoadStackVar(now),
+                                                        InstBuilder::genLoadStructVar(prev)))));
+        block->pushBackInst(InstBuilder::genStoreStructVar(prev, InstBuilder::genLoadStackVar(now)));
+    }
+
+    // Blocks with fewer zones first, since the zones of a control variable include the ones of the variables it reads
+    vector<pair<size_t, int> > order;
+    for (size_t g = 0; g < group_zones.size(); g++) {
+        order.push_back(make_pair(group_zones[g].size(), int(g)));
+    }
+    sort(order.begin(), order.end());
+    for (size_t o = 0; o < order.size(); o++) {
+        int        g    = order[o].second;
+        ValueInst* cond = 0;
+        for (set<string>::const_iterator z = group_zones[g].begin(); z != group_zones[g].end(); z++) {
+            ValueInst* zone_dirty = InstBuilder::genLoadStackVar(dirty[*z]);
+            cond                  = (cond) ? InstBuilder::genOr(cond, zone_dirty) : zone_dirty;
+        }
+        if (!cond) {
+            cond = InstBuilder::genLoadStructVar("iControlsDirty");
+        }
+        block->pushBackInst(
+            InstBuilder::genIfInst(InstBuilder::genNotEqual(cond, InstBuilder::genInt32NumInst(0)), group_code[g]));
+    }
+    block->pushBackInst(InstBuilder::genStoreStructVar("iControlsDirty", InstBuilder::genInt32NumInst(0)));
+
+    for (list<StatementInst*>::const_iterator it = others.begin(); it != others.end(); it++) {
+        block->pushBackInst(*it);
+    }
+    fComputeBlockInstructions = block;
+}
+
+/*
+ The profile is written by the Interpreter backend in field profile mode (FAUST_INTERP_TRACE=7), one line by field
+ or pair of fields accessed in a row:
+
+    # comment
+    field <name> <count>
+    pair <name1> <name2> <count>
+
+ The hot fields (accessed at least 1% as much as the most accessed one) smaller than a cache line come first,
+ each one followed by the remaining field it is the most often accessed with, then the cold small fields
+ (controls, per-block state...), then the larger arrays (long delay lines, tables) hot ones first, staggered
+ by a cache line padding field when their size is a multiple of the L1 set stride.
+*/
+void CodeContainer::sortDeclarationsByProfile(const string& filename)
+{
+    static const int kCacheLine = 64;
+    static const int kSetStride = 4096;
+
+    ifstream reader(filename.c_str());
+    if (!reader.is_open()) {
+        stringstream error;
+        error << "ERROR : cannot open profile file '" << filename << "'" << endl;
+        throw faustexception(error.str());
+    }
+
+    map<string, long long>               counts;
+    map<string, map<string, long long> > pairs;
+    long long                            max_count = 0;
+    string                               line;
+    while (getline(reader, line)) {
+        stringstream tokens(line);
+        string       kind, name1, name2;
+        long long    count;
+        tokens >> kind;
+        if (kind == "field" && (tokens >> name1 >> count)) {
+            counts[name1] = count;
+            max_count     = std::max(max_count, count);
+        } else if (kind == "pair" && (tokens >> name1 >> name2 >> count)) {
+            pairs[name1][name2] = count;
+            pairs[name2][name1] = count;
+        }
+    }
+
+    list<StatementInst*>         others, cold_small, hot_large, cold_large;
+    map<string, DeclareVarInst*> hot_small;
+    for (list<StatementInst*>::const_iterator it = fDeclarationInstructions->fCode.begin();
+         it != fDeclarationInstructions->fCode.end(); it++) {
+        DeclareVarInst* inst = dynamic_cast<DeclareVarInst*>(*it);
+        if (!inst || !(inst->fAddress->getAccess() & Address::kStruct)) {
+            others.push_back(*it);
+            continue;
+        }
+        string name = inst->fAddress->getName();
+        bool   hot  = counts.find(name) != counts.end() && counts[name] * 100 >= max_count;
+        if (inst->fType->getSize() <= kCacheLine) {
+            if (hot) {
+                hot_small[name] = inst;
+            } else {
+                cold_small.push_back(inst);
+            }
+        } else if (hot) {
+            hot_large.push_back(inst);
+        } else {
+            cold_large.push_back(inst);
+        }
+    }
+
+    // Hot large arrays by decreasing count
+    vector<pair<long long, StatementInst*> > sorted_large;
+    for (list<StatementInst*>::const_iterator it = hot_large.begin(); it != hot_large.end(); it++) {
+        sorted_large.push_back(make_pair(-counts[dynamic_cast<DeclareVarInst*>(*it)->fAddress->getName()], *it));
+    }
+    stable_sort(sorted_large.begin(), sorted_large.end(),
+                [](const pair<long long, StatementInst*>& a, const pair<long long, StatementInst*>& b) {
+                    return a.first < b.first;
+                });
+
+    fDeclarationInstructions->fCode = others;
+
+    // Chain the hot small fields: start from the hottest one, continue with the most co-accessed one
+    string current = "";
+    while (hot_small.size() > 0) {
+        string    next;
+        long long best = 0;
+        if (current != "") {
+            map<string, long long>& neighbours = pairs[current];
+            for (map<string, long long>::iterator it = neighbours.begin(); it != neighbours.end(); it++) {
+                if (hot_small.find(it->first) != hot_small.end() && it->second > best) {
+                    next = it->first;
+                    best = it->second;
+                }
+            }
+        }
+        if (best == 0) {
+            for (map<string, DeclareVarInst*>::iterator it = hot_small.begin(); it != hot_small.end(); it++) {
+                if (next == "" || counts[it->first] > counts[next]) {
+                    next = it->first;
+                }
+            }
+        }
+        fDeclarationInstructions->pushBackInst(hot_small[next]);
+        hot_small.erase(next);
+        current = next;
+    }
+
+    fDeclarationInstructions->fCode.splice(fDeclarationInstructions->fCode.end(), cold_small);
+    list<StatementInst*> large;
+    for (size_t i = 0; i < sorted_large.size(); i++) {
+        large.push_back(sorted_large[i].second);
+    }
+    large.splice(large.end(), cold_large);
+
+    // Contiguous arrays of a multiple of the L1 set stride (typically power of two delay lines) are accessed at the
+    // same index and would all map to the same cache sets: they are staggered by one cache line
+    for (list<StatementInst*>::const_iterator it = large.begin(); it != large.end(); it++) {
+        fDeclarationInstructions->pushBackInst(*it);
+        if (dynamic_cast<DeclareVarInst*>(*it)->fType->getSize() % kSetStride == 0 && std::next(it) != large.end()) {
+            fDeclarationInstructions->pushBackInst(InstBuilder::genDecStructVar(
+                gGlobal->getFreshID("fPad"),
+                InstBuilder::genArrayTyped(InstBuilder::genBasicTyped(Typed::kInt32), kCacheLine / 4)));
+        }
+    }
 }
 
 BlockInst* CodeContainer::flattenFIR(void)
@@ -773,16 +1125,64 @@ void CodeContainer::generateJSONFile()
     xout << json_visitor.JSON();
 }
 
+// Alignment of a field in the C layout: the size of its element type
+static int getTypeAlignment(Typed* type)
+{
+    ArrayTyped*  array_typed  = dynamic_cast<ArrayTyped*>(type);
+    NamedTyped*  named_typed  = dynamic_cast<NamedTyped*>(type);
+    VectorTyped* vector_typed = dynamic_cast<VectorTyped*>(type);
+    StructTyped* struct_typed = dynamic_cast<StructTyped*>(type);
+    if (array_typed && array_typed->fSize > 0) {
+        return getTypeAlignment(array_typed->fType);
+    } else if (named_typed) {
+        return getTypeAlignment(named_typed->fType);
+    } else if (vector_typed) {
+        return getTypeAlignment(vector_typed->fType);
+    } else if (struct_typed) {
+        int align = 1;
+        for (size_t i = 0; i < struct_typed->fFields.size(); i++) {
+            align = std::max(align, getTypeAlignment(struct_typed->fFields[i]));
+        }
+        return align;
+    } else {
+        return std::max(1, type->getSize());
+    }
+}
+
+// Size of the DSP struct in the C layout, with the padding of the fields and of the struct itself
+int CodeContainer::getStructSize()
+{
+    int size  = 0;
+    int align = 1;
+    for (list<StatementInst*>::const_iterator it = fDeclarationInstructions->fCode.begin();
+         it != fDeclarationInstructions->fCode.end(); it++) {
+        DeclareVarInst* inst = dynamic_cast<DeclareVarInst*>(*it);
+        if (inst && (inst->fAddress->getAccess() & Address::kStruct)) {
+            int field_align = getTypeAlignment(inst->fType);
+            size            = ((size + field_align - 1) / field_align) * field_align;
+            size += inst->fType->getSize();
+            align = std::max(align, field_align);
+        }
+    }
+    return ((size + align - 1) / align) * align;
+}
+
 void CodeContainer::generateJSON(JSONInstVisitor* visitor)
 {
     // Prepare compilation options
     stringstream compile_options;
     gGlobal->printCompilationOptions(compile_options);
 
+    // DSP memory size, to compare the delay lines layouts (-edl)
+    stringstream size;
+    if (gGlobal->gExactDelayLines) {
+        size << getStructSize();
+    }
+
     // "name", "filename" found in medata
     visitor->init("", "", fNumInputs, fNumOutputs, "", "",
                   FAUSTVERSION, compile_options.str(),
-                  gGlobal->gReader.listLibraryFiles(), gGlobal->gImportDirList, "",
+                  gGlobal->gReader.listLibraryFiles(), gGlobal->gImportDirList, size.str(),
                   std::map<std::string, int>());
      
     generateUserInterface(visitor);
@@ -223,7 +223,7 @@ class CodeContainer : public virtual Garbageable {
 
     void transformDAG(DispatchVisitor* visitor);
     void computeForwardDAG(lclgraph dag, int& loop_count, vector<int>& ready_loop);
-    void sortDeepFirstDAG(CodeLoop* l, set<CodeLoop*>& visited, list<CodeLoop*>& result);
+    void sortDeepFirstDAG(CodeLoop* l, lclset& visited, list<CodeLoop*>& result);
 
     void generateLocalInputs(BlockInst* loop_code, const string& index);
     void generateLocalOutputs(BlockInst* loop_code, const string& index);
@@ -274,14 +274,24 @@ class CodeContainer : public virtual Garbageable {
                               TextInstVisitor* producer);
 
     void generateDAGLoop(BlockInst* loop_code, DeclareVarInst* count);
+    void generateDAGLevelInterleaved(const lclset& level, BlockInst* loop_code, DeclareVarInst* count, int& loop_num);
 
     void generateJSONFile();
     void generateMetaData(JSONUI* json);
     void generateJSON(JSONInstVisitor* visitor);
 
+    // Size in bytes of the DSP structure fields (without the static ones)
+    int getStructSize();
+
     /* can be overridden by subclasses to reorder the FIR before the actual code generation */
     virtual void processFIR(void);
 
+    // Order the DSP structure fields using a field profile (-pgo-layout)
+    void sortDeclarationsByProfile(const string& filename);
+
+    // Only compute the control code depending on the changed zones (-dz)
+    void guardControlCode();
+
     virtual BlockInst* flattenFIR(void);
 
     // Fill code for each method
@@ -545,7 +555,7 @@ class CodeContainer : public virtual Garbageable {
     }
 };
 
-inline bool isElement(const set<CodeLoop*>& S, CodeLoop* l)
+inline bool isElement(const lclset& S, CodeLoop* l)
 {
     return S.find(l) != S.end();
 }
@@ -29,7 +29,7 @@
 
 using namespace std;
 
-map<string, bool> CPPInstVisitor::gFunctionSymbolTable;
+thread_local map<string, bool> CPPInstVisitor::gFunctionSymbolTable;
 
 dsp_factory_base* CPPCodeContainer::produceFactory()
 {
@@ -72,6 +72,8 @@ CodeContainer* CPPCodeContainer::createContainer(const string& name, const strin
         container = new CPPWorkStealingCodeContainer(name, super, numInputs, numOutputs, dst);
     } else if (gGlobal->gVectorSwitch) {
         container = new CPPVectorCodeContainer(name, super, numInputs, numOutputs, dst);
+    } else if (gGlobal->gBatchSize > 0) {
+        container = new CPPBatchCodeContainer(name, super, numInputs, numOutputs, dst);
     } else {
         container = new CPPScalarCodeContainer(name, super, numInputs, numOutputs, dst, kInt);
     }
@@ -281,9 +283,10 @@ void CPPCodeContainer::produceClass()
     tab(n + 1, *fOut);
 
     // Fields
-    fCodeProducer.Tab(n + 1);
+    CPPInstVisitor* producer = getInstanceCodeProducer();
+    producer->Tab(n + 1);
     tab(n + 1, *fOut);
-    generateDeclarations(&fCodeProducer);
+    generateDeclarations(producer);
 
     if (fAllocateInstructions->fCode.size() > 0) {
         tab(n + 1, *fOut);
@@ -393,8 +396,8 @@ void CPPCodeContainer::produceClass()
     tab(n + 1, *fOut);
     *fOut << "virtual void instanceConstants(int samplingFreq) {";
     tab(n + 2, *fOut);
-    fCodeProducer.Tab(n + 2);
-    generateInit(&fCodeProducer);
+    producer->Tab(n + 2);
+    generateInit(producer);
     tab(n + 1, *fOut);
     *fOut << "}";
     tab(n + 1, *fOut);
@@ -402,8 +405,8 @@ void CPPCodeContainer::produceClass()
     tab(n + 1, *fOut);
     *fOut << "virtual void instanceResetUserInterface() {";
     tab(n + 2, *fOut);
-    fCodeProducer.Tab(n + 2);
-    generateResetUserInterface(&fCodeProducer);
+    producer->Tab(n + 2);
+    generateResetUserInterface(producer);
     tab(n + 1, *fOut);
     *fOut << "}";
     tab(n + 1, *fOut);
@@ -411,8 +414,8 @@ void CPPCodeContainer::produceClass()
     tab(n + 1, *fOut);
     *fOut << "virtual void instanceClear() {";
     tab(n + 2, *fOut);
-    fCodeProducer.Tab(n + 2);
-    generateClear(&fCodeProducer);
+    producer->Tab(n + 2);
+    generateClear(producer);
     tab(n + 1, *fOut);
     *fOut << "}";
     tab(n + 1, *fOut);
@@ -462,8 +465,8 @@ void CPPCodeContainer::produceClass()
     tab(n + 1, *fOut);
     *fOut << "virtual void buildUserInterface(UI* ui_interface) {";
     tab(n + 2, *fOut);
-    fCodeProducer.Tab(n + 2);
-    generateUserInterface(&fCodeProducer);
+    producer->Tab(n + 2);
+    generateUserInterface(producer);
     tab(n + 1, *fOut);
     *fOut << "}";
 
@@ -523,27 +526,117 @@ void CPPScalarCodeContainer::generateCompute(int n)
     tab(n + 1, *fOut);
     *fOut << subst("virtual void compute(int $0, $1** inputs, $1** outputs) {", fFullCount, xfloat());
     tab(n + 2, *fOut);
-    fCodeProducer.Tab(n + 2);
+    CPPInstVisitor* producer = getInstanceCodeProducer();
+    producer->Tab(n + 2);
 
     // Generates local variables declaration and setup
-    generateComputeBlock(&fCodeProducer);
+    generateComputeBlock(producer);
 
     // Generates one single scalar loop
     ForLoopInst* loop = fCurLoop->generateScalarLoop(fFullCount);
-    loop->accept(&fCodeProducer);
+    loop->accept(producer);
 
     // Currently for soundfile management
-    generatePostComputeBlock(&fCodeProducer);
+    generatePostComputeBlock(producer);
 
     tab(n + 1, *fOut);
     *fOut << "}";
 }
 
+// Batch
+CPPBatchCodeContainer::CPPBatchCodeContainer(const string& name, const string& super, int numInputs, int numOutputs,
+                                             std::ostream* out)
+    : CPPScalarCodeContainer(name, super, numInputs, numOutputs, out, kInt),
+      fBatchCodeProducer(out, gGlobal->gBatchSize, numInputs, numOutputs)
+{
+    addIncludeFile("\"faust/dsp/simd.h\"");
+}
+
+CPPBatchCodeContainer::~CPPBatchCodeContainer()
+{
+}
+
+// Gives to the user interface items the control zones of one instance
+struct BatchLaneZones : public BasicCloneVisitor {
+    int fLane;
+
+    BatchLaneZones(int lane) : fLane(lane) {}
+
+    string laneZone(const string& zone)
+    {
+        return (zone == "0") ? zone : "faust_simd::lane(" + zone + ", " + T(fLane) + ")";
+    }
+
+    virtual StatementInst* visit(AddMetaDeclareInst* inst)
+    {
+        return new AddMetaDeclareInst(laneZone(inst->fZone), inst->fKey, inst->fValue);
+    }
+    virtual StatementInst* visit(AddButtonInst* inst)
+    {
+        return new AddButtonInst(inst->fLabel, laneZone(inst->fZone), inst->fType);
+    }
+    virtual StatementInst* visit(AddSliderInst* inst)
+    {
+        return new AddSliderInst(inst->fLabel, laneZone(inst->fZone), inst->fInit, inst->fMin, inst->fMax, inst->fStep,
+                                 inst->fType);
+    }
+    virtual StatementInst* visit(AddBargraphInst* inst)
+    {
+        return new AddBargraphInst(inst->fLabel, laneZone(inst->fZone), inst->fMin, inst->fMax, inst->fType);
+    }
+};
+
+void CPPBatchCodeContainer::produceClass()
+{
+    int lanes = gGlobal->gBatchSize;
+
+    // The fields and variables depending on the controls or the inputs are vectors
+    list<StatementInst*> code;
+    code.push_back(fUserInterfaceInstructions);
+    code.push_back(fInitInstructions);
+    code.push_back(fPostInitInstructions);
+    code.push_back(fResetUserInterfaceInstructions);
+    code.push_back(fClearInstructions);
+    code.push_back(fComputeBlockInstructions);
+    code.push_back(fCurLoop->generateScalarLoop(fFullCount));
+    code.push_back(fPostComputeBlockInstructions);
+    fBatchCodeProducer.findVarying(code);
+
+    // One user interface by instance, in a tab box
+    BlockInst* ui = InstBuilder::genBlockInst();
+    ui->pushBackInst(InstBuilder::genOpenboxInst(2, "Batch"));
+    for (int lane = 0; lane < lanes; lane++) {
+        BatchLaneZones zones(lane);
+        ui->pushBackInst(InstBuilder::genOpenboxInst(0, "Lane" + T(lane)));
+        ui->pushBackInst(static_cast<BlockInst*>(fUserInterfaceInstructions->clone(&zones)));
+        ui->pushBackInst(InstBuilder::genCloseboxInst());
+    }
+    ui->pushBackInst(InstBuilder::genCloseboxInst());
+    fUserInterfaceInstructions = ui;
+
+    // The channels of instance k are [k * numInputs, (k + 1) * numInputs - 1] (and the same for outputs)
+    vector<int> input_rates(fInputRates);
+    vector<int> output_rates(fOutputRates);
+    for (int lane = 1; lane < lanes; lane++) {
+        fInputRates.insert(fInputRates.end(), input_rates.begin(), input_rates.end());
+        fOutputRates.insert(fOutputRates.end(), output_rates.begin(), output_rates.end());
+    }
+    fNumInputs *= lanes;
+    fNumOutputs *= lanes;
+
+    CPPCodeContainer::produceClass();
+}
+
 // Vector
 CPPVectorCodeContainer::CPPVectorCodeContainer(const string& name, const string& super, int numInputs, int numOutputs,
                                                std::ostream* out)
-    : VectorCodeContainer(numInputs, numOutputs), CPPCodeContainer(name, super, numInputs, numOutputs, out)
+    : VectorCodeContainer(numInputs, numOutputs),
+      CPPCodeContainer(name, super, numInputs, numOutputs, out),
+      fSIMDCodeProducer(out)
 {
+    if (gGlobal->gSIMDSwitch) {
+        addIncludeFile("\"faust/dsp/simd.h\"");
+    }
 }
 
 CPPVectorCodeContainer::~CPPVectorCodeContainer()
@@ -563,7 +656,12 @@ void CPPVectorCodeContainer::generateCompute(int n)
     generateComputeBlock(&fCodeProducer);
 
     // Generates DSP loop
-    fDAGBlock->accept(&fCodeProducer);
+    if (gGlobal->gSIMDSwitch) {
+        fSIMDCodeProducer.Tab(n + 2);
+        fDAGBlock->accept(&fSIMDCodeProducer);
+    } else {
+        fDAGBlock->accept(&fCodeProducer);
+    }
 
     tab(n + 1, *fOut);
     *fOut << "}";
@@ -604,6 +702,8 @@ CPPWorkStealingCodeContainer::CPPWorkStealingCodeContainer(const string& name, c
                                                            int numOutputs, std::ostream* out)
     : WSSCodeContainer(numInputs, numOutputs, "this"), CPPCodeContainer(name, super, numInputs, numOutputs, out)
 {
+    // For the loop index shared by the threads
+    addIncludeFile("<atomic>");
 }
 
 CPPWorkStealingCodeContainer::~CPPWorkStealingCodeContainer()
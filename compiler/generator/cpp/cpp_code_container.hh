@@ -45,6 +45,9 @@ class CPPCodeContainer : public virtual CodeContainer {
     void produceMetadata(int tabs);
     void produceInit(int tabs);
 
+    // Visitor used for the fields and the instance methods
+    virtual CPPInstVisitor* getInstanceCodeProducer() { return &fCodeProducer; }
+
    public:
     CPPCodeContainer(const string& name, const string& super, int numInputs, int numOutputs, std::ostream* out)
         : fCodeProducer(out), fOut(out), fSuperKlassName(super)
@@ -104,8 +107,23 @@ class CPPScalarCodeContainer : public CPPCodeContainer {
     void generateCompute(int tab);
 };
 
+class CPPBatchCodeContainer : public CPPScalarCodeContainer {
+   protected:
+    CPPBatchInstVisitor fBatchCodeProducer;
+
+    virtual CPPInstVisitor* getInstanceCodeProducer() { return &fBatchCodeProducer; }
+
+   public:
+    CPPBatchCodeContainer(const string& name, const string& super, int numInputs, int numOutputs, std::ostream* out);
+    virtual ~CPPBatchCodeContainer();
+
+    void produceClass();
+};
+
 class CPPVectorCodeContainer : public VectorCodeContainer, public CPPCodeContainer {
    protected:
+    CPPVecInstVisitor fSIMDCodeProducer;
+
    public:
     CPPVectorCodeContainer(const string& name, const string& super, int numInputs, int numOutputs, std::ostream* out);
     virtual ~CPPVectorCodeContainer();
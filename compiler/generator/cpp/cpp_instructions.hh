@@ -33,8 +33,9 @@ class CPPInstVisitor : public TextInstVisitor {
      Global functions names table as a static variable in the visitor
      so that each function prototype is generated at most once in the module.
      */
-    static map<string, bool> gFunctionSymbolTable;
+    static thread_local map<string, bool> gFunctionSymbolTable;
 
+   protected:
     // Polymorphic math functions
     map<string, string> gPolyMathLibTable;
 
@@ -154,6 +155,15 @@ class CPPInstVisitor : public TextInstVisitor {
 
     virtual ~CPPInstVisitor() {}
 
+    // The math functions of 'faust/dsp/simd.h' have the same name than the standard ones
+    void initSIMDMathTable(map<string, string>& table)
+    {
+        for (map<string, string>::iterator it = gPolyMathLibTable.begin(); it != gPolyMathLibTable.end(); it++) {
+            table[(*it).first] =
+                (startWith((*it).second, "std::")) ? "faust_simd::" + (*it).second.substr(5) : "faust_simd::exp10";
+        }
+    }
+
     virtual void visit(AddMetaDeclareInst* inst)
     {
         // Special case
@@ -250,8 +260,16 @@ class CPPInstVisitor : public TextInstVisitor {
             *fOut << "static ";
         }
 
+        // The volatile fields (the loop index of the -sch mode) are shared by the threads of the scheduler
         if (inst->fAddress->getAccess() & Address::kVolatile) {
-            *fOut << "volatile ";
+            *fOut << "std::atomic<" << fTypeManager->generateType(inst->fType) << "> " << inst->fAddress->getName();
+            if (inst->fValue) {
+                *fOut << "{";
+                inst->fValue->accept(this);
+                *fOut << "}";
+            }
+            EndLine();
+            return;
         }
 
         *fOut << fTypeManager->generateType(inst->fType, inst->fAddress->getName());
@@ -295,6 +313,30 @@ class CPPInstVisitor : public TextInstVisitor {
         generateFunDefBody(inst);
     }
 
+    // The volatile fields are std::atomic, accessed with acquire/release orders
+    virtual void visit(LoadVarInst* inst)
+    {
+        if (inst->fAddress->getAccess() & Address::kVolatile) {
+            inst->fAddress->accept(this);
+            *fOut << ".load(std::memory_order_acquire)";
+        } else {
+            TextInstVisitor::visit(inst);
+        }
+    }
+
+    virtual void visit(StoreVarInst* inst)
+    {
+        if (inst->fAddress->getAccess() & Address::kVolatile) {
+            inst->fAddress->accept(this);
+            *fOut << ".store(";
+            inst->fValue->accept(this);
+            *fOut << ", std::memory_order_release)";
+            EndLine();
+        } else {
+            TextInstVisitor::visit(inst);
+        }
+    }
+
     virtual void visit(LoadVarAddressInst* inst)
     {
         *fOut << "&";
@@ -357,9 +399,1009 @@ class CPPInstVisitor : public TextInstVisitor {
     static void cleanup() { gFunctionSymbolTable.clear(); }
 };
 
+// Tests if some code uses one of the given variables
+struct VariableFinder : public DispatchVisitor {
+    const set<string>& fNames;
+    bool               fFound;
+
+    VariableFinder(const set<string>& names) : fNames(names), fFound(false) {}
+
+    virtual void visit(NamedAddress* address) { fFound |= (fNames.find(address->fName) != fNames.end()); }
+};
+
+/**
+ * Explicit SIMD code using the vector types of 'faust/dsp/simd.h' (-simd option in vector mode):
+ *
+ * - a vectorizable loop computes FAUST_SIMD_SIZE frames at once, followed by a scalar loop for the remaining frames
+ * - the recursive loops grouped by the container after an 'Interleaved recursive loops' label compute one loop
+ *   by lane of a vector, the delayed values of the recursive arrays being kept in vectors along the loop
+ *
+ * A loop that does not fit (unknown function, scalar state stored in the loop, array written and read
+ * at different frames...) is generated as scalar code.
+ */
 class CPPVecInstVisitor : public CPPInstVisitor {
+   private:
+    enum { kScalar, kFrames, kLanes };
+
+    static const int kMaxLanes = 8;
+    static const int kMaxDelay = 8;
+
+    int                 fMode;
+    bool                fValid;
+    map<string, string> fSIMDMathTable;
+
+    string      fLoopIndex;
+    set<string> fLocals;   // Variables declared in the loop body, computed as vectors
+    set<string> fVarying;  // Variables which value differs between the lanes
+
+    // kFrames mode : index of the store of each array written in the loop
+    map<string, string> fStores;
+
+    // kLanes mode
+    int                     fLanes;        // Number of interleaved loops
+    int                     fSize;         // Size of the vectors
+    vector<InstShape*>      fShapes;       // Body of each loop, the body of lane 0 is the one generated
+    map<Printable*, size_t> fPositions;    // Position of the nodes of lane 0 in their shape
+    set<string>             fStateArrays;  // Arrays written in the loop at the loop index
+    set<string>             fStored;       // State arrays already written in the current iteration
+    map<string, int>        fDelays;       // Longest delay read in each state array
+    map<string, string>     fLaneValues;   // Vector of the lane values of a scalar variable
+    vector<string>          fPrelude;      // Vectors initialized before the loop
+
+    void invalid() { fValid = false; }
+
+    string laneTypeName(Typed::VarType type) { return fTypeManager->fTypeDirectTable[type]; }
+
+    // Vector of FAUST_SIMD_SIZE lanes in kFrames mode, of fSize lanes in kLanes mode
+    string vecTypeName(Typed::VarType type, bool lanes)
+    {
+        return "faust_simd::vec<" + laneTypeName(type) + ((lanes) ? ", " + T(fSize) + ">" : ">");
+    }
+
+    // Only int and real values are computed in vectors
+    Typed::VarType laneType(Typed::VarType type)
+    {
+        return (type == Typed::kInt32 || type == Typed::kFloat || type == Typed::kFloatMacro ||
+                type == Typed::kDouble)
+                   ? type
+                   : Typed::kNoType;
+    }
+
+    Typed::VarType elementType(const string& name)
+    {
+        if (!gGlobal->hasVarType(name) || !isPtrType(gGlobal->getVarType(name))) return Typed::kNoType;
+        return laneType(Typed::getTypeFromPtr(gGlobal->getVarType(name)));
+    }
+
+    Typed::VarType varType(const string& name)
+    {
+        return (gGlobal->hasVarType(name)) ? laneType(gGlobal->getVarType(name)) : Typed::kNoType;
+    }
+
+    static bool isLoad(ValueInst* inst, const string& name)
+    {
+        LoadVarInst*  load  = dynamic_cast<LoadVarInst*>(inst);
+        NamedAddress* named = (load) ? dynamic_cast<NamedAddress*>(load->fAddress) : nullptr;
+        return named && named->fName == name;
+    }
+
+    bool isVarying(ValueInst* inst)
+    {
+        VariableFinder finder(fVarying);
+        inst->accept(&finder);
+        return finder.fFound;
+    }
+
+    // Index of the current frame, plus or minus a value which is the same for all frames
+    bool isContiguous(ValueInst* index)
+    {
+        BinopInst* binop = dynamic_cast<BinopInst*>(index);
+        return isLoad(index, fLoopIndex) ||
+               (binop && (binop->fOpcode == kAdd || binop->fOpcode == kSub) && isLoad(binop->fInst1, fLoopIndex) &&
+                !isVarying(binop->fInst2)) ||
+               (binop && binop->fOpcode == kAdd && isLoad(binop->fInst2, fLoopIndex) && !isVarying(binop->fInst1));
+    }
+
+    // Statements of a loop body that can be computed in vectors
+    bool collectBody(BlockInst* body)
+    {
+        fLocals.clear();
+        for (list<StatementInst*>::const_iterator it = body->fCode.begin(); it != body->fCode.end(); it++) {
+            DeclareVarInst* declare = dynamic_cast<DeclareVarInst*>(*it);
+            if (declare) {
+                fLocals.insert(declare->getName());
+            } else if (!dynamic_cast<StoreVarInst*>(*it) && !dynamic_cast<LabelInst*>(*it)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    string generateCode(Printable* inst, int mode)
+    {
+        std::ostream* out      = fOut;
+        int           cur_mode = fMode;
+        stringstream  code;
+        fOut  = &code;
+        fMode = mode;
+        if (dynamic_cast<ValueInst*>(inst)) {
+            static_cast<ValueInst*>(inst)->accept(this);
+        } else if (dynamic_cast<Address*>(inst)) {
+            static_cast<Address*>(inst)->accept(this);
+        } else {
+            static_cast<StatementInst*>(inst)->accept(this);
+        }
+        fOut  = out;
+        fMode = cur_mode;
+        return code.str();
+    }
+
+    string makeVector(Typed::VarType type, const vector<string>& lanes)
+    {
+        string res = "faust_simd::make<" + laneTypeName(type) + ", " + T(fSize) + ">(";
+        for (int lane = 0; lane < fSize; lane++) {
+            // Padding lanes compute the same values than lane 0
+            res += ((lane > 0) ? ", " : "") + lanes[(lane < fLanes) ? lane : 0];
+        }
+        return res + ")";
+    }
+
+    // The node of a lane corresponding to a node of lane 0
+    template <typename NODE>
+    NODE* laneNode(NODE* node, int lane)
+    {
+        return static_cast<NODE*>(fShapes[lane]->fNodes[fPositions[node]]);
+    }
+
+    // Scalar code of the node in each lane
+    vector<string> laneCodes(Printable* node)
+    {
+        vector<string> codes;
+        for (int lane = 0; lane < fLanes; lane++) {
+            codes.push_back(generateCode(laneNode(node, lane), kScalar));
+        }
+        return codes;
+    }
+
+    static bool isUniform(const vector<string>& codes)
+    {
+        for (size_t lane = 1; lane < codes.size(); lane++) {
+            if (codes[lane] != codes[0]) return false;
+        }
+        return true;
+    }
+
+    void generateNumber(ValueInst* inst, Typed::VarType type)
+    {
+        vector<string> codes = laneCodes(inst);
+        if (isUniform(codes)) {
+            *fOut << codes[0];
+        } else if (type == Typed::kNoType) {
+            invalid();
+        } else {
+            *fOut << makeVector(type, codes);
+        }
+    }
+
+    // 'for (int i = 0; i < count; i = i + 1)' loop, with a variable count
+    bool isFrameLoop(ForLoopInst* loop)
+    {
+        DeclareVarInst* init      = dynamic_cast<DeclareVarInst*>(loop->fInit);
+        BinopInst*      end       = dynamic_cast<BinopInst*>(loop->fEnd);
+        StoreVarInst*   increment = dynamic_cast<StoreVarInst*>(loop->fIncrement);
+        BinopInst*      next      = (increment) ? dynamic_cast<BinopInst*>(increment->fValue) : nullptr;
+        Int32NumInst*   step      = (next) ? dynamic_cast<Int32NumInst*>(next->fInst2) : nullptr;
+        return init && end && end->fOpcode == kLT && isLoad(end->fInst1, init->getName()) &&
+               dynamic_cast<LoadVarInst*>(end->fInst2) && next && next->fOpcode == kAdd &&
+               isLoad(next->fInst1, init->getName()) && step && step->fNum == 1;
+    }
+
+    bool generateFrames(ForLoopInst* loop)
+    {
+        if (!isFrameLoop(loop) || !collectBody(loop->fCode)) return false;
+
+        fLoopIndex = loop->fInit->getName();
+        fVarying   = fLocals;
+        fVarying.insert(fLoopIndex);
+
+        // Each array can be written once, its elements being read at the same index
+        fStores.clear();
+        for (list<StatementInst*>::const_iterator it = loop->fCode->fCode.begin(); it != loop->fCode->fCode.end();
+             it++) {
+            StoreVarInst*   store   = dynamic_cast<StoreVarInst*>(*it);
+            IndexedAddress* indexed = (store) ? dynamic_cast<IndexedAddress*>(store->fAddress) : nullptr;
+            if (indexed) {
+                if (fStores.find(indexed->getName()) != fStores.end()) return false;
+                fStores[indexed->getName()] = generateCode(indexed->fIndex, kScalar);
+            }
+        }
+
+        int tab_level = fTab;
+        fTab += 2;
+        fValid      = true;
+        string body = generateCode(loop->fCode, kFrames);
+        fTab        = tab_level;
+        if (!fValid) return false;
+
+        ValueInst* count = static_cast<BinopInst*>(loop->fEnd)->fInst2;
+        *fOut << "{";
+        fTab++;
+        tab(fTab, *fOut);
+        loop->fInit->accept(this);
+        *fOut << "for (; ((" << fLoopIndex << " + FAUST_SIMD_SIZE) <= " << generateCode(count, kScalar) << "); "
+              << fLoopIndex << " = (" << fLoopIndex << " + FAUST_SIMD_SIZE)) {";
+        fTab++;
+        tab(fTab, *fOut);
+        *fOut << body;
+        fTab--;
+        tab(fTab, *fOut);
+        *fOut << "}";
+        tab(fTab, *fOut);
+        // Remaining frames
+        *fOut << "for (; ";
+        fFinishLine = false;
+        loop->fEnd->accept(this);
+        *fOut << "; ";
+        loop->fIncrement->accept(this);
+        fFinishLine = true;
+        *fOut << ") {";
+        fTab++;
+        tab(fTab, *fOut);
+        loop->fCode->accept(this);
+        fTab--;
+        tab(fTab, *fOut);
+        *fOut << "}";
+        fTab--;
+        tab(fTab, *fOut);
+        *fOut << "}";
+        tab(fTab, *fOut);
+        return true;
+    }
+
+    void generateFramesLoad(LoadVarInst* inst)
+    {
+        IndexedAddress* indexed = dynamic_cast<IndexedAddress*>(inst->fAddress);
+        if (!indexed) {
+            // The loop index gives the frame index of each lane
+            if (inst->getName() == fLoopIndex) {
+                *fOut << "faust_simd::ramp(" << fLoopIndex << ")";
+            } else {
+                CPPInstVisitor::visit(inst);
+            }
+            return;
+        }
+
+        string name    = indexed->getName();
+        bool   written = fStores.find(name) != fStores.end();
+        if (!isVarying(indexed->fIndex)) {
+            if (written) {
+                invalid();
+            } else {
+                CPPInstVisitor::visit(inst);
+            }
+        } else if (!dynamic_cast<NamedAddress*>(indexed->fAddress) || elementType(name) == Typed::kNoType) {
+            invalid();
+        } else if (isContiguous(indexed->fIndex)) {
+            string index = generateCode(indexed->fIndex, kScalar);
+            if (written && fStores[name] != index) {
+                invalid();
+            } else {
+                *fOut << "faust_simd::load(&" << name << "[" << index << "])";
+            }
+        } else if (written) {
+            invalid();
+        } else {
+            *fOut << "faust_simd::gather(" << name << ", ";
+            indexed->fIndex->accept(this);
+            *fOut << ")";
+        }
+    }
+
+    void generateFramesStore(StoreVarInst* inst)
+    {
+        IndexedAddress* indexed = dynamic_cast<IndexedAddress*>(inst->fAddress);
+        string          name    = indexed->getName();
+        if (!dynamic_cast<NamedAddress*>(indexed->fAddress) || elementType(name) == Typed::kNoType ||
+            !isVarying(indexed->fIndex)) {
+            invalid();
+        } else if (isContiguous(indexed->fIndex)) {
+            *fOut << "faust_simd::store(&" << name << "[" << fStores[name] << "], ";
+            inst->fValue->accept(this);
+            *fOut << ")";
+            EndLine();
+        } else {
+            *fOut << "faust_simd::scatter(" << name << ", ";
+            indexed->fIndex->accept(this);
+            *fOut << ", ";
+            inst->fValue->accept(this);
+            *fOut << ")";
+            EndLine();
+        }
+    }
+
+    // The loops are interleaved by groups of at most kMaxLanes loops
+    void generateInterleaved(BlockInst* group)
+    {
+        vector<ForLoopInst*> loops;
+        for (list<StatementInst*>::const_iterator it = group->fCode.begin(); it != group->fCode.end(); it++) {
+            ForLoopInst* loop = dynamic_cast<ForLoopInst*>(*it);
+            if (!loop || loop->fCode->size() == 0) {
+                group->accept(this);
+                return;
+            }
+            loops.push_back(loop);
+        }
+        for (size_t first = 0; first < loops.size(); first += kMaxLanes) {
+            vector<ForLoopInst*> lanes(loops.begin() + first,
+                                       loops.begin() + std::min(first + kMaxLanes, loops.size()));
+            if (lanes.size() == 1 || !generateLanes(lanes)) {
+                for (size_t lane = 0; lane < lanes.size(); lane++) {
+                    lanes[lane]->accept(this);
+                }
+            }
+        }
+    }
+
+    bool generateLanes(const vector<ForLoopInst*>& loops)
+    {
+        fLanes = int(loops.size());
+        for (fSize = 2; fSize < fLanes; fSize *= 2) {
+        }
+        if (!isFrameLoop(loops[0]) || !collectBody(loops[0]->fCode)) return false;
+        fLoopIndex = loops[0]->fInit->getName();
+
+        // Same loop and same body shape in each lane
+        list<InstShape> shapes(loops.size());
+        fShapes.clear();
+        for (list<InstShape>::iterator it = shapes.begin(); it != shapes.end(); it++) {
+            ForLoopInst* loop = loops[fShapes.size()];
+            loop->fCode->accept(&(*it));
+            fShapes.push_back(&(*it));
+            if (loop->fInit->getName() != fLoopIndex ||
+                generateCode(loop->fEnd, kScalar) != generateCode(loops[0]->fEnd, kScalar) ||
+                it->getKey() != fShapes[0]->getKey()) {
+                return false;
+            }
+        }
+        fPositions.clear();
+        for (size_t i = 0; i < fShapes[0]->fNodes.size(); i++) {
+            fPositions.insert(make_pair(fShapes[0]->fNodes[i], i));
+        }
+
+        // The state arrays are written at the loop index
+        fStateArrays.clear();
+        for (list<StatementInst*>::const_iterator it = loops[0]->fCode->fCode.begin();
+             it != loops[0]->fCode->fCode.end(); it++) {
+            StoreVarInst*   store   = dynamic_cast<StoreVarInst*>(*it);
+            IndexedAddress* indexed = (store) ? dynamic_cast<IndexedAddress*>(store->fAddress) : nullptr;
+            if (indexed) {
+                if (!dynamic_cast<NamedAddress*>(indexed->fAddress) || !isLoad(indexed->fIndex, fLoopIndex) ||
+                    elementType(indexed->getName()) == Typed::kNoType ||
+                    fStateArrays.find(indexed->getName()) != fStateArrays.end()) {
+                    return false;
+                }
+                fStateArrays.insert(indexed->getName());
+            }
+        }
+        fVarying = fLocals;
+        fVarying.insert(fStateArrays.begin(), fStateArrays.end());
+
+        fStored.clear();
+        fDelays.clear();
+        fLaneValues.clear();
+        fPrelude.clear();
+
+        int tab_level = fTab;
+        fTab += 2;
+        fValid      = true;
+        string body = generateCode(loops[0]->fCode, kLanes);
+        // Delay lines of the state arrays, shifted at the end of each iteration
+        stringstream shift;
+        for (map<string, int>::iterator it = fDelays.begin(); it != fDelays.end(); it++) {
+            string         name = (*it).first;
+            Typed::VarType type = elementType(name);
+            for (int delay = (*it).second; delay > 0; delay--) {
+                shift << name << "_v" << delay << " = " << name << "_v" << (delay - 1) << ";";
+                tab(fTab, shift);
+                vector<string> values;
+                for (int lane = 0; lane < fLanes; lane++) {
+                    values.push_back(laneName(name, lane) + "[-" + T(delay) + "]");
+                }
+                fPrelude.push_back(vecTypeName(type, true) + " " + name + "_v" + T(delay) + " = " +
+                                   makeVector(type, values) + ";");
+            }
+        }
+        fTab = tab_level;
+        if (!fValid) return false;
+
+        *fOut << "{";
+        fTab++;
+        tab(fTab, *fOut);
+        for (size_t i = 0; i < fPrelude.size(); i++) {
+            *fOut << fPrelude[i];
+            tab(fTab, *fOut);
+        }
+        *fOut << "for (";
+        fFinishLine = false;
+        loops[0]->fInit->accept(this);
+        *fOut << "; ";
+        loops[0]->fEnd->accept(this);
+        *fOut << "; ";
+        loops[0]->fIncrement->accept(this);
+        fFinishLine = true;
+        *fOut << ") {";
+        fTab++;
+        tab(fTab, *fOut);
+        *fOut << body << shift.str();
+        fTab--;
+        tab(fTab, *fOut);
+        *fOut << "}";
+        fTab--;
+        tab(fTab, *fOut);
+        *fOut << "}";
+        tab(fTab, *fOut);
+        return true;
+    }
+
+    // Name in a lane of a variable of lane 0
+    string laneName(const string& name, int lane)
+    {
+        map<string, int>::iterator rank = fShapes[0]->fNames.find(name);
+        for (map<string, int>::iterator it = fShapes[lane]->fNames.begin(); it != fShapes[lane]->fNames.end(); it++) {
+            if ((*it).second == (*rank).second) return (*it).first;
+        }
+        faustassert(false);
+        return name;
+    }
+
+    void generateLanesLoad(LoadVarInst* inst)
+    {
+        IndexedAddress* indexed = dynamic_cast<IndexedAddress*>(inst->fAddress);
+        string          name    = inst->getName();
+
+        if (!indexed) {
+            vector<string> names;
+            for (int lane = 0; lane < fLanes; lane++) {
+                names.push_back(laneName(name, lane));
+            }
+            if (name == fLoopIndex || fLocals.find(name) != fLocals.end() || isUniform(names)) {
+                *fOut << name;
+            } else if (fStateArrays.find(name) != fStateArrays.end() || varType(name) == Typed::kNoType) {
+                invalid();
+            } else {
+                // Vector of the lane values, built before the loop
+                if (fLaneValues.find(name) == fLaneValues.end()) {
+                    fLaneValues[name] = name + "_v";
+                    fPrelude.push_back(vecTypeName(varType(name), true) + " " + fLaneValues[name] + " = " +
+                                       makeVector(varType(name), names) + ";");
+                }
+                *fOut << fLaneValues[name];
+            }
+            return;
+        }
+
+        if (fStateArrays.find(name) != fStateArrays.end()) {
+            // Current value, or delayed value kept in a vector
+            BinopInst*    binop = dynamic_cast<BinopInst*>(indexed->fIndex);
+            Int32NumInst* delay = (binop) ? dynamic_cast<Int32NumInst*>(binop->fInst2) : nullptr;
+            if (isLoad(indexed->fIndex, fLoopIndex) && fStored.find(name) != fStored.end()) {
+                *fOut << name << "_v0";
+            } else if (binop && binop->fOpcode == kSub && isLoad(binop->fInst1, fLoopIndex) && delay &&
+                       delay->fNum > 0 && delay->fNum <= kMaxDelay && isUniform(laneCodes(delay))) {
+                fDelays[name] = std::max(fDelays[name], delay->fNum);
+                *fOut << name << "_v" << delay->fNum;
+            } else {
+                invalid();
+            }
+        } else if (isVarying(indexed->fIndex) || elementType(name) == Typed::kNoType) {
+            invalid();
+        } else {
+            // Read only array : the value of each lane is loaded
+            vector<string> codes = laneCodes(inst);
+            *fOut << ((isUniform(codes)) ? codes[0] : makeVector(elementType(name), codes));
+        }
+    }
+
+    void generateLanesStore(StoreVarInst* inst)
+    {
+        IndexedAddress* indexed = static_cast<IndexedAddress*>(inst->fAddress);
+        string          name    = indexed->getName();
+        if (fStateArrays.find(name) == fStateArrays.end() || fStored.find(name) != fStored.end()) {
+            invalid();
+            return;
+        }
+        *fOut << vecTypeName(elementType(name), true) << " " << name << "_v0 = ";
+        inst->fValue->accept(this);
+        EndLine();
+        for (int lane = 0; lane < fLanes; lane++) {
+            *fOut << laneName(name, lane) << "[" << fLoopIndex << "] = " << name << "_v0[" << lane << "]";
+            EndLine();
+        }
+        fStored.insert(name);
+    }
+
+   public:
+    using CPPInstVisitor::visit;
+
+    CPPVecInstVisitor(std::ostream* out, int tab = 0) : CPPInstVisitor(out, tab), fMode(kScalar), fValid(true)
+    {
+        initSIMDMathTable(fSIMDMathTable);
+    }
+
+    virtual void visit(BlockInst* inst)
+    {
+        if (fMode != kScalar) {
+            if (inst->fIndent) invalid();
+            CPPInstVisitor::visit(inst);
+            return;
+        }
+
+        if (inst->fIndent) {
+            *fOut << "{";
+            fTab++;
+            tab(fTab, *fOut);
+        }
+        list<StatementInst*>::const_iterator it;
+        for (it = inst->fCode.begin(); it != inst->fCode.end(); it++) {
+            (*it)->accept(this);
+            // The loops following the label are interleaved
+            LabelInst*                           label = dynamic_cast<LabelInst*>(*it);
+            list<StatementInst*>::const_iterator next  = it;
+            if (label && startWith(label->fLabel, "/* Interleaved recursive loops") && ++next != inst->fCode.end() &&
+                dynamic_cast<BlockInst*>(*next)) {
+                generateInterleaved(static_cast<BlockInst*>(*next));
+                it = next;
+            }
+        }
+        if (inst->fIndent) {
+            fTab--;
+            tab(fTab, *fOut);
+            *fOut << "}";
+            tab(fTab, *fOut);
+        }
+    }
+
+    virtual void visit(ForLoopInst* inst)
+    {
+        if (fMode != kScalar) {
+            invalid();
+        } else if (inst->fCode->size() == 0 || !generateFrames(inst)) {
+            CPPInstVisitor::visit(inst);
+        }
+    }
+
+    virtual void visit(DeclareVarInst* inst)
+    {
+        if (fMode == kScalar) {
+            CPPInstVisitor::visit(inst);
+            return;
+        }
+        Typed::VarType type = laneType(inst->fType->getType());
+        if (type == Typed::kNoType || (inst->fAddress->getAccess() & (Address::kStaticStruct | Address::kVolatile))) {
+            invalid();
+            return;
+        }
+        *fOut << vecTypeName(type, fMode == kLanes) << " " << inst->getName();
+        if (inst->fValue) {
+            *fOut << " = ";
+            inst->fValue->accept(this);
+        }
+        EndLine();
+    }
+
+    virtual void visit(StoreVarInst* inst)
+    {
+        if (fMode == kScalar) {
+            CPPInstVisitor::visit(inst);
+        } else if (dynamic_cast<NamedAddress*>(inst->fAddress)) {
+            // Only the variables of the loop body can be written
+            if (fLocals.find(inst->fAddress->getName()) == fLocals.end()) {
+                invalid();
+            } else {
+                CPPInstVisitor::visit(inst);
+            }
+        } else if (fMode == kFrames) {
+            generateFramesStore(inst);
+        } else {
+            generateLanesStore(inst);
+        }
+    }
+
+    virtual void visit(LoadVarInst* inst)
+    {
+        if (fMode == kScalar) {
+            CPPInstVisitor::visit(inst);
+        } else if (fMode == kFrames) {
+            generateFramesLoad(inst);
+        } else {
+            generateLanesLoad(inst);
+        }
+    }
+
+    virtual void visit(FloatNumInst* inst)
+    {
+        if (fMode == kLanes) {
+            generateNumber(inst, Typed::kFloat);
+        } else {
+            CPPInstVisitor::visit(inst);
+        }
+    }
+
+    virtual void visit(DoubleNumInst* inst)
+    {
+        if (fMode == kLanes) {
+            generateNumber(inst, Typed::kDouble);
+        } else {
+            CPPInstVisitor::visit(inst);
+        }
+    }
+
+    virtual void visit(Int32NumInst* inst)
+    {
+        if (fMode == kLanes) {
+            generateNumber(inst, Typed::kInt32);
+        } else {
+            CPPInstVisitor::visit(inst);
+        }
+    }
+
+    virtual void visit(Int64NumInst* inst)
+    {
+        if (fMode == kLanes) {
+            generateNumber(inst, Typed::kNoType);
+        } else {
+            CPPInstVisitor::visit(inst);
+        }
+    }
+
+    virtual void visit(BoolNumInst* inst)
+    {
+        if (fMode == kLanes) {
+            generateNumber(inst, Typed::kNoType);
+        } else {
+            CPPInstVisitor::visit(inst);
+        }
+    }
+
+    virtual void visit(::CastInst* inst)
+    {
+        if (fMode == kScalar || (fMode == kFrames && !isVarying(inst))) {
+            CPPInstVisitor::visit(inst);
+        } else if (laneType(inst->fType->getType()) == Typed::kNoType) {
+            invalid();
+        } else {
+            *fOut << "faust_simd::cast<" << laneTypeName(inst->fType->getType()) << ">(";
+            inst->fInst->accept(this);
+            *fOut << ")";
+        }
+    }
+
+    virtual void visit(BitcastInst* inst)
+    {
+        if (fMode == kScalar) {
+            CPPInstVisitor::visit(inst);
+        } else {
+            invalid();
+        }
+    }
+
+    virtual void visit(FunCallInst* inst)
+    {
+        string name = gGlobal->getMathFunction(inst->fName);
+        if (fMode == kScalar || (fMode == kFrames && !isVarying(inst))) {
+            CPPInstVisitor::visit(inst);
+        } else if (inst->fMethod || fSIMDMathTable.find(name) == fSIMDMathTable.end()) {
+            invalid();
+        } else {
+            generateFunCall(inst, fSIMDMathTable[name]);
+        }
+    }
+
+    virtual void visit(Select2Inst* inst)
+    {
+        if (fMode == kScalar || (fMode == kFrames && !isVarying(inst))) {
+            CPPInstVisitor::visit(inst);
+        } else {
+            // Both branches are computed
+            *fOut << "faust_simd::select(";
+            inst->fCond->accept(this);
+            *fOut << ", ";
+            inst->fThen->accept(this);
+            *fOut << ", ";
+            inst->fElse->accept(this);
+            *fOut << ")";
+        }
+    }
+
+    virtual void visit(IfInst* inst)
+    {
+        if (fMode == kScalar) {
+            CPPInstVisitor::visit(inst);
+        } else {
+            invalid();
+        }
+    }
+};
+
+/**
+ * Batched instances (-batch <N> option in scalar mode): the class computes N instances of the DSP together,
+ * with the vector types of 'faust/dsp/simd.h' where lane k holds the value of instance k.
+ *
+ * The values which differ between the instances come from the controls and the inputs: the fields and variables
+ * receiving them (directly or not) are 'varying' and declared as vectors, the other ones (constants, IOTA,
+ * loop indexes, tables...) keep their scalar type and are shared by the instances. The N channels of a same
+ * input or output are kept in a table of N pointers.
+ */
+
+class CPPBatchInstVisitor : public CPPInstVisitor {
+   private:
+    // Adds the variables receiving a varying value, and the control zones
+    struct VaryingFinder : public DispatchVisitor {
+        set<string>& fVarying;
+        bool         fChanged;
+
+        VaryingFinder(set<string>& varying) : fVarying(varying), fChanged(false) {}
+
+        bool isVarying(ValueInst* inst)
+        {
+            VariableFinder finder(fVarying);
+            inst->accept(&finder);
+            return finder.fFound;
+        }
+
+        void setVarying(const string& name) { fChanged |= fVarying.insert(name).second; }
+
+        virtual void visit(DeclareVarInst* inst)
+        {
+            if (inst->fValue && isVarying(inst->fValue)) setVarying(inst->getName());
+            DispatchVisitor::visit(inst);
+        }
+
+        virtual void visit(StoreVarInst* inst)
+        {
+            IndexedAddress* indexed = dynamic_cast<IndexedAddress*>(inst->fAddress);
+            if (isVarying(inst->fValue) || (indexed && isVarying(indexed->fIndex))) setVarying(inst->getName());
+            DispatchVisitor::visit(inst);
+        }
+
+        virtual void visit(AddButtonInst* inst) { setVarying(inst->fZone); }
+        virtual void visit(AddSliderInst* inst) { setVarying(inst->fZone); }
+        virtual void visit(AddBargraphInst* inst) { setVarying(inst->fZone); }
+        virtual void visit(AddSoundfileInst* inst) { setVarying(inst->fSFZone); }
+    };
+
+    int                 fSize;        // Number of instances
+    int                 fNumInputs;   // Inputs of one instance
+    int                 fNumOutputs;  // Outputs of one instance
+    set<string>         fVarying;
+    set<string>         fChannels;  // Tables of the channels of an input or output
+    map<string, string> fSIMDMathTable;
+
+    void unsupported(const string& what) { throw faustexception("ERROR : " + what + " cannot be used in batch mode\n"); }
+
+    bool isVarying(ValueInst* inst)
+    {
+        VariableFinder finder(fVarying);
+        inst->accept(&finder);
+        return finder.fFound;
+    }
+
+    string vecTypeName(Typed::VarType type)
+    {
+        if (type != Typed::kInt32 && type != Typed::kFloat && type != Typed::kFloatMacro && type != Typed::kDouble) {
+            unsupported("a '" + fTypeManager->fTypeDirectTable[type] + "' value depending on a control or an input");
+        }
+        return "faust_simd::vec<" + fTypeManager->fTypeDirectTable[type] + ", " + T(fSize) + ">";
+    }
+
+    // 'inputs[chan]' or 'outputs[chan]'
+    bool isChannel(ValueInst* inst, string& io, int& chan)
+    {
+        LoadVarInst*    load    = dynamic_cast<LoadVarInst*>(inst);
+        IndexedAddress* indexed = (load) ? dynamic_cast<IndexedAddress*>(load->fAddress) : nullptr;
+        Int32NumInst*   num     = (indexed) ? dynamic_cast<Int32NumInst*>(indexed->fIndex) : nullptr;
+        if (num && dynamic_cast<NamedAddress*>(indexed->fAddress) &&
+            (indexed->getName() == "inputs" || indexed->getName() == "outputs")) {
+            io   = indexed->getName();
+            chan = num->fNum;
+            return true;
+        } else {
+            return false;
+        }
+    }
+
    public:
-    CPPVecInstVisitor(std::ostream* out, int tab = 0) : CPPInstVisitor(out, tab) {}
+    using CPPInstVisitor::visit;
+
+    CPPBatchInstVisitor(std::ostream* out, int size, int numInputs, int numOutputs, int tab = 0)
+        : CPPInstVisitor(out, tab), fSize(size), fNumInputs(numInputs), fNumOutputs(numOutputs)
+    {
+        initSIMDMathTable(fSIMDMathTable);
+        fVarying.insert("inputs");
+        fVarying.insert("outputs");
+    }
+
+    // To be called on all the instance code (user interface included) before generating it
+    void findVarying(const list<StatementInst*>& code)
+    {
+        VaryingFinder finder(fVarying);
+        do {
+            finder.fChanged = false;
+            for (list<StatementInst*>::const_iterator it = code.begin(); it != code.end(); it++) {
+                (*it)->accept(&finder);
+            }
+        } while (finder.fChanged);
+    }
+
+    virtual void visit(DeclareVarInst* inst)
+    {
+        if (fVarying.find(inst->getName()) == fVarying.end()) {
+            CPPInstVisitor::visit(inst);
+            return;
+        }
+
+        ArrayTyped*    array = dynamic_cast<ArrayTyped*>(inst->fType);
+        Typed::VarType type  = (array) ? array->fType->getType() : inst->fType->getType();
+        string         io;
+        int            chan;
+        if (type == Typed::kSound_ptr) {
+            unsupported("soundfiles");
+        } else if (inst->fAddress->getAccess() & (Address::kStaticStruct | Address::kVolatile)) {
+            unsupported("'" + inst->getName() + "' static field");
+        } else if (inst->fValue && isChannel(inst->fValue, io, chan)) {
+            // Channel 'chan' of each instance
+            int channels = (io == "inputs") ? fNumInputs : fNumOutputs;
+            *fOut << fTypeManager->generateType(inst->fType) << " " << inst->getName() << "[" << fSize << "] = {";
+            for (int lane = 0; lane < fSize; lane++) {
+                *fOut << ((lane > 0) ? ", " : "") << io << "[" << (lane * channels + chan) << "]";
+            }
+            *fOut << "}";
+            EndLine();
+            fChannels.insert(inst->getName());
+        } else if (array) {
+            if (inst->fValue) unsupported("'" + inst->getName() + "' initialized array");
+            *fOut << vecTypeName(type) << " " << inst->getName() << "[" << array->fSize << "]";
+            EndLine();
+        } else {
+            *fOut << vecTypeName(type) << " " << inst->getName();
+            if (inst->fValue) {
+                *fOut << " = ";
+                inst->fValue->accept(this);
+            }
+            EndLine();
+        }
+    }
+
+    virtual void visit(LoadVarInst* inst)
+    {
+        IndexedAddress* indexed = dynamic_cast<IndexedAddress*>(inst->fAddress);
+        if (!indexed) {
+            CPPInstVisitor::visit(inst);
+            return;
+        }
+
+        string name  = indexed->getName();
+        bool   index = isVarying(indexed->fIndex);
+        if (!dynamic_cast<NamedAddress*>(indexed->fAddress)) {
+            if (index || fVarying.find(name) != fVarying.end()) unsupported("'" + name + "' array access");
+            CPPInstVisitor::visit(inst);
+        } else if (fChannels.find(name) != fChannels.end()) {
+            if (index) unsupported("'" + name + "' channel access");
+            *fOut << "faust_simd::load_lanes<" << fSize << ">(" << name << ", ";
+            indexed->fIndex->accept(this);
+            *fOut << ")";
+        } else if (index) {
+            // Element read at a different index by each instance
+            *fOut << ((fVarying.find(name) != fVarying.end()) ? "faust_simd::lane_gather(" : "faust_simd::gather(")
+                  << name << ", ";
+            indexed->fIndex->accept(this);
+            *fOut << ")";
+        } else {
+            CPPInstVisitor::visit(inst);
+        }
+    }
+
+    virtual void visit(StoreVarInst* inst)
+    {
+        IndexedAddress* indexed = dynamic_cast<IndexedAddress*>(inst->fAddress);
+        if (!indexed) {
+            CPPInstVisitor::visit(inst);
+            return;
+        }
+
+        string name  = indexed->getName();
+        bool   index = isVarying(indexed->fIndex);
+        if (!dynamic_cast<NamedAddress*>(indexed->fAddress)) {
+            if (index || fVarying.find(name) != fVarying.end()) unsupported("'" + name + "' array access");
+            CPPInstVisitor::visit(inst);
+        } else if (fChannels.find(name) != fChannels.end()) {
+            if (index) unsupported("'" + name + "' channel access");
+            *fOut << "faust_simd::store_lanes<" << fSize << ">(" << name << ", ";
+            indexed->fIndex->accept(this);
+            *fOut << ", ";
+            inst->fValue->accept(this);
+            *fOut << ")";
+            EndLine();
+        } else if (index) {
+            // Element written at a different index by each instance
+            *fOut << "faust_simd::lane_scatter(" << name << ", ";
+            indexed->fIndex->accept(this);
+            *fOut << ", ";
+            inst->fValue->accept(this);
+            *fOut << ")";
+            EndLine();
+        } else {
+            CPPInstVisitor::visit(inst);
+        }
+    }
+
+    virtual void visit(::CastInst* inst)
+    {
+        if (!isVarying(inst->fInst)) {
+            CPPInstVisitor::visit(inst);
+        } else {
+            // Checks that the type can be used in vectors
+            vecTypeName(inst->fType->getType());
+            *fOut << "faust_simd::cast<" << fTypeManager->generateType(inst->fType) << ">(";
+            inst->fInst->accept(this);
+            *fOut << ")";
+        }
+    }
+
+    virtual void visit(BitcastInst* inst)
+    {
+        if (isVarying(inst->fInst)) unsupported("bitcast");
+        CPPInstVisitor::visit(inst);
+    }
+
+    virtual void visit(FunCallInst* inst)
+    {
+        string name = gGlobal->getMathFunction(inst->fName);
+        bool   varying = false;
+        for (list<ValueInst*>::const_iterator it = inst->fArgs.begin(); it != inst->fArgs.end(); it++) {
+            varying |= isVarying(*it);
+        }
+        if (!varying) {
+            CPPInstVisitor::visit(inst);
+        } else if (fSIMDMathTable.find(name) != fSIMDMathTable.end()) {
+            generateFunCall(inst, fSIMDMathTable[name]);
+        } else if (inst->fMethod || inst->fArgs.size() > 2) {
+            unsupported("'" + inst->fName + "' function");
+        } else {
+            // Other functions are called in each lane
+            *fOut << "faust_simd::apply(" << name << ", ";
+            generateFunCallArgs(inst->fArgs.begin(), inst->fArgs.end(), int(inst->fArgs.size()));
+            *fOut << ")";
+        }
+    }
+
+    virtual void visit(Select2Inst* inst)
+    {
+        if (!isVarying(inst)) {
+            CPPInstVisitor::visit(inst);
+        } else {
+            // Both branches are computed
+            *fOut << "faust_simd::select(";
+            inst->fCond->accept(this);
+            *fOut << ", ";
+            inst->fThen->accept(this);
+            *fOut << ", ";
+            inst->fElse->accept(this);
+            *fOut << ")";
+        }
+    }
+
+    virtual void visit(IfInst* inst)
+    {
+        if (isVarying(inst->fCond)) unsupported("a condition on a control or an input");
+        CPPInstVisitor::visit(inst);
+    }
+
+    virtual void visit(ForLoopInst* inst)
+    {
+        if (isVarying(inst->fEnd)) unsupported("a loop depending on a control or an input");
+        CPPInstVisitor::visit(inst);
+    }
 };
 
 /**
@@ -348,11 +348,10 @@ ValueInst* DAGInstructionsCompiler::generateCacheCode(Tree sig, ValueInst* exp)
                 } else {
                     // we use a ring buffer
                     string vname_idx = vname + "_idx";
-                    int    mask      = pow2limit(d + gGlobal->gVecSize) - 1;
-                    // return subst("$0[($0_idx+i) & $1]", vname, mask);
-                    FIRIndex index1 = (getCurrentLoopIndex() + InstBuilder::genLoadStructVar(vname_idx)) &
-                                      InstBuilder::genInt32NumInst(mask);
-                    return InstBuilder::genLoadArrayStructVar(vname, index1);
+                    int    N         = delayLineSize(d + gGlobal->gVecSize);
+                    // return subst("$0[($0_idx+i) & $1]", vname, N-1);
+                    FIRIndex index1 = getCurrentLoopIndex() + InstBuilder::genLoadStructVar(vname_idx);
+                    return InstBuilder::genLoadArrayStructVar(vname, wrapDelayIndex(index1, N));
                 }
             }
         } else {
@@ -447,29 +446,25 @@ ValueInst* DAGInstructionsCompiler::generateFixDelay(Tree sig, Tree exp, Tree de
             return InstBuilder::genLoadArrayStackVar(vname, index);
         }
     } else {
-        // long delay : we use a ring buffer of size 2^x
-        int    N         = pow2limit(mxd + gGlobal->gVecSize);
+        // long delay : we use a ring buffer of size 2^x (or mxd + vec size with -edl)
+        int    N         = delayLineSize(mxd + gGlobal->gVecSize);
         string vname_idx = vname + "_idx";
 
         if (isSigInt(delay, &d)) {
             if (d == 0) {
                 // return subst("$0[($0_idx+i)&$1]", vname, T(N-1));
-                FIRIndex index1 = (getCurrentLoopIndex() + InstBuilder::genLoadStructVar(vname_idx)) &
-                                  InstBuilder::genInt32NumInst(N - 1);
-                return InstBuilder::genLoadArrayStructVar(vname, index1);
+                FIRIndex index1 = getCurrentLoopIndex() + InstBuilder::genLoadStructVar(vname_idx);
+                return InstBuilder::genLoadArrayStructVar(vname, wrapDelayIndex(index1, N));
             } else {
                 // return subst("$0[($0_idx+i-$2)&$1]", vname, T(N-1), T(d));
                 FIRIndex index1 = getCurrentLoopIndex() + InstBuilder::genLoadStructVar(vname_idx);
-                FIRIndex index2 = index1 - InstBuilder::genInt32NumInst(d);
-                FIRIndex index3 = index2 & InstBuilder::genInt32NumInst(N - 1);
-                return InstBuilder::genLoadArrayStructVar(vname, index3);
+                return InstBuilder::genLoadArrayStructVar(vname,
+                                                          delayedIndex(index1, InstBuilder::genInt32NumInst(d), N));
             }
         } else {
             // return subst("$0[($0_idx+i-$2)&$1]", vname, T(N-1), CS(delay));
             FIRIndex index1 = getCurrentLoopIndex() + InstBuilder::genLoadStructVar(vname_idx);
-            FIRIndex index2 = index1 - CS(delay);
-            FIRIndex index3 = index2 & InstBuilder::genInt32NumInst(N - 1);
-            return InstBuilder::genLoadArrayStructVar(vname, index3);
+            return InstBuilder::genLoadArrayStructVar(vname, delayedIndex(index1, CS(delay), N));
         }
     }
 }
@@ -562,7 +557,8 @@ void DAGInstructionsCompiler::generateDlineLoop(Typed::VarType ctype, const stri
 
     } else {
         // Implementation of a ring-buffer delayline, the size should be large enough and aligned on a power of two
-        delay = pow2limit(delay + gGlobal->gVecSize);
+        // (or exactly large enough with -edl)
+        delay = delayLineSize(delay + gGlobal->gVecSize);
 
         // create names for temporary and permanent storage
         string idx      = subst("$0_idx", vname);
@@ -579,15 +575,13 @@ void DAGInstructionsCompiler::generateDlineLoop(Typed::VarType ctype, const stri
 
         // -- update index
         FIRIndex index1 = FIRIndex(InstBuilder::genLoadStructVar(idx)) + InstBuilder::genLoadStructVar(idx_save);
-        FIRIndex index2 = index1 & InstBuilder::genInt32NumInst(delay - 1);
 
-        pushComputePreDSPMethod(InstBuilder::genStoreStructVar(idx, index2));
+        pushComputePreDSPMethod(InstBuilder::genStoreStructVar(idx, wrapDelayIndex(index1, delay)));
 
         // -- compute the new samples
         FIRIndex index3 = getCurrentLoopIndex() + InstBuilder::genLoadStructVar(idx);
-        FIRIndex index4 = index3 & InstBuilder::genInt32NumInst(delay - 1);
 
-        pushComputeDSPMethod(InstBuilder::genStoreArrayStructVar(vname, index4, exp));
+        pushComputeDSPMethod(InstBuilder::genStoreArrayStructVar(vname, wrapDelayIndex(index3, delay), exp));
 
         // -- save index
         pushComputePostDSPMethod(InstBuilder::genStoreStructVar(idx_save, InstBuilder::genLoadStackVar("count")));
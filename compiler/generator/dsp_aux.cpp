@@ -22,10 +22,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#include "TMutex.h"
 #include "Text.hh"
 #include "compatibility.hh"
 #include "dsp_aux.hh"
@@ -292,6 +301,147 @@ EXPORT bool generateAuxFilesFromString(const string& name_app, const string& dsp
     }
 }
 
+// Persistent factory cache: one '<key>.fcache' file per factory, the file modification time is the last use
+
+static TLockAble gFactoryCacheLock;
+static string    gFactoryCacheDir;
+static size_t    gFactoryCacheMaxSize = 0;
+static int       gFactoryCacheHits    = 0;
+static int       gFactoryCacheMisses  = 0;
+
+static string factoryCachePath(const string& key)
+{
+    return gFactoryCacheDir + "/" + key + ".fcache";
+}
+
+#ifndef _WIN32
+// Remove the least recently used entries (except 'kept') while the directory is bigger than the maximum size
+static void evictFactoryCache(const string& kept)
+{
+    DIR* dir = opendir(gFactoryCacheDir.c_str());
+    if (!dir) return;
+
+    vector<pair<time_t, pair<string, size_t> > > entries;
+    size_t                                       total = 0;
+    struct dirent*                               entry;
+    while ((entry = readdir(dir))) {
+        string name = entry->d_name;
+        if (name.size() > 7 && name.compare(name.size() - 7, 7, ".fcache") == 0) {
+            string      path = gFactoryCacheDir + "/" + name;
+            struct stat info;
+            if (stat(path.c_str(), &info) == 0) {
+                if (path != kept) entries.push_back(make_pair(info.st_mtime, make_pair(path, size_t(info.st_size))));
+                total += size_t(info.st_size);
+            }
+        }
+    }
+    closedir(dir);
+
+    sort(entries.begin(), entries.end());
+    for (size_t i = 0; i < entries.size() && total > gFactoryCacheMaxSize; i++) {
+        if (remove(entries[i].second.first.c_str()) == 0) total -= entries[i].second.second;
+    }
+}
+#endif
+
+bool dsp_factory_cache::isEnabled()
+{
+    TLock lock(&gFactoryCacheLock);
+    return gFactoryCacheDir != "";
+}
+
+bool dsp_factory_cache::read(const string& key, string& machine_code)
+{
+    TLock lock(&gFactoryCacheLock);
+    if (gFactoryCacheDir == "") return false;
+
+    string   path = factoryCachePath(key);
+    ifstream reader(path.c_str(), ios::in | ios::binary);
+    if (reader.is_open()) {
+        stringstream content;
+        content << reader.rdbuf();
+        machine_code = content.str();
+    }
+    if (machine_code != "") {
+#ifndef _WIN32
+        // Most recently used entry
+        utime(path.c_str(), nullptr);
+#endif
+        gFactoryCacheHits++;
+        return true;
+    } else {
+        gFactoryCacheMisses++;
+        return false;
+    }
+}
+
+void dsp_factory_cache::invalidate(const string& key)
+{
+    TLock lock(&gFactoryCacheLock);
+    if (gFactoryCacheDir == "") return;
+
+    remove(factoryCachePath(key).c_str());
+    gFactoryCacheHits--;
+    gFactoryCacheMisses++;
+}
+
+void dsp_factory_cache::write(const string& key, const string& machine_code)
+{
+#ifndef _WIN32
+    TLock lock(&gFactoryCacheLock);
+    if (gFactoryCacheDir == "") return;
+
+    // Written in a temporary file then renamed, so that another process never reads a partial entry
+    stringstream tmp_path;
+    tmp_path << gFactoryCacheDir << "/" << key << ".tmp" << getpid();
+    {
+        ofstream writer(tmp_path.str().c_str(), ios::out | ios::binary);
+        writer << machine_code;
+        writer.close();
+        if (writer.fail()) {
+            remove(tmp_path.str().c_str());
+            return;
+        }
+    }
+    if (rename(tmp_path.str().c_str(), factoryCachePath(key).c_str()) != 0) {
+        remove(tmp_path.str().c_str());
+        return;
+    }
+
+    if (gFactoryCacheMaxSize > 0) evictFactoryCache(factoryCachePath(key));
+#endif
+}
+
+EXPORT bool setDSPFactoryCacheDirectory(const string& path, size_t max_size)
+{
+    TLock lock(&gFactoryCacheLock);
+    gFactoryCacheDir     = "";
+    gFactoryCacheMaxSize = max_size;
+    gFactoryCacheHits    = 0;
+    gFactoryCacheMisses  = 0;
+    if (path == "") return true;
+
+#ifdef _WIN32
+    return false;
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 && mkdir(path.c_str(), 0755) != 0) return false;
+    if (stat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) || access(path.c_str(), R_OK | W_OK) != 0) {
+        return false;
+    }
+    gFactoryCacheDir = path;
+    if (gFactoryCacheMaxSize > 0) evictFactoryCache("");
+    return true;
+#endif
+}
+
+EXPORT void getDSPFactoryCacheStats(int& hits, int& misses)
+{
+    TLock lock(&gFactoryCacheLock);
+    hits   = gFactoryCacheHits;
+    misses = gFactoryCacheMisses;
+}
+
     // External C libfaust API
 
 #ifdef __cplusplus
@@ -342,6 +492,16 @@ EXPORT void generateCSHA1(const char* data, char* sha_key)
     strncpy(sha_key, generateSHA1(data).c_str(), 64);
 }
 
+EXPORT bool setCDSPFactoryCacheDirectory(const char* path, size_t max_size)
+{
+    return setDSPFactoryCacheDirectory(path, max_size);
+}
+
+EXPORT void getCDSPFactoryCacheStats(int* hits, int* misses)
+{
+    getDSPFactoryCacheStats(*hits, *misses);
+}
+
 EXPORT void freeCMemory(void* ptr)
 {
     free(ptr);
@@ -290,6 +290,24 @@ struct dsp_factory_table : public std::map<T, std::list<dsp*> > {
     }
 };
 
+//----------------------------------------------------------------
+// Persistent factory cache (see setDSPFactoryCacheDirectory)
+//----------------------------------------------------------------
+
+struct dsp_factory_cache {
+    // Whether a cache directory is set
+    static bool isEnabled();
+
+    // Read the machine code kept for 'key' and count a hit, or count a miss
+    static bool read(const std::string& key, std::string& machine_code);
+
+    // The entry read for 'key' could not be loaded : remove it and count a miss instead of a hit
+    static void invalidate(const std::string& key);
+
+    // Atomically store the machine code for 'key', then remove the least recently used entries above the maximum size
+    static void write(const std::string& key, const std::string& machine_code);
+};
+
 // We take the largest sample size here, to cover 'float' and 'double' cases
 #define LLVM_FAUSTFLOAT double
 
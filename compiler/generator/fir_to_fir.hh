@@ -620,4 +620,218 @@ struct CastRemover : public BasicTypingCloneVisitor {
     BlockInst* getCode(BlockInst* src) { return dynamic_cast<BlockInst*>(src->clone(this)); }
 };
 
+/*
+ Shape of some code: the variable names are replaced by their rank of first use and the numbers by their type,
+ so that two loops with the same shape only differ by their variables and constants. The visited nodes are kept
+ in visiting order, so that the corresponding nodes of two loops of same shape have the same position.
+ Used to interleave independent recursive loops in SIMD lanes.
+*/
+struct InstShape : public DispatchVisitor {
+    stringstream       fKey;
+    map<string, int>   fNames;
+    vector<Printable*> fNodes;
+
+    void node(Printable* inst, const string& tag)
+    {
+        fNodes.push_back(inst);
+        fKey << tag << " ";
+    }
+
+    void unique(Printable* inst)
+    {
+        fNodes.push_back(inst);
+        fKey << "?" << inst << " ";
+    }
+
+    virtual void visit(DeclareVarInst* inst)
+    {
+        node(inst, "Dec" + T(inst->fType->getType()));
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(LoadVarInst* inst)
+    {
+        node(inst, "Load");
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(LoadVarAddressInst* inst)
+    {
+        node(inst, "Address");
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(TeeVarInst* inst)
+    {
+        node(inst, "Tee");
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(StoreVarInst* inst)
+    {
+        node(inst, "Store");
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(NamedAddress* address)
+    {
+        if (fNames.find(address->fName) == fNames.end()) {
+            int rank               = int(fNames.size());
+            fNames[address->fName] = rank;
+        }
+        node(address, "N" + T(fNames[address->fName]));
+    }
+    virtual void visit(IndexedAddress* address)
+    {
+        node(address, "[");
+        DispatchVisitor::visit(address);
+        fKey << "] ";
+    }
+    virtual void visit(FloatNumInst* inst) { node(inst, "Float"); }
+    virtual void visit(DoubleNumInst* inst) { node(inst, "Double"); }
+    virtual void visit(Int32NumInst* inst) { node(inst, "Int32"); }
+    virtual void visit(Int64NumInst* inst) { node(inst, "Int64"); }
+    virtual void visit(BoolNumInst* inst) { node(inst, "Bool"); }
+    virtual void visit(BinopInst* inst)
+    {
+        node(inst, "Binop" + T(inst->fOpcode));
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(::CastInst* inst)
+    {
+        node(inst, "Cast" + T(inst->fType->getType()));
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(BitcastInst* inst)
+    {
+        node(inst, "Bitcast" + T(inst->fType->getType()));
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(FunCallInst* inst)
+    {
+        node(inst, "Call" + inst->fName + T(int(inst->fArgs.size())));
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(Select2Inst* inst)
+    {
+        node(inst, "Select");
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(IfInst* inst)
+    {
+        node(inst, "If");
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(ForLoopInst* inst)
+    {
+        node(inst, "For");
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(WhileLoopInst* inst)
+    {
+        node(inst, "While");
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(::SwitchInst* inst)
+    {
+        node(inst, "Switch");
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(BlockInst* inst)
+    {
+        node(inst, "{");
+        DispatchVisitor::visit(inst);
+        fKey << "} ";
+    }
+    virtual void visit(LabelInst* inst) { node(inst, inst->fLabel); }
+
+    // Other instructions (arrays of numbers, UI...) never give the same shape
+    virtual void visit(FloatArrayNumInst* inst) { unique(inst); }
+    virtual void visit(DoubleArrayNumInst* inst) { unique(inst); }
+    virtual void visit(Int32ArrayNumInst* inst) { unique(inst); }
+    virtual void visit(RetInst* inst) { unique(inst); }
+    virtual void visit(DropInst* inst) { unique(inst); }
+    virtual void visit(ShiftArrayVarInst* inst) { unique(inst); }
+
+    string getKey() { return fKey.str(); }
+};
+
+// Zones of the buttons, sliders and nentries, and of the soundfiles
+struct UIZonesCollector : public DispatchVisitor {
+    set<string> fZones;
+    set<string> fSoundfiles;
+
+    using DispatchVisitor::visit;
+
+    virtual void visit(AddButtonInst* inst) { fZones.insert(inst->fZone); }
+    virtual void visit(AddSliderInst* inst) { fZones.insert(inst->fZone); }
+    virtual void visit(AddSoundfileInst* inst) { fSoundfiles.insert(inst->fSFZone); }
+};
+
+// Variables written by some code
+struct StoredVariables : public DispatchVisitor {
+    set<string> fNames;
+
+    using DispatchVisitor::visit;
+
+    virtual void visit(StoreVarInst* inst)
+    {
+        fNames.insert(inst->fAddress->getName());
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(TeeVarInst* inst)
+    {
+        fNames.insert(inst->fAddress->getName());
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(ShiftArrayVarInst* inst)
+    {
+        fNames.insert(inst->fAddress->getName());
+        DispatchVisitor::visit(inst);
+    }
+};
+
+// Variables read by a value, 'fOther' is set when it reads arguments or takes addresses
+struct LoadedVariables : public DispatchVisitor {
+    set<string> fStack;
+    set<string> fStruct;
+    bool        fOther;
+
+    LoadedVariables() : fOther(false) {}
+
+    using DispatchVisitor::visit;
+
+    virtual void visit(NamedAddress* address)
+    {
+        if (address->fAccess & (Address::kStack | Address::kLoop)) {
+            fStack.insert(address->fName);
+        } else if (address->fAccess & (Address::kStruct | Address::kStaticStruct | Address::kGlobal)) {
+            fStruct.insert(address->fName);
+        } else {
+            fOther = true;
+        }
+    }
+    virtual void visit(LoadVarAddressInst* inst)
+    {
+        fOther = true;
+        DispatchVisitor::visit(inst);
+    }
+    virtual void visit(TeeVarInst* inst)
+    {
+        fOther = true;
+        DispatchVisitor::visit(inst);
+    }
+};
+
+// Change the given stack variables in struct variables
+struct Stack2StructNamesRewriter : public DispatchVisitor {
+    const set<string>& fNames;
+
+    using DispatchVisitor::visit;
+
+    virtual void visit(NamedAddress* address)
+    {
+        if (address->fAccess == Address::kStack && fNames.find(address->fName) != fNames.end()) {
+            address->fAccess = Address::kStruct;
+        }
+    }
+
+    Stack2StructNamesRewriter(const set<string>& names) : fNames(names) {}
+};
+
 #endif
@@ -24,7 +24,7 @@
 #include "global.hh"
 #include "sigtype.hh"
 
-std::stack<BlockInst*> BasicCloneVisitor::fBlockStack;
+thread_local std::stack<BlockInst*> BasicCloneVisitor::fBlockStack;
 
 DeclareStructTypeInst* isStructType(const string& name)
 {
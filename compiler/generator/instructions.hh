@@ -1211,7 +1211,7 @@ struct WhileLoopInst : public StatementInst {
 
 class BasicCloneVisitor : public CloneVisitor {
    protected:
-    static std::stack<BlockInst*> fBlockStack;
+    static thread_local std::stack<BlockInst*> fBlockStack;
 
    public:
     BasicCloneVisitor() {}
@@ -1331,8 +1331,13 @@ class BasicCloneVisitor : public CloneVisitor {
     // Loop
     virtual StatementInst* visit(ForLoopInst* inst)
     {
-        return new ForLoopInst(inst->fInit->clone(this), inst->fEnd->clone(this), inst->fIncrement->clone(this),
-                               static_cast<BlockInst*>(inst->fCode->clone(this)));
+        // Cloned in order (the evaluation order of the arguments is unspecified): the loop variable
+        // declaration has to be visited first, since some cloners rename it (see FunctionInliner)
+        StatementInst* init      = inst->fInit->clone(this);
+        ValueInst*     end       = inst->fEnd->clone(this);
+        StatementInst* increment = inst->fIncrement->clone(this);
+        BlockInst*     code      = static_cast<BlockInst*>(inst->fCode->clone(this));
+        return new ForLoopInst(init, end, increment, code);
     }
 
     virtual StatementInst* visit(WhileLoopInst* inst)
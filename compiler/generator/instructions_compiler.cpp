@@ -184,6 +184,19 @@ Tree InstructionsCompiler::prepare(Tree LS)
     // annotationStatistics();
     endTiming("prepare");
 
+    // Declare the tail of the DSPs without recursion (used by 'dsp_silence')
+    if (gGlobal->gTailSamples) {
+        set<Tree> visited;
+        int       tail = 0;
+        for (Tree L = L5; isList(L) && tail >= 0; L = tl(L)) {
+            int sub = getTailLength(hd(L), visited);
+            tail    = (sub < 0) ? -1 : tail + sub;
+        }
+        if (tail >= 0) {
+            gGlobal->gMetaDataSet[tree("tail_samples")].insert(tree(quote(T(tail))));
+        }
+    }
+
     if (gGlobal->gDrawSignals) {
         ofstream dotfile(subst("$0-sig.dot", gGlobal->makeDrawPath()).c_str());
         sigToGraph(L5, dotfile);
@@ -204,6 +217,40 @@ Tree InstructionsCompiler::prepare2(Tree L0)
     return L0;
 }
 
+/**
+ * Number of samples after which the outputs of a DSP without recursion only depend on its controls, when its
+ * inputs stay at zero : a path from an input to an output goes through each delay line at most once, so the
+ * sum of the delay lines sizes is an upper bound. Returns -1 for the DSPs keeping a state forever (recursions,
+ * written tables, soundfiles).
+ */
+int InstructionsCompiler::getTailLength(Tree sig, set<Tree>& visited)
+{
+    if (visited.find(sig) != visited.end()) {
+        return 0;
+    }
+    visited.insert(sig);
+
+    int  i;
+    Tree rg, id, tbl, idx, val, label;
+    if (isProj(sig, &i, rg) || isSigWRTbl(sig, id, tbl, idx, val) || isSigSoundfile(sig, label)) {
+        return -1;
+    }
+
+    // The contents of the tables are computed at init time
+    Occurences*  o    = fOccMarkup.retrieve(sig);
+    int          tail = (o) ? o->getMaxDelay() : 0;
+    vector<Tree> subsigs;
+    int          n = getSubSignals(sig, subsigs, false);
+    for (int k = 0; k < n; k++) {
+        int sub = getTailLength(subsigs[k], visited);
+        if (sub < 0) {
+            return -1;
+        }
+        tail += sub;
+    }
+    return tail;
+}
+
 /*****************************************************************************
  CACHE CODE
  *****************************************************************************/
@@ -701,11 +748,19 @@ ValueInst* InstructionsCompiler::generateFixDelay(Tree sig, Tree exp, Tree delay
     } else if (mxd < gGlobal->gMaxCopyDelay) {
         return InstBuilder::genLoadArrayStructVar(vname, CS(delay));
     } else {
-        // Long delay : we use a ring buffer of size 2^x
-        int      N = pow2limit(mxd + 1);
-        FIRIndex value2 =
-            (FIRIndex(InstBuilder::genLoadStructVar("IOTA")) - CS(delay)) & InstBuilder::genInt32NumInst(N - 1);
-        return InstBuilder::genLoadArrayStructVar(vname, value2);
+        // Long delay : we use a ring buffer of size 2^x (or mxd + 1 with -edl)
+        int N = delayLineSize(mxd + 1);
+        if (gGlobal->gExactDelayLines) {
+            // The shared index is already wrapped
+            FIRIndex      index = FIRIndex(InstBuilder::genLoadStructVar(ensureDelayIndexCode(N)));
+            ValueInst*    value = CS(delay);
+            Int32NumInst* num   = dynamic_cast<Int32NumInst*>(value);
+            return InstBuilder::genLoadArrayStructVar(vname, (num && num->fNum == 0) ? index : delayedIndex(index, value, N));
+        } else {
+            FIRIndex value2 =
+                (FIRIndex(InstBuilder::genLoadStructVar("IOTA")) - CS(delay)) & InstBuilder::genInt32NumInst(N - 1);
+            return InstBuilder::genLoadArrayStructVar(vname, value2);
+        }
     }
 }
 
@@ -1674,6 +1729,18 @@ ValueInst* InstructionsCompiler::generateDelayLine(ValueInst* exp, Typed::VarTyp
             pushComputePostDSPMethod(generateShiftArray(vname, mxd));
         }
 
+    } else if (gGlobal->gExactDelayLines) {
+        // Generate code for a long delay : we use a ring buffer of size N = mxd + 1,
+        // with an index shared by all the delay lines of the same size
+        int    N     = delayLineSize(mxd + 1);
+        string index = ensureDelayIndexCode(N);
+
+        // Generates table init
+        pushClearMethod(generateInitArray(vname, ctype, N));
+
+        // Generate table use
+        pushComputeDSPMethod(InstBuilder::genStoreArrayStructVar(vname, InstBuilder::genLoadStructVar(index), exp));
+
     } else {
         // Generate code for a long delay : we use a ring buffer of size N = 2**x > mxd
         int N = pow2limit(mxd + 1);
@@ -1725,6 +1792,29 @@ void InstructionsCompiler::ensureIotaCode()
     }
 }
 
+/**
+ * Generate code for the index of the exact size ring buffers (-edl) of 'size' samples,
+ * increased at each sample and wrapped at 'size', and return its name.
+ */
+string InstructionsCompiler::ensureDelayIndexCode(int size)
+{
+    if (fDelayIndexTable.find(size) == fDelayIndexTable.end()) {
+        string index            = gGlobal->getFreshID("IOTA");
+        fDelayIndexTable[size] = index;
+
+        pushDeclare(InstBuilder::genDecStructVar(index, InstBuilder::genBasicTyped(Typed::kInt32)));
+        pushClearMethod(InstBuilder::genStoreStructVar(index, InstBuilder::genInt32NumInst(0)));
+
+        // Conditional wrap, cheaper than a modulo
+        FIRIndex   next  = FIRIndex(InstBuilder::genLoadStructVar(index)) + 1;
+        ValueInst* value = InstBuilder::genSelect2Inst(InstBuilder::genLessThan(next, InstBuilder::genInt32NumInst(size)),
+                                                       FIRIndex(InstBuilder::genLoadStructVar(index)) + 1,
+                                                       InstBuilder::genInt32NumInst(0));
+        pushComputePostDSPMethod(InstBuilder::genStoreStructVar(index, value));
+    }
+    return fDelayIndexTable[size];
+}
+
 /**
  * Add a widget with a certain path to the user interface tree
  */
@@ -53,6 +53,7 @@ class InstructionsCompiler : public virtual Garbageable {
     OccMarkup                       fOccMarkup;
 
     std::map<int, std::string> fIOTATable;  // Ensure IOTA base fixed delays are computed once
+    std::map<int, std::string> fDelayIndexTable;  // Ring buffer index of exact size delay lines (-edl), by size
 
     Tree         fUIRoot;
     Description* fDescription;
@@ -108,6 +109,36 @@ class InstructionsCompiler : public virtual Garbageable {
     StatementInst* pushComputePostDSPMethod(StatementInst* inst) { return fContainer->pushComputePostDSPMethod(inst); }
 
     void ensureIotaCode();
+    string ensureDelayIndexCode(int size);
+
+    // Ring buffer size: a power of two so that indexes are masked, or the exact size with -edl
+    int delayLineSize(int min_size) { return (gGlobal->gExactDelayLines) ? min_size : pow2limit(min_size); }
+
+    // Wrap 'index' in a ring buffer of 'size' samples
+    ValueInst* wrapDelayIndex(FIRIndex index, int size)
+    {
+        if (gGlobal->gExactDelayLines) {
+            return index % size;
+        } else {
+            return index & (size - 1);
+        }
+    }
+
+    // Index of the sample written 'delay' samples before 'index' in a ring buffer of 'size' samples
+    ValueInst* delayedIndex(FIRIndex index, ValueInst* delay, int size)
+    {
+        if (gGlobal->gExactDelayLines) {
+            // 'delay' is at most size - 1, so that the modulo is taken on a positive value
+            Int32NumInst* num = dynamic_cast<Int32NumInst*>(delay);
+            if (num) {
+                return (index + (size - num->fNum)) % size;
+            } else {
+                return ((index + size) - delay) % size;
+            }
+        } else {
+            return (index - delay) & (size - 1);
+        }
+    }
 
     int pow2limit(int x)
     {
@@ -211,6 +242,8 @@ class InstructionsCompiler : public virtual Garbageable {
     Tree prepare(Tree LS);
     Tree prepare2(Tree L0);
 
+    int getTailLength(Tree sig, set<Tree>& visited);
+
     void declareWaveform(Tree sig, string& vname, int& size);
 };
 
@@ -24,6 +24,7 @@
 
 using namespace std;
 
+#include <fstream>
 #include <iostream>
 #include <list>
 #include <map>
@@ -35,6 +36,69 @@ using namespace std;
 #include "exception.hh"
 #include "instructions.hh"
 
+/**
+ * Estimated cost in cycles of each kind of instruction, used to group the loops in tasks (see -mtc).
+ * The default values can be replaced by measured ones (see -tcm), read from a file with one line by kind:
+ *
+ *  # comment
+ *  <load|store|binop|number|declare|cast|select|loop|funcall> <cycles>
+ */
+struct InstCostModel {
+    double fLoad;
+    double fStore;
+    double fBinop;
+    double fNumbers;
+    double fDeclare;
+    double fCast;
+    double fSelect;
+    double fLoop;
+    double fFunCall;
+
+    InstCostModel(const string& filename = "")
+        : fLoad(1), fStore(1), fBinop(1), fNumbers(0), fDeclare(0), fCast(1), fSelect(2), fLoop(2), fFunCall(20)
+    {
+        if (filename != "") {
+            read(filename);
+        }
+    }
+
+    void read(const string& filename)
+    {
+        ifstream reader(filename.c_str());
+        if (!reader.is_open()) {
+            stringstream error;
+            error << "ERROR : cannot open task cost model file '" << filename << "'" << endl;
+            throw faustexception(error.str());
+        }
+        map<string, double*> costs;
+        costs["load"]    = &fLoad;
+        costs["store"]   = &fStore;
+        costs["binop"]   = &fBinop;
+        costs["number"]  = &fNumbers;
+        costs["declare"] = &fDeclare;
+        costs["cast"]    = &fCast;
+        costs["select"]  = &fSelect;
+        costs["loop"]    = &fLoop;
+        costs["funcall"] = &fFunCall;
+        string line;
+        while (getline(reader, line)) {
+            stringstream tokens(line);
+            string       kind;
+            double       cycles;
+            if (!(tokens >> kind) || kind[0] == '#') {
+                continue;
+            }
+            if (costs.find(kind) == costs.end() || !(tokens >> cycles)) {
+                stringstream error;
+                error << "ERROR : incorrect line '" << line << "' in task cost model file '" << filename << "'"
+                      << endl;
+                throw faustexception(error.str());
+            }
+            *costs[kind] = cycles;
+        }
+    }
+};
+
 class InstComplexityVisitor : public DispatchVisitor {
    private:
     int fLoad;
@@ -94,6 +158,12 @@ class InstComplexityVisitor : public DispatchVisitor {
         DispatchVisitor::visit(inst);
     }
 
+    virtual void visit(Select2Inst* inst)
+    {
+        fSelect++;
+        DispatchVisitor::visit(inst);
+    }
+
     virtual void visit(IfInst* inst)
     {
         fSelect++;
@@ -104,7 +174,7 @@ class InstComplexityVisitor : public DispatchVisitor {
         inst->fThen->accept(&then_branch);
 
         InstComplexityVisitor else_branch;
-        inst->fThen->accept(&else_branch);
+        inst->fElse->accept(&else_branch);
 
         // Takes the max of both then/else branches
         if (then_branch.cost() > else_branch.cost()) {
@@ -116,6 +186,7 @@ class InstComplexityVisitor : public DispatchVisitor {
             fCast += then_branch.fCast;
             fSelect += then_branch.fSelect;
             fLoop += then_branch.fLoop;
+            fFunCall += then_branch.fFunCall;
         } else {
             fLoad += else_branch.fLoad;
             fStore += else_branch.fStore;
@@ -125,6 +196,7 @@ class InstComplexityVisitor : public DispatchVisitor {
             fCast += else_branch.fCast;
             fSelect += else_branch.fSelect;
             fLoop += else_branch.fLoop;
+            fFunCall += else_branch.fFunCall;
         }
     }
 
@@ -158,13 +230,18 @@ class InstComplexityVisitor : public DispatchVisitor {
         fCast += visitor.fCast;
         fSelect += visitor.fSelect;
         fLoop += visitor.fLoop;
+        fFunCall += visitor.fFunCall;
     }
 
-    int cost()
+    // A polynom based on measured values
+    double cost(const InstCostModel& model)
     {
-        // A polynom based on measured values
-        return 0;
+        return fLoad * model.fLoad + fStore * model.fStore + fBinop * model.fBinop + fNumbers * model.fNumbers +
+               fDeclare * model.fDeclare + fCast * model.fCast + fSelect * model.fSelect + fLoop * model.fLoop +
+               fFunCall * model.fFunCall;
     }
+
+    int cost() { return int(cost(InstCostModel())); }
 };
 
 #endif
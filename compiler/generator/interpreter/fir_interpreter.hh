@@ -22,12 +22,18 @@
 #ifndef _FIR_INTERPRETER_H
 #define _FIR_INTERPRETER_H
 
+#include <stdint.h>
 #include <string.h>
+#include <algorithm>
 #include <cmath>
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #include "exception.hh"
 #include "faust/gui/CGlue.h"
@@ -43,6 +49,10 @@
  4 : collect FP_SUBNORMAL, FP_INFINITE, FP_NAN, INTEGER_OVERFLOW, DIV_BY_ZERO, fails at first FP_INFINITE or FP_NAN
  5 : collect FP_SUBNORMAL, FP_INFINITE, FP_NAN, INTEGER_OVERFLOW, DIV_BY_ZERO, continue after FP_INFINITE or FP_NAN
 
+ Profile mode: the code is optimized (without the superinstructions) and nothing is checked.
+
+ 6 : collect the executed opcode n-grams (see FIROpcodeProfile)
+
 */
 
 #define INTEGER_OVERFLOW -1
@@ -54,10 +64,155 @@
 template <class T, int TRACE>
 struct interpreter_dsp_factory_aux;
 
+/*
+  Counts the opcode n-grams (sequences of 2 to PROFILE_MAX_NGRAM instructions executed in a row,
+  without any branch in between), to choose the sequences fused in superinstructions by the optimizer.
+*/
+#define PROFILE_MAX_NGRAM 4  // At most 4 opcodes packed in a 64 bits key
+
+struct FIROpcodeProfile {
+    std::unordered_map<uint64_t, long long> fNGrams;  // Key: the opcodes (+1) packed on 16 bits, last one first
+    uint64_t                                fWindow;  // The latest executed opcodes (+1), same packing
+    long long                               fCount;   // Number of executed instructions
+
+    FIROpcodeProfile() : fWindow(0), fCount(0) {}
+
+    // A branch starts a new sequence
+    void reset() { fWindow = 0; }
+
+    void push(int opcode)
+    {
+        fCount++;
+        fWindow = (fWindow << 16) | uint64_t(opcode + 1);
+        for (int n = 2; n <= PROFILE_MAX_NGRAM; n++) {
+            uint64_t ngram = (16 * n < 64) ? (fWindow & ((uint64_t(1) << (16 * n)) - 1)) : fWindow;
+            if ((ngram >> (16 * (n - 1))) == 0) break;
+            fNGrams[ngram]++;
+        }
+    }
+
+    static int size(uint64_t ngram)
+    {
+        int n = 0;
+        for (; ngram; ngram >>= 16) n++;
+        return n;
+    }
+
+    // Writes a n-gram as 'count size opcode1 ... opcodeN', using the opcodes names
+    static void write(std::ostream* out, uint64_t ngram, long long count)
+    {
+        int n = size(ngram);
+        *out << count << " " << n;
+        for (int i = n - 1; i >= 0; i--) {
+            *out << " " << gFIRInstructionTable[((ngram >> (16 * i)) & 0xFFFF) - 1];
+        }
+        *out << std::endl;
+    }
+
+    // Writes all n-grams
+    void dump(std::ostream* out)
+    {
+        for (const auto& it : fNGrams) {
+            write(out, it.first, it.second);
+        }
+    }
+
+    // Writes the 'max' most frequent n-grams of each size
+    void print(std::ostream* out, int max)
+    {
+        *out << "Executed instructions: " << fCount << std::endl;
+        for (int n = 2; n <= PROFILE_MAX_NGRAM; n++) {
+            std::vector<std::pair<long long, uint64_t>> sorted;
+            for (const auto& it : fNGrams) {
+                if (size(it.first) == n) sorted.push_back(std::make_pair(it.second, it.first));
+            }
+            std::sort(sorted.rbegin(), sorted.rend());
+            *out << n << "-grams:" << std::endl;
+            for (int i = 0; i < std::min(max, int(sorted.size())); i++) {
+                write(out, sorted[i].second, sorted[i].first);
+            }
+        }
+    }
+};
+
+/*
+  Counts the accesses to the DSP structure fields, and the accesses to two different fields in a row,
+  so that the compiler can order the fields by access pattern (-pgo-layout option).
+  Fields are identified by their heap offset: 2 * offset for the int heap, 2 * offset + 1 for the real heap.
+*/
+struct FIRFieldProfile {
+    std::unordered_map<int, long long>      fCounts;
+    std::unordered_map<uint64_t, long long> fPairs;  // Key: the two fields, smallest first
+    int                                     fLast;
+
+    FIRFieldProfile() : fLast(-1) {}
+
+    void push(int field)
+    {
+        fCounts[field]++;
+        if (fLast >= 0 && fLast != field) {
+            fPairs[(uint64_t(std::min(fLast, field)) << 32) | uint64_t(std::max(fLast, field))]++;
+        }
+        fLast = field;
+    }
+    void pushInt(int offset) { push(2 * offset); }
+    void pushReal(int offset) { push(2 * offset + 1); }
+
+    /*
+     Writes the profile using the field names of the 'name type size offset' state layout (see dsp-state.h):
+     'field name count' and 'pair name1 name2 count' lines. Accesses to non-field variables are ignored.
+    */
+    void dump(std::ostream* out, const std::string& layout, int real_size)
+    {
+        // Start of each field (same key encoding), to find the field of an array element
+        std::map<int, std::pair<std::string, int> > fields;
+        std::stringstream                          reader(layout);
+        std::string                                name;
+        int                                        type, size;
+        long                                       offset;
+        while (reader >> name >> type >> size >> offset) {
+            int key     = (type == 0) ? 2 * int(offset / sizeof(int)) : 2 * int(offset / real_size) + 1;
+            fields[key] = std::make_pair(name, size);
+        }
+        std::map<std::string, long long>                              counts;
+        std::map<std::pair<std::string, std::string>, long long>      pairs;
+        std::unordered_map<int, std::string>                          names;
+        for (const auto& it : fCounts) {
+            std::map<int, std::pair<std::string, int> >::iterator field = fields.upper_bound(it.first);
+            if (field == fields.begin()) continue;
+            field--;
+            // Same heap and inside the field
+            if ((field->first & 1) == (it.first & 1) && (it.first - field->first) / 2 < field->second.second) {
+                names[it.first] = field->second.first;
+                counts[field->second.first] += it.second;
+            }
+        }
+        for (const auto& it : fPairs) {
+            int field1 = int(it.first >> 32);
+            int field2 = int(it.first & 0xFFFFFFFF);
+            if (names.count(field1) && names.count(field2) && names[field1] != names[field2]) {
+                std::string name1 = std::min(names[field1], names[field2]);
+                std::string name2 = std::max(names[field1], names[field2]);
+                pairs[std::make_pair(name1, name2)] += it.second;
+            }
+        }
+        *out << "# Faust field profile" << std::endl;
+        for (const auto& it : counts) {
+            *out << "field " << it.first << " " << it.second << std::endl;
+        }
+        for (const auto& it : pairs) {
+            *out << "pair " << it.first.first << " " << it.first.second << " " << it.second << std::endl;
+        }
+    }
+};
+
 // FIR bytecode interpreter
 template <class T, int TRACE>
 class FIRInterpreter {
    protected:
+    // The numerical checks are not done in profile mode
+    static const int kCheckLevel = (TRACE >= 6) ? 0 : TRACE;
+
     interpreter_dsp_factory_aux<T, TRACE>* fFactory;
 
     int*        fIntHeap;
@@ -72,20 +227,45 @@ class FIRInterpreter {
     T** fOutputs;
 
     std::map<int, long long> fRealStats;
+    FIROpcodeProfile         fProfile;
+    FIRFieldProfile          fFieldProfile;
 
     void printStats()
     {
-        if (TRACE > 0) {
+        if (TRACE == 6) {
+            // Appended to the FAUST_INTERP_NGRAMS file if set (to be merged on a set of DSPs), or printed
+            const char* ngrams = getenv("FAUST_INTERP_NGRAMS");
+            if (ngrams) {
+                std::ofstream out(ngrams, std::ios::app);
+                fProfile.dump(&out);
+            } else {
+                std::cout << "-------------------------------" << std::endl;
+                std::cout << "Interpreter opcodes statistics" << std::endl;
+                fProfile.print(&std::cout, 10);
+                std::cout << "-------------------------------" << std::endl;
+            }
+        }
+        if (TRACE == 7) {
+            // Written in the FAUST_INTERP_PROFILE file if set (to be given to the -pgo-layout option), or printed
+            const char* profile = getenv("FAUST_INTERP_PROFILE");
+            if (profile) {
+                std::ofstream out(profile);
+                fFieldProfile.dump(&out, fFactory->fStateLayout, sizeof(T));
+            } else {
+                fFieldProfile.dump(&std::cout, fFactory->fStateLayout, sizeof(T));
+            }
+        }
+        if (kCheckLevel > 0) {
             std::cout << "-------------------------------" << std::endl;
             std::cout << "Interpreter statistics" << std::endl;
-            if (TRACE >= 1) {
+            if (kCheckLevel >= 1) {
                 std::cout << "FP_SUBNORMAL: " << fRealStats[FP_SUBNORMAL] << std::endl;
             }
-            if (TRACE >= 2) {
+            if (kCheckLevel >= 2) {
                 std::cout << "FP_INFINITE: " << fRealStats[FP_INFINITE] << std::endl;
                 std::cout << "FP_NAN: " << fRealStats[FP_NAN] << std::endl;
             }
-            if (TRACE >= 3) {
+            if (kCheckLevel >= 3) {
                 std::cout << "INTEGER_OVERFLOW: " << fRealStats[INTEGER_OVERFLOW] << std::endl;
                 std::cout << "DIV_BY_ZERO: " << fRealStats[DIV_BY_ZERO] << std::endl;
             }
@@ -93,12 +273,13 @@ class FIRInterpreter {
         }
     }
 
-    inline void warning_overflow(InstructionIT it)
+    template <class IT>
+    inline void warning_overflow(IT it)
     {
-        if (TRACE >= 3) {
+        if (kCheckLevel >= 3) {
             fRealStats[INTEGER_OVERFLOW]++;
         }
-        if (TRACE >= 5) {
+        if (kCheckLevel >= 5) {
             std::cout << "-------- Interpreter 'Overflow' warning trace start --------" << std::endl;
             traceInstruction(it);
             fTraceContext.write(&std::cout);
@@ -106,12 +287,13 @@ class FIRInterpreter {
         }
     }
 
-    inline void check_div_zero(InstructionIT it, T val)
+    template <class IT>
+    inline void check_div_zero(IT it, T val)
     {
-        if ((TRACE >= 3) && (val == T(0))) {
+        if ((kCheckLevel >= 3) && (val == T(0))) {
             fRealStats[DIV_BY_ZERO]++;
         }
-        if ((TRACE >= 4) && (val == T(0))) {
+        if ((kCheckLevel >= 4) && (val == T(0))) {
             std::cout << "-------- Interpreter 'div by zero' trace start --------" << std::endl;
             traceInstruction(it);
             fTraceContext.write(&std::cout);
@@ -119,9 +301,10 @@ class FIRInterpreter {
         }
     }
 
-    inline T check_real_aux(InstructionIT it, T val)
+    template <class IT>
+    inline T check_real_aux(IT it, T val)
     {
-        if (TRACE >= 2) {
+        if (kCheckLevel >= 2) {
             if (std::isnan(val)) {
                 fRealStats[FP_NAN]++;
             } else if (std::isinf(val)) {
@@ -129,20 +312,20 @@ class FIRInterpreter {
             }
         }
 
-        if (TRACE >= 1) {
+        if (kCheckLevel >= 1) {
             if (std::fpclassify(val) == FP_SUBNORMAL) {
                 fRealStats[FP_SUBNORMAL]++;
             }
         }
 
-        if (TRACE >= 4) {
+        if (kCheckLevel >= 4) {
             if (std::isnan(val)) {
                 std::cout << "-------- Interpreter 'Nan' trace start --------" << std::endl;
                 traceInstruction(it);
                 fTraceContext.write(&std::cout);
                 std::cout << "-------- Interpreter 'Nan' trace end --------\n\n";
                 // Fails at first error...
-                if (TRACE == 4) {
+                if (kCheckLevel == 4) {
                     throw faustexception("");
                 }
             } else if (std::isinf(val)) {
@@ -151,7 +334,7 @@ class FIRInterpreter {
                 fTraceContext.write(&std::cout);
                 std::cout << "-------- Interpreter 'Inf' trace end --------\n\n";
                 // Fails at first error...
-                if (TRACE == 4) {
+                if (kCheckLevel == 4) {
                     throw faustexception("");
                 }
             }
@@ -195,18 +378,68 @@ class FIRInterpreter {
 
     InterpreterTrace fTraceContext;
 
-    inline void traceInstruction(InstructionIT it)
+    template <class IT>
+    inline void traceInstruction(IT it)
     {
-        if (TRACE >= 4) {
+        if (kCheckLevel >= 4) {
             std::stringstream message;
             (*it)->write(&message);
             fTraceContext.push(message.str());
+        } else if (TRACE == 6) {
+            fProfile.push((*it)->fOpcode);
+        } else if (TRACE == 7) {
+            traceField(it);
+        }
+    }
+
+    template <class IT>
+    inline void traceField(IT it)
+    {
+        switch ((*it)->fOpcode) {
+            case FIRInstruction::kLoadReal:
+            case FIRInstruction::kStoreReal:
+            case FIRInstruction::kStoreRealValue:
+            case FIRInstruction::kLoadIndexedReal:
+            case FIRInstruction::kStoreIndexedReal:
+            case FIRInstruction::kBlockShiftReal:
+            case FIRInstruction::kBlockPairMoveReal:
+                fFieldProfile.pushReal((*it)->fOffset1);
+                break;
+            case FIRInstruction::kMoveReal:
+            case FIRInstruction::kPairMoveReal:
+                fFieldProfile.pushReal((*it)->fOffset2);
+                fFieldProfile.pushReal((*it)->fOffset1);
+                break;
+            case FIRInstruction::kLoadInt:
+            case FIRInstruction::kStoreInt:
+            case FIRInstruction::kStoreIntValue:
+            case FIRInstruction::kLoadIndexedInt:
+            case FIRInstruction::kStoreIndexedInt:
+            case FIRInstruction::kBlockShiftInt:
+            case FIRInstruction::kBlockPairMoveInt:
+                fFieldProfile.pushInt((*it)->fOffset1);
+                break;
+            case FIRInstruction::kMoveInt:
+            case FIRInstruction::kPairMoveInt:
+                fFieldProfile.pushInt((*it)->fOffset2);
+                fFieldProfile.pushInt((*it)->fOffset1);
+                break;
+            default:
+                break;
+        }
+    }
+
+    inline void traceBranch()
+    {
+        if (TRACE == 6) {
+            fProfile.reset();
         }
     }
 
-    inline int assert_audio_buffer(InstructionIT it, int index)
+    template <class IT>
+    inline int assert_audio_buffer(IT it, int index)
     {
-        if (TRACE >= 4 && ((index < 0) || (index >= fIntHeap[fFactory->fCountOffset]))) {
+        if (kCheckLevel >= 4 && ((index < 0) || (index >= fIntHeap[fFactory->fCountOffset]))) {
             std::cout << "-------- Interpreter crash trace start --------" << std::endl;
             std::cout << "assert_audio_buffer : count " << fIntHeap[fFactory->fCountOffset] << " index " << index
                       << std::endl;
@@ -218,9 +451,10 @@ class FIRInterpreter {
         }
     }
 
-    inline int assert_int_heap(InstructionIT it, int index, int size = -1)
+    template <class IT>
+    inline int assert_int_heap(IT it, int index, int size = -1)
     {
-        if (TRACE >= 4 && ((index < 0) || (index >= fFactory->fIntHeapSize) || (size > 0 && index >= size))) {
+        if (kCheckLevel >= 4 && ((index < 0) || (index >= fFactory->fIntHeapSize) || (size > 0 && index >= size))) {
             std::cout << "-------- Interpreter crash trace start --------" << std::endl;
             std::cout << "assert_int_heap : fIntHeapSize " << fFactory->fIntHeapSize << " index " << index << " size "
                       << size << std::endl;
@@ -232,9 +466,10 @@ class FIRInterpreter {
         }
     }
 
-    inline int assert_sound_heap(InstructionIT it, int index, int size = -1)
+    template <class IT>
+    inline int assert_sound_heap(IT it, int index, int size = -1)
     {
-        if (TRACE >= 4 && ((index < 0) || (index >= fFactory->fSoundHeapSize) || (size > 0 && index >= size))) {
+        if (kCheckLevel >= 4 && ((index < 0) || (index >= fFactory->fSoundHeapSize) || (size > 0 && index >= size))) {
             std::cout << "-------- Interpreter crash trace start --------" << std::endl;
             std::cout << "assert_sound_heap : fSoundHeapSize " << fFactory->fSoundHeapSize << " index " << index
                       << " size " << size << std::endl;
@@ -246,9 +481,10 @@ class FIRInterpreter {
         }
     }
 
-    inline int assert_real_heap(InstructionIT it, int index, int size = -1)
+    template <class IT>
+    inline int assert_real_heap(IT it, int index, int size = -1)
     {
-        if (TRACE >= 4 && ((index < 0) || (index >= fFactory->fRealHeapSize) || (size > 0 && index >= size))) {
+        if (kCheckLevel >= 4 && ((index < 0) || (index >= fFactory->fRealHeapSize) || (size > 0 && index >= size))) {
             std::cout << "-------- Interpreter crash trace start --------" << std::endl;
             std::cout << "assert_real_heap : fRealHeapSize " << fFactory->fRealHeapSize << " index " << index
                       << " size " << size << std::endl;
@@ -260,7 +496,8 @@ class FIRInterpreter {
         }
     }
 
-    inline T check_real(InstructionIT it, T val) { return (TRACE > 0) ? check_real_aux(it, val) : val; }
+    template <class IT>
+    inline T check_real(IT it, T val) { return (kCheckLevel > 0) ? check_real_aux(it, val) : val; }
 
 #define push_int(val) (int_stack[int_stack_index++] = val)
 #define pop_int() (int_stack[--int_stack_index])
@@ -350,7 +587,71 @@ class FIRInterpreter {
         }
     }
 
+    // Access to the instruction stream, in the tree form (InstructionIT) or in the flat form (FIRFlatIterator)
+    static inline void* getHandler(InstructionIT it, void** dispatch_table)
+    {
+        return dispatch_table[(*it)->fOpcode];
+    }
+    static inline void* getHandler(FIRFlatIterator<T> it, void** dispatch_table) { return (*it)->fHandler; }
+
+    static inline InstructionIT getBranch1(InstructionIT it) { return (*it)->fBranch1->fInstructions.begin(); }
+    static inline InstructionIT getBranch2(InstructionIT it) { return (*it)->fBranch2->fInstructions.begin(); }
+    static inline FIRFlatIterator<T> getBranch1(FIRFlatIterator<T> it) { return it + (*it)->fBranch1; }
+    static inline FIRFlatIterator<T> getBranch2(FIRFlatIterator<T> it) { return it + (*it)->fBranch2; }
+
+    static inline const T* getRealTable(InstructionIT it)
+    {
+        return static_cast<FIRBlockStoreRealInstruction<T>*>(*it)->fNumTable.data();
+    }
+    static inline const int* getIntTable(InstructionIT it)
+    {
+        return static_cast<FIRBlockStoreIntInstruction<T>*>(*it)->fNumTable.data();
+    }
+    static inline const T*   getRealTable(FIRFlatIterator<T> it) { return static_cast<const T*>((*it)->fNumTable); }
+    static inline const int* getIntTable(FIRFlatIterator<T> it) { return static_cast<const int*>((*it)->fNumTable); }
+
+    // The flat code is only used without trace, the tree form is kept for tracing
     inline void ExecuteBlock(FIRBlockInstruction<T>* block)
+    {
+        // Check block coherency
+        interp_assert(block->fInstructions.back()->fOpcode == FIRInstruction::kReturn);
+
+        ExecuteBlock(block, std::integral_constant<bool, TRACE == 0>());
+    }
+
+    inline void ExecuteBlock(FIRBlockInstruction<T>* block, std::true_type)
+    {
+        if (block->fFlatCode) {
+            ExecuteBlockAux(block->fFlatCode->begin());
+        } else {
+            ExecuteBlockAux(block->fInstructions.begin());
+        }
+    }
+
+    inline void ExecuteBlock(FIRBlockInstruction<T>* block, std::false_type)
+    {
+        ExecuteBlockAux(block->fInstructions.begin());
+    }
+
+    // Handlers addresses used to compile the flat code (NULL in trace mode)
+    void** getDispatchTable() { return getDispatchTable(std::integral_constant<bool, TRACE == 0>()); }
+
+    void** getDispatchTable(std::true_type)
+    {
+        void** dispatch_table = 0;
+        ExecuteBlockAux(FIRFlatIterator<T>(), &dispatch_table);
+        return dispatch_table;
+    }
+
+    void** getDispatchTable(std::false_type) { return 0; }
+
+    /*
+      Executes the instructions starting at 'start' until the final kReturn.
+      When 'dispatch_table' is given, nothing is executed and the handlers addresses
+      (indexed by opcode) are returned to compile the flat code.
+    */
+    template <class IT>
+    inline void ExecuteBlockAux(IT start, void*** dispatch_table = 0)
     {
         static void* fDispatchTable[] = {
 
@@ -447,49 +748,75 @@ class FIRInterpreter {
             &&do_kLoop, &&do_kReturn,
 
             // Select/if
-            &&do_kIf, &&do_kSelectReal, &&do_kSelectInt, &&do_kCondBranch
+            &&do_kIf, &&do_kSelectReal, &&do_kSelectInt, &&do_kCondBranch,
+
+            // Vector
+            &&do_kVectorSize, &&do_kRealValueVec, &&do_kLoadRealVec, &&do_kMoveRealVec, &&do_kLoadInputVec,
+            &&do_kStoreOutputVec, &&do_kCastRealVec,
+
+            // Vector standard math
+            &&do_kAddRealVec, &&do_kSubRealVec, &&do_kMultRealVec, &&do_kDivRealVec, &&do_kRemRealVec,
+
+            // Vector extended unary math
+            &&do_kAbsfVec, &&do_kAcosfVec, &&do_kAsinfVec, &&do_kAtanfVec, &&do_kCeilfVec, &&do_kCosfVec,
+            &&do_kCoshfVec, &&do_kExpfVec, &&do_kFloorfVec, &&do_kLogfVec, &&do_kLog10fVec, &&do_kRoundfVec,
+            &&do_kSinfVec, &&do_kSinhfVec, &&do_kSqrtfVec, &&do_kTanfVec, &&do_kTanhfVec,
+
+            // Vector extended binary math
+            &&do_kAtan2fVec, &&do_kFmodfVec, &&do_kPowfVec, &&do_kMaxfVec, &&do_kMinfVec,
+
+            // Superinstructions
+            &&do_kMultAddRealHeap, &&do_kAddMultRealStack, &&do_kAddStoreReal, &&do_kSubStoreReal,
+            &&do_kAddStoreRealStack, &&do_kSubStoreRealStack, &&do_kMultStoreRealStack
 
         };
 
+        if (dispatch_table) {
+            *dispatch_table = fDispatchTable;
+            return;
+        }
+
         int real_stack_index  = 0;
         int int_stack_index   = 0;
         int sound_stack_index = 0;
         int addr_stack_index  = 0;
+        int vec_size          = 0;  // Number of samples processed by the vector instructions
 
         T             real_stack[fRealStackSize];
         int           int_stack[fIntStackSize];
         Soundfile*    sound_stack[fSoundStackSize];
-        InstructionIT address_stack[64];
+        IT            address_stack[64];
 
-#define dispatch_first()                      \
-    {                                         \
-        goto* fDispatchTable[(*it)->fOpcode]; \
+#define dispatch_first()                          \
+    {                                             \
+        traceBranch();                            \
+        goto* getHandler(it, fDispatchTable);     \
     }
-#define dispatch_next()                       \
-    {                                         \
-        traceInstruction(it);                 \
-        it++;                                 \
-        goto* fDispatchTable[(*it)->fOpcode]; \
+#define dispatch_next()                           \
+    {                                             \
+        traceInstruction(it);                     \
+        it++;                                     \
+        goto* getHandler(it, fDispatchTable);     \
     }
 
-#define dispatch_branch1()                           \
-    {                                                \
-        it = (*it)->fBranch1->fInstructions.begin(); \
-        dispatch_first();                            \
+#define dispatch_branch1()    \
+    {                         \
+        it = getBranch1(it);  \
+        dispatch_first();     \
     }
-#define dispatch_branch2()                           \
-    {                                                \
-        it = (*it)->fBranch2->fInstructions.begin(); \
-        dispatch_first();                            \
+#define dispatch_branch2()    \
+    {                         \
+        it = getBranch2(it);  \
+        dispatch_first();     \
     }
 
-#define push_branch1()                                     \
-    {                                                      \
-        push_addr((*it)->fBranch1->fInstructions.begin()); \
+#define push_branch1()              \
+    {                               \
+        push_addr(getBranch1(it));  \
     }
-#define push_branch2()                                     \
-    {                                                      \
-        push_addr((*it)->fBranch2->fInstructions.begin()); \
+#define push_branch2()              \
+    {                               \
+        push_addr(getBranch2(it));  \
     }
 
 #define dispatch_return() \
@@ -503,13 +830,8 @@ class FIRInterpreter {
     }
 #define empty_return() (addr_stack_index == 0)
 
-        // Check block coherency
-        InstructionIT it1 = block->fInstructions.end();
-        it1--;
-        interp_assert((*it1)->fOpcode == FIRInstruction::kReturn);
-
         try {
-            InstructionIT it = block->fInstructions.begin();
+            IT it = start;
             dispatch_first();
 
             while (true) {
@@ -650,19 +972,17 @@ class FIRInterpreter {
             }
 
             do_kBlockStoreReal : {
-                FIRBlockStoreRealInstruction<T>* inst = static_cast<FIRBlockStoreRealInstruction<T>*>(*it);
-                interp_assert(inst);
-                for (int i = 0; i < inst->fOffset2; i++) {
-                    fRealHeap[inst->fOffset1 + i] = inst->fNumTable[i];
+                const T* num_table = getRealTable(it);
+                for (int i = 0; i < (*it)->fOffset2; i++) {
+                    fRealHeap[(*it)->fOffset1 + i] = num_table[i];
                 }
                 dispatch_next();
             }
 
             do_kBlockStoreInt : {
-                FIRBlockStoreIntInstruction<T>* inst = static_cast<FIRBlockStoreIntInstruction<T>*>(*it);
-                interp_assert(inst);
-                for (int i = 0; i < inst->fOffset2; i++) {
-                    fIntHeap[inst->fOffset1 + i] = inst->fNumTable[i];
+                const int* num_table = getIntTable(it);
+                for (int i = 0; i < (*it)->fOffset2; i++) {
+                    fIntHeap[(*it)->fOffset1 + i] = num_table[i];
                 }
                 dispatch_next();
             }
@@ -2254,6 +2574,372 @@ class FIRInterpreter {
                 interp_assert((*it)->fBranch1);
                 dispatch_branch1();
             }
+
+                //---------------------------------------------------------------
+                // Vector operations : 'vec_size' samples, result in 'fIntValue'
+                //---------------------------------------------------------------
+
+            do_kVectorSize : {
+                vec_size = fIntHeap[(*it)->fOffset1];
+                dispatch_next();
+            }
+
+            do_kRealValueVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T  v   = (*it)->fRealValue;
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = v;
+                }
+                dispatch_next();
+            }
+
+            do_kLoadRealVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T  v   = fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = v;
+                }
+                dispatch_next();
+            }
+
+            do_kMoveRealVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = v[i];
+                }
+                dispatch_next();
+            }
+
+            // Input/output buffers are accessed at the index kept in fOffset2
+            do_kLoadInputVec : {
+                T*       res = &fRealHeap[(*it)->fIntValue];
+                const T* in  = &fInputs[(*it)->fOffset1][fIntHeap[(*it)->fOffset2]];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = in[i];
+                }
+                dispatch_next();
+            }
+
+            do_kStoreOutputVec : {
+                T* out = &fOutputs[(*it)->fOffset1][fIntHeap[(*it)->fOffset2]];
+                T* v   = &fRealHeap[(*it)->fIntValue];
+                for (int i = 0; i < vec_size; i++) {
+                    out[i] = v[i];
+                }
+                dispatch_next();
+            }
+
+            // Int array (at fOffset1 in Int HEAP) to real
+            do_kCastRealVec : {
+                T*   res = &fRealHeap[(*it)->fIntValue];
+                int* v   = &fIntHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = T(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kAddRealVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v1  = &fRealHeap[(*it)->fOffset1];
+                T* v2  = &fRealHeap[(*it)->fOffset2];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = v1[i] + v2[i];
+                }
+                dispatch_next();
+            }
+
+            do_kSubRealVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v1  = &fRealHeap[(*it)->fOffset1];
+                T* v2  = &fRealHeap[(*it)->fOffset2];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = v1[i] - v2[i];
+                }
+                dispatch_next();
+            }
+
+            do_kMultRealVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v1  = &fRealHeap[(*it)->fOffset1];
+                T* v2  = &fRealHeap[(*it)->fOffset2];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = v1[i] * v2[i];
+                }
+                dispatch_next();
+            }
+
+            do_kDivRealVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v1  = &fRealHeap[(*it)->fOffset1];
+                T* v2  = &fRealHeap[(*it)->fOffset2];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = v1[i] / v2[i];
+                }
+                dispatch_next();
+            }
+
+            do_kRemRealVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v1  = &fRealHeap[(*it)->fOffset1];
+                T* v2  = &fRealHeap[(*it)->fOffset2];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::remainder(v1[i], v2[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kAbsfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::fabs(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kAcosfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::acos(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kAsinfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::asin(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kAtanfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::atan(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kCeilfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::ceil(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kCosfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::cos(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kCoshfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::cosh(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kExpfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::exp(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kFloorfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::floor(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kLogfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::log(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kLog10fVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::log10(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kRoundfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::round(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kSinfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::sin(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kSinhfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::sinh(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kSqrtfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::sqrt(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kTanfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::tan(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kTanhfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v   = &fRealHeap[(*it)->fOffset1];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::tanh(v[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kAtan2fVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v1  = &fRealHeap[(*it)->fOffset1];
+                T* v2  = &fRealHeap[(*it)->fOffset2];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::atan2(v1[i], v2[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kFmodfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v1  = &fRealHeap[(*it)->fOffset1];
+                T* v2  = &fRealHeap[(*it)->fOffset2];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::fmod(v1[i], v2[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kPowfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v1  = &fRealHeap[(*it)->fOffset1];
+                T* v2  = &fRealHeap[(*it)->fOffset2];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::pow(v1[i], v2[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kMaxfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v1  = &fRealHeap[(*it)->fOffset1];
+                T* v2  = &fRealHeap[(*it)->fOffset2];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::max(v1[i], v2[i]);
+                }
+                dispatch_next();
+            }
+
+            do_kMinfVec : {
+                T* res = &fRealHeap[(*it)->fIntValue];
+                T* v1  = &fRealHeap[(*it)->fOffset1];
+                T* v2  = &fRealHeap[(*it)->fOffset2];
+                for (int i = 0; i < vec_size; i++) {
+                    res[i] = std::min(v1[i], v2[i]);
+                }
+                dispatch_next();
+            }
+
+            // Superinstructions : fused sequences, same evaluation order and rounding as the original instructions
+            // (the product is rounded before the addition: the Interpreter sources are compiled with -ffp-contract=off)
+            do_kMultAddRealHeap : {
+                T v1 = pop_real(it);
+                T v2 = fRealHeap[(*it)->fOffset1] * fRealHeap[(*it)->fOffset2];
+                push_real(it, v2 + v1);
+                dispatch_next();
+            }
+
+            do_kAddMultRealStack : {
+                T v1 = pop_real(it);
+                T v2 = pop_real(it);
+                push_real(it, fRealHeap[(*it)->fOffset1] * (v1 + v2));
+                dispatch_next();
+            }
+
+            do_kAddStoreReal : {
+                T v1                       = pop_real(it);
+                T v2                       = pop_real(it);
+                fRealHeap[(*it)->fOffset1] = v1 + v2;
+                dispatch_next();
+            }
+
+            do_kSubStoreReal : {
+                T v1                       = pop_real(it);
+                T v2                       = pop_real(it);
+                fRealHeap[(*it)->fOffset1] = v1 - v2;
+                dispatch_next();
+            }
+
+            do_kAddStoreRealStack : {
+                T v1                       = pop_real(it);
+                fRealHeap[(*it)->fOffset1] = fRealHeap[(*it)->fOffset2] + v1;
+                dispatch_next();
+            }
+
+            do_kSubStoreRealStack : {
+                T v1                       = pop_real(it);
+                fRealHeap[(*it)->fOffset1] = fRealHeap[(*it)->fOffset2] - v1;
+                dispatch_next();
+            }
+
+            do_kMultStoreRealStack : {
+                T v1                       = pop_real(it);
+                fRealHeap[(*it)->fOffset1] = fRealHeap[(*it)->fOffset2] * v1;
+                dispatch_next();
+            }
             }
 
             // printf("END real_stack_index = %d, int_stack_index = %d\n", real_stack_index, int_stack_index);
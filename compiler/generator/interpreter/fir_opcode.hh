@@ -332,6 +332,57 @@ struct FIRInstruction {
         kSelectInt,
         kCondBranch,
 
+        // Vector (element-wise operations on 'count' samples, see kVectorSize)
+        kVectorSize,
+        kRealValueVec,
+        kLoadRealVec,
+        kMoveRealVec,
+        kLoadInputVec,
+        kStoreOutputVec,
+        kCastRealVec,
+
+        // Vector standard math (heap OP heap)
+        kAddRealVec,
+        kSubRealVec,
+        kMultRealVec,
+        kDivRealVec,
+        kRemRealVec,
+
+        // Vector extended unary math (heap OP)
+        kAbsfVec,
+        kAcosfVec,
+        kAsinfVec,
+        kAtanfVec,
+        kCeilfVec,
+        kCosfVec,
+        kCoshfVec,
+        kExpfVec,
+        kFloorfVec,
+        kLogfVec,
+        kLog10fVec,
+        kRoundfVec,
+        kSinfVec,
+        kSinhfVec,
+        kSqrtfVec,
+        kTanfVec,
+        kTanhfVec,
+
+        // Vector extended binary math (heap OP heap)
+        kAtan2fVec,
+        kFmodfVec,
+        kPowfVec,
+        kMaxfVec,
+        kMinfVec,
+
+        // Superinstructions (frequent sequences fused by FIRInstructionFusionOptimizer)
+        kMultAddRealHeap,
+        kAddMultRealStack,
+        kAddStoreReal,
+        kSubStoreReal,
+        kAddStoreRealStack,
+        kSubStoreRealStack,
+        kMultStoreRealStack,
+
         // User Interface
         kOpenVerticalBox,
         kOpenHorizontalBox,
@@ -466,6 +517,24 @@ static std::string gFIRInstructionTable[] = {
     // Select/if
     "kIf", "kSelectReal", "kSelectInt", "kCondBranch",
 
+    // Vector
+    "kVectorSize", "kRealValueVec", "kLoadRealVec", "kMoveRealVec", "kLoadInputVec", "kStoreOutputVec",
+    "kCastRealVec",
+
+    // Vector standard math (heap OP heap)
+    "kAddRealVec", "kSubRealVec", "kMultRealVec", "kDivRealVec", "kRemRealVec",
+
+    // Vector extended unary math (heap OP)
+    "kAbsfVec", "kAcosfVec", "kAsinfVec", "kAtanfVec", "kCeilfVec", "kCosfVec", "kCoshfVec", "kExpfVec", "kFloorfVec",
+    "kLogfVec", "kLog10fVec", "kRoundfVec", "kSinfVec", "kSinhfVec", "kSqrtfVec", "kTanfVec", "kTanhfVec",
+
+    // Vector extended binary math (heap OP heap)
+    "kAtan2fVec", "kFmodfVec", "kPowfVec", "kMaxfVec", "kMinfVec",
+
+    // Superinstructions
+    "kMultAddRealHeap", "kAddMultRealStack", "kAddStoreReal", "kSubStoreReal", "kAddStoreRealStack",
+    "kSubStoreRealStack", "kMultStoreRealStack",
+
     // User Interface
     "kOpenVerticalBox", "kOpenHorizontalBox", "kOpenTabBox", "kCloseBox", "kAddButton", "kAddChecButton",
     "kAddHorizontalSlider", "kAddVerticalSlider", "kAddNumEntry", "kAddSoundFile", "kAddHorizontalBargraph",
@@ -473,6 +542,6 @@ static std::string gFIRInstructionTable[] = {
 
     "kNop"};
 
-#define INTERP_FILE_VERSION 5
+#define INTERP_FILE_VERSION 8
 
 #endif
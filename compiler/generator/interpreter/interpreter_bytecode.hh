@@ -24,6 +24,7 @@
 
 #include <math.h>
 #include <iostream>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -45,6 +46,9 @@ static inline std::string unquote1(const std::string& str)
 template <class T>
 struct FIRBlockInstruction;
 
+template <class T>
+struct FIRFlatBlock;
+
 template <class T>
 struct FIRBasicInstruction : public FIRInstruction {
     Opcode fOpcode;
@@ -410,12 +414,24 @@ template <class T>
 struct FIRBlockInstruction : public FIRInstruction {
     std::vector<FIRBasicInstruction<T>*> fInstructions;
 
+    FIRFlatBlock<T>* fFlatCode;  // Direct threaded version of the block (when compiled)
+
+    FIRBlockInstruction() : fFlatCode(0) {}
+
     virtual ~FIRBlockInstruction()
     {
         InstructionIT it;
         for (it = fInstructions.begin(); it != fInstructions.end(); it++) {
             delete (*it);
         }
+        delete fFlatCode;
+    }
+
+    // Compile the block (and all its sub-blocks) in a contiguous direct threaded code
+    void compileFlatCode(void** dispatch_table)
+    {
+        delete fFlatCode;
+        fFlatCode = new FIRFlatBlock<T>(this, dispatch_table);
     }
 
     void push(FIRBasicInstruction<T>* inst) { fInstructions.push_back(inst); }
@@ -482,4 +498,123 @@ struct FIRBlockInstruction : public FIRInstruction {
     bool isRealInst() { return isRealType(fInstructions.back()->fOpcode); }
 };
 
+/*
+ Flat bytecode: the instructions of a block and of all its sub-blocks are stored in a single contiguous array,
+ each instruction keeps the address of its handler in the interpreter loop (direct threading), its operands inline,
+ and its branches as relative offsets (in instructions) from itself. So executing an instruction does not need
+ any dependent pointer load, compared to the tree form where each instruction is separately allocated.
+*/
+
+template <class T>
+struct FIRFlatInstruction {
+    void* fHandler;
+    int   fOffset1;
+    int   fOffset2;
+    int   fIntValue;
+    int   fBranch1;
+    int   fBranch2;
+    int   fOpcode;
+    union {
+        T           fRealValue;
+        const void* fNumTable;  // Values of kBlockStoreReal/kBlockStoreInt
+    };
+
+    void write(std::ostream* out)
+    {
+        *out << "opcode " << fOpcode << " " << gFIRInstructionTable[fOpcode] << " int " << fIntValue << " real "
+             << ((fOpcode == FIRInstruction::kBlockStoreReal || fOpcode == FIRInstruction::kBlockStoreInt)
+                     ? T(0)
+                     : fRealValue)
+             << " offset1 " << fOffset1 << " offset2 " << fOffset2 << " branch1 " << fBranch1 << " branch2 "
+             << fBranch2 << std::endl;
+    }
+};
+
+// Gives the same '(*it)->field' access than InstructionIT, so that the interpreter loop can run both forms
+template <class T>
+struct FIRFlatIterator {
+    FIRFlatInstruction<T>* fInst;
+
+    FIRFlatIterator(FIRFlatInstruction<T>* inst = 0) : fInst(inst) {}
+
+    FIRFlatInstruction<T>* operator*() const { return fInst; }
+    FIRFlatIterator<T>     operator+(int offset) const { return FIRFlatIterator<T>(fInst + offset); }
+    FIRFlatIterator<T>     operator++(int)
+    {
+        FIRFlatIterator<T> res = *this;
+        fInst++;
+        return res;
+    }
+};
+
+template <class T>
+struct FIRFlatBlock {
+    std::vector<FIRFlatInstruction<T> > fCode;
+
+    FIRFlatBlock(FIRBlockInstruction<T>* block, void** dispatch_table)
+    {
+        std::map<FIRBlockInstruction<T>*, int> starts;
+        compileBlock(block, dispatch_table, starts);
+    }
+
+    FIRFlatIterator<T> begin() { return FIRFlatIterator<T>(&fCode[0]); }
+
+    int size() { return int(fCode.size()); }
+
+    void write(std::ostream* out)
+    {
+        *out << "flat_block_size " << fCode.size() << std::endl;
+        for (size_t i = 0; i < fCode.size(); i++) {
+            *out << i << " : ";
+            fCode[i].write(out);
+        }
+    }
+
+   private:
+    // Returns the position of the block in the code, sub-blocks are appended after their parent block
+    int compileBlock(FIRBlockInstruction<T>* block, void** dispatch_table,
+                     std::map<FIRBlockInstruction<T>*, int>& starts)
+    {
+        typename std::map<FIRBlockInstruction<T>*, int>::iterator found = starts.find(block);
+        if (found != starts.end()) return found->second;
+
+        int start     = int(fCode.size());
+        starts[block] = start;
+
+        for (size_t i = 0; i < block->fInstructions.size(); i++) {
+            FIRBasicInstruction<T>* inst = block->fInstructions[i];
+            FIRFlatInstruction<T>   flat;
+            flat.fHandler  = dispatch_table[inst->fOpcode];
+            flat.fOffset1  = inst->fOffset1;
+            flat.fOffset2  = inst->fOffset2;
+            flat.fIntValue = inst->fIntValue;
+            flat.fBranch1  = 0;
+            flat.fBranch2  = 0;
+            flat.fOpcode   = inst->fOpcode;
+            if (inst->fOpcode == FIRInstruction::kBlockStoreReal) {
+                flat.fNumTable = static_cast<FIRBlockStoreRealInstruction<T>*>(inst)->fNumTable.data();
+            } else if (inst->fOpcode == FIRInstruction::kBlockStoreInt) {
+                flat.fNumTable = static_cast<FIRBlockStoreIntInstruction<T>*>(inst)->fNumTable.data();
+            } else {
+                flat.fRealValue = inst->fRealValue;
+            }
+            fCode.push_back(flat);
+        }
+
+        // Branches (the kCondBranch one goes back to the beginning of its own block, already compiled)
+        for (size_t i = 0; i < block->fInstructions.size(); i++) {
+            FIRBasicInstruction<T>* inst = block->fInstructions[i];
+            int                     pos  = start + int(i);
+            if (inst->fBranch1) {
+                fCode[pos].fBranch1 = compileBlock(inst->fBranch1, dispatch_table, starts) - pos;
+            }
+            if (inst->fBranch2) {
+                fCode[pos].fBranch2 = compileBlock(inst->fBranch2, dispatch_table, starts) - pos;
+            }
+        }
+
+        return start;
+    }
+};
+
 #endif
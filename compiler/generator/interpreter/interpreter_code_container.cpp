@@ -43,13 +43,15 @@ Interpreter backend description:
 'instanceInit' of the main container
  - 'clone' method is implemented in the 'interpreter_dsp' wrapping code
  - soundfile: Sounfile* pointers are put in speical Sound heap
+ - vector mode (-vec): loops of the DAG are compiled with vector instructions (each one processing 'count' samples)
+ when they only contain element-wise real computations, the other ones are compiled in scalar mode
 
  TODO: in -mem mode, classInit and classDestroy will have to be called once at factory init and destroy time (after
 global memory allocation is implemented)
 */
 
 template <class T>
-map<string, FIRInstruction::Opcode> InterpreterInstVisitor<T>::gMathLibTable;
+thread_local map<string, FIRInstruction::Opcode> InterpreterInstVisitor<T>::gMathLibTable;
 
 template <class T>
 static FIRBlockInstruction<T>* getCurrentBlock()
@@ -111,7 +113,7 @@ CodeContainer* InterpreterCodeContainer<T>::createContainer(const string& name,
     } else if (gGlobal->gSchedulerSwitch) {
         throw faustexception("ERROR : Scheduler mode not supported for Interpreter\n");
     } else if (gGlobal->gVectorSwitch) {
-        throw faustexception("ERROR : Vector mode not supported for Interpreter\n");
+        container = new InterpreterVectorCodeContainer<T>(name, numInputs, numOutputs);
     } else {
         container = new InterpreterScalarCodeContainer<T>(name, numInputs, numOutputs, kInt);
     }
@@ -133,6 +135,20 @@ InterpreterScalarCodeContainer<T>::~InterpreterScalarCodeContainer()
 {
 }
 
+// Vector
+template <class T>
+InterpreterVectorCodeContainer<T>::InterpreterVectorCodeContainer(const string& name, int numInputs, int numOutputs)
+    : VectorCodeContainer(numInputs, numOutputs), InterpreterCodeContainer<T>(name, numInputs, numOutputs)
+{
+    // Loops are compiled with vector instructions when possible
+    getInterpreterVisitor<T>()->fVecSize = gGlobal->gVecSize;
+}
+
+template <class T>
+InterpreterVectorCodeContainer<T>::~InterpreterVectorCodeContainer()
+{
+}
+
 template <class T>
 void InterpreterCodeContainer<T>::produceInternal()
 {
@@ -161,6 +177,9 @@ dsp_factory_base* InterpreterCodeContainer<T>::produceFactory()
     // After field declaration...
     generateSubContainers();
 
+    // Keep "count" offset (in vector mode, a local "count" variable is declared in the compute loops)
+    int count_offset = getInterpreterVisitor<T>()->getFieldOffset("count");
+
     // Rename 'sig' in 'dsp', remove 'dsp' allocation, inline subcontainers 'instanceInit' and 'fill' function call
     inlineSubcontainersFunCalls(fStaticInitInstructions)->accept(gGlobal->gInterpreterVisitor);
     // Keep "init_static_block"
@@ -193,10 +212,8 @@ dsp_factory_base* InterpreterCodeContainer<T>::produceFactory()
     FIRBlockInstruction<T>* compute_control_block = getCurrentBlock<T>();
     setCurrentBlock<T>(new FIRBlockInstruction<T>);
 
-    // Generate one single scalar loop
-    ForLoopInst* loop = fCurLoop->generateScalarLoop(fFullCount);
-
-    loop->accept(gGlobal->gInterpreterVisitor);
+    // Generate the DSP loop(s)
+    generateComputeLoop()->accept(gGlobal->gInterpreterVisitor);
     FIRBlockInstruction<T>* compute_dsp_block = getCurrentBlock<T>();
 
     // Generate metadata block and name
@@ -213,45 +230,70 @@ dsp_factory_base* InterpreterCodeContainer<T>::produceFactory()
             name, "", INTERP_FILE_VERSION, fNumInputs,
             fNumOutputs, getInterpreterVisitor<T>()->fIntHeapOffset, getInterpreterVisitor<T>()->fRealHeapOffset,
             getInterpreterVisitor<T>()->fSoundHeapOffset, getInterpreterVisitor<T>()->getFieldOffset("fSamplingFreq"),
-            getInterpreterVisitor<T>()->getFieldOffset("count"), getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
+            count_offset, getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
             INTER_MAX_OPT_LEVEL, metadata_block, getInterpreterVisitor<T>()->fUserInterfaceBlock, init_static_block,
-            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block);
+            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block,
+            getInterpreterVisitor<T>()->fStateLayout.str());
 
         case 2:
         return new interpreter_dsp_factory_aux<T, 2>(
             name, "", INTERP_FILE_VERSION, fNumInputs,
             fNumOutputs, getInterpreterVisitor<T>()->fIntHeapOffset, getInterpreterVisitor<T>()->fRealHeapOffset,
             getInterpreterVisitor<T>()->fSoundHeapOffset, getInterpreterVisitor<T>()->getFieldOffset("fSamplingFreq"),
-            getInterpreterVisitor<T>()->getFieldOffset("count"), getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
+            count_offset, getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
             INTER_MAX_OPT_LEVEL, metadata_block, getInterpreterVisitor<T>()->fUserInterfaceBlock, init_static_block,
-            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block);
+            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block,
+            getInterpreterVisitor<T>()->fStateLayout.str());
 
         case 3:
         return new interpreter_dsp_factory_aux<T, 3>(
             name, "", INTERP_FILE_VERSION, fNumInputs,
             fNumOutputs, getInterpreterVisitor<T>()->fIntHeapOffset, getInterpreterVisitor<T>()->fRealHeapOffset,
             getInterpreterVisitor<T>()->fSoundHeapOffset, getInterpreterVisitor<T>()->getFieldOffset("fSamplingFreq"),
-            getInterpreterVisitor<T>()->getFieldOffset("count"), getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
+            count_offset, getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
             INTER_MAX_OPT_LEVEL, metadata_block, getInterpreterVisitor<T>()->fUserInterfaceBlock, init_static_block,
-            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block);
+            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block,
+            getInterpreterVisitor<T>()->fStateLayout.str());
 
         case 4:
         return new interpreter_dsp_factory_aux<T, 4>(
             name, "", INTERP_FILE_VERSION, fNumInputs,
             fNumOutputs, getInterpreterVisitor<T>()->fIntHeapOffset, getInterpreterVisitor<T>()->fRealHeapOffset,
             getInterpreterVisitor<T>()->fSoundHeapOffset, getInterpreterVisitor<T>()->getFieldOffset("fSamplingFreq"),
-            getInterpreterVisitor<T>()->getFieldOffset("count"), getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
+            count_offset, getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
             INTER_MAX_OPT_LEVEL, metadata_block, getInterpreterVisitor<T>()->fUserInterfaceBlock, init_static_block,
-            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block);
+            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block,
+            getInterpreterVisitor<T>()->fStateLayout.str());
 
         case 5:
         return new interpreter_dsp_factory_aux<T, 5>(
             name, "", INTERP_FILE_VERSION, fNumInputs,
             fNumOutputs, getInterpreterVisitor<T>()->fIntHeapOffset, getInterpreterVisitor<T>()->fRealHeapOffset,
             getInterpreterVisitor<T>()->fSoundHeapOffset, getInterpreterVisitor<T>()->getFieldOffset("fSamplingFreq"),
-            getInterpreterVisitor<T>()->getFieldOffset("count"), getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
+            count_offset, getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
+            INTER_MAX_OPT_LEVEL, metadata_block, getInterpreterVisitor<T>()->fUserInterfaceBlock, init_static_block,
+            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block,
+            getInterpreterVisitor<T>()->fStateLayout.str());
+
+        case 6:
+        return new interpreter_dsp_factory_aux<T, 6>(
+            name, "", INTERP_FILE_VERSION, fNumInputs,
+            fNumOutputs, getInterpreterVisitor<T>()->fIntHeapOffset, getInterpreterVisitor<T>()->fRealHeapOffset,
+            getInterpreterVisitor<T>()->fSoundHeapOffset, getInterpreterVisitor<T>()->getFieldOffset("fSamplingFreq"),
+            count_offset, getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
+            INTER_MAX_OPT_LEVEL, metadata_block, getInterpreterVisitor<T>()->fUserInterfaceBlock, init_static_block,
+            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block,
+            getInterpreterVisitor<T>()->fStateLayout.str());
+
+        case 7:
+        return new interpreter_dsp_factory_aux<T, 7>(
+            name, "", INTERP_FILE_VERSION, fNumInputs,
+            fNumOutputs, getInterpreterVisitor<T>()->fIntHeapOffset, getInterpreterVisitor<T>()->fRealHeapOffset,
+            getInterpreterVisitor<T>()->fSoundHeapOffset, getInterpreterVisitor<T>()->getFieldOffset("fSamplingFreq"),
+            count_offset, getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
             INTER_MAX_OPT_LEVEL, metadata_block, getInterpreterVisitor<T>()->fUserInterfaceBlock, init_static_block,
-            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block);
+            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block,
+            getInterpreterVisitor<T>()->fStateLayout.str());
 
         default:
         // Default case, no trace...
@@ -259,9 +301,10 @@ dsp_factory_base* InterpreterCodeContainer<T>::produceFactory()
             name, "", INTERP_FILE_VERSION, fNumInputs,
             fNumOutputs, getInterpreterVisitor<T>()->fIntHeapOffset, getInterpreterVisitor<T>()->fRealHeapOffset,
             getInterpreterVisitor<T>()->fSoundHeapOffset, getInterpreterVisitor<T>()->getFieldOffset("fSamplingFreq"),
-            getInterpreterVisitor<T>()->getFieldOffset("count"), getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
+            count_offset, getInterpreterVisitor<T>()->getFieldOffset("IOTA"),
             INTER_MAX_OPT_LEVEL, metadata_block, getInterpreterVisitor<T>()->fUserInterfaceBlock, init_static_block,
-            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block);
+            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block,
+            getInterpreterVisitor<T>()->fStateLayout.str());
     }
 }
 
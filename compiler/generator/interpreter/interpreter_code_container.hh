@@ -27,6 +27,7 @@
 #include "instructions_compiler.hh"
 #include "interpreter_dsp_aux.hh"
 #include "interpreter_instructions.hh"
+#include "vec_code_container.hh"
 
 using namespace std;
 
@@ -37,6 +38,9 @@ class InterpreterCodeContainer : public virtual CodeContainer {
 
     FIRMetaBlockInstruction* produceMetadata(string& name);
 
+    // Generates the DSP loop of 'compute' : one single scalar loop by default
+    virtual StatementInst* generateComputeLoop() { return fCurLoop->generateScalarLoop(fFullCount); }
+
     virtual void generateSR()
     {
         if (!fGeneratedSR) {
@@ -67,6 +71,16 @@ class InterpreterScalarCodeContainer : public InterpreterCodeContainer<T> {
     void generateCompute(int tab);
 };
 
+template <class T>
+class InterpreterVectorCodeContainer : public VectorCodeContainer, public InterpreterCodeContainer<T> {
+   protected:
+    virtual StatementInst* generateComputeLoop() { return fDAGBlock; }
+
+   public:
+    InterpreterVectorCodeContainer(const string& name, int numInputs, int numOutputs);
+    virtual ~InterpreterVectorCodeContainer();
+};
+
 class InterpreterInstructionsCompiler : public virtual InstructionsCompiler {
    public:
     InterpreterInstructionsCompiler(CodeContainer* container) : InstructionsCompiler(container) {}
@@ -20,6 +20,7 @@
  ************************************************************************/
 
 #include "interpreter_dsp_aux.hh"
+#include "TMutex.h"
 #include "Text.hh"
 #include "compatibility.hh"
 #include "dsp_aux.hh"
@@ -30,10 +31,16 @@ using namespace std;
 typedef class faust_smartptr<interpreter_dsp_factory> SDsp_factory;
 static dsp_factory_table<SDsp_factory>                gInterpreterFactoryTable;
 
+// Compilation is reentrant, only the accesses to the factory table are serialized
+static TLockAble gInterpreterFactoriesLock;
+
+static interpreter_dsp_factory* readInterpreterDSPFactoryFromMachineAux(std::istream* in);
+
 // External API
 
 EXPORT interpreter_dsp_factory* getInterpreterDSPFactoryFromSHAKey(const string& sha_key)
 {
+    TLock lock(&gInterpreterFactoriesLock);
     return static_cast<interpreter_dsp_factory*>(gInterpreterFactoryTable.getDSPFactoryFromSHAKey(sha_key));
 }
 
@@ -78,29 +85,56 @@ EXPORT interpreter_dsp_factory* createInterpreterDSPFactoryFromString(const stri
 
         interpreter_dsp_factory* factory = 0;
 
-        if (gInterpreterFactoryTable.getFactory(sha_key, it)) {
-            SDsp_factory sfactory = (*it).first;
-            sfactory->addReference();
-            return sfactory;
-        } else {
-            dsp_factory_base* dsp_factory_aux =
-                compileFaustFactory(argc1, argv1, name_app.c_str(), dsp_content.c_str(), error_msg, true);
-            if (dsp_factory_aux) {
+        {
+            TLock lock(&gInterpreterFactoriesLock);
+            if (gInterpreterFactoryTable.getFactory(sha_key, it)) {
+                SDsp_factory sfactory = (*it).first;
+                sfactory->addReference();
+                return sfactory;
+            }
+        }
+
+        // Bytecode kept in the persistent cache (not in trace mode, which compiles specialized factories)
+        bool   use_cache = dsp_factory_cache::isEnabled() && !getenv("FAUST_INTERP_TRACE");
+        string cache_key = generateSHA1(sha_key + " interp " + FAUSTVERSION + " " + std::to_string(INTERP_FILE_VERSION));
+        string machine_code;
+        if (use_cache && dsp_factory_cache::read(cache_key, machine_code)) {
+            stringstream reader(machine_code);
+            if ((factory = readInterpreterDSPFactoryFromMachineAux(&reader))) {
+                TLock lock(&gInterpreterFactoriesLock);
+                factory->setSHAKey(sha_key);
+                factory->setDSPCode(expanded_dsp_content);
+                return factory;
+            }
+            dsp_factory_cache::invalidate(cache_key);
+        }
+
+        // Compiled outside of the lock, so that several factories can be compiled concurrently
+        dsp_factory_base* dsp_factory_aux =
+            compileFaustFactory(argc1, argv1, name_app.c_str(), dsp_content.c_str(), error_msg, true);
+        if (dsp_factory_aux) {
+            {
+                TLock lock(&gInterpreterFactoriesLock);
                 dsp_factory_aux->setName(name_app);
                 factory = new interpreter_dsp_factory(dsp_factory_aux);
-                gInterpreterFactoryTable.setFactory(factory);
                 factory->setSHAKey(sha_key);
                 factory->setDSPCode(expanded_dsp_content);
-                return factory;
-            } else {
-                return nullptr;
+                // Written before the factory is visible to other threads, since the bytecode is optimized in place by
+                // the first instance
+                if (use_cache) machine_code = writeInterpreterDSPFactoryToMachine(factory);
+                gInterpreterFactoryTable.setFactory(factory);
             }
+            if (use_cache) dsp_factory_cache::write(cache_key, machine_code);
+            return factory;
+        } else {
+            return nullptr;
         }
     }
 }
 
 EXPORT bool deleteInterpreterDSPFactory(interpreter_dsp_factory* factory)
 {
+    TLock lock(&gInterpreterFactoriesLock);
     return (factory) ? gInterpreterFactoryTable.deleteDSPFactory(factory) : false;
 }
 
@@ -113,17 +147,22 @@ EXPORT vector<string> getInterpreterDSPFactoryLibraryList(interpreter_dsp_factor
 
 EXPORT vector<string> getAllInterpreterDSPFactories()
 {
+    TLock lock(&gInterpreterFactoriesLock);
     return gInterpreterFactoryTable.getAllDSPFactories();
 }
 
 EXPORT void deleteAllInterpreterDSPFactories()
 {
+    TLock lock(&gInterpreterFactoriesLock);
     gInterpreterFactoryTable.deleteAllDSPFactories();
 }
 
 EXPORT interpreter_dsp::~interpreter_dsp()
 {
-    gInterpreterFactoryTable.removeDSP(fFactory, this);
+    {
+        TLock lock(&gInterpreterFactoriesLock);
+        gInterpreterFactoryTable.removeDSP(fFactory, this);
+    }
 
     if (fFactory->getMemoryManager()) {
         fDSP->~interpreter_dsp_base();
@@ -135,7 +174,8 @@ EXPORT interpreter_dsp::~interpreter_dsp()
 
 EXPORT interpreter_dsp* interpreter_dsp_factory::createDSPInstance()
 {
-    dsp* dsp = fFactory->createDSPInstance(this);
+    dsp*  dsp = fFactory->createDSPInstance(this);
+    TLock lock(&gInterpreterFactoriesLock);
     gInterpreterFactoryTable.addDSP(this, dsp);
     return static_cast<interpreter_dsp*>(dsp);
 }
@@ -180,6 +220,7 @@ static interpreter_dsp_factory* readInterpreterDSPFactoryFromMachineAux(std::ist
             faustassert(false);
         }
 
+        TLock lock(&gInterpreterFactoriesLock);
         gInterpreterFactoryTable.setFactory(factory);
         return factory;
     } catch (faustexception& e) {
@@ -287,3 +328,8 @@ EXPORT void interpreter_dsp::compute(int count, FAUSTFLOAT** input, FAUSTFLOAT**
 {
     fDSP->compute(count, input, output);
 }
+
+EXPORT dsp_state_layout interpreter_dsp::getStateLayout()
+{
+    return fDSP->getStateLayout();
+}
@@ -31,6 +31,7 @@
 #include <string>
 
 #include "faust/dsp/dsp.h"
+#include "faust/dsp/dsp-state.h"
 #include "faust/gui/CGlue.h"
 #include "faust/gui/meta.h"
 
@@ -70,6 +71,8 @@ struct interpreter_dsp_factory_aux : public dsp_factory_imp {
     FIRBlockInstruction<T>*              fComputeBlock;
     FIRBlockInstruction<T>*              fComputeDSPBlock;
 
+    std::string fStateLayout;  // DSP structure fields, as 'name type size offset' lines (see dsp-state.h)
+
     interpreter_dsp_factory_aux(const std::string& name, const std::string& sha_key,
                                 int version_num, int inputs,
                                 int outputs, int int_heap_size, int real_heap_size, int sound_heap_size, int sr_offset,
@@ -77,7 +80,7 @@ struct interpreter_dsp_factory_aux : public dsp_factory_imp {
                                 FIRUserInterfaceBlockInstruction<T>* firinterface, FIRBlockInstruction<T>* static_init,
                                 FIRBlockInstruction<T>* init, FIRBlockInstruction<T>* resetui,
                                 FIRBlockInstruction<T>* clear, FIRBlockInstruction<T>* compute_control,
-                                FIRBlockInstruction<T>* compute_dsp)
+                                FIRBlockInstruction<T>* compute_dsp, const std::string& state_layout)
         : dsp_factory_imp(name, sha_key, ""),
           fVersion(version_num),
           fNumInputs(inputs),
@@ -97,7 +100,8 @@ struct interpreter_dsp_factory_aux : public dsp_factory_imp {
           fResetUIBlock(resetui),
           fClearBlock(clear),
           fComputeBlock(compute_control),
-          fComputeDSPBlock(compute_dsp)
+          fComputeDSPBlock(compute_dsp),
+          fStateLayout(state_layout)
     {
     }
 
@@ -114,18 +118,29 @@ struct interpreter_dsp_factory_aux : public dsp_factory_imp {
         delete fComputeDSPBlock;
     }
 
-    void optimize()
+    void optimize(void** dispatch_table)
     {
         if (!fOptimized) {
             fOptimized = true;
-            // Bytecode optimization
-            if (TRACE == 0) {
-                fStaticInitBlock = FIRInstructionOptimizer<T>::optimizeBlock(fStaticInitBlock, 1, fOptLevel);
-                fInitBlock       = FIRInstructionOptimizer<T>::optimizeBlock(fInitBlock, 1, fOptLevel);
-                fResetUIBlock    = FIRInstructionOptimizer<T>::optimizeBlock(fResetUIBlock, 1, fOptLevel);
-                fClearBlock      = FIRInstructionOptimizer<T>::optimizeBlock(fClearBlock, 1, fOptLevel);
-                fComputeBlock    = FIRInstructionOptimizer<T>::optimizeBlock(fComputeBlock, 1, fOptLevel);
-                fComputeDSPBlock = FIRInstructionOptimizer<T>::optimizeBlock(fComputeDSPBlock, 1, fOptLevel);
+            // Bytecode optimization (in profile mode, without the superinstructions to count their sequences)
+            // The field profile mode (7) runs the code as compiled, so that the fields are accessed by the basic opcodes
+            if (TRACE == 0 || TRACE == 6) {
+                int opt_level    = (TRACE == 0) ? fOptLevel : std::min(fOptLevel, INTER_FUSION_OPT_LEVEL - 1);
+                fStaticInitBlock = FIRInstructionOptimizer<T>::optimizeBlock(fStaticInitBlock, 1, opt_level);
+                fInitBlock       = FIRInstructionOptimizer<T>::optimizeBlock(fInitBlock, 1, opt_level);
+                fResetUIBlock    = FIRInstructionOptimizer<T>::optimizeBlock(fResetUIBlock, 1, opt_level);
+                fClearBlock      = FIRInstructionOptimizer<T>::optimizeBlock(fClearBlock, 1, opt_level);
+                fComputeBlock    = FIRInstructionOptimizer<T>::optimizeBlock(fComputeBlock, 1, opt_level);
+                fComputeDSPBlock = FIRInstructionOptimizer<T>::optimizeBlock(fComputeDSPBlock, 1, opt_level);
+            }
+            // Direct threaded code (not in trace mode, or when FAUST_INTERP_TREE is set to compare with the tree form)
+            if (dispatch_table && !getenv("FAUST_INTERP_TREE")) {
+                fStaticInitBlock->compileFlatCode(dispatch_table);
+                fInitBlock->compileFlatCode(dispatch_table);
+                fResetUIBlock->compileFlatCode(dispatch_table);
+                fClearBlock->compileFlatCode(dispatch_table);
+                fComputeBlock->compileFlatCode(dispatch_table);
+                fComputeDSPBlock->compileFlatCode(dispatch_table);
             }
         }
     }
@@ -170,6 +185,8 @@ struct interpreter_dsp_factory_aux : public dsp_factory_imp {
 
             *out << "d" << std::endl;
             fComputeDSPBlock->write(out, small);
+
+            writeStateLayout(out, "t");
         } else {
             *out << "interpreter_dsp_factory " << ((sizeof(T) == 8) ? "double" : "float") << std::endl;
             *out << "version " << FAUSTVERSION << std::endl;
@@ -207,7 +224,37 @@ struct interpreter_dsp_factory_aux : public dsp_factory_imp {
 
             *out << "dsp_block" << std::endl;
             fComputeDSPBlock->write(out, small);
+
+            writeStateLayout(out, "state_layout");
+        }
+    }
+
+    void writeStateLayout(std::ostream* out, const std::string& header)
+    {
+        int          size = 0;
+        std::string  line;
+        std::stringstream reader(fStateLayout);
+        while (getline(reader, line)) size++;
+        *out << header << " " << size << std::endl;
+        *out << fStateLayout;
+    }
+
+    static std::string readStateLayout(std::istream* in)
+    {
+        std::string dummy, line, layout;
+        int         size = 0;
+
+        // Read "state_layout" line
+        getline(*in, line);
+        std::stringstream line_reader(line);
+        line_reader >> dummy;  // Read "state_layout" token
+        line_reader >> size;
+
+        for (int i = 0; i < size; i++) {
+            getline(*in, line);
+            layout += line + "\n";
         }
+        return layout;
     }
 
     // Factory reader
@@ -329,10 +376,13 @@ struct interpreter_dsp_factory_aux : public dsp_factory_imp {
         getline(*in, dummy);  // Read "dsp_block" line
         FIRBlockInstruction<T>* compute_dsp_block = readCodeBlock(in);
 
+        // Read state layout
+        std::string state_layout = readStateLayout(in);
+
         return new interpreter_dsp_factory_aux(
             factory_name, sha_key, file_num, inputs, outputs, int_heap_size, real_heap_size,
             sound_heap_size, sr_offset, count_offset, iota_offset, opt_level, meta_block, ui_block, static_init_block,
-            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block);
+            init_block, resetui_block, clear_block, compute_control_block, compute_dsp_block, state_layout);
     }
 
     static std::string parseStringToken(std::stringstream* inst)
@@ -589,6 +639,8 @@ struct interpreter_dsp_base : public dsp {
     // Replaced by this one
     virtual void buildUserInterface(UITemplate* glue) = 0;
 
+    virtual dsp_state_layout getStateLayout() = 0;
+
     virtual void instanceInit(int samplingRate) {}
 
     virtual void instanceConstants(int samplingRate) {}
@@ -631,7 +683,7 @@ class interpreter_dsp_aux : public interpreter_dsp_base, public FIRInterpreter<T
         }
 
         // Comment to allow specialization...
-        this->fFactory->optimize();
+        this->fFactory->optimize(this->getDispatchTable());
 
         /*
         fFactory->fStaticInitBlock->write(&std::cout, false);
@@ -786,6 +838,12 @@ class interpreter_dsp_aux : public interpreter_dsp_base, public FIRInterpreter<T
     }
     */
 
+    virtual dsp_state_layout getStateLayout()
+    {
+        return parseDSPStateLayout(this->fFactory->fStateLayout, reinterpret_cast<char*>(this->fIntHeap),
+                                   reinterpret_cast<char*>(this->fRealHeap));
+    }
+
     virtual void buildUserInterface(UITemplate* glue)
     {
         // std::cout << "buildUserInterface" << std::endl;
@@ -991,6 +1049,20 @@ class EXPORT interpreter_dsp : public dsp {
         : fFactory(factory), fDSP(dsp)
     {
     }
+    interpreter_dsp(interpreter_dsp_factory* factory, interpreter_dsp_aux<float, 6>* dsp) : fFactory(factory), fDSP(dsp)
+    {
+    }
+    interpreter_dsp(interpreter_dsp_factory* factory, interpreter_dsp_aux<double, 6>* dsp)
+        : fFactory(factory), fDSP(dsp)
+    {
+    }
+    interpreter_dsp(interpreter_dsp_factory* factory, interpreter_dsp_aux<float, 7>* dsp) : fFactory(factory), fDSP(dsp)
+    {
+    }
+    interpreter_dsp(interpreter_dsp_factory* factory, interpreter_dsp_aux<double, 7>* dsp)
+        : fFactory(factory), fDSP(dsp)
+    {
+    }
 
     virtual ~interpreter_dsp();
 
@@ -1019,6 +1091,8 @@ class EXPORT interpreter_dsp : public dsp {
     void metadata(Meta* meta);
 
     void compute(int count, FAUSTFLOAT** inputs, FAUSTFLOAT** outputs);
+
+    dsp_state_layout getStateLayout();
 };
 
 class EXPORT interpreter_dsp_factory : public dsp_factory, public faust_smartable {
@@ -23,8 +23,10 @@
 #define _INTERPRETER_INSTRUCTIONS_H
 
 #include <cstdlib>
+#include <sstream>
 
 #include "exception.hh"
+#include "faust/dsp/dsp-state.h"
 #include "fir_interpreter.hh"
 #include "instructions.hh"
 #include "struct_manager.hh"
@@ -40,7 +42,7 @@ struct InterpreterInstVisitor : public DispatchVisitor {
      Global functions names table as a static variable in the visitor
      so that each function prototype is generated as most once in the module.
     */
-    static map<string, FIRInstruction::Opcode> gMathLibTable;
+    static thread_local map<string, FIRInstruction::Opcode> gMathLibTable;
 
     int  fRealHeapOffset;   // Offset in Real HEAP
     int  fIntHeapOffset;    // Offset in Integer HEAP
@@ -48,6 +50,14 @@ struct InterpreterInstVisitor : public DispatchVisitor {
     bool fCommute;          // Whether to try commutative operation reverse order generation
 
     map<string, MemoryDesc> fFieldTable;  // Table : field_name, { offset, size, type }
+    stringstream            fStateLayout; // DSP structure fields, as 'name type size offset' lines (see dsp-state.h)
+
+    // Vector mode
+    int              fVecSize;      // Size of vectorized loops (0 in scalar mode, no vector instruction generated)
+    map<string, int> fInputTable;   // Table : 'fInputN' name, input number (the field keeps the buffer index)
+    map<string, int> fOutputTable;  // Table : 'fOutputN' name, output number (the field keeps the buffer index)
+    map<string, int> fAliasTable;   // Table : array pointer name, index in the array it points to
+    vector<int>      fVecTemps;     // Offsets of the temporary vectors (one by expression depth) in Real HEAP
 
     FIRUserInterfaceBlockInstruction<T>* fUserInterfaceBlock;
     FIRBlockInstruction<T>*              fCurrentBlock;
@@ -60,6 +70,7 @@ struct InterpreterInstVisitor : public DispatchVisitor {
         fIntHeapOffset      = 0;
         fSoundHeapOffset    = 0;
         fCommute            = true;
+        fVecSize            = 0;
         initMathTable();
     }
 
@@ -76,6 +87,7 @@ struct InterpreterInstVisitor : public DispatchVisitor {
         gMathLibTable["abs"]   = FIRInstruction::kAbs;
         gMathLibTable["min_i"] = FIRInstruction::kMin;
         gMathLibTable["max_i"] = FIRInstruction::kMax;
+        gMathLibTable["min"]   = FIRInstruction::kMin;  // Used in vector mode loop variant 1
 
         // Float version
         gMathLibTable["fabsf"]      = FIRInstruction::kAbsf;
@@ -243,6 +255,30 @@ struct InterpreterInstVisitor : public DispatchVisitor {
             return;
         }
 
+        string name = inst->fAddress->getName();
+        string num;
+
+        // Vector mode : 'fInputN_ptr/fOutputN_ptr' are the 'inputs/outputs' buffers (accessed with kLoadInput and
+        // kStoreOutput), and 'fInputN/fOutputN' pointers are only kept as an index in those buffers
+        if (endWith(name, "_ptr")) {
+            return;
+        } else if (startWithRes(name, "fInput", num) || startWithRes(name, "fOutput", num)) {
+            if (startWith(name, "fInput")) {
+                fInputTable[name] = std::atoi(num.c_str());
+            } else {
+                fOutputTable[name] = std::atoi(num.c_str());
+            }
+            fFieldTable[name] = MemoryDesc(fIntHeapOffset, 1, Typed::kInt32);
+            fIntHeapOffset++;
+            return;
+        }
+
+        // Vector mode : 'fRec0 = &fRec0_tmp[k]' pointer
+        if (dynamic_cast<LoadVarAddressInst*>(inst->fValue)) {
+            visitStore(inst->fAddress, inst->fValue);
+            return;
+        }
+
         ArrayTyped* array_typed = dynamic_cast<ArrayTyped*>(inst->fType);
 
         if (array_typed && array_typed->fSize > 1) {
@@ -268,6 +304,18 @@ struct InterpreterInstVisitor : public DispatchVisitor {
             }
         }
 
+        // Keep the DSP structure fields in the state layout, with their offset in bytes in the int or real heap
+        MemoryDesc desc = fFieldTable[name];
+        if ((inst->fAddress->getAccess() & Address::kStruct) && desc.fType != Typed::kSound_ptr) {
+            if (desc.fType == Typed::kInt32) {
+                fStateLayout << name << " " << kStateInt32 << " " << desc.fSize << " " << desc.fOffset * sizeof(int)
+                             << endl;
+            } else {
+                fStateLayout << name << " " << ((sizeof(T) == 8) ? kStateDouble : kStateFloat) << " " << desc.fSize
+                             << " " << desc.fOffset * sizeof(T) << endl;
+            }
+        }
+
         // Simulate a 'Store'
         if (inst->fValue) {
             visitStore(inst->fAddress, inst->fValue, inst->fType);
@@ -306,7 +354,12 @@ struct InterpreterInstVisitor : public DispatchVisitor {
             if (startWithRes(indexed->getName(), "input", num)) {
                 fCurrentBlock->push(
                     new FIRBasicInstruction<T>(FIRInstruction::kLoadInput, 0, 0, std::atoi(num.c_str()), 0));
+            } else if (fInputTable.find(indexed->getName()) != fInputTable.end()) {
+                compileIndexShift(indexed->getName());
+                fCurrentBlock->push(
+                    new FIRBasicInstruction<T>(FIRInstruction::kLoadInput, 0, 0, fInputTable[indexed->getName()], 0));
             } else {
+                tmp = getArrayDesc(indexed);
                 DeclareStructTypeInst* struct_type = isStructType(indexed->getName());
                 if (struct_type) {
                     Int32NumInst* field_index = static_cast<Int32NumInst*>(indexed->fIndex);
@@ -324,10 +377,73 @@ struct InterpreterInstVisitor : public DispatchVisitor {
 
     virtual void visit(LoadVarAddressInst* inst) { faustassert(false); }
 
+    // Vector mode : the index (on top of the stack) of an access in an input/output buffer is shifted by the buffer index
+    void compileIndexShift(const string& name)
+    {
+        fCurrentBlock->push(new FIRBasicInstruction<T>(FIRInstruction::kLoadInt, 0, 0, fFieldTable[name].fOffset, 0));
+        fCurrentBlock->push(new FIRBasicInstruction<T>(FIRInstruction::kAddInt));
+    }
+
+    // Vector mode : an access in an array alias is compiled as an access in the array, the constant shift of the index
+    // (the alias one, plus 'c' in the 'alias[exp + c]' form) being added to the array offset
+    ValueInst* getAliasIndex(IndexedAddress* indexed, int& shift)
+    {
+        map<string, int>::iterator it = fAliasTable.find(indexed->getName());
+        if (it == fAliasTable.end()) {
+            shift = 0;
+            return indexed->fIndex;
+        }
+        shift               = it->second;
+        BinopInst*    binop = dynamic_cast<BinopInst*>(indexed->fIndex);
+        Int32NumInst* num   = (binop) ? dynamic_cast<Int32NumInst*>(binop->fInst2) : 0;
+        if (num && (binop->fOpcode == kAdd || binop->fOpcode == kSub)) {
+            shift += (binop->fOpcode == kAdd) ? num->fNum : -num->fNum;
+            return binop->fInst1;
+        } else {
+            return indexed->fIndex;
+        }
+    }
+
+    MemoryDesc getArrayDesc(IndexedAddress* indexed)
+    {
+        int        shift;
+        MemoryDesc tmp = fFieldTable[indexed->getName()];
+        getAliasIndex(indexed, shift);
+        return MemoryDesc(tmp.fOffset + shift, tmp.fSize - shift, tmp.fType);
+    }
+
+    virtual void visit(IndexedAddress* indexed)
+    {
+        int shift;
+        getAliasIndex(indexed, shift)->accept(this);
+    }
+
     virtual void visitStore(Address* address, ValueInst* value, Typed* type = NULL)
     {
         ArrayTyped* array_typed;
 
+        // Vector mode : 'fInputN_ptr = inputs[N]' is not needed, only the index is kept in 'fInputN =
+        // &fInputN_ptr[index]', and 'fRec0 = &fRec0_tmp[k]' pointers are aliases of the array (accessed with an index
+        // shifted by k)
+        if (endWith(address->getName(), "_ptr")) {
+            return;
+        } else if (LoadVarAddressInst* load_address = dynamic_cast<LoadVarAddressInst*>(value)) {
+            string          name    = address->getName();
+            IndexedAddress* indexed = dynamic_cast<IndexedAddress*>(load_address->fAddress);
+            faustassert(indexed);
+            if (fInputTable.find(name) != fInputTable.end() || fOutputTable.find(name) != fOutputTable.end()) {
+                indexed->fIndex->accept(this);
+                fCurrentBlock->push(
+                    new FIRBasicInstruction<T>(FIRInstruction::kStoreInt, 0, 0, fFieldTable[name].fOffset, 0));
+            } else {
+                Int32NumInst* index = dynamic_cast<Int32NumInst*>(indexed->fIndex);
+                faustassert(index);
+                fFieldTable[name] = fFieldTable[indexed->getName()];
+                fAliasTable[name] = index->fNum;
+            }
+            return;
+        }
+
         // dump2FIR(value);
         // if (type) dump2FIR(type);
 
@@ -399,7 +515,12 @@ struct InterpreterInstVisitor : public DispatchVisitor {
                 if (startWithRes(indexed->getName(), "output", num)) {
                     fCurrentBlock->push(
                         new FIRBasicInstruction<T>(FIRInstruction::kStoreOutput, 0, 0, std::atoi(num.c_str()), 0));
+                } else if (fOutputTable.find(indexed->getName()) != fOutputTable.end()) {
+                    compileIndexShift(indexed->getName());
+                    fCurrentBlock->push(new FIRBasicInstruction<T>(FIRInstruction::kStoreOutput, 0, 0,
+                                                                   fOutputTable[indexed->getName()], 0));
                 } else {
+                    tmp = getArrayDesc(indexed);
                     fCurrentBlock->push(new FIRBasicInstruction<T>((tmp.fType == Typed::kInt32)
                                                                        ? FIRInstruction::kStoreIndexedInt
                                                                        : FIRInstruction::kStoreIndexedReal,
@@ -606,9 +727,265 @@ struct InterpreterInstVisitor : public DispatchVisitor {
         fCurrentBlock = previous;
     }
 
+    /*
+     Vector mode : loops like 'for (int i = 0; i < count; i = i + 1) { X[i] = exp; ... }' where 'exp' only uses
+     arrays and inputs accessed at 'i' (plus a constant shift), scalar real values, and real arithmetic/math functions,
+     are compiled with vector instructions: each operation processes the 'count' samples at once in Real HEAP,
+     intermediate results being kept in temporary vectors. Other loops are compiled in scalar mode.
+    */
+
+    // Returns the HEAP offset of the first element of a real (or int) array accessed at 'loop_index + k', or -1
+    int getVectorOffset(IndexedAddress* indexed, const string& loop_index, bool is_int = false)
+    {
+        int          shift;
+        LoadVarInst* load = dynamic_cast<LoadVarInst*>(getAliasIndex(indexed, shift));
+        if (!load || load->getName() != loop_index) return -1;
+
+        string name = indexed->getName();
+        if (fFieldTable.find(name) == fFieldTable.end()) return -1;
+        MemoryDesc tmp = fFieldTable[name];
+        if ((tmp.fType == Typed::kInt32) != is_int || tmp.fType == Typed::kSound_ptr || tmp.fSize <= 1) return -1;
+        return tmp.fOffset + shift;
+    }
+
+    // Returns the Int HEAP offset of 'value' if it is an int array accessed at 'loop_index + k', or -1
+    int getIntVectorOffset(ValueInst* value, const string& loop_index)
+    {
+        LoadVarInst*    load    = dynamic_cast<LoadVarInst*>(value);
+        IndexedAddress* indexed = (load) ? dynamic_cast<IndexedAddress*>(load->fAddress) : 0;
+        return (indexed) ? getVectorOffset(indexed, loop_index, true) : -1;
+    }
+
+    // Returns whether the input/output buffer is accessed at 'loop_index'
+    bool isVectorIO(IndexedAddress* indexed, const string& loop_index, map<string, int>& table)
+    {
+        LoadVarInst* load = dynamic_cast<LoadVarInst*>(indexed->fIndex);
+        return (table.find(indexed->getName()) != table.end()) && load && load->getName() == loop_index;
+    }
+
+    static FIRInstruction::Opcode getVectorOpcode(FIRInstruction::Opcode opcode)
+    {
+        switch (opcode) {
+            case FIRInstruction::kAddReal:
+                return FIRInstruction::kAddRealVec;
+            case FIRInstruction::kSubReal:
+                return FIRInstruction::kSubRealVec;
+            case FIRInstruction::kMultReal:
+                return FIRInstruction::kMultRealVec;
+            case FIRInstruction::kDivReal:
+                return FIRInstruction::kDivRealVec;
+            case FIRInstruction::kRemReal:
+                return FIRInstruction::kRemRealVec;
+            case FIRInstruction::kAbsf:
+                return FIRInstruction::kAbsfVec;
+            case FIRInstruction::kAcosf:
+                return FIRInstruction::kAcosfVec;
+            case FIRInstruction::kAsinf:
+                return FIRInstruction::kAsinfVec;
+            case FIRInstruction::kAtanf:
+                return FIRInstruction::kAtanfVec;
+            case FIRInstruction::kCeilf:
+                return FIRInstruction::kCeilfVec;
+            case FIRInstruction::kCosf:
+                return FIRInstruction::kCosfVec;
+            case FIRInstruction::kCoshf:
+                return FIRInstruction::kCoshfVec;
+            case FIRInstruction::kExpf:
+                return FIRInstruction::kExpfVec;
+            case FIRInstruction::kFloorf:
+                return FIRInstruction::kFloorfVec;
+            case FIRInstruction::kLogf:
+                return FIRInstruction::kLogfVec;
+            case FIRInstruction::kLog10f:
+                return FIRInstruction::kLog10fVec;
+            case FIRInstruction::kRoundf:
+                return FIRInstruction::kRoundfVec;
+            case FIRInstruction::kSinf:
+                return FIRInstruction::kSinfVec;
+            case FIRInstruction::kSinhf:
+                return FIRInstruction::kSinhfVec;
+            case FIRInstruction::kSqrtf:
+                return FIRInstruction::kSqrtfVec;
+            case FIRInstruction::kTanf:
+                return FIRInstruction::kTanfVec;
+            case FIRInstruction::kTanhf:
+                return FIRInstruction::kTanhfVec;
+            case FIRInstruction::kAtan2f:
+                return FIRInstruction::kAtan2fVec;
+            case FIRInstruction::kFmodf:
+                return FIRInstruction::kFmodfVec;
+            case FIRInstruction::kPowf:
+                return FIRInstruction::kPowfVec;
+            case FIRInstruction::kMaxf:
+                return FIRInstruction::kMaxfVec;
+            case FIRInstruction::kMinf:
+                return FIRInstruction::kMinfVec;
+            default:
+                return FIRInstruction::kNop;
+        }
+    }
+
+    static bool isRealType(Typed::VarType type)
+    {
+        return (type == Typed::kFloat) || (type == Typed::kFloatMacro) || (type == Typed::kDouble);
+    }
+
+    // Checks that 'value' is a real expression that can be vectorized, and collects the accessed arrays offsets
+    bool isVectorValue(ValueInst* value, const string& loop_index, vector<int>& loads)
+    {
+        if (dynamic_cast<FloatNumInst*>(value) || dynamic_cast<DoubleNumInst*>(value)) {
+            return true;
+        } else if (LoadVarInst* load = dynamic_cast<LoadVarInst*>(value)) {
+            if (IndexedAddress* indexed = dynamic_cast<IndexedAddress*>(load->fAddress)) {
+                if (isVectorIO(indexed, loop_index, fInputTable)) return true;
+                int offset = getVectorOffset(indexed, loop_index);
+                loads.push_back(offset);
+                return offset >= 0;
+            } else {
+                return (fFieldTable.find(load->getName()) != fFieldTable.end()) &&
+                       isRealType(fFieldTable[load->getName()].fType) && (fFieldTable[load->getName()].fSize == 1);
+            }
+        } else if (::CastInst* cast = dynamic_cast<::CastInst*>(value)) {
+            if (!isRealType(cast->fType->getType())) return false;
+            return (getIntVectorOffset(cast->fInst, loop_index) >= 0) || isVectorValue(cast->fInst, loop_index, loads);
+        } else if (BinopInst* binop = dynamic_cast<BinopInst*>(value)) {
+            return (getVectorOpcode(gBinOpTable[binop->fOpcode]->fInterpFloatInst) != FIRInstruction::kNop) &&
+                   isVectorValue(binop->fInst1, loop_index, loads) && isVectorValue(binop->fInst2, loop_index, loads);
+        } else if (FunCallInst* funcall = dynamic_cast<FunCallInst*>(value)) {
+            if (gMathLibTable.find(funcall->fName) == gMathLibTable.end() ||
+                getVectorOpcode(gMathLibTable[funcall->fName]) == FIRInstruction::kNop) {
+                return false;
+            }
+            for (list<ValueInst*>::iterator it = funcall->fArgs.begin(); it != funcall->fArgs.end(); it++) {
+                if (!isVectorValue(*it, loop_index, loads)) return false;
+            }
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    int getVectorTemp(int depth)
+    {
+        while (int(fVecTemps.size()) <= depth) {
+            fVecTemps.push_back(fRealHeapOffset);
+            fRealHeapOffset += fVecSize;
+        }
+        return fVecTemps[depth];
+    }
+
+    // Compiles 'value' and returns the Real HEAP offset of its vector: either an array or 'res'
+    int compileVectorValue(ValueInst* value, const string& loop_index, int depth, int res)
+    {
+        if (FloatNumInst* num = dynamic_cast<FloatNumInst*>(value)) {
+            fCurrentBlock->push(new FIRBasicInstruction<T>(FIRInstruction::kRealValueVec, res, num->fNum));
+        } else if (DoubleNumInst* num = dynamic_cast<DoubleNumInst*>(value)) {
+            fCurrentBlock->push(new FIRBasicInstruction<T>(FIRInstruction::kRealValueVec, res, num->fNum));
+        } else if (LoadVarInst* load = dynamic_cast<LoadVarInst*>(value)) {
+            if (IndexedAddress* indexed = dynamic_cast<IndexedAddress*>(load->fAddress)) {
+                if (fInputTable.find(indexed->getName()) == fInputTable.end()) {
+                    return getVectorOffset(indexed, loop_index);
+                }
+                fCurrentBlock->push(new FIRBasicInstruction<T>(FIRInstruction::kLoadInputVec, res, 0,
+                                                               fInputTable[indexed->getName()],
+                                                               fFieldTable[indexed->getName()].fOffset));
+            } else {
+                fCurrentBlock->push(new FIRBasicInstruction<T>(FIRInstruction::kLoadRealVec, res, 0,
+                                                               fFieldTable[load->getName()].fOffset, 0));
+            }
+        } else if (::CastInst* cast = dynamic_cast<::CastInst*>(value)) {
+            int offset = getIntVectorOffset(cast->fInst, loop_index);
+            if (offset < 0) return compileVectorValue(cast->fInst, loop_index, depth, res);
+            fCurrentBlock->push(new FIRBasicInstruction<T>(FIRInstruction::kCastRealVec, res, 0, offset, 0));
+        } else if (BinopInst* binop = dynamic_cast<BinopInst*>(value)) {
+            int v1 = compileVectorValue(binop->fInst1, loop_index, depth, getVectorTemp(depth));
+            int v2 = compileVectorValue(binop->fInst2, loop_index, depth + 1, getVectorTemp(depth + 1));
+            fCurrentBlock->push(new FIRBasicInstruction<T>(
+                getVectorOpcode(gBinOpTable[binop->fOpcode]->fInterpFloatInst), res, 0, v1, v2));
+        } else if (FunCallInst* funcall = dynamic_cast<FunCallInst*>(value)) {
+            int v[2] = {0, 0};
+            int arg  = 0;
+            for (list<ValueInst*>::iterator it = funcall->fArgs.begin(); it != funcall->fArgs.end(); it++, arg++) {
+                v[arg] = compileVectorValue(*it, loop_index, depth + arg, getVectorTemp(depth + arg));
+            }
+            fCurrentBlock->push(
+                new FIRBasicInstruction<T>(getVectorOpcode(gMathLibTable[funcall->fName]), res, 0, v[0], v[1]));
+        } else {
+            faustassert(false);
+        }
+        return res;
+    }
+
+    bool compileVectorLoop(ForLoopInst* inst)
+    {
+        // Check the 'for (int i = 0; i < count; i = i + 1)' loop
+        DeclareVarInst* init  = dynamic_cast<DeclareVarInst*>(inst->fInit);
+        BinopInst*      end   = dynamic_cast<BinopInst*>(inst->fEnd);
+        StoreVarInst*   incr  = dynamic_cast<StoreVarInst*>(inst->fIncrement);
+        Int32NumInst*   start = (init) ? dynamic_cast<Int32NumInst*>(init->fValue) : 0;
+        if (!start || start->fNum != 0 || !end || end->fOpcode != kLT || !incr) return false;
+
+        string        loop_index = init->fAddress->getName();
+        LoadVarInst*  index      = dynamic_cast<LoadVarInst*>(end->fInst1);
+        LoadVarInst*  count      = dynamic_cast<LoadVarInst*>(end->fInst2);
+        BinopInst*    next       = dynamic_cast<BinopInst*>(incr->fValue);
+        Int32NumInst* step       = (next) ? dynamic_cast<Int32NumInst*>(next->fInst2) : 0;
+        if (!index || index->getName() != loop_index || !count || count->getName() != "count" ||
+            incr->fAddress->getName() != loop_index || !step || next->fOpcode != kAdd || step->fNum != 1) {
+            return false;
+        }
+
+        // Check the 'X[i] = exp' stores
+        vector<int> loads;
+        vector<int> stores;
+        for (list<StatementInst*>::iterator it = inst->fCode->fCode.begin(); it != inst->fCode->fCode.end(); it++) {
+            StoreVarInst*   store   = dynamic_cast<StoreVarInst*>(*it);
+            IndexedAddress* indexed = (store) ? dynamic_cast<IndexedAddress*>(store->fAddress) : 0;
+            if (!indexed) return false;
+            if (!isVectorIO(indexed, loop_index, fOutputTable)) {
+                int offset = getVectorOffset(indexed, loop_index);
+                if (offset < 0) return false;
+                stores.push_back(offset);
+            }
+            if (!isVectorValue(store->fValue, loop_index, loads)) return false;
+        }
+
+        // A sample cannot depend on another sample computed in the same loop (like in recursive loops)
+        for (size_t i = 0; i < stores.size(); i++) {
+            for (size_t j = 0; j < loads.size(); j++) {
+                if (loads[j] != stores[i] && std::abs(loads[j] - stores[i]) < fVecSize) return false;
+            }
+        }
+
+        // Compile the stores
+        fCurrentBlock->push(
+            new FIRBasicInstruction<T>(FIRInstruction::kVectorSize, 0, 0, fFieldTable[count->getName()].fOffset, 0));
+
+        for (list<StatementInst*>::iterator it = inst->fCode->fCode.begin(); it != inst->fCode->fCode.end(); it++) {
+            StoreVarInst*   store   = static_cast<StoreVarInst*>(*it);
+            IndexedAddress* indexed = static_cast<IndexedAddress*>(store->fAddress);
+            if (fOutputTable.find(indexed->getName()) != fOutputTable.end()) {
+                int res = compileVectorValue(store->fValue, loop_index, 0, getVectorTemp(0));
+                fCurrentBlock->push(new FIRBasicInstruction<T>(FIRInstruction::kStoreOutputVec, res, 0,
+                                                               fOutputTable[indexed->getName()],
+                                                               fFieldTable[indexed->getName()].fOffset));
+            } else {
+                int res = getVectorOffset(indexed, loop_index);
+                int val = compileVectorValue(store->fValue, loop_index, 0, res);
+                if (val != res) {
+                    fCurrentBlock->push(new FIRBasicInstruction<T>(FIRInstruction::kMoveRealVec, res, 0, val, 0));
+                }
+            }
+        }
+
+        return true;
+    }
+
     // Loop
     virtual void visit(ForLoopInst* inst)
     {
+        if (fVecSize > 0 && compileVectorLoop(inst)) return;
+
         // Keep current block
         FIRBlockInstruction<T>* previous = fCurrentBlock;
 
@@ -29,21 +29,24 @@
 #include "exception.hh"
 #include "interpreter_bytecode.hh"
 
-#define INTER_MAX_OPT_LEVEL 6
+#define INTER_MAX_OPT_LEVEL 7
+
+// Last level: frequent instruction sequences are fused in superinstructions
+#define INTER_FUSION_OPT_LEVEL 7
 
 // Tables for math optimization
 
-static std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRMath2Heap;
-static std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRMath2Stack;
-static std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRMath2StackValue;
-static std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRMath2Value;
-static std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRMath2ValueInvert;
+static thread_local std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRMath2Heap;
+static thread_local std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRMath2Stack;
+static thread_local std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRMath2StackValue;
+static thread_local std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRMath2Value;
+static thread_local std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRMath2ValueInvert;
 
-static std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRExtendedMath2Heap;
-static std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRExtendedMath2Stack;
-static std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRExtendedMath2StackValue;
-static std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRExtendedMath2Value;
-static std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRExtendedMath2ValueInvert;
+static thread_local std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRExtendedMath2Heap;
+static thread_local std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRExtendedMath2Stack;
+static thread_local std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRExtendedMath2StackValue;
+static thread_local std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRExtendedMath2Value;
+static thread_local std::map<FIRInstruction::Opcode, FIRInstruction::Opcode> gFIRExtendedMath2ValueInvert;
 
 //=======================
 // Optimization
@@ -266,6 +269,79 @@ struct FIRInstructionPairMoveOptimizer : public FIRInstructionOptimizer<T> {
     }
 };
 
+/*
+ Fuse frequent sequences of 2 instructions in superinstructions, to save a dispatch and the stack traffic.
+ The sequences have been chosen by counting the executed opcode n-grams (after the previous levels)
+ on the impulse-tests DSPs, with the 'interp-ngrams' tool (tools/benchmark), which can be used
+ to tune this set on other DSPs. Share of the executed 2-grams:
+
+ kMultRealHeap kAddReal         ==> kMultAddRealHeap     (13.0 %)
+ kAddReal kMultRealStack        ==> kAddMultRealStack    (8.1 %)
+ kSubReal kStoreReal            ==> kSubStoreReal        (3.0 %)
+ kSubRealStack kStoreReal       ==> kSubStoreRealStack   (1.8 %)
+ kAddReal kStoreReal            ==> kAddStoreReal        (1.5 %)
+ kAddRealStack kStoreReal       ==> kAddStoreRealStack   (1.4 %)
+ kMultRealStack kStoreReal      ==> kMultStoreRealStack  (0.7 %)
+*/
+
+template <class T>
+struct FIRInstructionFusionOptimizer : public FIRInstructionOptimizer<T> {
+    FIRInstructionFusionOptimizer()
+    {
+        // std::cout << "FIRInstructionFusionOptimizer" << std::endl;
+    }
+
+    virtual ~FIRInstructionFusionOptimizer() {}
+
+    FIRBasicInstruction<T>* rewrite(InstructionIT cur, InstructionIT& end)
+    {
+        FIRBasicInstruction<T>* inst1 = *cur;
+        end                           = cur + 1;
+
+        // The last instruction of a block (kReturn) is not fused
+        if (inst1->fOpcode == FIRInstruction::kReturn) {
+            return inst1->copy();
+        }
+
+        FIRBasicInstruction<T>* inst2 = *(cur + 1);
+
+        if (inst1->fOpcode == FIRInstruction::kMultRealHeap && inst2->fOpcode == FIRInstruction::kAddReal) {
+            end = cur + 2;
+            return new FIRBasicInstruction<T>(FIRInstruction::kMultAddRealHeap, 0, 0, inst1->fOffset1,
+                                              inst1->fOffset2);
+        } else if (inst1->fOpcode == FIRInstruction::kAddReal && inst2->fOpcode == FIRInstruction::kMultRealStack) {
+            end = cur + 2;
+            return new FIRBasicInstruction<T>(FIRInstruction::kAddMultRealStack, 0, 0, inst2->fOffset1, 0);
+        } else if (inst2->fOpcode == FIRInstruction::kStoreReal) {
+            // Math operation directly stored in the heap : the stored location is always in 'offset1'
+            switch (inst1->fOpcode) {
+                case FIRInstruction::kAddReal:
+                    end = cur + 2;
+                    return new FIRBasicInstruction<T>(FIRInstruction::kAddStoreReal, 0, 0, inst2->fOffset1, 0);
+                case FIRInstruction::kSubReal:
+                    end = cur + 2;
+                    return new FIRBasicInstruction<T>(FIRInstruction::kSubStoreReal, 0, 0, inst2->fOffset1, 0);
+                case FIRInstruction::kAddRealStack:
+                    end = cur + 2;
+                    return new FIRBasicInstruction<T>(FIRInstruction::kAddStoreRealStack, 0, 0, inst2->fOffset1,
+                                                      inst1->fOffset1);
+                case FIRInstruction::kSubRealStack:
+                    end = cur + 2;
+                    return new FIRBasicInstruction<T>(FIRInstruction::kSubStoreRealStack, 0, 0, inst2->fOffset1,
+                                                      inst1->fOffset1);
+                case FIRInstruction::kMultRealStack:
+                    end = cur + 2;
+                    return new FIRBasicInstruction<T>(FIRInstruction::kMultStoreRealStack, 0, 0, inst2->fOffset1,
+                                                      inst1->fOffset1);
+                default:
+                    break;
+            }
+        }
+
+        return inst1->copy();
+    }
+};
+
 // Rewrite math operations as 'heap', 'stack' or 'Value' versions
 template <class T>
 struct FIRInstructionMathOptimizer : public FIRInstructionOptimizer<T> {
@@ -1390,6 +1466,14 @@ struct FIRInstructionOptimizer {
             // block->write(&std::cout);
         }
 
+        if (min_level <= 7 && 7 <= max_level) {
+            // 7) fuse frequent sequences in superinstructions
+            FIRInstructionFusionOptimizer<T> opt7;
+            block = FIRInstructionOptimizer<T>::optimize(block, opt7);
+            // std::cout << "FIRInstructionFusionOptimizer block size = " << block->size() << std::endl;
+            // block->write(&std::cout);
+        }
+
         return block;
     }
 };
@@ -27,8 +27,8 @@
 
 using namespace std;
 
-map<string, bool>   JAVAScriptInstVisitor::gFunctionSymbolTable;
-map<string, string> JAVAScriptInstVisitor::gMathLibTable;
+thread_local map<string, bool>   JAVAScriptInstVisitor::gFunctionSymbolTable;
+thread_local map<string, string> JAVAScriptInstVisitor::gMathLibTable;
 
 dsp_factory_base* JAVAScriptCodeContainer::produceFactory()
 {
@@ -272,6 +272,28 @@ LIBEXPORT bool generateCAuxFilesFromFile(const char* filename, int argc, const c
 LIBEXPORT bool generateCAuxFilesFromString(const char* name_app, const char* dsp_content, int argc, const char* argv[],
                                            char* error_msg);
 
+/**
+ * Set the persistent cache directory where the factories machine code is kept (disabled by default).
+ * The LLVM and interpreter factories created from a DSP source are then loaded from this directory
+ * when the same expanded DSP has already been compiled with the same options for the same target,
+ * and stored in it otherwise. The hit/miss counters are reset.
+ *
+ * @param path - the cache directory (created if needed), or an empty string to disable the cache
+ * @param max_size - the maximum size of the directory in bytes, the least recently used entries are removed above it
+ * (0 means no limit)
+ *
+ * @return true if the cache directory can be used, false otherwise
+ */
+LIBEXPORT bool setCDSPFactoryCacheDirectory(const char* path, size_t max_size);
+
+/**
+ * Get the persistent cache counters since the last call to setCDSPFactoryCacheDirectory.
+ *
+ * @param hits - the number of factories loaded from the cache directory
+ * @param misses - the number of factories compiled and stored in the cache directory
+ */
+LIBEXPORT void getCDSPFactoryCacheStats(int* hits, int* misses);
+
 /**
  * The free function to be used on memory returned by getCDSPMachineTarget, getCName, getCSHAKey,
  * getCDSPCode, getCLibraryList, getAllCDSPFactories, writeCDSPFactoryToBitcode,
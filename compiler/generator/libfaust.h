@@ -272,6 +272,28 @@ LIBEXPORT bool generateAuxFilesFromFile(const std::string& filename, int argc, c
 LIBEXPORT bool generateAuxFilesFromString(const std::string& name_app, const std::string& dsp_content, int argc,
                                           const char* argv[], std::string& error_msg);
 
+/**
+ * Set the persistent cache directory where the factories machine code is kept (disabled by default).
+ * The LLVM and interpreter factories created from a DSP source are then loaded from this directory
+ * when the same expanded DSP has already been compiled with the same options for the same target,
+ * and stored in it otherwise. The hit/miss counters are reset.
+ *
+ * @param path - the cache directory (created if needed), or an empty string to disable the cache
+ * @param max_size - the maximum size of the directory in bytes, the least recently used entries are removed above it
+ * (0 means no limit)
+ *
+ * @return true if the cache directory can be used, false otherwise
+ */
+LIBEXPORT bool setDSPFactoryCacheDirectory(const std::string& path, size_t max_size = 256 * 1024 * 1024);
+
+/**
+ * Get the persistent cache counters since the last call to setDSPFactoryCacheDirectory.
+ *
+ * @param hits - the number of factories loaded from the cache directory
+ * @param misses - the number of factories compiled and stored in the cache directory
+ */
+LIBEXPORT void getDSPFactoryCacheStats(int& hits, int& misses);
+
 /**
  * The free function to be used on memory returned by getCDSPMachineTarget, getCName, getCSHAKey,
  * getCDSPCode, getCLibraryList, getAllCDSPFactories, writeCDSPFactoryToBitcode,
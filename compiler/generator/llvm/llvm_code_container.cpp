@@ -41,7 +41,7 @@ bool      linkModules(Module* dst, ModulePTR src, char* error_msg);
 ModulePTR loadModule(const string& module_name, llvm::LLVMContext* context);
 Module*   linkAllModules(llvm::LLVMContext* context, Module* dst, char* error);
 
-list<string> LLVMInstVisitor::gMathLibTable;
+thread_local list<string> LLVMInstVisitor::gMathLibTable;
 
 CodeContainer* LLVMCodeContainer::createScalarContainer(const string& name, int sub_container_type)
 {
@@ -732,6 +732,21 @@ void LLVMCodeContainer::generateGetJSON(int dsp_size)
     fBuilder->ClearInsertionPoint();
 }
 
+void LLVMCodeContainer::generateGetStateLayout(const string& layout)
+{
+    PointerType*    string_ptr = PointerType::get(fBuilder->getInt8Ty(), 0);
+    VECTOR_OF_TYPES llvm_getStateLayout_args;
+    FunctionType*   llvm_getStateLayout_type =
+        FunctionType::get(string_ptr, MAKE_VECTOR_OF_TYPES(llvm_getStateLayout_args), false);
+    Function* llvm_getStateLayout = Function::Create(llvm_getStateLayout_type, GlobalValue::ExternalLinkage,
+                                                     "getStateLayout" + fKlassName, fModule);
+
+    BasicBlock* return_block = BasicBlock::Create(getContext(), "return_block", llvm_getStateLayout);
+    ReturnInst::Create(getContext(), fCodeProducer->getStringConstant(layout), return_block);
+    verifyFunction(*llvm_getStateLayout);
+    fBuilder->ClearInsertionPoint();
+}
+
 void LLVMCodeContainer::generateFunMaps()
 {
     if (gGlobal->gFastMath) {
@@ -894,6 +909,7 @@ dsp_factory_base* LLVMCodeContainer::produceFactory()
     generateBuildUserInterfaceEnd();
   
     generateGetJSON(fTypeBuilder.getSize());
+    generateGetStateLayout(fTypeBuilder.getStateLayout());
 
     // Compute
     generateCompute();
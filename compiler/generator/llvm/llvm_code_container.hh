@@ -98,6 +98,7 @@ class LLVMCodeContainer : public virtual CodeContainer {
     void generateBuildUserInterfaceEnd();
   
     void generateGetJSON(int dsp_size);
+    void generateGetStateLayout(const string& layout);
 
     LLVMContext& getContext();
 
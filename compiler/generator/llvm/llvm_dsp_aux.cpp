@@ -215,6 +215,7 @@ void llvm_dsp_factory_aux::init(const string& type_name, const string& dsp_name)
     fInstanceResetUI    = nullptr;
     fInstanceClear      = nullptr;
     fCompute            = nullptr;
+    fGetStateLayout     = nullptr;
     fClassName          = "mydsp";
     fName               = dsp_name;
     fTypeName           = type_name;
@@ -273,6 +274,8 @@ bool llvm_dsp_factory_aux::initJITAux(string& error_msg)
         fMetadata           = (metadataFun)loadOptimize("metadata" + fClassName);
         fGetJSON            = (getJSONFun)loadOptimize("getJSON" + fClassName);
         fSetDefaultSound    = (setDefaultSoundFun)loadOptimize("setDefaultSound" + fClassName);
+        // Optional: not generated in machine code written by previous versions
+        fGetStateLayout     = (getJSONFun)fJIT->getFunctionAddress("getStateLayout" + fClassName);
         
         fDecoder = new JSONUIDecoder(fGetJSON());
         
@@ -425,6 +428,13 @@ void llvm_dsp::compute(int count, FAUSTFLOAT** input, FAUSTFLOAT** output)
     fFactory->getFactory()->fCompute(fDSP, count, input, output);
 }
 
+dsp_state_layout llvm_dsp::getStateLayout()
+{
+    getJSONFun get_state_layout = fFactory->getFactory()->fGetStateLayout;
+    // All fields are addressed from the beginning of the DSP struct
+    return (get_state_layout) ? parseDSPStateLayout(get_state_layout(), (char*)fDSP, (char*)fDSP) : dsp_state_layout();
+}
+
 // Public C++ API
 
 EXPORT bool startMTDSPFactories()
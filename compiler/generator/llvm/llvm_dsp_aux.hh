@@ -28,6 +28,7 @@
 #include <vector>
 
 #include "faust/dsp/dsp.h"
+#include "faust/dsp/dsp-state.h"
 #include "faust/gui/CInterface.h"
 #include "faust/gui/meta.h"
 #include "faust/gui/JSONUIDecoder.h"
@@ -124,6 +125,8 @@ class EXPORT llvm_dsp : public dsp {
     virtual void metadata(MetaGlue* glue);
 
     virtual void compute(int count, FAUSTFLOAT** input, FAUSTFLOAT** output);
+
+    dsp_state_layout getStateLayout();
 };
 
 #ifndef LLVM_35
@@ -184,6 +187,7 @@ class llvm_dsp_factory_aux : public dsp_factory_imp {
     computeFun            fCompute;
     metadataFun           fMetadata;
     getJSONFun            fGetJSON;
+    getJSONFun            fGetStateLayout;
     setDefaultSoundFun    fSetDefaultSound;
 
     void* loadOptimize(const std::string& function);
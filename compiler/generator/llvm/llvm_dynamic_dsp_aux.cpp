@@ -35,6 +35,7 @@
 
 #include <llvm-c/Core.h>
 #include <llvm/ADT/Triple.h>
+#include <llvm/Config/llvm-config.h>
 #include <llvm/ExecutionEngine/MCJIT.h>
 #include <llvm/ExecutionEngine/ObjectCache.h>
 #include <llvm/IR/DataLayout.h>
@@ -489,6 +490,22 @@ EXPORT llvm_dsp_factory* createDSPFactoryFromString(const string& name_app, cons
             sfactory->addReference();
             return sfactory;
         } else {
+#ifndef LLVM_35
+            // Machine code kept in the persistent cache for this target and optimization level
+            bool   use_cache = dsp_factory_cache::isEnabled();
+            string cache_key = generateSHA1(sha_key + " llvm " + LLVM_VERSION_STRING + " " +
+                                            ((target == "") ? getDSPMachineTarget() : target) + " " +
+                                            std::to_string(opt_level) + " " + FAUSTVERSION);
+            string machine_code;
+            if (use_cache && dsp_factory_cache::read(cache_key, machine_code)) {
+                if ((factory = readDSPFactoryFromMachine(machine_code, target))) {
+                    factory->setSHAKey(sha_key);
+                    factory->setDSPCode(expanded_dsp_content);
+                    return factory;
+                }
+                dsp_factory_cache::invalidate(cache_key);
+            }
+#endif
             llvm_dynamic_dsp_factory_aux* factory_aux = nullptr;
             try {
                 factory_aux = static_cast<llvm_dynamic_dsp_factory_aux*>(
@@ -505,6 +522,9 @@ EXPORT llvm_dsp_factory* createDSPFactoryFromString(const string& name_app, cons
                     llvm_dsp_factory_aux::gLLVMFactoryTable.setFactory(factory);
                     factory->setSHAKey(sha_key);
                     factory->setDSPCode(expanded_dsp_content);
+#ifndef LLVM_35
+                    if (use_cache) dsp_factory_cache::write(cache_key, writeDSPFactoryToMachine(factory, target));
+#endif
                     return factory;
                 }
             } catch (faustexception& e) {
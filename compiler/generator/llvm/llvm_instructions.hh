@@ -29,11 +29,13 @@
 #include <list>
 #include <map>
 #include <set>
+#include <sstream>
 #include <string>
 
 #include "Text.hh"
 #include "binop.hh"
 #include "exception.hh"
+#include "faust/dsp/dsp-state.h"
 #include "fir_to_fir.hh"
 #include "global.hh"
 #include "instructions.hh"
@@ -247,6 +249,9 @@ class LLVMTypeInstVisitor : public DispatchVisitor, public LLVMTypeHelper {
     // DSP struct size in bytes
     int fSize;
 
+    // DSP state layout ('name type size offset' lines, see faust/dsp/dsp-state.h)
+    string fStateLayout;
+
     // DSP structure creation
     std::map<string, int> fDSPFieldsNames;    // map of field names and indexes
     VECTOR_OF_TYPES       fDSPFields;         // vector of LLVM types (for each field)
@@ -592,6 +597,8 @@ class LLVMTypeInstVisitor : public DispatchVisitor, public LLVMTypeHelper {
 
     int getSize() { return fSize; }
 
+    string getStateLayout() { return fStateLayout; }
+
     virtual void visit(DeclareVarInst* inst)
     {
         // Not supposed to declare var with value here
@@ -670,12 +677,42 @@ class LLVMTypeInstVisitor : public DispatchVisitor, public LLVMTypeHelper {
         verifyFunction(*llvm_setDefault);
     }
 
+    // Describe the int32, float and double fields (or arrays of) with their byte offset in the DSP struct,
+    // the same way the Interpreter backend does, so that the state can be transferred between backends
+    void generateStateLayout(llvm::StructType* dsp_type)
+    {
+        const StructLayout* struct_layout = fDataLayout->getStructLayout(dsp_type);
+        stringstream        layout;
+        for (std::map<string, int>::iterator it = fDSPFieldsNames.begin(); it != fDSPFieldsNames.end(); it++) {
+            llvm::Type* type = fDSPFields[(*it).second];
+            int         size = 1;
+            if (type->isArrayTy()) {
+                size = int(type->getArrayNumElements());
+                type = type->getArrayElementType();
+            }
+            int state_type;
+            if (type->isIntegerTy(32)) {
+                state_type = kStateInt32;
+            } else if (type->isFloatTy()) {
+                state_type = kStateFloat;
+            } else if (type->isDoubleTy()) {
+                state_type = kStateDouble;
+            } else {
+                continue;
+            }
+            layout << (*it).first << " " << state_type << " " << size << " "
+                   << struct_layout->getElementOffset((*it).second) << endl;
+        }
+        fStateLayout = layout.str();
+    }
+
     llvm::PointerType* getDSPType(bool internal, bool generate_ui = true)
     {
         llvm::StructType*  dsp_type     = LLVMTypeHelper::createStructType(fModule, "struct.dsp" + fPrefix, fDSPFields);
         llvm::PointerType* dsp_type_ptr = PointerType::get(dsp_type, 0);
 
         fSize = fDataLayout->getTypeSizeInBits(dsp_type)/8;
+        generateStateLayout(dsp_type);
 
         // Create llvm_free_dsp function
         generateFreeDsp(dsp_type_ptr, internal);
@@ -801,7 +838,7 @@ class LLVMInstVisitor : public InstVisitor, public LLVMTypeHelper {
 
     map<string, GlobalVariable*> fGlobalStringTable;
 
-    static list<string> gMathLibTable;
+    static thread_local list<string> gMathLibTable;
 
     LLVMValue genReal(double val)
     {
@@ -47,6 +47,7 @@
 #include "sourcereader.hh"
 #include "sqrtprim.hh"
 #include "tanprim.hh"
+#include "timing.hh"
 #include "tree.hh"
 
 #ifdef WIN32
@@ -86,12 +87,10 @@
 #endif
 
 // Parser
-extern FILE*       yyin;
-extern const char* yyfilename;
+extern thread_local const char* yyfilename;
 
-// CG globals
-list<Garbageable*> global::gObjectTable;
-bool               global::gHeapCleanup = false;
+// Timing
+extern thread_local bool gTimingSwitch;
 
 /*
 faust1 uses a loop size of 512, but 512 makes faust2 crash (stack allocation error).
@@ -100,6 +99,9 @@ So we use a lower value here.
 
 global::global() : TABBER(1), gLoopDetector(1024, 400), gNextFreeColor(1)
 {
+    // The context has to be the current one before any tree or symbol is created in its tables
+    gGlobal = this;
+
     CTree::init();
     Symbol::init();
 
@@ -121,19 +123,28 @@ global::global() : TABBER(1), gLoopDetector(1024, 400), gNextFreeColor(1)
     gSimplifyDiagrams = false;
     gLessTempSwitch   = false;
     gMaxCopyDelay     = 16;
+    gExactDelayLines  = false;
+    gEvalCacheSwitch  = false;
+    gPGOLayoutFile    = "";
+    gDirtyZones       = false;
+    gTailSamples      = false;
 
     gVectorSwitch      = false;
+    gSIMDSwitch        = false;
+    gBatchSize         = 0;
     gDeepFirstSwitch   = false;
     gVecSize           = 32;
     gVectorLoopVariant = 0;
 
-    gOpenMPSwitch    = false;
-    gOpenMPLoop      = false;
-    gSchedulerSwitch = false;
-    gOpenCLSwitch    = false;
-    gCUDASwitch      = false;
-    gGroupTaskSwitch = false;
-    gFunTaskSwitch   = false;
+    gOpenMPSwitch      = false;
+    gOpenMPLoop        = false;
+    gSchedulerSwitch   = false;
+    gOpenCLSwitch      = false;
+    gCUDASwitch        = false;
+    gGroupTaskSwitch   = false;
+    gMinTaskCost       = 0;
+    gTaskCostModelFile = "";
+    gFunTaskSwitch     = false;
 
     gUIMacroSwitch = false;
     gDumpNorm      = false;
@@ -229,6 +240,7 @@ global::global() : TABBER(1), gLoopDetector(1024, 400), gNextFreeColor(1)
     gDummyInput = 10000;
 
     gBoxSlotNumber = 0;
+    gEvalCache     = nullptr;
     gMemoryManager = false;
 
     gOccurrences = 0;
@@ -492,8 +504,8 @@ void global::init()
     PROPAGATEPROPERTY = symbol("PropagateProperty");
 
     // yyfilename is defined in errormsg.cpp but must be redefined at each compilation.
+    // (the shared lexer state, like 'yyin', is only accessed by SourceReader under the parser lock)
     yyfilename = "";
-    yyin       = 0;
 
     gLatexheaderfilename = "latexheader.tex";
     gDocTextsDefaultFile = "mathdoctexts-default.txt";
@@ -566,23 +578,31 @@ void global::printCompilationOptions(ostream& dst, bool backend)
             << " -vs " << gVecSize << ((gFunTaskSwitch) ? " -fun" : "") << ((gGroupTaskSwitch) ? " -g" : "")
             << ((gDeepFirstSwitch) ? " -dfs" : "")
             << ((gFloatSize == 2) ? " -double" : (gFloatSize == 3) ? " -quad" : "") << " -ftz " << gFTZMode
-            << ((gMemoryManager) ? " -mem" : "");
+            << ((gMemoryManager) ? " -mem" : "")
+            << ((gExactDelayLines) ? " -edl" : "");
     } else if (gVectorSwitch) {
         dst << "-vec"
             << " -lv " << gVectorLoopVariant << " -vs " << gVecSize << ((gFunTaskSwitch) ? " -fun" : "")
             << ((gGroupTaskSwitch) ? " -g" : "") << ((gDeepFirstSwitch) ? " -dfs" : "")
             << ((gFloatSize == 2) ? " -double" : (gFloatSize == 3) ? " -quad" : "") << " -ftz " << gFTZMode
-            << ((gMemoryManager) ? " -mem" : "");
+            << ((gMemoryManager) ? " -mem" : "")
+            << ((gExactDelayLines) ? " -edl" : "") << ((gSIMDSwitch) ? " -simd" : "");
     } else if (gOpenMPSwitch) {
         dst << "-omp"
             << " -vs " << gVecSize << " -vs " << gVecSize << ((gFunTaskSwitch) ? " -fun" : "")
             << ((gGroupTaskSwitch) ? " -g" : "") << ((gDeepFirstSwitch) ? " -dfs" : "")
             << ((gFloatSize == 2) ? " -double" : (gFloatSize == 3) ? " -quad" : "") << " -ftz " << gFTZMode
-            << ((gMemoryManager) ? " -mem" : "");
+            << ((gMemoryManager) ? " -mem" : "")
+            << ((gExactDelayLines) ? " -edl" : "");
     } else {
         dst << ((gFloatSize == 1) ? "-scal" : ((gFloatSize == 2) ? "-double" : (gFloatSize == 3) ? "-quad" : ""))
-            << " -ftz " << gFTZMode << ((gMemoryManager) ? " -mem" : "");
+            << " -ftz " << gFTZMode << ((gMemoryManager) ? " -mem" : "")
+            << ((gExactDelayLines) ? " -edl" : "");
+        if (gBatchSize > 0) dst << " -batch " << gBatchSize;
+        if (gDirtyZones) dst << " -dz";
     }
+    if (gPGOLayoutFile != "") dst << " -pgo-layout " << gPGOLayoutFile;
+    if (gTailSamples) dst << " -ts";
 }
 
 global::~global()
@@ -590,6 +610,8 @@ global::~global()
     Garbageable::cleanup();
     BasicTyped::cleanup();
     DeclareVarInst::cleanup();
+    CTree::cleanup();
+    Symbol::cleanup();
     setlocale(LC_ALL, gCurrentLocal);
     free(gCurrentLocal);
 
@@ -676,57 +698,138 @@ Garbageable::~Garbageable()
 
 void Garbageable::cleanup()
 {
-    std::list<Garbageable*>::iterator it;
-
-    // Here removing the deleted pointer from the list is pointless
-    // and takes time, thus we don't do it.
-    global::gHeapCleanup = true;
-    for (it = global::gObjectTable.begin(); it != global::gObjectTable.end(); it++) {
-#ifdef _WIN32
-        // Hack : "this" and actual pointer are not the same: destructor cannot be called...
-        Garbageable::operator delete(*it);
-#else
-        delete (*it);
-#endif
-    }
-
-    // Reset to default state
-    global::gObjectTable.clear();
-    global::gHeapCleanup = false;
+    gGlobal->gArena.cleanup();
 }
 
 void* Garbageable::operator new(size_t size)
 {
-    // HACK : add 16 bytes to avoid unsolved memory smashing bug...
-    Garbageable* res = (Garbageable*)malloc(size + 16);
-    global::gObjectTable.push_front(res);
-    return res;
+    // Objects allocated outside of a compilation context are not collected
+    return GarbageableArena::allocate((gGlobal) ? &gGlobal->gArena : NULL, size);
 }
 
 void Garbageable::operator delete(void* ptr)
 {
-    // We may have cases when a pointer will be deleted during
-    // a compilation, thus the pointer has to be removed from the list.
-    if (!global::gHeapCleanup) {
-        global::gObjectTable.remove(static_cast<Garbageable*>(ptr));
-    }
-    free(ptr);
+    GarbageableArena::release(ptr);
 }
 
 void* Garbageable::operator new[](size_t size)
 {
-    // HACK : add 16 bytes to avoid unsolved memory smashing bug...
-    Garbageable* res = (Garbageable*)malloc(size + 16);
-    global::gObjectTable.push_front(res);
-    return res;
+    return GarbageableArena::allocate((gGlobal) ? &gGlobal->gArena : NULL, size);
 }
 
 void Garbageable::operator delete[](void* ptr)
 {
-    // We may have cases when a pointer will be deleted during
-    // a compilation, thus the pointer has to be removed from the list.
-    if (!global::gHeapCleanup) {
-        global::gObjectTable.remove(static_cast<Garbageable*>(ptr));
+    GarbageableArena::release(ptr);
+}
+
+/*****************************************************************************
+                        GarbageableArena
+*****************************************************************************/
+
+GarbageableArena::GarbageableArena()
+    : fCurrent(NULL), fAvailable(0), fCleanup(false), fAllocatedBytes(0), fDeletedObjects(0)
+{
+}
+
+GarbageableArena::~GarbageableArena()
+{
+    cleanup();
+}
+
+char* GarbageableArena::allocateChunk(size_t size)
+{
+    char* chunk = static_cast<char*>(malloc(size));
+    if (!chunk) throw std::bad_alloc();
+    fChunks.push_back(chunk);
+    return chunk;
+}
+
+void* GarbageableArena::allocate(GarbageableArena* arena, size_t size)
+{
+    // HACK : add 16 bytes to avoid unsolved memory smashing bug...
+    size_t block = sizeof(Header) + ((size + 16 + kAlignment - 1) & ~(kAlignment - 1));
+    Header* header;
+
+    if (!arena) {
+        header = static_cast<Header*>(malloc(block));
+        if (!header) throw std::bad_alloc();
+        header->fArena = NULL;
+        header->fIndex = 0;
+        return header + 1;
+    }
+
+    if (block > kChunkSize / 4) {
+        // Big blocks get their own chunk, the current one can still be used
+        header = reinterpret_cast<Header*>(arena->allocateChunk(block));
+    } else {
+        if (block > arena->fAvailable) {
+            arena->fCurrent   = arena->allocateChunk(kChunkSize);
+            arena->fAvailable = kChunkSize;
+        }
+        header = reinterpret_cast<Header*>(arena->fCurrent);
+        arena->fCurrent += block;
+        arena->fAvailable -= block;
+    }
+
+    header->fArena = arena;
+    header->fIndex = arena->fObjects.size();
+    arena->fObjects.push_back(reinterpret_cast<Garbageable*>(header + 1));
+    arena->fAllocatedBytes += block;
+    return header + 1;
+}
+
+void GarbageableArena::release(void* ptr)
+{
+    if (!ptr) return;
+    Header*           header = static_cast<Header*>(ptr) - 1;
+    GarbageableArena* arena  = header->fArena;
+
+    if (!arena) {
+        free(header);
+    } else if (!arena->fCleanup) {
+        // We may have cases when a pointer will be deleted during a compilation,
+        // thus the pointer has to be removed from the table (its memory is kept until cleanup)
+        arena->fObjects[header->fIndex] = NULL;
+        arena->fDeletedObjects++;
+    }
+}
+
+void GarbageableArena::cleanup()
+{
+    printStats();
+
+    // Objects are deleted in reverse allocation order,
+    // 'release' does nothing while the cleanup is running.
+    fCleanup = true;
+    for (size_t i = fObjects.size(); i-- > 0;) {
+        if (fObjects[i]) {
+#ifdef _WIN32
+            // Hack : "this" and actual pointer are not the same: destructor cannot be called...
+#else
+            delete fObjects[i];
+#endif
+        }
+    }
+    for (size_t i = 0; i < fChunks.size(); i++) {
+        free(fChunks[i]);
+    }
+
+    // Reset to default state
+    fObjects.clear();
+    fChunks.clear();
+    fCurrent        = NULL;
+    fAvailable      = 0;
+    fAllocatedBytes = 0;
+    fDeletedObjects = 0;
+    fCleanup        = false;
+}
+
+void GarbageableArena::printStats()
+{
+    if (gTimingSwitch && fObjects.size() > 0) {
+        stringstream stats;
+        stats << "allocation : " << fObjects.size() << " objects, " << fDeletedObjects
+              << " deleted during compilation, " << fAllocatedBytes << " bytes in " << fChunks.size() << " chunks";
+        infoTiming(stats.str().c_str());
     }
-    free(ptr);
 }
@@ -43,6 +43,8 @@
 #include "sourcereader.hh"
 
 class CTree;
+class LibraryRecorder;
+class EvalCache;
 typedef CTree* Tree;
 
 class Symbol;
@@ -114,20 +116,29 @@ struct global {
     bool   gSimplifyDiagrams;
     bool   gLessTempSwitch;
     int    gMaxCopyDelay;
+    bool   gExactDelayLines;  // Ring buffers of the exact delay size instead of a power of two
+    bool   gEvalCacheSwitch;  // Evaluations of the library definitions kept across compilations (see EvalCache)
+    string gPGOLayoutFile;    // Field profile used to order the DSP structure fields
+    bool   gDirtyZones;       // Control code only computed when the zones it depends on have changed
+    bool   gTailSamples;      // 'tail_samples' metadata declared for the DSPs without recursion (see dsp_silence)
     string gOutputFile;
 
     bool gVectorSwitch;
+    bool gSIMDSwitch;  // Explicit SIMD code using the 'faust/dsp/simd.h' vector types
+    int  gBatchSize;   // Number of instances computed together in the lanes of the SIMD vectors (0 : no batch)
     bool gDeepFirstSwitch;
     int  gVecSize;
     int  gVectorLoopVariant;
 
-    bool gOpenMPSwitch;
-    bool gOpenMPLoop;
-    bool gSchedulerSwitch;
-    bool gOpenCLSwitch;
-    bool gCUDASwitch;
-    bool gGroupTaskSwitch;
-    bool gFunTaskSwitch;
+    bool   gOpenMPSwitch;
+    bool   gOpenMPLoop;
+    bool   gSchedulerSwitch;
+    bool   gOpenCLSwitch;
+    bool   gCUDASwitch;
+    bool   gGroupTaskSwitch;
+    bool   gFunTaskSwitch;
+    int    gMinTaskCost;        // Minimal estimated cost of a task in cycles (0 : no cost based grouping)
+    string gTaskCostModelFile;  // Measured costs of the instructions (see InstCostModel)
 
     bool gUIMacroSwitch;
     bool gDumpNorm;
@@ -206,6 +217,8 @@ struct global {
 
     int gBoxSlotNumber;  ///< counter for unique slot number
 
+    EvalCache* gEvalCache;  ///< evaluation cache used by the current evaluation (see evaluateBlockDiagram)
+
     bool gMemoryManager;
 
     Tree BOXTYPEPROP;
@@ -508,8 +521,15 @@ struct global {
     string gErrorMessage;
 
     // GC
-    static list<Garbageable*> gObjectTable;
-    static bool               gHeapCleanup;
+    GarbageableArena gArena;  // Garbageable objects of the context (see Garbageable::operator new)
+
+    // Hash-consing tables, owned by the compilation context so that several contexts can live in different threads
+    HashConsTable<CTree>*          gTreeTable;        // CTree hash table (see CTree::init)
+    unsigned int                   gTreeVisitTime;    // Incremented for each new visit of the trees
+    unsigned int                   gTreeSerial;       // Incremented for each new tree (see CTreeComparator)
+    LibraryRecorder*               gLibraryRecorder;  // Records the trees made by the parser (see SourceReader::getList)
+    HashConsTable<Symbol>*         gSymbolTable;      // Symbol hash table (see Symbol::init)
+    map<const char*, unsigned int> gSymbolPrefixCounters;
 
     global();
     ~global();
@@ -540,8 +560,8 @@ struct global {
     void printCompilationOptions(ostream& dst, bool backend = true);
 };
 
-// Unique shared global pointer
-extern global* gGlobal;
+// Current compilation context: one per thread, so that several DSPs can be compiled concurrently
+extern thread_local global* gGlobal;
 
 #define FAUST_LIB_PATH "FAUST_LIB_PATH"
 #define MAX_STACK_SIZE 50000
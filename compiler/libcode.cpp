@@ -40,6 +40,7 @@
 #include "enrobage.hh"
 #include "errormsg.hh"
 #include "eval.hh"
+#include "evalcache.hh"
 #include "exception.hh"
 #include "floats.hh"
 #include "garbageable.hh"
@@ -183,17 +184,17 @@ extern const char* floatname[4];
 extern const char* castname[4];
 extern double      floatmin[4];
 
-static ifstream* injcode  = NULL;
-static ifstream* enrobage = NULL;
+static thread_local ifstream* injcode  = NULL;
+static thread_local ifstream* enrobage = NULL;
 
 #ifdef OCPP_BUILD
 // Old CPP compiler
-Compiler* old_comp = NULL;
+thread_local Compiler* old_comp = NULL;
 #endif
 
 // FIR container
-InstructionsCompiler* new_comp  = NULL;
-CodeContainer*        container = NULL;
+thread_local InstructionsCompiler* new_comp  = NULL;
+thread_local CodeContainer*        container = NULL;
 
 typedef void* (*compile_fun)(void* arg);
 
@@ -202,15 +203,32 @@ string reorganizeCompilationOptions(int argc, const char* argv[]);
 #ifdef _WIN32
 static void callFun(compile_fun fun)
 {
-    fun(NULL);
+    fun(gGlobal);
 }
 #else
+// Timing can be used outside of the scope of 'gGlobal'
+extern thread_local bool gTimingSwitch;
+
+// The compilation context and the timing switch are thread local, so they are given to the thread
+struct CompileThread {
+    compile_fun fFun;
+    global*     fGlobal;
+    bool        fTiming;
+};
+
+static void* runCompileThread(void* arg)
+{
+    CompileThread* thread = static_cast<CompileThread*>(arg);
+    gTimingSwitch         = thread->fTiming;
+    return thread->fFun(thread->fGlobal);
+}
+
 static void callFun(compile_fun fun)
 {
     if (gGlobal->gOutputLang == "ajs" || startWith(gGlobal->gOutputLang, "wast") ||
         startWith(gGlobal->gOutputLang, "wasm")) {
         // No thread support in asm.js and wast/wasm
-        fun(NULL);
+        fun(gGlobal);
     } else {
         pthread_t      thread;
         pthread_attr_t attr;
@@ -219,7 +237,8 @@ static void callFun(compile_fun fun)
         pthread_attr_setstacksize(&attr, 524288 * 128);
 #endif
         pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-        pthread_create(&thread, &attr, fun, NULL);
+        CompileThread arg = {fun, gGlobal, gTimingSwitch};
+        pthread_create(&thread, &attr, runCompileThread, &arg);
         pthread_join(thread, NULL);
     }
 }
@@ -229,6 +248,7 @@ static Tree evaluateBlockDiagram(Tree expandedDefList, int& numInputs, int& numO
 
 static void* threadEvaluateBlockDiagram(void* arg)
 {
+    gGlobal = static_cast<global*>(arg);
     try {
         gGlobal->gProcessTree =
             evaluateBlockDiagram(gGlobal->gExpandedDefList, gGlobal->gNumInputs, gGlobal->gNumOutputs);
@@ -240,6 +260,7 @@ static void* threadEvaluateBlockDiagram(void* arg)
 
 static void* threadBoxPropagateSig(void* arg)
 {
+    gGlobal = static_cast<global*>(arg);
     try {
         gGlobal->gLsignalsTree =
             boxPropagateSig(gGlobal->nil, gGlobal->gProcessTree, makeSigInputList(gGlobal->gNumInputs));
@@ -253,10 +274,10 @@ static void* threadBoxPropagateSig(void* arg)
                         Global context variable
 *****************************************************************/
 
-global* gGlobal = NULL;
+thread_local global* gGlobal = NULL;
 
 // Timing can be used outside of the scope of 'gGlobal'
-extern bool gTimingSwitch;
+extern thread_local bool gTimingSwitch;
 
 /****************************************************************
                         Parser variables
@@ -387,6 +408,34 @@ static bool processCmdline(int argc, const char* argv[])
             gGlobal->gMaxCopyDelay = std::atoi(argv[i + 1]);
             i += 2;
 
+        } else if (isCmd(argv[i], "-simd", "--simd")) {
+            gGlobal->gSIMDSwitch = true;
+            i += 1;
+
+        } else if (isCmd(argv[i], "-batch", "--batch") && (i + 1 < argc)) {
+            gGlobal->gBatchSize = std::atoi(argv[i + 1]);
+            i += 2;
+
+        } else if (isCmd(argv[i], "-edl", "--exact-delay-lines")) {
+            gGlobal->gExactDelayLines = true;
+            i += 1;
+
+        } else if (isCmd(argv[i], "-ec", "--eval-cache")) {
+            gGlobal->gEvalCacheSwitch = true;
+            i += 1;
+
+        } else if (isCmd(argv[i], "-pgo-layout", "--pgo-layout") && (i + 1 < argc)) {
+            gGlobal->gPGOLayoutFile = argv[i + 1];
+            i += 2;
+
+        } else if (isCmd(argv[i], "-dz", "--dirty-zones")) {
+            gGlobal->gDirtyZones = true;
+            i += 1;
+
+        } else if (isCmd(argv[i], "-ts", "--tail-samples")) {
+            gGlobal->gTailSamples = true;
+            i += 1;
+
         } else if (isCmd(argv[i], "-mem", "--memory-manager")) {
             gGlobal->gMemoryManager = true;
             i += 1;
@@ -440,6 +489,14 @@ static bool processCmdline(int argc, const char* argv[])
             gGlobal->gGroupTaskSwitch = true;
             i += 1;
 
+        } else if (isCmd(argv[i], "-mtc", "--min-task-cost") && (i + 1 < argc)) {
+            gGlobal->gMinTaskCost = std::atoi(argv[i + 1]);
+            i += 2;
+
+        } else if (isCmd(argv[i], "-tcm", "--task-cost-model") && (i + 1 < argc)) {
+            gGlobal->gTaskCostModelFile = argv[i + 1];
+            i += 2;
+
         } else if (isCmd(argv[i], "-fun", "--funTasks")) {
             gGlobal->gFunTaskSwitch = true;
             i += 1;
@@ -640,6 +697,28 @@ static bool processCmdline(int argc, const char* argv[])
         throw faustexception("ERROR : 'ocpp' option can only be used in scalar mode\n");
     }
 
+    if (gGlobal->gSIMDSwitch && (!gGlobal->gVectorSwitch || gGlobal->gOpenMPSwitch || gGlobal->gSchedulerSwitch ||
+                                 gGlobal->gOutputLang != "cpp")) {
+        throw faustexception("ERROR : 'simd' option can only be used with the cpp backend in 'vec' mode\n");
+    }
+
+    if (gGlobal->gDirtyZones && (gGlobal->gVectorSwitch || gGlobal->gBatchSize != 0)) {
+        throw faustexception("ERROR : 'dirty-zones' option can only be used in scalar mode (without -batch)\n");
+    }
+
+    if (gGlobal->gBatchSize != 0) {
+        if (gGlobal->gVectorSwitch || gGlobal->gOpenMPSwitch || gGlobal->gSchedulerSwitch || gGlobal->gOpenCLSwitch ||
+            gGlobal->gCUDASwitch || gGlobal->gOutputLang != "cpp") {
+            throw faustexception("ERROR : 'batch' option can only be used with the cpp backend in 'scalar' mode\n");
+        }
+        if (gGlobal->gBatchSize < 2 || (gGlobal->gBatchSize & (gGlobal->gBatchSize - 1)) != 0) {
+            stringstream error;
+            error << "ERROR : invalid batch size [-batch = " << gGlobal->gBatchSize << "] should be a power of 2, at least 2"
+                  << endl;
+            throw faustexception(error.str());
+        }
+    }
+
     if (gGlobal->gVectorLoopVariant < 0 || gGlobal->gVectorLoopVariant > 1) {
         stringstream error;
         error << "ERROR : invalid loop variant [-lv = " << gGlobal->gVectorLoopVariant << "] should be 0 or 1" << endl;
@@ -715,6 +794,13 @@ static void printHelp()
     cout << "-mcd <n> \t--max-copy-delay <n> threshold between copy and ring buffer implementation (default 16 "
             "samples)\n";
     cout << "-mem \t\t--memory allocate static in global state using a custom memory manager\n";
+    cout << "-edl \t\tuse --exact-delay-lines ring buffers of the delay size instead of the next power of two\n";
+    cout << "-ec \t\tuse an --eval-cache keeping the evaluations of the library definitions across compilations\n";
+    cout << "-pgo-layout <file> \t--pgo-layout <file> order the DSP structure fields using the field profile <file>\n";
+    cout << "-dz \t\t--dirty-zones only compute the control code depending on the zones changed since the last compute "
+            "(scalar mode)\n";
+    cout << "-ts 		--tail-samples declare the 'tail_samples' metadata of the DSPs without recursion (used by "
+            "dsp_silence)\n";
     cout << "-a <file> \twrapper architecture file\n";
     cout << "-i \t\t--inline-architecture-files \n";
     cout << "-cn <name> \t--class-name <name> specify the name of the dsp class to be used instead of mydsp \n";
@@ -727,6 +813,8 @@ static void printHelp()
     cout << "-scal   \t--scalar generate non-vectorized code\n";
     cout << "-vec    \t--vectorize generate easier to vectorize code\n";
     cout << "-vs <n> \t--vec-size <n> size of the vector (default 32 samples)\n";
+    cout << "-simd   \t--simd generate explicit SIMD code in --vectorize mode (cpp backend only)\n";
+    cout << "-batch <n> \t--batch <n> generate a class computing <n> instances together in SIMD vectors, in scalar mode (cpp backend only)\n";
     cout << "-lv <n> \t--loop-variant [0:fastest (default), 1:simple] \n";
     cout << "-omp    \t--openMP generate OpenMP pragmas, activates --vectorize option\n";
     cout << "-pl     \t--par-loop generate parallel loops in --openMP mode\n";
@@ -735,6 +823,9 @@ static void printHelp()
     cout << "-cuda   \t--cuda generate tasks with CUDA (experimental) \n";
     cout << "-dfs    \t--deepFirstScheduling schedule vector loops in deep first order\n";
     cout << "-g    \t\t--groupTasks group single-threaded sequential tasks together when -omp or -sch is used\n";
+    cout << "-mtc <n> \t--min-task-cost <n> group the tasks estimated to cost less than <n> cycles (implies -g)\n";
+    cout << "-tcm <file> \t--task-cost-model <file> use the instruction costs (in cycles) measured in <file> to estimate the "
+            "tasks costs\n";
     cout << "-fun  \t\t--funTasks separate tasks code as separated functions (in -vec, -sch, or -omp mode)\n";
     cout << "-lang <lang> \t--language generate various output formats : c, ocpp, cpp, rust, java, js, ajs, llvm, "
             "cllvm, fir, wast/wasm, interp (default cpp)\n";
@@ -974,6 +1065,7 @@ static void parseSourceFiles()
     }
 
     gGlobal->gExpandedDefList = gGlobal->gReader.expandList(gGlobal->gResult2);
+    gGlobal->gReader.printStats();
 
     endTiming("parser");
 }
@@ -983,7 +1075,21 @@ static Tree evaluateBlockDiagram(Tree expandedDefList, int& numInputs, int& numO
     startTiming("evaluation");
     // cout << "expandedDefList " << *expandedDefList << endl;
 
-    Tree process = evalprocess(expandedDefList);
+    // The diagrams and the documentation use the definition names set by a complete evaluation
+    EvalCache cache;
+    if (gGlobal->gEvalCacheSwitch && !gGlobal->gDrawPSSwitch && !gGlobal->gDrawSVGSwitch &&
+        !gGlobal->gPrintDocSwitch) {
+        gGlobal->gEvalCache = &cache;
+    }
+    Tree process;
+    try {
+        process = evalprocess(expandedDefList);
+    } catch (faustexception& e) {
+        gGlobal->gEvalCache = nullptr;
+        throw;
+    }
+    if (gGlobal->gEvalCache) cache.printStats();
+    gGlobal->gEvalCache = nullptr;
     if (gGlobal->gErrorCount > 0) {
         stringstream error;
         error << "ERROR : total of " << gGlobal->gErrorCount << " errors during the compilation of "
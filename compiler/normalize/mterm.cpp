@@ -30,7 +30,7 @@
 
 using namespace std;
 
-typedef map<Tree, int> MP;
+typedef map<Tree, int, CTreeComparator> MP;
 
 mterm::mterm() : fCoef(sigInt(0))
 {
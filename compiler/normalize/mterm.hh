@@ -44,7 +44,7 @@ using namespace std;
 
 class mterm : public virtual Garbageable {
     Tree           fCoef;     ///< constant part of the term (usually 1 or -1)
-    map<Tree, int> fFactors;  ///< non constant terms and their power
+    map<Tree, int, CTreeComparator> fFactors;  ///< non constant terms and their power
 
    public:
     mterm();                ///< create a 0 mterm
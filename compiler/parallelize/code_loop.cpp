@@ -37,9 +37,12 @@
 #include "code_loop.hh"
 #include "floats.hh"
 #include "global.hh"
+#include "instructions_complexity.hh"
 
 using namespace std;
 
+thread_local unsigned int CodeLoop::gSerialCounter = 0;
+
 CodeLoop::CodeLoop(CodeLoop* encl, string index_name, int size)
     : fIsRecursive(false),
       fRecSymbolSet(gGlobal->nil),
@@ -47,6 +50,7 @@ CodeLoop::CodeLoop(CodeLoop* encl, string index_name, int size)
       fSize(size),
       fOrder(-1),
       fIndex(-1),
+      fSerial(++gSerialCounter),
       fPreInst(new BlockInst()),
       fComputeInst(new BlockInst()),
       fPostInst(new BlockInst()),
@@ -91,34 +95,47 @@ void CodeLoop::generateDAGScalarLoop(BlockInst* block, DeclareVarInst* count, bo
     }
 
     // Generate code before the loop
-    if (fPreInst->fCode.size() > 0) {
-        block->pushBackInst(InstBuilder::genLabelInst("/* Pre code */"));
-        if (omp) {
-            block->pushBackInst(InstBuilder::genLabelInst("#pragma omp single"));
-        }
-        pushBlock(fPreInst, block);
-    }
+    generateDAGPreCode(block, omp);
 
     // Generate loop code
     if (fComputeInst->fCode.size() > 0) {
-        DeclareVarInst* loop_decl = InstBuilder::genDecLoopVar(fLoopIndex, InstBuilder::genBasicTyped(Typed::kInt32),
-                                                               InstBuilder::genInt32NumInst(0));
-        ValueInst*      loop_end  = InstBuilder::genLessThan(loop_decl->load(), count->load());
-        StoreVarInst*   loop_increment = loop_decl->store(InstBuilder::genAdd(loop_decl->load(), 1));
-
         block->pushBackInst(InstBuilder::genLabelInst("/* Compute code */"));
         if (omp) {
             block->pushBackInst(InstBuilder::genLabelInst("#pragma omp for"));
         }
+        block->pushBackInst(generateDAGComputeLoop(count));
+    }
 
-        BlockInst* block1 = InstBuilder::genBlockInst();
-        pushBlock(fComputeInst, block1);
+    // Generate code after the loop
+    generateDAGPostCode(block, omp);
+}
 
-        ForLoopInst* loop = InstBuilder::genForLoopInst(loop_decl, loop_end, loop_increment, block1);
-        block->pushBackInst(loop);
+void CodeLoop::generateDAGPreCode(BlockInst* block, bool omp)
+{
+    if (fPreInst->fCode.size() > 0) {
+        block->pushBackInst(InstBuilder::genLabelInst("/* Pre code */"));
+        if (omp) {
+            block->pushBackInst(InstBuilder::genLabelInst("#pragma omp single"));
+        }
+        pushBlock(fPreInst, block);
     }
+}
 
-    // Generate code after the loop
+ForLoopInst* CodeLoop::generateDAGComputeLoop(DeclareVarInst* count)
+{
+    DeclareVarInst* loop_decl = InstBuilder::genDecLoopVar(fLoopIndex, InstBuilder::genBasicTyped(Typed::kInt32),
+                                                           InstBuilder::genInt32NumInst(0));
+    ValueInst*      loop_end  = InstBuilder::genLessThan(loop_decl->load(), count->load());
+    StoreVarInst*   loop_increment = loop_decl->store(InstBuilder::genAdd(loop_decl->load(), 1));
+
+    BlockInst* block = InstBuilder::genBlockInst();
+    pushBlock(fComputeInst, block);
+
+    return InstBuilder::genForLoopInst(loop_decl, loop_end, loop_increment, block);
+}
+
+void CodeLoop::generateDAGPostCode(BlockInst* block, bool omp)
+{
     if (fPostInst->fCode.size() > 0) {
         block->pushBackInst(InstBuilder::genLabelInst("/* Post code */"));
         if (omp) {
@@ -185,6 +202,12 @@ void CodeLoop::concat(CodeLoop* l)
     fBackwardLoopDependencies = l->fBackwardLoopDependencies;
 }
 
+void CodeLoop::group(CodeLoop* l)
+{
+    fExtraLoops.push_back(l);
+    fBackwardLoopDependencies.insert(l->fBackwardLoopDependencies.begin(), l->fBackwardLoopDependencies.end());
+}
+
 // Graph sorting
 
 void CodeLoop::setOrder(CodeLoop* l, int order, lclgraph& V)
@@ -206,7 +229,7 @@ void CodeLoop::setLevel(int order, const lclset& T1, lclset& T2, lclgraph& V)
     }
 }
 
-void CodeLoop::resetOrder(CodeLoop* l, set<CodeLoop*>& visited)
+void CodeLoop::resetOrder(CodeLoop* l, lclset& visited)
 {
     // Not yet visited...
     if (visited.find(l) == visited.end()) {
@@ -222,7 +245,7 @@ void CodeLoop::resetOrder(CodeLoop* l, set<CodeLoop*>& visited)
 void CodeLoop::sortGraph(CodeLoop* root, lclgraph& V)
 {
     faustassert(root);
-    set<CodeLoop*> visited;
+    lclset visited;
     resetOrder(root, visited);
 
     lclset T1, T2;
@@ -264,7 +287,7 @@ void CodeLoop::computeUseCount(CodeLoop* l)
 /**
  * Group together sequences of loops
  */
-void CodeLoop::groupSeqLoops(CodeLoop* l, set<CodeLoop*>& visited)
+void CodeLoop::groupSeqLoops(CodeLoop* l, lclset& visited)
 {
     if (visited.find(l) == visited.end()) {
         visited.insert(l);
@@ -288,3 +311,136 @@ void CodeLoop::groupSeqLoops(CodeLoop* l, set<CodeLoop*>& visited)
         }
     }
 }
+
+/**
+ * Cost of a block of gVecSize samples : the pre and post code are executed once, the compute code for each sample
+ */
+double CodeLoop::getCost(const InstCostModel& model)
+{
+    double cost = 0;
+    for (list<CodeLoop*>::const_iterator s = fExtraLoops.begin(); s != fExtraLoops.end(); s++) {
+        cost += (*s)->getCost(model);
+    }
+
+    InstComplexityVisitor pre_post;
+    fPreInst->accept(&pre_post);
+    fPostInst->accept(&pre_post);
+
+    InstComplexityVisitor compute;
+    fComputeInst->accept(&compute);
+
+    return cost + pre_post.cost(model) + compute.cost(model) * gGlobal->gVecSize;
+}
+
+int CodeLoop::getLoopCount()
+{
+    int count = 1;
+    for (list<CodeLoop*>::const_iterator s = fExtraLoops.begin(); s != fExtraLoops.end(); s++) {
+        count += (*s)->getLoopCount();
+    }
+    return count;
+}
+
+void CodeLoop::collectLoops(CodeLoop* l, lclset& loops)
+{
+    if (loops.find(l) == loops.end()) {
+        loops.insert(l);
+        for (lclset::const_iterator p = l->fBackwardLoopDependencies.begin(); p != l->fBackwardLoopDependencies.end();
+             p++) {
+            collectLoops(*p, loops);
+        }
+    }
+}
+
+/**
+ * The loops depending on 'old_loop' now depend on 'new_loop' that computes it
+ */
+void CodeLoop::replaceLoop(const lclset& loops, CodeLoop* old_loop, CodeLoop* new_loop)
+{
+    for (lclset::const_iterator p = loops.begin(); p != loops.end(); p++) {
+        if (*p != new_loop && (*p)->fBackwardLoopDependencies.erase(old_loop) > 0) {
+            (*p)->fBackwardLoopDependencies.insert(new_loop);
+        }
+    }
+}
+
+/**
+ * Group the loops costing less than 'min_cost' cycles, so that the tasks are not dominated by their scheduling cost :
+ *
+ * - a cheap loop used by a single loop is computed at the beginning of the task of this loop, until the task
+ *   reaches 'min_cost'
+ * - the cheap independent loops of a level of the graph are computed together, until the task reaches 'min_cost'
+ *
+ * The loops costing more than 'min_cost' are kept in their own task, to be computed in parallel.
+ */
+void CodeLoop::groupCheapLoops(CodeLoop* root, double min_cost, const InstCostModel& model)
+{
+    lclset loops;
+    collectLoops(root, loops);
+
+    map<CodeLoop*, double>    costs;
+    map<CodeLoop*, CodeLoop*> users;  // the loop using each loop, 0 if used by several loops
+    for (lclset::const_iterator p = loops.begin(); p != loops.end(); p++) {
+        costs[*p] = (*p)->getCost(model);
+        for (lclset::const_iterator d = (*p)->fBackwardLoopDependencies.begin();
+             d != (*p)->fBackwardLoopDependencies.end(); d++) {
+            users[*d] = (users.find(*d) == users.end()) ? *p : 0;
+        }
+    }
+
+    // A chain of cheap loops is grouped in its last user, as long as the task costs less than 'min_cost'
+    // (the candidates are collected first, since the grouped loops are erased from 'loops')
+    vector<CodeLoop*> candidates(loops.rbegin(), loops.rend());
+    for (vector<CodeLoop*>::const_iterator p = candidates.begin(); p != candidates.end(); p++) {
+        CodeLoop* f = *p;
+        CodeLoop* l = (f != root) ? users[f] : 0;
+        if (!l || costs[f] >= min_cost || costs[l] >= min_cost) {
+            continue;
+        }
+        // The other users of the dependencies of 'f' are unchanged
+        for (lclset::const_iterator d = f->fBackwardLoopDependencies.begin(); d != f->fBackwardLoopDependencies.end();
+             d++) {
+            if (users[*d] == f) {
+                users[*d] = l;
+            } else if (l->fBackwardLoopDependencies.find(*d) != l->fBackwardLoopDependencies.end()) {
+                // Used by 'f' and 'l' before, now only by 'l' (when they were its only users)
+                int count = 0;
+                for (lclset::const_iterator u = loops.begin(); u != loops.end(); u++) {
+                    if (*u != f && (*u)->fBackwardLoopDependencies.find(*d) != (*u)->fBackwardLoopDependencies.end()) {
+                        count++;
+                    }
+                }
+                if (count == 1) {
+                    users[*d] = l;
+                }
+            }
+        }
+        l->fExtraLoops.push_front(f);
+        l->fBackwardLoopDependencies.erase(f);
+        l->fBackwardLoopDependencies.insert(f->fBackwardLoopDependencies.begin(), f->fBackwardLoopDependencies.end());
+        costs[l] += costs[f];
+        loops.erase(f);
+    }
+
+    // The loops of a level are not connected, grouping them cannot make a cycle
+    lclgraph G;
+    sortGraph(root, G);
+    for (int level = int(G.size() - 1); level > 0; level--) {
+        CodeLoop* task = 0;
+        for (lclset::const_iterator p = G[level].begin(); p != G[level].end(); p++) {
+            if (costs[*p] >= min_cost) {
+                continue;
+            } else if (!task) {
+                task = *p;
+            } else {
+                task->group(*p);
+                costs[task] += costs[*p];
+                loops.erase(*p);
+                replaceLoop(loops, *p, task);
+                if (costs[task] >= min_cost) {
+                    task = 0;
+                }
+            }
+        }
+    }
+}
@@ -63,8 +63,16 @@ Scalarisation d'une boucle:
 */
 
 class CodeLoop;
+struct InstCostModel;
 
-typedef set<CodeLoop*> lclset;
+/**
+ * Order loops by creation, so that the generated code does not depend on the memory layout
+ */
+struct CodeLoopComparator {
+    bool operator()(const CodeLoop* a, const CodeLoop* b) const;
+};
+
+typedef set<CodeLoop*, CodeLoopComparator> lclset;
 typedef vector<lclset> lclgraph;
 
 class CodeLoop : public virtual Garbageable {
@@ -77,6 +85,9 @@ class CodeLoop : public virtual Garbageable {
     int             fSize;           ///< number of iterations of the loop
     int             fOrder;          ///< used during topological sort
     int             fIndex;
+    unsigned int    fSerial;  ///< creation number, used to order loops
+
+    static thread_local unsigned int gSerialCounter;
 
     BlockInst* fPreInst;
     BlockInst* fComputeInst;
@@ -88,8 +99,8 @@ class CodeLoop : public virtual Garbageable {
     list<CodeLoop*> fExtraLoops;  ///< extra loops that where in sequences
 
     set<Tree>      fRecDependencies;           ///< Loops having recursive dependencies must be merged
-    set<CodeLoop*> fBackwardLoopDependencies;  ///< Loops that must be computed before this one
-    set<CodeLoop*> fForwardLoopDependencies;   ///< Loops that will be computed after this one
+    lclset fBackwardLoopDependencies;  ///< Loops that must be computed before this one
+    lclset fForwardLoopDependencies;   ///< Loops that will be computed after this one
 
     void pushBlock(BlockInst* block, BlockInst* loop)
     {
@@ -103,11 +114,16 @@ class CodeLoop : public virtual Garbageable {
 
     void absorb(CodeLoop* l);  ///< absorb a loop inside this one
     void concat(CodeLoop* l);
+    void group(CodeLoop* l);  ///< compute an independent loop in the same task
+
+    // Task grouping
+    static void collectLoops(CodeLoop* l, lclset& loops);
+    static void replaceLoop(const lclset& loops, CodeLoop* old_loop, CodeLoop* new_loop);
 
     // Graph sorting
     static void setOrder(CodeLoop* l, int order, lclgraph& V);
     static void setLevel(int order, const lclset& T1, lclset& T2, lclgraph& V);
-    static void resetOrder(CodeLoop* l, set<CodeLoop*>& visited);
+    static void resetOrder(CodeLoop* l, lclset& visited);
 
    public:
     ///< create a recursive loop
@@ -118,6 +134,7 @@ class CodeLoop : public virtual Garbageable {
           fSize(size),
           fOrder(-1),
           fIndex(-1),
+          fSerial(++gSerialCounter),
           fPreInst(new BlockInst()),
           fComputeInst(new BlockInst()),
           fPostInst(new BlockInst()),
@@ -149,8 +166,10 @@ class CodeLoop : public virtual Garbageable {
 
     int getIndex() { return fIndex; }
 
-    set<CodeLoop*>& getForwardLoopDependencies() { return fForwardLoopDependencies; }
-    set<CodeLoop*>& getBackwardLoopDependencies() { return fBackwardLoopDependencies; }
+    unsigned int getSerial() const { return fSerial; }
+
+    lclset& getForwardLoopDependencies() { return fForwardLoopDependencies; }
+    lclset& getBackwardLoopDependencies() { return fBackwardLoopDependencies; }
 
     ValueInst* getLoopIndex() { return InstBuilder::genLoadLoopVar(fLoopIndex); }
 
@@ -158,6 +177,11 @@ class CodeLoop : public virtual Garbageable {
 
     void generateDAGScalarLoop(BlockInst* block, DeclareVarInst* count, bool omp);
 
+    // Parts of the DAG loop, used when the compute loops of several loops are interleaved
+    void         generateDAGPreCode(BlockInst* block, bool omp);
+    ForLoopInst* generateDAGComputeLoop(DeclareVarInst* count);
+    void         generateDAGPostCode(BlockInst* block, bool omp);
+
     void transform(DispatchVisitor* visitor)
     {
         // Transform extra loops
@@ -174,7 +198,18 @@ class CodeLoop : public virtual Garbageable {
 
     static void sortGraph(CodeLoop* root, lclgraph& V);
     static void computeUseCount(CodeLoop* l);
-    static void groupSeqLoops(CodeLoop* l, set<CodeLoop*>& visited);
+    static void groupSeqLoops(CodeLoop* l, lclset& visited);
+
+    ///< estimated cost in cycles of a block of gVecSize samples
+    double getCost(const InstCostModel& model);
+    int    getLoopCount();  ///< number of loops computed in this task
+
+    static void groupCheapLoops(CodeLoop* root, double min_cost, const InstCostModel& model);
 };
 
+inline bool CodeLoopComparator::operator()(const CodeLoop* a, const CodeLoop* b) const
+{
+    return a->getSerial() < b->getSerial();
+}
+
 #endif
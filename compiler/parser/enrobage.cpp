@@ -250,31 +250,24 @@ void streamCopyUntilEnd(istream& src, ostream& dst)
     streamCopyUntil(src, dst, "<<<FORBIDDEN LINE IN A FAUST ARCHITECTURE FILE>>>");
 }
 
-#define TRY_OPEN(filename)           \
-    ifstream* f = new ifstream();    \
-    f->open(filename, ifstream::in); \
-    err = chdir(old);                \
-    if (f->is_open())                \
-        return f;                    \
-    else                             \
-        delete f;
-
 /**
- * Try to open an architecture file searching in various directories
+ * Try to open an architecture file searching in various directories.
+ * The directories are prepended to the filename instead of being made current,
+ * since the current directory is shared by all the compilation threads.
  */
 ifstream* openArchStream(const char* filename)
 {
-    char  buffer[FAUST_PATH_MAX];
-    char* old = getcwd(buffer, FAUST_PATH_MAX);
-    int   err;
+    ifstream* f = new ifstream();
+    f->open(filename, ifstream::in);
+    if (f->is_open()) return f;
 
-    TRY_OPEN(filename);
     for (string dirname : gGlobal->gArchitectureDirList) {
-        if ((err = chdir(dirname.c_str())) == 0) {
-            TRY_OPEN(filename);
-        }
+        f->clear();
+        f->open((dirname + '/' + filename).c_str(), ifstream::in);
+        if (f->is_open()) return f;
     }
 
+    delete f;
     return 0;
 }
 
@@ -342,41 +335,18 @@ bool checkURL(const char* filename)
  */
 static FILE* fopenAt(string& fullpath, const char* dir, const char* filename)
 {
-    int  err;
-    char olddirbuffer[FAUST_PATH_MAX];
-    char newdirbuffer[FAUST_PATH_MAX];
-
-    char* olddir = getcwd(olddirbuffer, FAUST_PATH_MAX);
-
-    if (chdir(dir) == 0) {
-        FILE* f      = fopen(filename, "r");
-        char* newdir = getcwd(newdirbuffer, FAUST_PATH_MAX);
-        if (!newdir) {
-            fclose(f);
-            stringstream error;
-            error << "ERROR : getcwd : " << strerror(errno) << endl;
-            throw faustexception(error.str());
-        }
-        fullpath = newdir;
-        fullpath += '/';
-        fullpath += filename;
-        err = chdir(olddir);
-        if (err != 0) {
-            fclose(f);
-            stringstream error;
-            error << "ERROR : cannot change back directory to '" << ((olddir) ? olddir : "null")
-                  << "' : " << strerror(errno) << endl;
-            throw faustexception(error.str());
+    char  dirbuffer[FAUST_PATH_MAX];
+    char* fulldir = realpath(dir, dirbuffer);
+
+    // The current directory is not changed, since it is shared by all the compilation threads
+    if (fulldir) {
+        string path = string(fulldir) + '/' + filename;
+        FILE*  f    = fopen(path.c_str(), "r");
+        if (f) {
+            fullpath = path;
         }
         return f;
     }
-    err = chdir(olddir);
-    if (err != 0) {
-        stringstream error;
-        error << "ERROR : cannot change back directory to '" << ((olddir) ? olddir : "null")
-              << "' : " << strerror(errno) << endl;
-        throw faustexception(error.str());
-    }
     return 0;
 }
 
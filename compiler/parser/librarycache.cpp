@@ -0,0 +1,438 @@
+/************************************************************************
+ ************************************************************************
+    FAUST compiler
+    Copyright (C) 2003-2018 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ ************************************************************************
+ ************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "compatibility.hh"
+#include "enrobage.hh"
+#include "export.hh"
+#include "global.hh"
+#include "libfaust.h"
+#include "librarycache.hh"
+#include "list.hh"
+#include "signals.hh"
+
+#define LIBRARY_CACHE_MAGIC "FAUSTLIB"
+#define LIBRARY_CACHE_VERSION 1
+
+// The entries of the process : kind and key => encoded entry (see LibraryRecorder::write)
+static std::mutex                               gLibraryCacheLock;
+static map<string, shared_ptr<const string> > gLibraryCache;
+
+/*****************************************************************************
+    Binary encoding
+*****************************************************************************/
+
+// The primitives the parser puts in pointer nodes, in a fixed order (only add new ones at the end)
+static const vector<void*>& primitives()
+{
+    static const vector<void*> prims = {
+        (void*)(prim1)sigDelay1,       (void*)(prim1)sigIntCast,       (void*)(prim1)sigFloatCast,
+        (void*)(prim2)sigAdd,          (void*)(prim2)sigSub,           (void*)(prim2)sigMul,
+        (void*)(prim2)sigDiv,          (void*)(prim2)sigRem,           (void*)(prim2)sigFixDelay,
+        (void*)(prim2)sigAND,          (void*)(prim2)sigOR,            (void*)(prim2)sigXOR,
+        (void*)(prim2)sigLeftShift,    (void*)(prim2)sigRightShift,    (void*)(prim2)sigLT,
+        (void*)(prim2)sigLE,           (void*)(prim2)sigGT,            (void*)(prim2)sigGE,
+        (void*)(prim2)sigEQ,           (void*)(prim2)sigNE,            (void*)(prim2)sigPrefix,
+        (void*)(prim2)sigAttach,       (void*)(prim2)sigEnable,        (void*)(prim2)sigControl,
+        (void*)(prim3)sigReadOnlyTable, (void*)(prim3)sigSelect2,      (void*)(prim4)sigSelect3,
+        (void*)(prim5)sigWriteReadTable};
+    return prims;
+}
+
+uint64_t CacheReader::readCount()
+{
+    uint64_t n = 0;
+    for (int shift = 0; shift < 64 && fPos < fData.size(); shift += 7) {
+        unsigned char c = fData[fPos++];
+        n |= uint64_t(c & 0x7f) << shift;
+        if (!(c & 0x80)) return n;
+    }
+    fFail = true;
+    return 0;
+}
+
+size_t CacheReader::readIndex(size_t size)
+{
+    uint64_t i = readCount();
+    if (i >= size) {
+        fFail = true;
+        return 0;
+    }
+    return size_t(i);
+}
+
+string CacheReader::readString()
+{
+    uint64_t n = readCount();
+    if (fFail || n > fData.size() - fPos) {
+        fFail = true;
+        return "";
+    }
+    string str = fData.substr(fPos, size_t(n));
+    fPos += size_t(n);
+    return str;
+}
+
+unsigned char CacheReader::readByte()
+{
+    if (fPos >= fData.size()) {
+        fFail = true;
+        return 0;
+    }
+    return fData[fPos++];
+}
+
+double CacheReader::readDouble()
+{
+    double x = 0.;
+    if (fData.size() - fPos < sizeof(double)) {
+        fFail = true;
+    } else {
+        memcpy(&x, &fData[fPos], sizeof(double));
+        fPos += sizeof(double);
+    }
+    return x;
+}
+
+bool TreeWriter::add(Tree t)
+{
+    if (fIndex.find(t) != fIndex.end()) return true;
+    for (int i = 0; i < t->arity(); i++) {
+        if (!add(t->branch(i))) return false;
+    }
+    const Node& n     = t->node();
+    size_t      start = fTrees.size();
+    fTrees += char(n.type());
+    switch (n.type()) {
+        case kIntNode: {
+            // Zigzag encoding of signed integers
+            int64_t i = n.getInt();
+            writeCount(fTrees, (uint64_t(i) << 1) ^ uint64_t(i >> 63));
+            break;
+        }
+        case kDoubleNode: {
+            double x = n.getDouble();
+            fTrees.append(reinterpret_cast<const char*>(&x), sizeof(double));
+            break;
+        }
+        case kSymNode: {
+            map<Sym, size_t>::iterator it = fSymbolsIndex.find(n.getSym());
+            if (it == fSymbolsIndex.end()) {
+                it = fSymbolsIndex.insert(make_pair(n.getSym(), fSymbolsIndex.size())).first;
+                writeString(fSymbols, name(n.getSym()));
+            }
+            writeCount(fTrees, it->second);
+            break;
+        }
+        case kPointerNode: {
+            const vector<void*>&          prims = primitives();
+            vector<void*>::const_iterator it    = find(prims.begin(), prims.end(), n.getPointer());
+            if (it == prims.end()) {
+                fTrees.resize(start);
+                return false;
+            }
+            writeCount(fTrees, it - prims.begin());
+            break;
+        }
+        default:
+            fTrees.resize(start);
+            return false;
+    }
+    writeCount(fTrees, t->arity());
+    for (int i = 0; i < t->arity(); i++) {
+        writeCount(fTrees, fIndex[t->branch(i)]);
+    }
+    size_t index = fIndex.size();
+    fIndex[t]    = index;
+    return true;
+}
+
+void TreeWriter::write(string& data)
+{
+    writeCount(data, fSymbolsIndex.size());
+    data += fSymbols;
+    writeCount(data, fIndex.size());
+    data += fTrees;
+}
+
+bool TreeReader::read(CacheReader& in)
+{
+    const vector<void*>& prims = primitives();
+
+    size_t symbols_count = in.readCount();
+    if (symbols_count > in.fData.size()) return false;
+    vector<Sym> symbols(symbols_count);
+    for (size_t i = 0; i < symbols.size() && !in.fFail; i++) {
+        symbols[i] = symbol(in.readString());
+    }
+
+    size_t count = in.readCount();
+    for (size_t i = 0; i < count && !in.fFail; i++) {
+        switch (in.readByte()) {
+            case kIntNode: {
+                uint64_t z = in.readCount();
+                fNodes.push_back(Node(int(int64_t(z >> 1) ^ -int64_t(z & 1))));
+                break;
+            }
+            case kDoubleNode:
+                fNodes.push_back(Node(in.readDouble()));
+                break;
+            case kSymNode: {
+                size_t s = in.readIndex(symbols.size());
+                fNodes.push_back((in.fFail) ? Node(0) : Node(symbols[s]));
+                break;
+            }
+            case kPointerNode:
+                fNodes.push_back(Node(prims[in.readIndex(prims.size())]));
+                break;
+            default:
+                in.fFail = true;
+                break;
+        }
+        size_t arity = in.readCount();
+        fArities.push_back(arity);
+        for (size_t j = 0; j < arity && !in.fFail; j++) {
+            // Branches are made before
+            fBranches.push_back(in.readIndex(i));
+        }
+    }
+    return !in.fFail;
+}
+
+void TreeReader::make()
+{
+    fTrees.resize(fNodes.size());
+    for (size_t i = 0, b = 0; i < fNodes.size(); i++) {
+        tvec br(fArities[i]);
+        for (size_t j = 0; j < fArities[i]; j++) br[j] = fTrees[fBranches[b++]];
+        fTrees[i] = tree(fNodes[i], br);
+    }
+}
+
+/*****************************************************************************
+    LibraryRecorder
+*****************************************************************************/
+
+/*
+ Encoding : the trees tables (see TreeWriter), the actions (kind, tree and value indexes) and the index of the definitions list.
+ Trees are numbered in their first make order, so that they are rebuilt in the same order.
+*/
+bool LibraryRecorder::write(Tree ldef, string& data)
+{
+    if (!fCacheable) return false;
+
+    TreeWriter trees;
+    for (size_t i = 0; i < fTrees.size(); i++) {
+        if (!trees.add(fTrees[i])) return false;
+    }
+    for (size_t i = 0; i < fActions.size(); i++) {
+        if (!trees.add(fActions[i].fTree) || !trees.add(fActions[i].fValue)) return false;
+    }
+    if (!trees.add(ldef)) return false;
+
+    data.clear();
+    trees.write(data);
+    writeCount(data, fActions.size());
+    for (size_t i = 0; i < fActions.size(); i++) {
+        data += char(fActions[i].fKind);
+        writeCount(data, trees.index(fActions[i].fTree));
+        writeCount(data, trees.index(fActions[i].fValue));
+    }
+    writeCount(data, trees.index(ldef));
+    return true;
+}
+
+/*****************************************************************************
+    LibraryCache
+*****************************************************************************/
+
+// Replays an encoded parse in the current context, returns NULL if the encoding is not valid
+static Tree replay(const string& data)
+{
+    // The whole encoding is checked before any tree is made
+    CacheReader in(data);
+    TreeReader  trees;
+    if (!trees.read(in)) return nullptr;
+
+    size_t         count   = trees.size();
+    size_t         actions = in.readCount();
+    vector<int>    kinds;
+    vector<size_t> targets;
+    for (size_t i = 0; i < actions && !in.fFail; i++) {
+        unsigned char kind = in.readByte();
+        if (kind > LibraryRecorder::kMetadata) in.fFail = true;
+        kinds.push_back(kind);
+        targets.push_back(in.readIndex(count));
+        targets.push_back(in.readIndex(count));
+    }
+    size_t root = in.readIndex(count);
+    if (!in.end()) return nullptr;
+
+    trees.make();
+    for (size_t i = 0; i < kinds.size(); i++) {
+        Tree t     = trees.get(targets[2 * i]);
+        Tree value = trees.get(targets[2 * i + 1]);
+        if (kinds[i] == LibraryRecorder::kDefProp) {
+            setProperty(t, gGlobal->DEFLINEPROP, value);
+        } else if (kinds[i] == LibraryRecorder::kUseProp) {
+            setProperty(t, gGlobal->USELINEPROP, value);
+        } else {
+            gGlobal->gMetaDataSet[t].insert(value);
+        }
+    }
+    return trees.get(root);
+}
+
+static string libraryCacheDir()
+{
+    const char* dir = getenv("FAUST_LIBRARY_CACHE");
+    return (dir) ? dir : "";
+}
+
+static string libraryCachePath(const string& dir, const string& ext, const string& key)
+{
+    return dir + "/faust-" + generateSHA1(key) + "." + ext;
+}
+
+static string libraryCacheHeader(const string& key)
+{
+    string header = LIBRARY_CACHE_MAGIC;
+    writeCount(header, LIBRARY_CACHE_VERSION);
+    writeString(header, FAUSTVERSION);
+    writeString(header, key);
+    return header;
+}
+
+bool LibraryCache::getKey(const char* fname, string& fullpath, string& key)
+{
+#ifdef EMCC
+    return false;
+#else
+    // Only local files are cached, URLs are always fetched
+    if (strstr(fname, "://")) return false;
+
+    FILE* file = fopenSearch(fname, fullpath);
+    if (!file) return false;
+    string content;
+    char   buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) content.append(buffer, size);
+    fclose(file);
+
+    struct stat info;
+    long long   mtime = (stat(fullpath.c_str(), &info) == 0) ? (long long)info.st_mtime : 0;
+
+    // The file name is part of the key since it is kept in the definitions lines and metadata keys
+    stringstream res;
+    res << fname << '\n' << fullpath << '\n' << mtime << '\n' << content.size() << '\n' << generateSHA1(content);
+    key = res.str();
+    return true;
+#endif
+}
+
+Tree LibraryCache::read(const string& key, bool& disk)
+{
+    shared_ptr<const string> data;
+    if (!load("flib", key, data, disk)) return nullptr;
+
+    Tree ldef = replay(*data);
+    // A corrupted entry is parsed again
+    if (!ldef) forget("flib", key);
+    return ldef;
+}
+
+void LibraryCache::write(const string& key, const string& data)
+{
+    store("flib", key, data);
+}
+
+bool LibraryCache::load(const string& ext, const string& key, shared_ptr<const string>& data, bool& disk)
+{
+    std::lock_guard<std::mutex> lock(gLibraryCacheLock);
+    disk = false;
+    map<string, shared_ptr<const string> >::iterator it = gLibraryCache.find(ext + '\n' + key);
+    if (it != gLibraryCache.end()) {
+        data = it->second;
+        return true;
+    }
+
+    string dir = libraryCacheDir();
+    if (dir == "") return false;
+    ifstream reader(libraryCachePath(dir, ext, key).c_str(), ios::in | ios::binary);
+    if (!reader.is_open()) return false;
+    stringstream content;
+    content << reader.rdbuf();
+    string file   = content.str();
+    string header = libraryCacheHeader(key);
+    if (file.compare(0, header.size(), header) != 0) return false;
+    data                           = make_shared<const string>(file.substr(header.size()));
+    gLibraryCache[ext + '\n' + key] = data;
+    disk                           = true;
+    return true;
+}
+
+void LibraryCache::store(const string& ext, const string& key, const string& data)
+{
+    std::lock_guard<std::mutex> lock(gLibraryCacheLock);
+    gLibraryCache[ext + '\n' + key] = make_shared<const string>(data);
+
+#ifndef _WIN32
+    string dir = libraryCacheDir();
+    if (dir == "") return;
+
+    // Written in a temporary file then renamed, so that another process never reads a partial entry
+    string       path = libraryCachePath(dir, ext, key);
+    stringstream tmp_path;
+    tmp_path << path << ".tmp" << getpid();
+    {
+        ofstream writer(tmp_path.str().c_str(), ios::out | ios::binary);
+        writer << libraryCacheHeader(key) << data;
+        writer.close();
+        if (writer.fail()) {
+            remove(tmp_path.str().c_str());
+            return;
+        }
+    }
+    if (rename(tmp_path.str().c_str(), path.c_str()) != 0) {
+        remove(tmp_path.str().c_str());
+    }
+#endif
+}
+
+void LibraryCache::forget(const string& ext, const string& key)
+{
+    std::lock_guard<std::mutex> lock(gLibraryCacheLock);
+    gLibraryCache.erase(ext + '\n' + key);
+}
@@ -0,0 +1,178 @@
+/************************************************************************
+ ************************************************************************
+    FAUST compiler
+    Copyright (C) 2003-2018 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ ************************************************************************
+ ************************************************************************/
+
+#ifndef __LIBRARYCACHE__
+#define __LIBRARYCACHE__
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tree.hh"
+
+using namespace std;
+
+/**
+ * Parsed library cache : the definitions of the library files are kept across the compilations of a process
+ * (and optionally on disk, in the FAUST_LIBRARY_CACHE directory) in a compact binary format, so that the
+ * libraries imported by many DSPs are only parsed once.
+ *
+ * Since the trees of a compilation context are released with it, a cached file is rebuilt in the new context
+ * by replaying the parse : all the trees made by the parser are recreated in the same order (so that the trees
+ * serial numbers, used to order the normalized signals, are the same as with a real parse), then the properties
+ * (definition and use lines) and the metadata declared by the file are set again.
+ */
+
+/**
+ * Binary encoding of trees, shared with the evaluation cache : a table of symbols, then a table of nodes
+ * (a node and the indexes of its branches, children before parents), so that the trees are rebuilt in
+ * the encoding order.
+ */
+inline void writeCount(string& out, uint64_t n)
+{
+    while (n >= 0x80) {
+        out += char((n & 0x7f) | 0x80);
+        n >>= 7;
+    }
+    out += char(n);
+}
+
+inline void writeString(string& out, const string& str)
+{
+    writeCount(out, str.size());
+    out += str;
+}
+
+class TreeWriter {
+   private:
+    unordered_map<Tree, size_t> fIndex;
+    map<Sym, size_t>            fSymbolsIndex;
+    string                      fSymbols;
+    string                      fTrees;
+
+   public:
+    // Encodes t after its branches, returns false if a node cannot be encoded
+    bool add(Tree t);
+
+    // The index of an encoded tree
+    size_t index(Tree t) { return fIndex[t]; }
+
+    void write(string& data);
+};
+
+// Decodes an encoded data, any inconsistency sets fFail
+struct CacheReader {
+    const string& fData;
+    size_t        fPos;
+    bool          fFail;
+
+    CacheReader(const string& data, size_t pos = 0) : fData(data), fPos(pos), fFail(false) {}
+
+    uint64_t readCount();
+
+    // An index in a table of 'size' elements
+    size_t readIndex(size_t size);
+
+    string        readString();
+    unsigned char readByte();
+    double        readDouble();
+
+    bool end() { return !fFail && fPos == fData.size(); }
+};
+
+class TreeReader {
+   private:
+    vector<Node>   fNodes;
+    vector<size_t> fArities;
+    vector<size_t> fBranches;
+    vector<Tree>   fTrees;
+
+   public:
+    // Decodes the tables written by TreeWriter::write, no tree is made yet
+    bool read(CacheReader& in);
+
+    size_t size() const { return fNodes.size(); }
+
+    // Makes the trees in the current context, in the encoding order
+    void make();
+
+    Tree get(size_t i) { return fTrees[i]; }
+};
+
+/**
+ * Records the trees made and the side effects of the parser while a library file is parsed
+ * (active when gGlobal->gLibraryRecorder is set, see SourceReader::getList).
+ */
+class LibraryRecorder {
+   public:
+    enum { kDefProp, kUseProp, kMetadata };
+
+   private:
+    struct Action {
+        int  fKind;
+        Tree fTree;
+        Tree fValue;
+    };
+
+    vector<Tree>        fTrees;  ///< the trees made by the parser, in the order of their first make
+    unordered_set<Tree> fMade;
+    vector<Action>      fActions;
+    bool                fCacheable;
+
+   public:
+    LibraryRecorder() : fCacheable(true) {}
+
+    void make(Tree t)
+    {
+        if (fMade.insert(t).second) fTrees.push_back(t);
+    }
+    void action(int kind, Tree t, Tree value) { fActions.push_back({kind, t, value}); }
+
+    // Documentation changes the global documentation state, these files are always parsed
+    void declareDoc() { fCacheable = false; }
+
+    // Encodes the recorded parse and its result, returns false if the parse cannot be replayed
+    bool write(Tree ldef, string& data);
+};
+
+class LibraryCache {
+   public:
+    // The key of a library file : its name and path, modification date and content hash
+    static bool getKey(const char* fname, string& fullpath, string& key);
+
+    // Rebuilds the definitions of a cached file in the current context, returns NULL if the file is not cached
+    static Tree read(const string& key, bool& disk);
+
+    static void write(const string& key, const string& data);
+
+    // The raw entries of the process (and of the cache directory), 'ext' is the kind of entry
+    static bool load(const string& ext, const string& key, shared_ptr<const string>& data, bool& disk);
+    static void store(const string& ext, const string& key, const string& data);
+
+    // Removes a corrupted entry from the process
+    static void forget(const string& ext, const string& key);
+};
+
+#endif
@@ -28,6 +28,7 @@
 #include <iostream>
 #include <map>
 #include <list>
+#include <mutex>
 #include <string>
 #include <sstream>
 
@@ -46,6 +47,8 @@
 #include "ppbox.hh"
 #include "exception.hh"
 #include "global.hh"
+#include "librarycache.hh"
+#include "timing.hh"
 #include "Text.hh"
 
 using namespace std;
@@ -63,7 +66,11 @@ extern int yyerr;
 extern int yydebug;
 extern FILE* yyin;
 extern int yylineno;
-extern const char* yyfilename;
+extern thread_local const char* yyfilename;
+
+// The bison/flex generated parser is not reentrant, so parsing is serialized
+// between compilation contexts running in different threads
+static std::mutex gParserLock;
 
 /**
  * Checks an argument list for containing only
@@ -415,13 +422,54 @@ static Tree addFunctionMetadata(Tree ldef, FunMDSet& M)
 Tree SourceReader::getList(const char* fname)
 {
 	if (!cached(fname)) {
+        // Library files are kept in the parsed library cache of the process (the DSP itself is always parsed)
+        string fullpath, key;
+        bool library = !gGlobal->gInputString && gGlobal->gMasterDocument != fname
+            && LibraryCache::getKey(fname, fullpath, key);
+        if (library) {
+            fFileKeys[fname] = key;
+            bool disk;
+            Tree ldef = LibraryCache::read(key, disk);
+            if (ldef) {
+                fLibraryHits++;
+                if (disk) fLibraryDiskHits++;
+                fFilePathnames.push_back(fullpath);
+                fFileCache[fname] = ldef;
+                return ldef;
+            }
+            fLibraryMisses++;
+        }
+
         // Previous metadata need to be cleared before parsing a file
         gGlobal->gFunMDSet.clear();
 
-        Tree ldef = (gGlobal->gInputString) ? parseString(fname) : parseFile(fname);
+        LibraryRecorder recorder;
+        if (library) gGlobal->gLibraryRecorder = &recorder;
+        try {
+            Tree ldef;
+            {
+                std::lock_guard<std::mutex> lock(gParserLock);
+                try {
+                    ldef = (gGlobal->gInputString) ? parseString(fname) : parseFile(fname);
+                } catch (faustexception& e) {
+                    // The lexer state is shared by all compilations and has to be reset after a failed parse
+                    yylex_destroy();
+                    throw;
+                }
+            }
 
-        // Definitions with metadata have to be wrapped into a boxMetadata construction
-        fFileCache[fname] = addFunctionMetadata(ldef, gGlobal->gFunMDSet);
+            // Definitions with metadata have to be wrapped into a boxMetadata construction
+            fFileCache[fname] = addFunctionMetadata(ldef, gGlobal->gFunMDSet);
+        } catch (faustexception& e) {
+            gGlobal->gLibraryRecorder = nullptr;
+            throw;
+        }
+        gGlobal->gLibraryRecorder = nullptr;
+
+        string data;
+        if (library && recorder.write(fFileCache[fname], data)) {
+            LibraryCache::write(key, data);
+        }
 	}
     return fFileCache[fname];
 }
@@ -450,6 +498,34 @@ vector<string> SourceReader::listLibraryFiles()
     return tmp;
 }
 
+/**
+ * Return the key of a library file, the DSP itself and the URL files have no key
+ */
+
+bool SourceReader::getKey(const char* fname, string& key)
+{
+    map<string, string>::iterator it = fFileKeys.find(fname);
+    if (it != fFileKeys.end()) {
+        key = it->second;
+        return true;
+    } else if (cached(fname) || gGlobal->gMasterDocument == fname) {
+        return false;
+    } else {
+        string fullpath;
+        return LibraryCache::getKey(fname, fullpath, key);
+    }
+}
+
+void SourceReader::printStats()
+{
+    if (fLibraryHits + fLibraryMisses > 0) {
+        stringstream stats;
+        stats << "library cache : " << fLibraryHits << " hits (" << fLibraryDiskHits << " from disk), "
+              << fLibraryMisses << " misses";
+        infoTiming(stats.str().c_str());
+    }
+}
+
 /**
  * Return the list of definitions where all imports have been expanded.
  *
@@ -495,7 +571,9 @@ void declareMetadata(Tree key, Tree value)
             fkey += "/";
         }
         fkey += tree2str(key);
-        gGlobal->gMetaDataSet[tree(fkey.c_str())].insert(value);
+        Tree lkey = tree(fkey.c_str());
+        gGlobal->gMetaDataSet[lkey].insert(value);
+        if (gGlobal->gLibraryRecorder) gGlobal->gLibraryRecorder->action(LibraryRecorder::kMetadata, lkey, value);
     }
 }
 
@@ -520,4 +598,5 @@ void declareDefinitionMetadata(Tree id, Tree key, Tree value)
 void declareDoc(Tree t)
 {
 	gGlobal->gDocVector.push_back(t);
+    if (gGlobal->gLibraryRecorder) gGlobal->gLibraryRecorder->declareDoc();
 }
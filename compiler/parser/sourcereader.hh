@@ -42,6 +42,10 @@ class SourceReader
     
         map<string, Tree> fFileCache;
         vector<string> fFilePathnames;
+        map<string, string> fFileKeys;  // The keys of the library files (see LibraryCache::getKey)
+        int fLibraryHits;       // Files rebuilt from the parsed library cache
+        int fLibraryDiskHits;   // ... loaded from the disk cache
+        int fLibraryMisses;     // Library files parsed
     
         Tree parseLocal(const char* fname);
         Tree expandRec(Tree ldef, set<string>& visited, Tree lresult);
@@ -52,10 +56,14 @@ class SourceReader
         
     public:
     
+        SourceReader():fLibraryHits(0), fLibraryDiskHits(0), fLibraryMisses(0) {}
+    
         Tree getList(const char* fname);
         Tree expandList(Tree ldef);
         vector<string> listSrcFiles();
         vector<string> listLibraryFiles();
+        bool getKey(const char* fname, string& key);
+        void printStats();
 
 };
 
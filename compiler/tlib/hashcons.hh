@@ -0,0 +1,171 @@
+/************************************************************************
+ ************************************************************************
+    FAUST compiler
+    Copyright (C) 2003-2018 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ ************************************************************************
+ ************************************************************************/
+
+#ifndef __HASHCONS__
+#define __HASHCONS__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+
+/**
+ * Open addressing hash table used for hash-consing (trees and symbols).
+ *
+ * The table only stores pointers to the items with their hash key, the equality test is given to 'find'.
+ * Collisions are resolved with linear probing and the table is doubled when its load factor exceeds 0.7,
+ * so that it starts small (cheap for tiny programs) and keeps short probe sequences on big ones.
+ * Removal uses backward shifting, thus no tombstone is needed.
+ */
+template <class T>
+class HashConsTable {
+   private:
+    struct Slot {
+        size_t fHash;
+        T*     fItem;
+    };
+
+    Slot*  fSlots;
+    size_t fMask;   ///< capacity - 1 (the capacity is a power of two)
+    size_t fCount;  ///< number of items in the table
+
+    // Statistics
+    size_t fMaxCount;
+    size_t fLookups;
+    size_t fProbes;
+
+    // Hash keys are often built from pointers or by shifts: mix all the bits before masking
+    static size_t slotIndex(size_t hash, size_t mask)
+    {
+        uint64_t h = uint64_t(hash);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return size_t(h) & mask;
+    }
+
+    static Slot* allocateSlots(size_t capacity)
+    {
+        Slot* slots = static_cast<Slot*>(calloc(capacity, sizeof(Slot)));
+        if (!slots) throw std::bad_alloc();
+        return slots;
+    }
+
+    void grow()
+    {
+        size_t old_capacity = fMask + 1;
+        Slot*  old_slots    = fSlots;
+
+        fSlots = allocateSlots(old_capacity * 2);
+        fMask  = old_capacity * 2 - 1;
+
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_slots[i].fItem) {
+                size_t j = slotIndex(old_slots[i].fHash, fMask);
+                while (fSlots[j].fItem) j = (j + 1) & fMask;
+                fSlots[j] = old_slots[i];
+            }
+        }
+        free(old_slots);
+    }
+
+   public:
+    HashConsTable(size_t capacity) : fCount(0), fMaxCount(0), fLookups(0), fProbes(0)
+    {
+        size_t size = 16;
+        while (size < capacity) size *= 2;
+        fSlots = allocateSlots(size);
+        fMask  = size - 1;
+    }
+
+    virtual ~HashConsTable() { free(fSlots); }
+
+    /**
+     * Returns the item with the given hash key that satisfies 'equal', or NULL.
+     */
+    template <class Equal>
+    T* find(size_t hash, Equal equal)
+    {
+        fLookups++;
+        for (size_t i = slotIndex(hash, fMask); fSlots[i].fItem; i = (i + 1) & fMask) {
+            fProbes++;
+            if (fSlots[i].fHash == hash && equal(fSlots[i].fItem)) return fSlots[i].fItem;
+        }
+        return NULL;
+    }
+
+    /**
+     * Adds a new item (the caller has checked with 'find' that no equivalent item exists).
+     */
+    void insert(size_t hash, T* item)
+    {
+        if ((fCount + 1) * 10 > (fMask + 1) * 7) grow();
+
+        size_t i = slotIndex(hash, fMask);
+        while (fSlots[i].fItem) i = (i + 1) & fMask;
+        fSlots[i].fHash = hash;
+        fSlots[i].fItem = item;
+
+        if (++fCount > fMaxCount) fMaxCount = fCount;
+    }
+
+    /**
+     * Removes an item, the following slots of the probe sequence are shifted back.
+     */
+    void remove(size_t hash, T* item)
+    {
+        size_t i = slotIndex(hash, fMask);
+        while (fSlots[i].fItem != item) {
+            if (!fSlots[i].fItem) return;
+            i = (i + 1) & fMask;
+        }
+
+        size_t j = i;
+        while (true) {
+            j = (j + 1) & fMask;
+            if (!fSlots[j].fItem) break;
+            // The item in j can be moved to i if its home slot is not in ]i, j]
+            size_t home = slotIndex(fSlots[j].fHash, fMask);
+            if ((i <= j) ? (home <= i || home > j) : (home <= i && home > j)) {
+                fSlots[i] = fSlots[j];
+                i         = j;
+            }
+        }
+        fSlots[i].fHash = 0;
+        fSlots[i].fItem = NULL;
+        fCount--;
+    }
+
+    template <class Fun>
+    void forEach(Fun fun) const
+    {
+        for (size_t i = 0; i <= fMask; i++) {
+            if (fSlots[i].fItem) fun(fSlots[i].fItem);
+        }
+    }
+
+    size_t size() const { return fCount; }
+    size_t capacity() const { return fMask + 1; }
+    size_t maxSize() const { return fMaxCount; }
+    size_t lookups() const { return fLookups; }
+    size_t probes() const { return fProbes; }
+};
+
+#endif
@@ -27,18 +27,16 @@
 
 #include "compatibility.hh"
 #include "exception.hh"
+#include "global.hh"
 #include "symbol.hh"
 
 using namespace std;
 
 /**
- * Hash table used to store the symbols
+ * The hash table used to store the symbols and the prefix counters
+ * are kept in the current compilation context (see global.hh)
  */
 
-Symbol* Symbol::gSymbolTable[kHashTableSize];
-
-map<const char*, unsigned int> Symbol::gPrefixCounters;
-
 /**
  * Search the hash table for the symbol of name \p str or returns a new one.
  * \param str the name of the symbol
@@ -65,13 +63,13 @@ Symbol* Symbol::get(const char* rawstr)
         str[i] = (c >= 0 && c < 32) ? 32 : c;
     }
     unsigned int hsh  = calcHashKey(str.c_str());
-    int          bckt = hsh % kHashTableSize;
-    Symbol*      item = gSymbolTable[bckt];
+    Symbol*      item = gGlobal->gSymbolTable->find(hsh, [&](Symbol* s) { return s->equiv(hsh, str.c_str()); });
 
-    while (item && !item->equiv(hsh, str.c_str())) item = item->fNext;
-    Symbol* r = item ? item : gSymbolTable[bckt] = new Symbol(str, hsh, gSymbolTable[bckt]);
-
-    return r;
+    if (!item) {
+        item = new Symbol(str, hsh);
+        gGlobal->gSymbolTable->insert(hsh, item);
+    }
+    return item;
 }
 
 /**
@@ -82,12 +80,8 @@ Symbol* Symbol::get(const char* rawstr)
 
 bool Symbol::isnew(const char* str)
 {
-    unsigned int hsh  = calcHashKey(str);
-    int          bckt = hsh % kHashTableSize;
-    Symbol*      item = gSymbolTable[bckt];
-
-    while (item && !item->equiv(hsh, str)) item = item->fNext;
-    return item == 0;
+    unsigned int hsh = calcHashKey(str);
+    return gGlobal->gSymbolTable->find(hsh, [&](Symbol* s) { return s->equiv(hsh, str); }) == 0;
 }
 
 /**
@@ -101,7 +95,7 @@ Symbol* Symbol::prefix(const char* str)
     char name[256];
 
     for (int n = 0; n < 10000; n++) {
-        snprintf(name, 256, "%s%d", str, gPrefixCounters[str]++);
+        snprintf(name, 256, "%s%d", str, gGlobal->gSymbolPrefixCounters[str]++);
         if (isnew(name)) return get(name);
     }
     faustassert(false);
@@ -142,14 +136,12 @@ unsigned int Symbol::calcHashKey(const char* str)
  * Gets a string to be kept.
  * \param str the name of the symbol
  * \param hsh the hash key of the symbol
- * \param nxt a pointer to the next symbol in the hash table entry
  */
 
-Symbol::Symbol(const string& str, unsigned int hsh, Symbol* nxt)
+Symbol::Symbol(const string& str, unsigned int hsh)
 {
     fName = str;
     fHash = hsh;
-    fNext = nxt;
     fData = 0;
 }
 
@@ -164,6 +156,12 @@ ostream& Symbol::print(ostream& fout) const  ///< print a symbol on a stream
 
 void Symbol::init()
 {
-    gPrefixCounters.clear();
-    memset(gSymbolTable, 0, sizeof(Symbol*) * kHashTableSize);
+    gGlobal->gSymbolPrefixCounters.clear();
+    gGlobal->gSymbolTable = new HashConsTable<Symbol>(kHashTableSize);
+}
+
+void Symbol::cleanup()
+{
+    delete gGlobal->gSymbolTable;
+    gGlobal->gSymbolTable = NULL;
 }
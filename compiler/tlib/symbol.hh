@@ -43,6 +43,7 @@
 #include <string>
 
 #include "garbageable.hh"
+#include "hashcons.hh"
 
 using namespace std;
 
@@ -53,20 +54,16 @@ using namespace std;
  */
 class Symbol : public virtual Garbageable {
    private:
-    static const int kHashTableSize = 511;          ///< Size of the hash table (a prime number is recommended)
-    static Symbol*   gSymbolTable[kHashTableSize];  ///< Hash table used to store the symbols
-    static map<const char*, unsigned int> gPrefixCounters;
+    static const int kHashTableSize = 1024;  ///< Initial size of the hash table (grows with the number of symbols)
 
     // Fields
     string       fName;  ///< Name of the symbol
     unsigned int fHash;  ///< Hash key computed from the name and used to determine the hash table entry
-    Symbol*      fNext;  ///< Next symbol in the hash table entry
     void*        fData;  ///< Field to user disposal to store additional data
 
     // Constructors & destructors
-    Symbol(const string&, unsigned int hsh,
-           Symbol* nxt);  ///< Constructs a new symbol ready to be placed in the hash table
-    ~Symbol();            ///< The Destructor is never used
+    Symbol(const string&, unsigned int hsh);  ///< Constructs a new symbol ready to be placed in the hash table
+    ~Symbol();                                ///< The Destructor is never used
 
     // Others
     bool                equiv(unsigned int hash,
@@ -90,7 +87,8 @@ class Symbol : public virtual Garbageable {
     friend void* getUserData(Symbol* sym);
     friend void  setUserData(Symbol* sym, void* d);
 
-    static void init();
+    static void init();     ///< Allocate the symbol table of the current compilation context
+    static void cleanup();  ///< Release the symbol table of the current compilation context
 };
 
 inline Symbol* symbol(const char* str)
@@ -79,8 +79,12 @@ storage of trees.
 #include <string.h>
 #include <cstdlib>
 #include <fstream>
+#include <sstream>
 
 #include "exception.hh"
+#include "global.hh"
+#include "librarycache.hh"
+#include "timing.hh"
 #include "tree.hh"
 
 #define ERROR(s, t)              \
@@ -88,38 +92,25 @@ storage of trees.
         throw faustexception(s); \
     }
 
-Tree         CTree::gHashTable[kHashTableSize];
-bool         CTree::gDetails   = false;
-unsigned int CTree::gVisitTime = 0;
+bool CTree::gDetails = false;
 
 // Constructor : add the tree to the hash table
 CTree::CTree(size_t hk, const Node& n, const tvec& br)
-    : fNode(n), fType(0), fHashKey(hk), fAperture(calcTreeAperture(n, br)), fVisitTime(0), fBranch(br)
+    : fNode(n),
+      fType(0),
+      fHashKey(hk),
+      fAperture(calcTreeAperture(n, br)),
+      fVisitTime(0),
+      fSerial(++gGlobal->gTreeSerial),
+      fBranch(br)
 {
-    // link dans la hash table
-    int j         = hk % kHashTableSize;
-    fNext         = gHashTable[j];
-    gHashTable[j] = this;
+    gGlobal->gTreeTable->insert(hk, this);
 }
 
 // Destructor : remove the tree from the hash table
 CTree::~CTree()
 {
-    int  i = fHashKey % kHashTableSize;
-    Tree t = gHashTable[i];
-
-    // printf("Delete of "); this->print(); printf("\n");
-    if (t == this) {
-        gHashTable[i] = fNext;
-    } else {
-        Tree p = NULL;
-        while (t != this) {
-            p = t;
-            t = t->fNext;
-        }
-        faustassert(p);
-        p->fNext = fNext;
-    }
+    gGlobal->gTreeTable->remove(fHashKey, this);
 }
 
 // equivalence
@@ -148,23 +139,19 @@ Tree CTree::make(const Node& n, int ar, Tree* tbl)
     for (int i = 0; i < ar; i++) br[i] = tbl[i];
 
     size_t hk = calcTreeHash(n, br);
-    Tree   t  = gHashTable[hk % kHashTableSize];
-
-    while (t && !t->equiv(n, br)) {
-        t = t->fNext;
-    }
-    return (t) ? t : new CTree(hk, n, br);
+    Tree   t  = gGlobal->gTreeTable->find(hk, [&](Tree u) { return u->equiv(n, br); });
+    if (!t) t = new CTree(hk, n, br);
+    if (gGlobal->gLibraryRecorder) gGlobal->gLibraryRecorder->make(t);
+    return t;
 }
 
 Tree CTree::make(const Node& n, const tvec& br)
 {
     size_t hk = calcTreeHash(n, br);
-    Tree   t  = gHashTable[hk % kHashTableSize];
-
-    while (t && !t->equiv(n, br)) {
-        t = t->fNext;
-    }
-    return (t) ? t : new CTree(hk, n, br);
+    Tree   t  = gGlobal->gTreeTable->find(hk, [&](Tree u) { return u->equiv(n, br); });
+    if (!t) t = new CTree(hk, n, br);
+    if (gGlobal->gLibraryRecorder) gGlobal->gLibraryRecorder->make(t);
+    return t;
 }
 
 ostream& CTree::print(ostream& fout) const
@@ -191,24 +178,53 @@ ostream& CTree::print(ostream& fout) const
 void CTree::control()
 {
     printf("\ngHashTable Content :\n\n");
-    for (int i = 0; i < kHashTableSize; i++) {
-        Tree t = gHashTable[i];
-        if (t) {
-            printf("%4d = ", i);
-            while (t) {
-                /*t->print();*/
-                printf(" => ");
-                t = t->fNext;
-            }
-            printf("VOID\n");
-        }
-    }
+    gGlobal->gTreeTable->forEach([](Tree t) {
+        t->print(cout);
+        cout << endl;
+    });
     printf("\nEnd gHashTable\n");
 }
 
+void CTree::printStats()
+{
+    HashConsTable<CTree>* table = gGlobal->gTreeTable;
+    if (table && table->lookups() > 0) {
+        stringstream stats;
+        stats << "hash-consing : " << table->maxSize() << " trees in " << table->capacity() << " entries, "
+              << table->lookups() << " lookups, " << double(table->probes()) / double(table->lookups())
+              << " probes per lookup";
+        infoTiming(stats.str().c_str());
+    }
+}
+
 void CTree::init()
 {
-    memset(gHashTable, 0, sizeof(Tree) * kHashTableSize);
+    gGlobal->gTreeTable       = new HashConsTable<CTree>(kHashTableSize);
+    gGlobal->gTreeVisitTime   = 0;
+    gGlobal->gTreeSerial      = 0;
+    gGlobal->gLibraryRecorder = nullptr;
+}
+
+void CTree::cleanup()
+{
+    printStats();
+    delete gGlobal->gTreeTable;
+    gGlobal->gTreeTable = NULL;
+}
+
+void CTree::startNewVisit()
+{
+    ++gGlobal->gTreeVisitTime;
+}
+
+bool CTree::isAlreadyVisited()
+{
+    return fVisitTime == gGlobal->gTreeVisitTime;
+}
+
+void CTree::setVisited()
+{
+    fVisitTime = gGlobal->gTreeVisitTime;
 }
 
 // if t has a node of type int, return it otherwise error
@@ -73,10 +73,12 @@
 #define __TREE__
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 #include "exception.hh"
 #include "garbageable.hh"
+#include "hashcons.hh"
 #include "node.hh"
 #include "symbol.hh"
 
@@ -85,8 +87,90 @@
 class CTree;
 typedef CTree* Tree;
 
-typedef map<Tree, Tree> plist;
-typedef vector<Tree>    tvec;
+typedef vector<Tree> tvec;
+
+/**
+ * The property list attached to a tree. Most trees have only a few properties, they are kept in a small
+ * vector (in insertion order) searched linearly. An index is built only for the trees holding many
+ * properties, like the environments where each definition is a property.
+ */
+class plist {
+   private:
+    static const size_t kIndexThreshold = 16;  ///< number of properties from which the index is used
+
+    vector<pair<Tree, Tree> >     fItems;
+    unordered_map<Tree, size_t>* fIndex;  ///< position of the keys in fItems, NULL for small lists
+
+    plist(const plist&);
+    plist& operator=(const plist&);
+
+    int position(Tree key) const
+    {
+        if (fIndex) {
+            unordered_map<Tree, size_t>::const_iterator it = fIndex->find(key);
+            return (it == fIndex->end()) ? -1 : int(it->second);
+        } else {
+            for (size_t i = 0; i < fItems.size(); i++) {
+                if (fItems[i].first == key) return int(i);
+            }
+            return -1;
+        }
+    }
+
+    void buildIndex()
+    {
+        if (!fIndex) fIndex = new unordered_map<Tree, size_t>();
+        fIndex->clear();
+        for (size_t i = 0; i < fItems.size(); i++) (*fIndex)[fItems[i].first] = i;
+    }
+
+   public:
+    typedef vector<pair<Tree, Tree> >::const_iterator const_iterator;
+
+    plist() : fIndex(NULL) {}
+    ~plist() { delete fIndex; }
+
+    Tree get(Tree key) const
+    {
+        int i = position(key);
+        return (i < 0) ? 0 : fItems[i].second;
+    }
+
+    void set(Tree key, Tree value)
+    {
+        int i = position(key);
+        if (i >= 0) {
+            fItems[i].second = value;
+        } else {
+            fItems.push_back(make_pair(key, value));
+            if (fIndex) {
+                (*fIndex)[key] = fItems.size() - 1;
+            } else if (fItems.size() > kIndexThreshold) {
+                buildIndex();
+            }
+        }
+    }
+
+    void erase(Tree key)
+    {
+        int i = position(key);
+        if (i >= 0) {
+            fItems.erase(fItems.begin() + i);
+            if (fIndex) buildIndex();
+        }
+    }
+
+    void clear()
+    {
+        fItems.clear();
+        delete fIndex;
+        fIndex = NULL;
+    }
+
+    size_t         size() const { return fItems.size(); }
+    const_iterator begin() const { return fItems.begin(); }
+    const_iterator end() const { return fItems.end(); }
+};
 
 /**
  * A CTree = (Node x [CTree]) is a Node associated with a list of subtrees called branches.
@@ -107,22 +191,20 @@ typedef vector<Tree>    tvec;
 
 class CTree : public virtual Garbageable {
    private:
-    static const int kHashTableSize = 400009;     ///< size of the hash table (prime number)
-    static Tree      gHashTable[kHashTableSize];  ///< hash table used for "hash consing"
+    static const int kHashTableSize = 4096;  ///< initial size of the hash table (grows with the number of trees)
 
    public:
-    static bool         gDetails;    ///< Ctree::print() print with more details when true
-    static unsigned int gVisitTime;  ///< Should be incremented for each new visit to keep track of visited tree.
+    static bool gDetails;  ///< Ctree::print() print with more details when true
 
    private:
     // fields
-    Tree         fNext;        ///< next tree in the same hashtable entry
     Node         fNode;        ///< the node content of the tree
     void*        fType;        ///< the type of a tree
     plist        fProperties;  ///< the properties list attached to the tree
     size_t       fHashKey;     ///< the hashtable key
     int          fAperture;    ///< how "open" is a tree (synthezised field)
     unsigned int fVisitTime;   ///< keep track of visits
+    unsigned int fSerial;      ///< creation order of the tree in its compilation context
     tvec         fBranch;      ///< the subtrees
 
     CTree(size_t hk, const Node& n, const tvec& br);  ///< construction is private, uses tree::make instead
@@ -144,40 +226,43 @@ class CTree : public virtual Garbageable {
     Tree        branch(int i) const { return fBranch[i]; }     ///< return the ith branch (subtree) of a tree
     const tvec& branches() const { return fBranch; }           ///< return all branches (subtrees) of a tree
     size_t      hashkey() const { return fHashKey; }           ///< return the hashkey of the tree
+    unsigned int serial() const { return fSerial; }            ///< return the creation order of the tree
     int         aperture() const { return fAperture; }  ///< return how "open" is a tree in terms of free variables
     void        setAperture(int a) { fAperture = a; }   ///< modify the aperture of a tree
 
     // Print a tree and the hash table (for debugging purposes)
     ostream&    print(ostream& fout) const;  ///< print recursively the content of a tree on a stream
     static void control();                   ///< print the hash table content (for debug purpose)
+    static void printStats();                ///< print the hash table statistics (with -time)
 
-    static void init();
+    static void init();     ///< allocate the hash table of the current compilation context
+    static void cleanup();  ///< release the hash table of the current compilation context
 
     // type information
     void  setType(void* t) { fType = t; }
     void* getType() { return fType; }
 
-    // Keep track of visited trees (WARNING : non reentrant)
-    static void startNewVisit() { ++gVisitTime; }
-    bool        isAlreadyVisited() { return fVisitTime == gVisitTime; }
-    void        setVisited() { /*faustassert(fVisitTime!=gVisitTime);*/ fVisitTime = gVisitTime; }
+    // Keep track of visited trees (the visit time is kept in the current compilation context)
+    static void startNewVisit();
+    bool        isAlreadyVisited();
+    void        setVisited();
 
     // Property list of a tree
-    void setProperty(Tree key, Tree value) { fProperties[key] = value; }
+    void setProperty(Tree key, Tree value) { fProperties.set(key, value); }
     void clearProperty(Tree key) { fProperties.erase(key); }
-    void clearProperties() { fProperties = plist(); }
+    void clearProperties() { fProperties.clear(); }
 
     void exportProperties(vector<Tree>& keys, vector<Tree>& values);
 
-    Tree getProperty(Tree key)
-    {
-        plist::iterator i = fProperties.find(key);
-        if (i == fProperties.end()) {
-            return 0;
-        } else {
-            return i->second;
-        }
-    }
+    Tree getProperty(Tree key) { return fProperties.get(key); }
+};
+
+/**
+ * Order trees by creation order instead of by address, so that the containers using it
+ * (and the generated code) do not depend on where the trees have been allocated.
+ */
+struct CTreeComparator {
+    bool operator()(Tree a, Tree b) const { return a->serial() < b->serial(); }
 };
 
 //---------------------------------API---------------------------------------
@@ -8,6 +8,7 @@
 #include "faust/dsp/llvm-dsp.h"
 #include "faust/gui/GUI.h"
 #include "faust/dsp/poly-dsp.h"
+#include "faust/dsp/dsp-silence.h"
 #include "faust/audio/channels.h"
 #include "faust/gui/DecoratorUI.h"
 #include "faust/gui/FUI.h"
@@ -0,0 +1,136 @@
+#ifndef FAUSTFLOAT
+#define FAUSTFLOAT double
+#endif
+
+#include "controlTools.h"
+
+// Tail in seconds given to 'dsp_silence', -1 to use the one declared in the DSP metadata
+#ifndef SILENCE_TAIL
+#define SILENCE_TAIL -1.
+#endif
+
+//----------------------------------------------------------------------------
+//FAUST generated code
+//----------------------------------------------------------------------------
+
+<<includeIntrinsic>>
+
+<<includeclass>>
+
+// The impulse response is computed by the DSP wrapped in 'dsp_silence', and has to be the same
+dsp_silence* DSP;
+
+int main(int argc, char* argv[])
+{
+    char rcfilename[256];
+    FUI finterface;
+    snprintf(rcfilename, 255, "%src", argv[0]);
+    
+    bool inpl = isopt(argv, "-inpl");
+    
+    DSP = new dsp_silence(new mydsp(), FAUSTFLOAT(0.000001), SILENCE_TAIL);
+    
+    DSP->buildUserInterface(&finterface);
+ 
+    // Get control and then 'initRandom'
+    CheckControlUI controlui;
+    DSP->buildUserInterface(&controlui);
+    controlui.initRandom();
+    
+    // Init signal processor and the user interface values
+    DSP->init(44100);
+    
+    // Check getSampleRate
+    if (DSP->getSampleRate() != 44100) {
+        cerr << "ERROR in getSampleRate" << std::endl;
+    }
+   
+    // Check default after 'init'
+    if (!controlui.checkDefaults()) {
+        cerr << "ERROR in checkDefaults after 'init'" << std::endl;
+    }
+    
+    // Check default after 'instanceResetUserInterface'
+    controlui.initRandom();
+    DSP->instanceResetUserInterface();
+    if (!controlui.checkDefaults()) {
+        cerr << "ERROR in checkDefaults after 'instanceResetUserInterface'" << std::endl;
+    }
+    
+    // Check default after 'instanceInit'
+    controlui.initRandom();
+    DSP->instanceInit(44100);
+    if (!controlui.checkDefaults()) {
+        cerr << "ERROR in checkDefaults after 'instanceInit'" << std::endl;
+    }
+    
+    // Init again
+    DSP->init(44100);
+ 
+    int nins = DSP->getNumInputs();
+    int nouts = DSP->getNumOutputs();
+    
+    channels* ichan = new channels(kFrames, ((inpl) ? std::max(nins, nouts) : nins));
+    channels* ochan = (inpl) ? ichan : new channels(kFrames, nouts);
+
+    int nbsamples = 60000;
+    int linenum = 0;
+    int run = 0;
+    
+    // recall saved state
+    finterface.recallState(rcfilename);
+    
+    // print general informations
+    printf("number_of_inputs  : %3d\n", nins);
+    printf("number_of_outputs : %3d\n", nouts);
+    printf("number_of_frames  : %6d\n", nbsamples);
+    
+    // print audio frames
+    int i;
+    try {
+        while (nbsamples > 0) {
+            if (run == 0) {
+                ichan->impulse();
+                finterface.setButtons(true);
+            }
+            if (run >= 1) {
+                ichan->zero();
+                finterface.setButtons(false);
+            }
+            int nFrames = min(kFrames, nbsamples);
+            
+            DSP->compute(nFrames, ichan->buffers(), ochan->buffers());
+            
+            /*
+            DSP->compute(5, ichan->buffers(0), ochan->buffers(0));
+            DSP->compute(nFrames - 5, ichan->buffers(5), ochan->buffers(5));
+            */
+            
+            /*
+            DSP->compute(5, ichan->buffers(0), ochan->buffers(0));
+            DSP->compute(5, ichan->buffers(5), ochan->buffers(5));
+            DSP->compute(nFrames - 10, ichan->buffers(10), ochan->buffers(10));
+            */
+            
+            run++;
+            for (int i = 0; i < nFrames; i++) {
+                printf("%6d : ", linenum++);
+                for (int c = 0; c < nouts; c++) {
+                    FAUSTFLOAT f = normalize(ochan->buffers()[c][i]);
+                    printf(" %8.6f", f);
+                }
+                printf("\n");
+            }
+            nbsamples -= nFrames;
+        }
+    } catch (...) {
+        cerr << "ERROR in " << argv[1] << " line : " << i << std::endl;
+    }
+    
+    cerr << argv[0] << " : " << DSP->getSkippedBlocks() << " skipped blocks, " << DSP->getComputedBlocks()
+         << " computed blocks" << std::endl;
+
+    testPolyphony(DSP);
+    
+    return 0;
+}
@@ -0,0 +1,139 @@
+/************************************************************************
+ ************************************************************************
+    FAUST compiler
+    Copyright (C) 2018 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ ************************************************************************
+ ************************************************************************/
+
+/*
+ Stress test for the reentrant compiler: the same set of DSP files is compiled
+ from several threads at the same time, and the generated code (or error message)
+ has to be byte-identical to the one produced by a sequential compilation.
+*/
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dsp_factory.hh"
+
+using namespace std;
+
+struct Result {
+    string fCode;
+    string fError;
+
+    bool operator==(const Result& res) const { return (fCode == res.fCode) && (fError == res.fError); }
+};
+
+static vector<string> gOptions;
+
+static string pathToContent(const string& path)
+{
+    ifstream     file(path.c_str());
+    stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+static Result compile(const string& name, const string& content)
+{
+    int         argc = 0;
+    const char* argv[64];
+    argv[argc++] = "faust";
+    argv[argc++] = "-lang";
+    argv[argc++] = "cpp";
+    argv[argc++] = "-o";
+    argv[argc++] = "string";
+    for (size_t i = 0; i < gOptions.size(); i++) {
+        argv[argc++] = gOptions[i].c_str();
+    }
+    argv[argc] = 0;
+
+    Result            res;
+    dsp_factory_base* factory = compileFaustFactory(argc, argv, name.c_str(), content.c_str(), res.fError, true);
+    if (factory) {
+        res.fCode = factory->getBinaryCode();
+        delete factory;
+    }
+    return res;
+}
+
+int main(int argc, char* argv[])
+{
+    int            threads = 8;
+    int            rounds  = 4;
+    vector<string> files;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (arg == "-r" && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if ((arg == "-I" || arg == "-vs" || arg == "-lv") && i + 1 < argc) {
+            gOptions.push_back(arg);
+            gOptions.push_back(argv[++i]);
+        } else if (arg[0] == '-') {
+            gOptions.push_back(arg);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.size() == 0) {
+        cerr << "Usage: " << argv[0] << " [-t threads] [-r rounds] [faust options] file.dsp..." << endl;
+        return 1;
+    }
+
+    vector<string> contents;
+    vector<Result> references;
+    for (size_t i = 0; i < files.size(); i++) {
+        contents.push_back(pathToContent(files[i]));
+        references.push_back(compile(files[i], contents[i]));
+    }
+
+    atomic<int>    errors(0);
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++) {
+        pool.push_back(thread([&, t]() {
+            for (int r = 0; r < rounds; r++) {
+                // Each thread uses a different order, so that different DSPs are compiled at the same time
+                for (size_t i = 0; i < files.size(); i++) {
+                    size_t index = (i + t * 7 + r) % files.size();
+                    if (!(compile(files[index], contents[index]) == references[index])) {
+                        cerr << "ERROR : thread " << t << " round " << r << " : different output for "
+                             << files[index] << endl;
+                        errors++;
+                    }
+                }
+            }
+        }));
+    }
+
+    for (size_t t = 0; t < pool.size(); t++) {
+        pool[t].join();
+    }
+
+    cout << files.size() << " files, " << threads << " threads, " << rounds << " rounds : " << errors
+         << " error(s)" << endl;
+    return (errors > 0) ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************/
+
+/*
+ Scheduler test : two instances of the DSP are computed at the same time by two host threads, with buffers
+ of varying sizes (including partial blocks of the -sch and -vec modes). The outputs of both instances are
+ printed in hexadecimal, so that the outputs of the -sch and -scal compilations can be compared bit-exactly.
+*/
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "faust/gui/UI.h"
+#include "faust/gui/meta.h"
+#include "faust/dsp/dsp.h"
+
+using std::max;
+using std::min;
+
+//----------------------------------------------------------------------------
+//  FAUST generated signal processor
+//----------------------------------------------------------------------------
+
+<<includeIntrinsic>>
+
+<<includeclass>>
+
+using namespace std;
+
+#define SAMPLE_RATE 44100
+#define NUM_FRAMES 8192
+#define MAX_BUFFER_SIZE 512
+
+// Buffer sizes used in turn, the -sch and -vec blocks are 32 frames by default
+static const int gBufferSizes[] = {1, 7, 32, 33, 64, 100, 511, 512, 2, 250};
+
+struct Instance {
+    mydsp               fDSP;
+    vector<FAUSTFLOAT*> fInputs;
+    vector<FAUSTFLOAT*> fOutputs;
+    vector<FAUSTFLOAT>  fResult;  // interleaved outputs
+
+    Instance()
+    {
+        fDSP.init(SAMPLE_RATE);
+        for (int i = 0; i < fDSP.getNumInputs(); i++) {
+            fInputs.push_back(new FAUSTFLOAT[MAX_BUFFER_SIZE]);
+        }
+        for (int i = 0; i < fDSP.getNumOutputs(); i++) {
+            fOutputs.push_back(new FAUSTFLOAT[MAX_BUFFER_SIZE]);
+        }
+        fResult.resize(NUM_FRAMES * fDSP.getNumOutputs());
+    }
+
+    virtual ~Instance()
+    {
+        for (size_t i = 0; i < fInputs.size(); i++) {
+            delete[] fInputs[i];
+        }
+        for (size_t i = 0; i < fOutputs.size(); i++) {
+            delete[] fOutputs[i];
+        }
+    }
+
+    // Impulse followed by a deterministic noise
+    static FAUSTFLOAT input(int chan, int frame)
+    {
+        if (frame == 0) return FAUSTFLOAT(1);
+        unsigned int seed = (unsigned int)(frame * 1103515245 + chan * 12345 + 12345);
+        return FAUSTFLOAT(int(seed >> 8) % 1000) / FAUSTFLOAT(2000);
+    }
+
+    void compute()
+    {
+        // As the worker threads of the scheduler
+        AVOIDDENORMALS;
+        int inputs  = fDSP.getNumInputs();
+        int outputs = fDSP.getNumOutputs();
+        for (int frame = 0, b = 0; frame < NUM_FRAMES; b++) {
+            int size = min(gBufferSizes[b % (sizeof(gBufferSizes) / sizeof(int))], NUM_FRAMES - frame);
+            for (int i = 0; i < inputs; i++) {
+                for (int j = 0; j < size; j++) {
+                    fInputs[i][j] = input(i, frame + j);
+                }
+            }
+            fDSP.compute(size, fInputs.data(), fOutputs.data());
+            for (int i = 0; i < outputs; i++) {
+                for (int j = 0; j < size; j++) {
+                    fResult[(frame + j) * outputs + i] = fOutputs[i][j];
+                }
+            }
+            frame += size;
+        }
+    }
+
+    void print()
+    {
+        int outputs = fDSP.getNumOutputs();
+        for (int frame = 0; frame < NUM_FRAMES; frame++) {
+            printf("%6d :", frame);
+            for (int i = 0; i < outputs; i++) {
+                printf(" %a", double(fResult[frame * outputs + i]));
+            }
+            printf("\n");
+        }
+    }
+};
+
+static void computeInstance(Instance* instance)
+{
+    instance->compute();
+}
+
+int main(int argc, char* argv[])
+{
+    Instance* instance1 = new Instance();
+    Instance* instance2 = new Instance();
+
+    thread host(computeInstance, instance2);
+    instance1->compute();
+    host.join();
+
+    instance1->print();
+    instance2->print();
+
+    delete instance1;
+    delete instance2;
+    return 0;
+}
@@ -0,0 +1,129 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************/
+
+/*
+ Tiered execution test : a tiered_dsp and a reference Interpreter instance of the same DSP compute the same
+ impulse, block by block. The tiered_dsp starts on the Interpreter, and the test waits between two blocks
+ until it has swapped to the LLVM JIT instance, so that the swap happens in the middle of the impulse response.
+ The outputs of both instances have to stay equal (within a tolerance for the code generated by LLVM) before
+ and after the swap, so that the state transfer (getStateLayout of both backends) does not make any click.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "faust/dsp/tiered-dsp.h"
+
+using namespace std;
+
+#define SAMPLE_RATE 44100
+#define BUFFER_SIZE 64
+#define NUM_BLOCKS 400
+#define SWAP_BLOCK 100      // The swap is waited for from this block
+#define MAX_WAIT 60000      // in ms
+#define TOLERANCE 1e-4
+
+static FAUSTFLOAT** allocChannels(int channels)
+{
+    FAUSTFLOAT** buffers = new FAUSTFLOAT*[channels];
+    for (int chan = 0; chan < channels; chan++) {
+        buffers[chan] = new FAUSTFLOAT[BUFFER_SIZE];
+    }
+    return buffers;
+}
+
+int main(int argc, const char* argv[])
+{
+    if (argc < 2) {
+        cerr << "Usage : " << argv[0] << " <file.dsp> [faust options]\n";
+        return 1;
+    }
+    ifstream reader(argv[1]);
+    stringstream content;
+    content << reader.rdbuf();
+
+    string error_msg;
+    tiered_dsp* tiered = tiered_dsp::create(argv[1], content.str(), argc - 2, &argv[2], "", error_msg);
+    interpreter_dsp_factory* factory = createInterpreterDSPFactoryFromString(argv[1], content.str(), argc - 2, &argv[2], error_msg);
+    if (!tiered || !factory) {
+        cerr << error_msg;
+        return 1;
+    }
+    dsp* reference = factory->createDSPInstance();
+    tiered->init(SAMPLE_RATE);
+    reference->init(SAMPLE_RATE);
+
+    int num_inputs = tiered->getNumInputs();
+    int num_outputs = tiered->getNumOutputs();
+    FAUSTFLOAT** inputs = allocChannels(num_inputs);
+    FAUSTFLOAT** tiered_outputs = allocChannels(num_outputs);
+    FAUSTFLOAT** reference_outputs = allocChannels(num_outputs);
+
+    int swap_block = -1;
+    int errors = 0;
+    for (int block = 0; block < NUM_BLOCKS; block++) {
+        // Impulse on the first frame
+        for (int chan = 0; chan < num_inputs; chan++) {
+            for (int frame = 0; frame < BUFFER_SIZE; frame++) {
+                inputs[chan][frame] = (block == 0 && frame == 0) ? FAUSTFLOAT(1) : FAUSTFLOAT(0);
+            }
+        }
+        // Waits for the JIT instance, it is swapped at the beginning of the next block
+        for (int wait = 0; block == SWAP_BLOCK && tiered->isCompiling() && wait < MAX_WAIT; wait += 10) {
+            usleep(10000);
+        }
+        tiered->compute(BUFFER_SIZE, inputs, tiered_outputs);
+        if (swap_block < 0 && tiered->isJIT()) {
+            swap_block = block;
+        }
+        reference->compute(BUFFER_SIZE, inputs, reference_outputs);
+        for (int chan = 0; chan < num_outputs; chan++) {
+            for (int frame = 0; frame < BUFFER_SIZE; frame++) {
+                double a = tiered_outputs[chan][frame];
+                double b = reference_outputs[chan][frame];
+                if (fabs(a - b) > TOLERANCE * max(1., fabs(b)) && errors++ < 10) {
+                    cerr << "block " << block << " channel " << chan << " frame " << frame
+                         << " : tiered " << a << " reference " << b << ((tiered->isJIT()) ? " (JIT)" : " (Interpreter)") << endl;
+                }
+            }
+        }
+    }
+
+    if (swap_block < 0 || swap_block > SWAP_BLOCK) {
+        cerr << argv[1] << " : the JIT instance has not been swapped by block " << SWAP_BLOCK << endl;
+        errors++;
+    }
+    cout << argv[1] << " : swapped at block " << swap_block << ", " << errors << " errors" << endl;
+
+    delete reference;
+    deleteInterpreterDSPFactory(factory);
+    delete tiered;
+    return (errors > 0) ? 1 : 0;
+}
@@ -0,0 +1,161 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************/
+
+/*
+ Measure the cost of the control code at small buffer sizes: the DSP is computed with buffers of 32 frames,
+ and one of its buttons, sliders or nentries is moved every <num> buffers (or never). Compile the DSP with and
+ without -dz to compare the time spent in compute, the displayed checksums of the outputs have to be the same.
+*/
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "faust/gui/DecoratorUI.h"
+#include "faust/gui/meta.h"
+#include "faust/dsp/dsp.h"
+
+using std::max;
+using std::min;
+
+//----------------------------------------------------------------------------
+//  FAUST generated signal processor
+//----------------------------------------------------------------------------
+
+<<includeIntrinsic>>
+
+<<includeclass>>
+
+using namespace std;
+
+#define SAMPLE_RATE 44100
+#define BUFFER_SIZE 32
+
+// The zones of the buttons, sliders and nentries, with their range
+struct ControlsUI : public GenericUI {
+    struct Control {
+        FAUSTFLOAT* fZone;
+        FAUSTFLOAT  fMin;
+        FAUSTFLOAT  fMax;
+    };
+
+    vector<Control> fControls;
+
+    void add(FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max)
+    {
+        Control control = {zone, min, max};
+        fControls.push_back(control);
+    }
+
+    virtual void addButton(const char* label, FAUSTFLOAT* zone) { add(zone, 0, 1); }
+    virtual void addCheckButton(const char* label, FAUSTFLOAT* zone) { add(zone, 0, 1); }
+    virtual void addVerticalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min,
+                                   FAUSTFLOAT max, FAUSTFLOAT step)
+    {
+        add(zone, min, max);
+    }
+    virtual void addHorizontalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min,
+                                     FAUSTFLOAT max, FAUSTFLOAT step)
+    {
+        add(zone, min, max);
+    }
+    virtual void addNumEntry(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max,
+                             FAUSTFLOAT step)
+    {
+        add(zone, min, max);
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    int buffers = 100000;
+    int move    = 0;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-h" || arg == "-help") {
+            cout << argv[0] << " [-run <num>] [-move <num>]" << endl;
+            cout << "Use '-run <num>' to compute <num> buffers of " << BUFFER_SIZE << " frames (default 100000)"
+                 << endl;
+            cout << "Use '-move <num>' to move a control every <num> buffers (default 0, never)" << endl;
+            return 0;
+        } else if (arg == "-run" && i + 1 < argc) {
+            buffers = atoi(argv[++i]);
+        } else if (arg == "-move" && i + 1 < argc) {
+            move = max(0, atoi(argv[++i]));
+        }
+    }
+
+    mydsp      DSP;
+    ControlsUI controls;
+    DSP.init(SAMPLE_RATE);
+    DSP.buildUserInterface(&controls);
+
+    vector<FAUSTFLOAT*> inputs;
+    vector<FAUSTFLOAT*> outputs;
+    for (int i = 0; i < DSP.getNumInputs(); i++) {
+        inputs.push_back(new FAUSTFLOAT[BUFFER_SIZE]);
+        for (int j = 0; j < BUFFER_SIZE; j++) {
+            inputs[i][j] = FAUSTFLOAT(sin((i + j) * 0.1));
+        }
+    }
+    for (int i = 0; i < DSP.getNumOutputs(); i++) {
+        outputs.push_back(new FAUSTFLOAT[BUFFER_SIZE]);
+    }
+
+    // Only the compute calls are measured
+    double check   = 0;
+    double elapsed = 0;
+    for (int b = 0; b < buffers; b++) {
+        if (move > 0 && b % move == 0 && controls.fControls.size() > 0) {
+            ControlsUI::Control& control = controls.fControls[(b / move) % controls.fControls.size()];
+            *control.fZone = control.fMin + (control.fMax - control.fMin) * FAUSTFLOAT(((b / move) * 37) % 100) / 100;
+        }
+        chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+        DSP.compute(BUFFER_SIZE, inputs.data(), outputs.data());
+        elapsed += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        for (int i = 0; i < DSP.getNumOutputs(); i++) {
+            for (int j = 0; j < BUFFER_SIZE; j++) {
+                check += outputs[i][j];
+            }
+        }
+    }
+
+    printf("%d controls, %g ns per buffer of %d frames, checksum %a\n", int(controls.fControls.size()),
+           elapsed * 1e9 / buffers, BUFFER_SIZE, check);
+
+    for (int i = 0; i < DSP.getNumInputs(); i++) {
+        delete[] inputs[i];
+    }
+    for (int i = 0; i < DSP.getNumOutputs(); i++) {
+        delete[] outputs[i];
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************/
+
+/*
+ Play N DirectToDisk streams of sound-player.h in real time: the streams are computed in audio blocks
+ paced like an audio callback, while the I/O threads read the files. The minimum ring buffer fill
+ and the underruns of the streams are displayed at the end.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "faust/gui/GUI.h"
+#include "faust/dsp/sound-player.h"
+
+using namespace std;
+
+std::list<GUI*> GUI::fGuiList;
+ztimedmap       GUI::gTimedZoneMap;
+
+#define SAMPLE_RATE 44100
+
+int main(int argc, char* argv[])
+{
+    int            streams = 100;
+    int            buffers = 2000;
+    int            seek    = 0;
+    vector<string> files;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-h" || arg == "-help") {
+            cout << "dtd-bench [-streams <num>] [-run <num>] [-seek <num>] foo.wav..." << endl;
+            cout << "Use '-streams <num>' to play <num> streams, using the files in turn (default 100)" << endl;
+            cout << "Use '-run <num>' to play <num> buffers of " << BUFFER_SIZE << " frames (default 2000)" << endl;
+            cout << "Use '-seek <num>' to move each stream at a random position every <num> buffers (default 0, no seek)"
+                 << endl;
+            return 0;
+        } else if (arg == "-streams" && i + 1 < argc) {
+            streams = atoi(argv[++i]);
+        } else if (arg == "-run" && i + 1 < argc) {
+            buffers = atoi(argv[++i]);
+        } else if (arg == "-seek" && i + 1 < argc) {
+            seek = atoi(argv[++i]);
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.size() == 0) {
+        cerr << "dtd-bench : no sound file" << endl;
+        return 1;
+    }
+
+    vector<sound_dtd_player*> players;
+    int                       channels = 0;
+    for (int i = 0; i < streams; i++) {
+        sound_dtd_player* player = new sound_dtd_player(files[i % files.size()]);
+        player->init(SAMPLE_RATE);
+        channels = max(channels, player->getNumOutputs());
+        players.push_back(player);
+    }
+
+    vector<FAUSTFLOAT*> outputs(channels);
+    for (int chan = 0; chan < channels; chan++) outputs[chan] = new FAUSTFLOAT[BUFFER_SIZE];
+
+    unsigned int                                   seed     = 12345;
+    chrono::microseconds                           duration = chrono::microseconds(1000000LL * BUFFER_SIZE / SAMPLE_RATE);
+    chrono::high_resolution_clock::time_point      next     = chrono::high_resolution_clock::now();
+    for (int buffer = 0; buffer < buffers; buffer++) {
+        for (size_t i = 0; i < players.size(); i++) {
+            players[i]->compute(BUFFER_SIZE, nullptr, outputs.data());
+            // Position change requested between two blocks, like from a control thread
+            if (seek > 0 && (buffer + i) % seek == 0) {
+                seed = seed * 1103515245 + 12345;
+                players[i]->seek((seed >> 8) % (BUFFER_SIZE * 1000));
+            }
+        }
+        next += duration;
+        this_thread::sleep_until(next);
+    }
+
+    long min_fill = RING_BUFFER_SIZE, underruns = 0, missing = 0;
+    for (size_t i = 0; i < players.size(); i++) {
+        min_fill = min(min_fill, players[i]->getMinFill());
+        underruns += players[i]->getUnderruns();
+        missing += players[i]->getMissingFrames();
+    }
+    cout << streams << " streams, " << STREAM_THREADS << " I/O threads, " << buffers << " buffers of " << BUFFER_SIZE
+         << " frames" << endl;
+    cout << "min ring fill " << min_fill << " frames (" << (1000. * min_fill / SAMPLE_RATE) << " ms of "
+         << (1000. * RING_BUFFER_SIZE / SAMPLE_RATE) << " ms), " << underruns << " underrun(s), " << missing
+         << " missing frames" << endl;
+
+    for (size_t i = 0; i < players.size(); i++) delete players[i];
+    for (int chan = 0; chan < channels; chan++) delete[] outputs[chan];
+    return 0;
+}
@@ -0,0 +1,157 @@
+/************************************************************************
+    FAUST Architecture File
+    Copyright (C) 2003-2018 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This Architecture section is free software; you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+    EXCEPTION : As a special exception, you may create a larger work
+    that contains this FAUST architecture section and distribute
+    that work under terms of your choice, so long as this FAUST
+    architecture section is not modified.
+
+ ************************************************************************/
+
+/*
+ Measure the evaluation cache (-ec): the DSP files are compiled without the cache, then twice with it
+ (the first pass fills the cache of the process, the second one uses it). The generated code has to be
+ the same in the three passes.
+*/
+
+#include <sys/time.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "dsp_factory.hh"
+
+using namespace std;
+
+static double getTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return double(tv.tv_sec) + double(tv.tv_usec) * 1e-6;
+}
+
+static string pathToContent(const string& path)
+{
+    ifstream     file(path.c_str());
+    stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// The bargraphs without label are named with their address, these lines are not compared
+static string removeAddresses(const string& code)
+{
+    stringstream in(code), out;
+    string       line;
+    while (getline(in, line)) {
+        if (line.find("\"0x") == string::npos) out << line << endl;
+    }
+    return out.str();
+}
+
+// Compile 'run' times, return the average compilation time (in ms) and the generated code
+static double benchCompile(const string& path, const vector<string>& options, bool cache, int run, string& code,
+                           string& error_msg)
+{
+    string      content = pathToContent(path);
+    const char* argv[64];
+    int         argc = 0;
+    argv[argc++]     = "faust";
+    argv[argc++]     = "-lang";
+    argv[argc++]     = "cpp";
+    argv[argc++]     = "-o";
+    argv[argc++]     = "string";
+    if (cache) argv[argc++] = "-ec";
+    for (size_t i = 0; i < options.size() && argc < 63; i++) {
+        argv[argc++] = options[i].c_str();
+    }
+    argv[argc] = 0;
+
+    double start = getTime();
+    for (int i = 0; i < run; i++) {
+        dsp_factory_base* factory = compileFaustFactory(argc, argv, path.c_str(), content.c_str(), error_msg, true);
+        if (!factory) return -1;
+        stringstream out;
+        factory->write(&out);
+        code = removeAddresses(out.str());
+        delete factory;
+    }
+    return (getTime() - start) * 1000. / run;
+}
+
+int main(int argc, char* argv[])
+{
+    int            run = 1;
+    vector<string> options;
+    vector<string> files;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-h" || arg == "-help") {
+            cout << "faustbench-eval [-run <num>] [additional Faust options (-vec -vs 8...)] foo.dsp..." << endl;
+            cout << "Use '-run <num>' to compile each DSP <num> times in each pass" << endl;
+            return 0;
+        } else if (arg == "-run" && i + 1 < argc) {
+            run = atoi(argv[++i]);
+        } else if ((arg == "-I" || arg == "-vs" || arg == "-lv" || arg == "-ftz") && i + 1 < argc) {
+            options.push_back(arg);
+            options.push_back(argv[++i]);
+        } else if (arg[0] == '-') {
+            options.push_back(arg);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    // Pass 0 only fills the parsed library cache of the process, so that the parse is the same in the measured passes
+    const char* passes[] = {"", "no cache", "cache (first)", "cache (second)"};
+    vector<string> codes(files.size());
+    vector<bool>   failed(files.size(), false);
+    double         total[4] = {0, 0, 0, 0};
+    int            errors = 0, diffs = 0;
+    for (int pass = 0; pass < 4; pass++) {
+        for (size_t i = 0; i < files.size(); i++) {
+            if (failed[i]) continue;
+            string code, error_msg;
+            double duration = benchCompile(files[i], options, pass >= 2, (pass == 0) ? 1 : run, code, error_msg);
+            if (duration < 0) {
+                cerr << files[i] << " : " << error_msg;
+                failed[i] = true;
+                errors++;
+                continue;
+            }
+            if (pass == 1) {
+                codes[i] = code;
+            } else if (pass > 1 && code != codes[i]) {
+                cerr << files[i] << " : different code with the " << passes[pass] << endl;
+                diffs++;
+            }
+            total[pass] += duration;
+        }
+    }
+
+    for (int pass = 1; pass < 4; pass++) {
+        cout << "Total compilation time, " << passes[pass] << " : " << total[pass] << " ms" << endl;
+    }
+    if (total[3] > 0) {
+        cout << "Speedup of the evaluation cache : " << total[1] / total[3] << endl;
+    }
+    cout << files.size() << " files, " << errors << " error(s), " << diffs << " different code(s)" << endl;
+    return (errors + diffs > 0) ? 1 : 0;
+}
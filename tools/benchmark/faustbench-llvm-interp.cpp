@@ -22,6 +22,10 @@
 
  ************************************************************************/
 
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
 #include "faust/dsp/dsp-bench.h"
 #include "faust/misc.h"
 #include "faust/dsp/llvm-dsp.h"
@@ -29,54 +33,101 @@
 
 using namespace std;
 
+static double measure(dsp_factory* factory)
+{
+    dsp* DSP = factory->createDSPInstance();
+    if (!DSP) {
+        std::cout << "Cannot create instance" << std::endl;
+        exit(1);
+    }
+    
+    measure_dsp* measure = new measure_dsp(DSP, 1024, 5.0);
+    measure->measure();
+    double res = measure->getStats();
+    delete measure;
+    return res;
+}
+
+static double measureInterpreter(const string& filename, int argc, const char* argv[])
+{
+    string error_msg;
+    interpreter_dsp_factory* factory = createInterpreterDSPFactoryFromFile(filename, argc, argv, error_msg);
+    if (!factory) {
+        std::cout << "Cannot create factory : " << error_msg;
+        exit(1);
+    }
+    double res = measure(factory);
+    // Deleted so that the next measure compiles a new factory
+    deleteInterpreterDSPFactory(factory);
+    return res;
+}
+
 int main(int argc, char* argv[])
 {
     if (isopt(argv, "-h") || isopt(argv, "-help")) {
-        cout << "faustbench-llvm-interp foo.dsp" << endl;
+        cout << "faustbench-llvm-interp [additional Faust options (-vec -vs 8...)] foo.dsp..." << endl;
+        cout << "Compares the LLVM backend, the interpreter (flat direct threaded code)" << endl;
+        cout << "and the interpreter executing the tree form of the bytecode" << endl;
+        cout << "then the interpreter in vector mode ('-vec' added to the options)" << endl;
         return 0;
     }
     
     std::cout << "Libfaust version : " << getCLibFaustVersion () << std::endl;
     
-    std::string error_msg1;
-    std::string error_msg2;
-    dsp_factory* factory1 = createDSPFactoryFromFile(argv[argc-1], argc-2, (const char**)&argv[1], "", error_msg1, -1);
-    dsp_factory* factory2 = createInterpreterDSPFactoryFromFile(argv[argc-1], argc-2, (const char**)&argv[1], error_msg2);
-    
-    if (!factory1) {
-        std::cout << "Cannot create factory : " << error_msg1;
-        exit(1);
-    }
-    
-    if (!factory2) {
-        std::cout << "Cannot create factory : " << error_msg2;
-        exit(1);
+    vector<string> files;
+    vector<const char*> options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.size() > 4 && arg.substr(arg.size() - 4) == ".dsp") {
+            files.push_back(arg);
+        } else {
+            options.push_back(argv[i]);
+        }
     }
+    options.push_back(0);
+    int options_num = int(options.size()) - 1;
     
-    dsp* DSP1 = factory1->createDSPInstance();
-    dsp* DSP2 = factory2->createDSPInstance();
+    // Same options in vector mode
+    vector<const char*> vec_options(options.begin(), options.end() - 1);
+    vec_options.push_back("-vec");
+    vec_options.push_back(0);
     
-    if (!DSP1 || !DSP2) {
-        std::cout << "Cannot create instances" << std::endl;
-        exit(1);
+    double speedup = 0.;
+    double vec_speedup = 0.;
+    for (size_t i = 0; i < files.size(); i++) {
+        
+        std::string error_msg;
+        dsp_factory* factory = createDSPFactoryFromFile(files[i], options_num, &options[0], "", error_msg, -1);
+        if (!factory) {
+            std::cout << "Cannot create factory : " << error_msg;
+            exit(1);
+        }
+        double res1 = measure(factory);
+        deleteDSPFactory(static_cast<llvm_dsp_factory*>(factory));
+        
+        // Flat direct threaded code (default)
+        unsetenv("FAUST_INTERP_TREE");
+        double res2 = measureInterpreter(files[i], options_num, &options[0]);
+        
+        // Tree form of the bytecode
+        setenv("FAUST_INTERP_TREE", "1", 1);
+        double res3 = measureInterpreter(files[i], options_num, &options[0]);
+        unsetenv("FAUST_INTERP_TREE");
+        
+        // Vector mode (vector instructions)
+        double res4 = measureInterpreter(files[i], options_num + 1, &vec_options[0]);
+        
+        cout << files[i] << " : Result LLVM : " << res1 <<  " Interpreter : " << res2 << " Interpreter (tree) : " << res3
+             << " Interpreter (vec) : " << res4 << " ratio : " << res1/res2 << " flat/tree speedup : " << res2/res3
+             << " vec/scalar speedup : " << res4/res2 << std::endl;
+        speedup += res2/res3;
+        vec_speedup += res4/res2;
     }
     
-    measure_dsp* measure1 = new measure_dsp(DSP1, 1024, 5.0);
-    measure_dsp* measure2 = new measure_dsp(DSP2, 1024, 5.0);
-    
-    measure1->measure();
-    measure2->measure();
-    
-    double res1 = measure1->getStats();
-    double res2 = measure2->getStats();
-  
-    cout << "Result LLVM : " << res1 <<  " Interpreter : " << res2 << " ratio : " << res1/res2 << std::endl;
-  
-    delete measure1;
-    delete measure2;
-    
-    deleteDSPFactory(static_cast<llvm_dsp_factory*>(factory1));
-    deleteInterpreterDSPFactory(static_cast<interpreter_dsp_factory*>(factory2));
+    if (files.size() > 1) {
+        cout << "Average flat/tree speedup : " << speedup/files.size() << std::endl;
+        cout << "Average vec/scalar speedup : " << vec_speedup/files.size() << std::endl;
+    }
     
     return 0;
 }
@@ -0,0 +1,194 @@
+/************************************************************************
+    FAUST Architecture File
+    Copyright (C) 2003-2018 GRAME, Centre National de Creation Musicale
+    ---------------------------------------------------------------------
+    This Architecture section is free software; you can redistribute it
+    and/or modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+    EXCEPTION : As a special exception, you may create a larger work
+    that contains this FAUST architecture section and distribute
+    that work under terms of your choice, so long as this FAUST
+    architecture section is not modified.
+
+ ************************************************************************/
+
+/*
+ Measure the compiler data structures: the compilation time of a set of DSP files,
+ and the throughput of the hash-consing (tree creation) and property accesses.
+*/
+
+#include <sys/time.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "dsp_factory.hh"
+#include "global.hh"
+#include "property.hh"
+#include "tree.hh"
+
+using namespace std;
+
+static double getTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return double(tv.tv_sec) + double(tv.tv_usec) * 1e-6;
+}
+
+static string pathToContent(const string& path)
+{
+    ifstream     file(path.c_str());
+    stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// Compile 'run' times and return the average compilation time (in ms)
+static double benchCompile(const string& path, const vector<string>& options, int run, string& error_msg)
+{
+    string      content = pathToContent(path);
+    const char* argv[64];
+    int         argc = 0;
+    argv[argc++]     = "faust";
+    argv[argc++]     = "-lang";
+    argv[argc++]     = "cpp";
+    argv[argc++]     = "-o";
+    argv[argc++]     = "string";
+    for (size_t i = 0; i < options.size() && argc < 63; i++) {
+        argv[argc++] = options[i].c_str();
+    }
+    argv[argc] = 0;
+
+    double start = getTime();
+    for (int i = 0; i < run; i++) {
+        dsp_factory_base* factory = compileFaustFactory(argc, argv, path.c_str(), content.c_str(), error_msg, true);
+        if (!factory) return -1;
+        delete factory;
+    }
+    return (getTime() - start) * 1000. / run;
+}
+
+// Build 'size' binary trees above integer leaves, like big signal expressions
+static void buildTrees(int size, vector<Tree>& trees)
+{
+    Tree add = tree(symbol("add"));
+    Tree mul = tree(symbol("mul"));
+    trees.push_back(tree(0));
+    trees.push_back(tree(1));
+    for (int i = 2; i < size; i++) {
+        Tree a = trees[(i * 7) % i];
+        Tree b = trees[(i * 13) % i];
+        trees.push_back(tree(Node(i), (i % 2) ? add : mul, a, b));
+    }
+}
+
+static void benchTrees(int size)
+{
+    global::allocate();
+
+    // Creation of new trees (hash table misses)
+    vector<Tree> trees;
+    double       start = getTime();
+    buildTrees(size, trees);
+    double create = getTime() - start;
+
+    // Lookup of existing trees (hash table hits)
+    vector<Tree> trees2;
+    start = getTime();
+    buildTrees(size, trees2);
+    double lookup = getTime() - start;
+    faustassert(trees == trees2);
+
+    cout << "make-tree  : " << int(size / create / 1000.) << " Ktrees/s (new), " << int(size / lookup / 1000.)
+         << " Ktrees/s (existing)" << endl;
+
+    // Properties : a few properties per tree (the usual case) and a lot of properties on one tree (environments)
+    const int         keys_num = 4;
+    property<Tree>*   props[keys_num];
+    for (int k = 0; k < keys_num; k++) {
+        props[k] = new property<Tree>();
+        for (size_t i = 0; i < trees.size(); i++) props[k]->set(trees[i], trees[(i + k) % trees.size()]);
+    }
+    Tree res;
+    int  found = 0;
+    start      = getTime();
+    for (int k = 0; k < keys_num; k++) {
+        for (size_t i = 0; i < trees.size(); i++) found += props[k]->get(trees[i], res);
+    }
+    double get = getTime() - start;
+    faustassert(found == keys_num * size);
+
+    Tree env = tree(symbol("environment"));
+    for (size_t i = 0; i < trees.size(); i++) env->setProperty(trees[i], trees[i]);
+    start = getTime();
+    for (size_t i = 0; i < trees.size(); i++) found += (env->getProperty(trees[i]) == trees[i]);
+    double get_env = getTime() - start;
+    faustassert(found == (keys_num + 1) * size);
+
+    cout << "getProperty: " << int(keys_num * size / get / 1000.) << " Kget/s (" << keys_num << " properties per tree), "
+         << int(size / get_env / 1000.) << " Kget/s (" << size << " properties on one tree)" << endl;
+
+    global::destroy();
+}
+
+int main(int argc, char* argv[])
+{
+    int            run  = 10;
+    int            size = 1000000;
+    vector<string> options;
+    vector<string> files;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-h" || arg == "-help") {
+            cout << "faustbench-tree [-run <num>] [-size <num>] [additional Faust options (-vec -vs 8...)] foo.dsp..."
+                 << endl;
+            cout << "Use '-run <num>' to compile each DSP <num> times" << endl;
+            cout << "Use '-size <num>' to create <num> trees in the make-tree and getProperty tests" << endl;
+            return 0;
+        } else if (arg == "-run" && i + 1 < argc) {
+            run = atoi(argv[++i]);
+        } else if (arg == "-size" && i + 1 < argc) {
+            size = atoi(argv[++i]);
+        } else if ((arg == "-I" || arg == "-vs" || arg == "-lv" || arg == "-ftz") && i + 1 < argc) {
+            options.push_back(arg);
+            options.push_back(argv[++i]);
+        } else if (arg[0] == '-') {
+            options.push_back(arg);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    benchTrees(size);
+
+    double total = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        string error_msg;
+        double duration = benchCompile(files[i], options, run, error_msg);
+        if (duration < 0) {
+            cerr << files[i] << " : " << error_msg;
+        } else {
+            cout << files[i] << " : " << duration << " ms" << endl;
+            total += duration;
+        }
+    }
+    if (files.size() > 0) {
+        cout << "Total compilation time : " << total << " ms" << endl;
+    }
+
+    return 0;
+}
@@ -85,6 +85,14 @@
 
 #include "dsp_scal.h"
 
+#elif defined(SIMD_TESTS)
+
+#include "dsp_scal.h"
+#include "dsp_vec0_32.h"
+#include "dsp_vec0g_32.h"
+#include "dsp_simd_32.h"
+#include "dsp_simdg_32.h"
+
 #endif
 
 using namespace std;
@@ -165,6 +173,14 @@ extern "C" int bench_all(const char* name, int run)
     
     options.push_back(ADD_DOUBLE + "-scal");
     
+#elif defined(SIMD_TESTS)
+    
+    options.push_back(ADD_DOUBLE + "-scal");
+    options.push_back(ADD_DOUBLE + "-vec -lv 0 -vs 32");
+    options.push_back(ADD_DOUBLE + "-vec -lv 0 -vs 32 -g");
+    options.push_back(ADD_DOUBLE + "-vec -lv 0 -vs 32 -simd");
+    options.push_back(ADD_DOUBLE + "-vec -lv 0 -vs 32 -g -simd");
+    
 #endif
     
     int ind = 0;
@@ -227,6 +243,14 @@ extern "C" int bench_all(const char* name, int run)
     
     measures.push_back(bench(new dsp_scal(), options[ind++], run));
     
+#elif defined(SIMD_TESTS)
+    
+    measures.push_back(bench(new dsp_scal(), options[ind++], run));
+    measures.push_back(bench(new dsp_vec0_32(), options[ind++], run));
+    measures.push_back(bench(new dsp_vec0g_32(), options[ind++], run));
+    measures.push_back(bench(new dsp_simd_32(), options[ind++], run));
+    measures.push_back(bench(new dsp_simdg_32(), options[ind++], run));
+    
 #endif
     
     vector<double> measures1 = measures;
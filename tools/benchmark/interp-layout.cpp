@@ -0,0 +1,119 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************/
+
+/*
+ Profile the DSP structure fields accessed by the interpreter (trace mode 7) on a DSP file, and write
+ the profile to be given to the -pgo-layout option of the compiler.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "faust/dsp/interpreter-dsp.h"
+
+using namespace std;
+
+#define BUFFER_SIZE 512
+
+int main(int argc, char* argv[])
+{
+    int                 buffers = 100;
+    string              profile;
+    vector<const char*> options;
+    string              file;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-h" || arg == "-help") {
+            cout << "interp-layout [-run <num>] [-o <file>] [additional Faust options (-double -ftz 2...)] foo.dsp" << endl;
+            cout << "Use '-run <num>' to compute <num> buffers of " << BUFFER_SIZE << " frames (default 100)" << endl;
+            cout << "Use '-o <file>' to write the profile in <file> (default: foo.prof)" << endl;
+            return 0;
+        } else if (arg == "-run" && i + 1 < argc) {
+            buffers = atoi(argv[++i]);
+        } else if (arg == "-o" && i + 1 < argc) {
+            profile = argv[++i];
+        } else if (arg == "-double") {
+            // The buffers are allocated as FAUSTFLOAT here
+            continue;
+        } else if ((arg == "-I" || arg == "-vs" || arg == "-lv" || arg == "-ftz") && i + 1 < argc) {
+            options.push_back(argv[i]);
+            options.push_back(argv[++i]);
+        } else if (arg[0] == '-') {
+            options.push_back(argv[i]);
+        } else {
+            file = arg;
+        }
+    }
+
+    if (profile == "") {
+        profile = file.substr(0, file.rfind('.')) + ".prof";
+    }
+
+    // Profile mode: the interpreter counts the field accesses and writes them in the 'profile' file
+    setenv("FAUST_INTERP_TRACE", "7", 1);
+    setenv("FAUST_INTERP_PROFILE", profile.c_str(), 1);
+
+    string       error_msg;
+    dsp_factory* factory =
+        createInterpreterDSPFactoryFromFile(file, int(options.size()), (const char**)options.data(), error_msg);
+    if (!factory) {
+        cerr << file << " : " << error_msg;
+        return 1;
+    }
+
+    dsp* DSP = factory->createDSPInstance();
+    DSP->init(44100);
+
+    int                 ins  = DSP->getNumInputs();
+    int                 outs = DSP->getNumOutputs();
+    vector<FAUSTFLOAT*> inputs(ins + 1);
+    vector<FAUSTFLOAT*> outputs(outs + 1);
+    for (int chan = 0; chan < ins; chan++) inputs[chan] = new FAUSTFLOAT[BUFFER_SIZE];
+    for (int chan = 0; chan < outs; chan++) outputs[chan] = new FAUSTFLOAT[BUFFER_SIZE];
+
+    unsigned int seed = 12345;
+    for (int buffer = 0; buffer < buffers; buffer++) {
+        for (int chan = 0; chan < ins; chan++) {
+            for (int frame = 0; frame < BUFFER_SIZE; frame++) {
+                seed                = seed * 1103515245 + 12345;
+                inputs[chan][frame] = FAUSTFLOAT(int(seed >> 1)) / FAUSTFLOAT(2147483647.0);
+            }
+        }
+        DSP->compute(BUFFER_SIZE, inputs.data(), outputs.data());
+    }
+
+    for (int chan = 0; chan < ins; chan++) delete[] inputs[chan];
+    for (int chan = 0; chan < outs; chan++) delete[] outputs[chan];
+
+    // The profile is written when the instance is deleted
+    delete DSP;
+    deleteInterpreterDSPFactory(static_cast<interpreter_dsp_factory*>(factory));
+
+    cout << file << " : profile written in '" << profile << "', compile with '-pgo-layout " << profile << "'" << endl;
+    return 0;
+}
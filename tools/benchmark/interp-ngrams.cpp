@@ -0,0 +1,165 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************/
+
+/*
+ Count the opcode n-grams executed by the interpreter (trace mode 6) on a set of DSP files,
+ and print the most frequent ones, to choose the superinstructions fused by the interpreter optimizer.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "faust/dsp/interpreter-dsp.h"
+
+using namespace std;
+
+#define BUFFER_SIZE 512
+
+// Run 'buffers' buffers of noise in the DSP, its n-grams are appended to the FAUST_INTERP_NGRAMS file
+static bool profileDSP(const string& path, const vector<const char*>& options, int buffers)
+{
+    string       error_msg;
+    dsp_factory* factory =
+        createInterpreterDSPFactoryFromFile(path, int(options.size()), (const char**)options.data(), error_msg);
+    if (!factory) {
+        cerr << path << " : " << error_msg;
+        return false;
+    }
+
+    dsp* DSP = factory->createDSPInstance();
+    DSP->init(44100);
+
+    int                 ins  = DSP->getNumInputs();
+    int                 outs = DSP->getNumOutputs();
+    vector<FAUSTFLOAT*> inputs(ins + 1);
+    vector<FAUSTFLOAT*> outputs(outs + 1);
+    for (int chan = 0; chan < ins; chan++) inputs[chan] = new FAUSTFLOAT[BUFFER_SIZE];
+    for (int chan = 0; chan < outs; chan++) outputs[chan] = new FAUSTFLOAT[BUFFER_SIZE];
+
+    unsigned int seed = 12345;
+    for (int buffer = 0; buffer < buffers; buffer++) {
+        for (int chan = 0; chan < ins; chan++) {
+            for (int frame = 0; frame < BUFFER_SIZE; frame++) {
+                seed                = seed * 1103515245 + 12345;
+                inputs[chan][frame] = FAUSTFLOAT(int(seed >> 1)) / FAUSTFLOAT(2147483647.0);
+            }
+        }
+        DSP->compute(BUFFER_SIZE, inputs.data(), outputs.data());
+    }
+
+    for (int chan = 0; chan < ins; chan++) delete[] inputs[chan];
+    for (int chan = 0; chan < outs; chan++) delete[] outputs[chan];
+
+    // The statistics are written when the instance is deleted
+    delete DSP;
+    deleteInterpreterDSPFactory(static_cast<interpreter_dsp_factory*>(factory));
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int                 buffers = 100;
+    int                 top     = 20;
+    string              ngrams  = "interp-ngrams.txt";
+    vector<const char*> options;
+    vector<string>      files;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-h" || arg == "-help") {
+            cout << "interp-ngrams [-run <num>] [-top <num>] [-o <file>] [additional Faust options (-vec -vs 8...)] "
+                    "foo.dsp..."
+                 << endl;
+            cout << "Use '-run <num>' to compute <num> buffers of " << BUFFER_SIZE << " frames in each DSP" << endl;
+            cout << "Use '-top <num>' to print the <num> most frequent n-grams of each size" << endl;
+            cout << "Use '-o <file>' to keep the n-grams of all DSPs in <file> (default: interp-ngrams.txt)" << endl;
+            return 0;
+        } else if (arg == "-run" && i + 1 < argc) {
+            buffers = atoi(argv[++i]);
+        } else if (arg == "-top" && i + 1 < argc) {
+            top = atoi(argv[++i]);
+        } else if (arg == "-o" && i + 1 < argc) {
+            ngrams = argv[++i];
+        } else if (arg == "-double") {
+            // The opcodes are the same in float and double, and the buffers are allocated as float here
+            continue;
+        } else if ((arg == "-I" || arg == "-vs" || arg == "-lv" || arg == "-ftz") && i + 1 < argc) {
+            options.push_back(argv[i]);
+            options.push_back(argv[++i]);
+        } else if (arg[0] == '-') {
+            options.push_back(argv[i]);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    // Profile mode: the interpreter counts the n-grams and appends them to the 'ngrams' file
+    remove(ngrams.c_str());
+    setenv("FAUST_INTERP_TRACE", "6", 1);
+    setenv("FAUST_INTERP_NGRAMS", ngrams.c_str(), 1);
+
+    for (size_t i = 0; i < files.size(); i++) {
+        profileDSP(files[i], options, buffers);
+    }
+
+    // Merge the n-grams of all DSPs: each line is 'count size opcode1 ... opcodeN'
+    map<int, map<string, long long> > merged;
+    map<int, long long>               total;
+    ifstream                          in(ngrams.c_str());
+    string                            line;
+    while (getline(in, line)) {
+        stringstream reader(line);
+        long long    count;
+        int          size;
+        string       opcodes, opcode;
+        reader >> count >> size;
+        while (reader >> opcode) opcodes += (opcodes.empty() ? "" : " ") + opcode;
+        merged[size][opcodes] += count;
+        total[size] += count;
+    }
+
+    for (map<int, map<string, long long> >::iterator it1 = merged.begin(); it1 != merged.end(); it1++) {
+        vector<pair<long long, string> > sorted;
+        for (map<string, long long>::iterator it2 = it1->second.begin(); it2 != it1->second.end(); it2++) {
+            sorted.push_back(make_pair(it2->second, it2->first));
+        }
+        sort(sorted.rbegin(), sorted.rend());
+        cout << "------------------------------" << endl;
+        cout << it1->first << "-grams" << endl;
+        cout << "------------------------------" << endl;
+        for (int i = 0; i < min(top, int(sorted.size())); i++) {
+            cout << sorted[i].first << " " << (100. * sorted[i].first / total[it1->first]) << "% : "
+                 << sorted[i].second << endl;
+        }
+    }
+
+    return 0;
+}
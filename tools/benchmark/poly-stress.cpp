@@ -0,0 +1,175 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************/
+
+/*
+ Stress the polyphonic voice allocation: a MIDI thread sends keyOn/keyOff events as fast as possible
+ while the audio thread computes the polyphonic DSP, and the duration of each audio block is measured.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "faust/dsp/interpreter-dsp.h"
+
+// Parallel voice rendering
+#define POLY_THREADS
+#include "faust/dsp/poly-dsp.h"
+
+using namespace std;
+
+std::list<GUI*> GUI::fGuiList;
+ztimedmap       GUI::gTimedZoneMap;
+
+#define BUFFER_SIZE 256
+
+static volatile bool gRunning = true;
+
+// Dense MIDI : each keyOn is followed by the keyOff of a previously played pitch, 'period' usec between events
+static void midiThread(mydsp_poly* poly, int period, long* events)
+{
+    unsigned int seed = 12345;
+    vector<int>  pitches;
+    while (gRunning) {
+        seed      = seed * 1103515245 + 12345;
+        int pitch = 36 + (seed >> 16) % 60;
+        poly->keyOn(0, pitch, 100);
+        pitches.push_back(pitch);
+        if (pitches.size() > 8) {
+            int index = (seed >> 8) % pitches.size();
+            poly->keyOff(0, pitches[index], 0);
+            pitches.erase(pitches.begin() + index);
+        }
+        (*events) += 2;
+        if (period > 0) usleep(period);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int                 nvoices = 128;
+    int                 buffers = 5000;
+    int                 period  = 50;
+    int                 pause   = 1000;
+    int                 threads = 1;
+    vector<const char*> options;
+    string              file;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-h" || arg == "-help") {
+            cout << "poly-stress [-nvoices <num>] [-run <num>] [-period <usec>] [-pause <usec>] [-threads <num>] [additional Faust options "
+                    "(-vec -vs 8...)] foo.dsp"
+                 << endl;
+            cout << "Use '-nvoices <num>' to set the number of voices (default 128)" << endl;
+            cout << "Use '-run <num>' to compute <num> buffers of " << BUFFER_SIZE << " frames (default 5000)" << endl;
+            cout << "Use '-period <usec>' to wait <usec> between MIDI events (default 50)" << endl;
+            cout << "Use '-pause <usec>' to wait <usec> between audio blocks, like an audio callback (default 1000)"
+                 << endl;
+            cout << "Use '-threads <num>' to render the voices with <num> threads, -1 for all processors (default 1)"
+                 << endl;
+            return 0;
+        } else if (arg == "-nvoices" && i + 1 < argc) {
+            nvoices = atoi(argv[++i]);
+        } else if (arg == "-run" && i + 1 < argc) {
+            buffers = atoi(argv[++i]);
+        } else if (arg == "-period" && i + 1 < argc) {
+            period = atoi(argv[++i]);
+        } else if (arg == "-pause" && i + 1 < argc) {
+            pause = atoi(argv[++i]);
+        } else if (arg == "-threads" && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (arg == "-double") {
+            // The buffers are allocated as FAUSTFLOAT here
+            continue;
+        } else if ((arg == "-I" || arg == "-vs" || arg == "-lv" || arg == "-ftz") && i + 1 < argc) {
+            options.push_back(argv[i]);
+            options.push_back(argv[++i]);
+        } else if (arg[0] == '-') {
+            options.push_back(argv[i]);
+        } else {
+            file = arg;
+        }
+    }
+
+    string       error_msg;
+    dsp_factory* factory =
+        createInterpreterDSPFactoryFromFile(file, int(options.size()), (const char**)options.data(), error_msg);
+    if (!factory) {
+        cerr << file << " : " << error_msg;
+        return 1;
+    }
+
+    mydsp_poly* poly = new mydsp_poly(factory->createDSPInstance(), nvoices, true, true);
+    poly->init(44100);
+    threads = poly->setThreads(threads);
+
+    int                 ins  = poly->getNumInputs();
+    int                 outs = poly->getNumOutputs();
+    vector<FAUSTFLOAT*> inputs(ins + 1);
+    vector<FAUSTFLOAT*> outputs(outs + 1);
+    for (int chan = 0; chan < ins; chan++) inputs[chan] = new FAUSTFLOAT[BUFFER_SIZE]();
+    for (int chan = 0; chan < outs; chan++) outputs[chan] = new FAUSTFLOAT[BUFFER_SIZE];
+
+    long   events = 0;
+    thread midi(midiThread, poly, period, &events);
+
+    vector<double> durations;
+    durations.reserve(buffers);
+    for (int buffer = 0; buffer < buffers; buffer++) {
+        chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+        poly->compute(BUFFER_SIZE, inputs.data(), outputs.data());
+        chrono::high_resolution_clock::time_point end = chrono::high_resolution_clock::now();
+        durations.push_back(chrono::duration<double, micro>(end - start).count());
+        if (pause > 0) usleep(pause);
+    }
+
+    gRunning = false;
+    midi.join();
+
+    double mean = 0, deviation = 0;
+    for (size_t i = 0; i < durations.size(); i++) mean += durations[i];
+    mean /= durations.size();
+    for (size_t i = 0; i < durations.size(); i++) deviation += (durations[i] - mean) * (durations[i] - mean);
+    deviation = sqrt(deviation / durations.size());
+    sort(durations.begin(), durations.end());
+
+    cout << file << " : " << nvoices << " voices, " << threads << " thread(s), " << events << " MIDI events, " << buffers << " buffers of "
+         << BUFFER_SIZE << " frames" << endl;
+    cout << "mean " << mean << " usec, deviation " << deviation << " usec, 99% "
+         << durations[size_t(durations.size() * 0.99)] << " usec, max " << durations.back() << " usec (deadline "
+         << (1e6 * BUFFER_SIZE / 44100) << " usec)" << endl;
+
+    for (int chan = 0; chan < ins; chan++) delete[] inputs[chan];
+    for (int chan = 0; chan < outs; chan++) delete[] outputs[chan];
+    delete poly;
+    deleteInterpreterDSPFactory(static_cast<interpreter_dsp_factory*>(factory));
+    return 0;
+}
@@ -0,0 +1,171 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************/
+
+/*
+ Compute K copies of a DSP compiled with -sch, for K = 1 to max: the copies are computed in turn by one or
+ several audio threads, all of them using the process-wide worker threads of the scheduler. The total
+ throughput is displayed for each K, and the outputs of the copies are checked to be the same.
+*/
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "faust/gui/UI.h"
+#include "faust/gui/meta.h"
+#include "faust/dsp/dsp.h"
+
+using std::max;
+using std::min;
+
+//----------------------------------------------------------------------------
+//  FAUST generated signal processor
+//----------------------------------------------------------------------------
+
+<<includeIntrinsic>>
+
+<<includeclass>>
+
+using namespace std;
+
+#define SAMPLE_RATE 44100
+#define BUFFER_SIZE 512
+
+struct Copy {
+    mydsp       fDSP;
+    FAUSTFLOAT* fInputs[256];
+    FAUSTFLOAT* fOutputs[256];
+    double      fCheck;
+
+    Copy() : fCheck(0)
+    {
+        fDSP.init(SAMPLE_RATE);
+        for (int i = 0; i < fDSP.getNumInputs(); i++) {
+            fInputs[i] = new FAUSTFLOAT[BUFFER_SIZE];
+            for (int j = 0; j < BUFFER_SIZE; j++) {
+                fInputs[i][j] = FAUSTFLOAT(sin(j * 0.1));
+            }
+        }
+        for (int i = 0; i < fDSP.getNumOutputs(); i++) {
+            fOutputs[i] = new FAUSTFLOAT[BUFFER_SIZE];
+        }
+    }
+
+    virtual ~Copy()
+    {
+        for (int i = 0; i < fDSP.getNumInputs(); i++) {
+            delete[] fInputs[i];
+        }
+        for (int i = 0; i < fDSP.getNumOutputs(); i++) {
+            delete[] fOutputs[i];
+        }
+    }
+
+    void compute()
+    {
+        fDSP.compute(BUFFER_SIZE, fInputs, fOutputs);
+        for (int i = 0; i < fDSP.getNumOutputs(); i++) {
+            for (int j = 0; j < BUFFER_SIZE; j++) {
+                fCheck += fOutputs[i][j];
+            }
+        }
+    }
+};
+
+// Each audio thread computes its copies in turn
+static void computeCopies(vector<Copy*>* copies, int first, int step, int buffers)
+{
+    for (int b = 0; b < buffers; b++) {
+        for (size_t i = first; i < copies->size(); i += step) {
+            (*copies)[i]->compute();
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int max_copies = 8;
+    int buffers    = 1000;
+    int hosts      = 1;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-h" || arg == "-help") {
+            cout << argv[0] << " [-max <num>] [-run <num>] [-host <num>]" << endl;
+            cout << "Use '-max <num>' to compute 1 to <num> copies of the DSP (default 8)" << endl;
+            cout << "Use '-run <num>' to compute <num> buffers of " << BUFFER_SIZE << " frames in each copy (default 1000)" << endl;
+            cout << "Use '-host <num>' to compute the copies with <num> audio threads (default 1)" << endl;
+            return 0;
+        } else if (arg == "-max" && i + 1 < argc) {
+            max_copies = atoi(argv[++i]);
+        } else if (arg == "-run" && i + 1 < argc) {
+            buffers = atoi(argv[++i]);
+        } else if (arg == "-host" && i + 1 < argc) {
+            hosts = max(1, atoi(argv[++i]));
+        }
+    }
+
+    int errors = 0;
+    for (int k = 1; k <= max_copies; k++) {
+        vector<Copy*> copies;
+        for (int i = 0; i < k; i++) {
+            copies.push_back(new Copy());
+        }
+
+        int                      threads = min(hosts, k);
+        vector<thread*>          host_threads;
+        chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+        for (int h = 1; h < threads; h++) {
+            host_threads.push_back(new thread(computeCopies, &copies, h, threads, buffers));
+        }
+        computeCopies(&copies, 0, threads, buffers);
+        for (size_t h = 0; h < host_threads.size(); h++) {
+            host_threads[h]->join();
+            delete host_threads[h];
+        }
+        double duration = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        bool same = true;
+        for (int i = 1; i < k; i++) {
+            same = same && (copies[i]->fCheck == copies[0]->fCheck);
+        }
+        if (!same) errors++;
+
+        double frames = double(k) * buffers * BUFFER_SIZE;
+        cout << k << " copies : " << (frames / duration / 1e6) << " Mframes/s, " << (frames / duration / 1e6 / k)
+             << " Mframes/s per copy" << (same ? "" : " (different outputs)") << endl;
+
+        for (int i = 0; i < k; i++) {
+            delete copies[i];
+        }
+    }
+
+    return (errors > 0) ? 1 : 0;
+}
@@ -0,0 +1,167 @@
+/************************************************************************
+ FAUST Architecture File
+ Copyright (C) 2019 GRAME, Centre National de Creation Musicale
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************/
+
+/*
+ Measure the cost of sample accurate control in timed_dsp: a DSP with a growing number of timed zones
+ receives dated values at random frames in each block, and its compute time is compared with the plain DSP.
+*/
+
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "faust/dsp/interpreter-dsp.h"
+#include "faust/dsp/timed-dsp.h"
+#include "faust/gui/GUI.h"
+
+using namespace std;
+
+std::list<GUI*> GUI::fGuiList;
+ztimedmap       GUI::gTimedZoneMap;
+
+#define BUFFER_SIZE 256
+
+struct TimedItem : public uiTimedItem {
+    TimedItem(GUI* ui, FAUSTFLOAT* zone) : uiTimedItem(ui, zone) {}
+    void reflectZone() {}
+};
+
+// Creates a timed item for each control, like MidiUI does for the MIDI clock
+struct TimedUI : public GUI {
+    vector<uiTimedItem*> fItems;  // Deleted by GUI
+
+    void addTimedItem(FAUSTFLOAT* zone) { fItems.push_back(new TimedItem(this, zone)); }
+
+    void addButton(const char* label, FAUSTFLOAT* zone) { addTimedItem(zone); }
+    void addCheckButton(const char* label, FAUSTFLOAT* zone) { addTimedItem(zone); }
+    void addVerticalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max,
+                           FAUSTFLOAT step)
+    {
+        addTimedItem(zone);
+    }
+    void addHorizontalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max,
+                             FAUSTFLOAT step)
+    {
+        addTimedItem(zone);
+    }
+    void addNumEntry(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max,
+                     FAUSTFLOAT step)
+    {
+        addTimedItem(zone);
+    }
+};
+
+// Returns the mean duration of a block in usec, 'events' dated values of random zones being sent before each block
+static double measure(dsp* DSP, TimedUI* ui, int buffers, int events)
+{
+    int                 ins  = DSP->getNumInputs();
+    int                 outs = DSP->getNumOutputs();
+    vector<FAUSTFLOAT*> inputs(ins + 1);
+    vector<FAUSTFLOAT*> outputs(outs + 1);
+    for (int chan = 0; chan < ins; chan++) inputs[chan] = new FAUSTFLOAT[BUFFER_SIZE]();
+    for (int chan = 0; chan < outs; chan++) outputs[chan] = new FAUSTFLOAT[BUFFER_SIZE];
+
+    unsigned int seed     = 12345;
+    double       duration = 0;
+    for (int buffer = 0; buffer < buffers; buffer++) {
+        if (ui) {
+            for (int event = 0; event < events; event++) {
+                seed = seed * 1103515245 + 12345;
+                // Dates are increasing, like MIDI timestamps
+                ui->fItems[(seed >> 8) % ui->fItems.size()]->modifyZone(double(event * BUFFER_SIZE / events),
+                                                                       FAUSTFLOAT((seed >> 16) % 100) / 100);
+            }
+        }
+        chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+        // Dates are expressed in frames
+        DSP->compute(-1, BUFFER_SIZE, inputs.data(), outputs.data());
+        chrono::high_resolution_clock::time_point end = chrono::high_resolution_clock::now();
+        duration += chrono::duration<double, micro>(end - start).count();
+    }
+
+    for (int chan = 0; chan < ins; chan++) delete[] inputs[chan];
+    for (int chan = 0; chan < outs; chan++) delete[] outputs[chan];
+    return duration / buffers;
+}
+
+int main(int argc, char* argv[])
+{
+    int buffers   = 2000;
+    int events    = 16;
+    int max_zones = 1024;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-h" || arg == "-help") {
+            cout << "timed-bench [-zones <num>] [-events <num>] [-run <num>]" << endl;
+            cout << "Use '-zones <num>' to measure DSPs with 1, 4, 16... up to <num> timed zones (default 1024)"
+                 << endl;
+            cout << "Use '-events <num>' to send <num> dated values before each block (default 16)" << endl;
+            cout << "Use '-run <num>' to compute <num> buffers of " << BUFFER_SIZE << " frames (default 2000)"
+                 << endl;
+            return 0;
+        } else if (arg == "-zones" && i + 1 < argc) {
+            max_zones = atoi(argv[++i]);
+        } else if (arg == "-events" && i + 1 < argc) {
+            events = atoi(argv[++i]);
+        } else if (arg == "-run" && i + 1 < argc) {
+            buffers = atoi(argv[++i]);
+        }
+    }
+
+    cout << "zones\tplain (usec)\ttimed (usec)\toverhead (usec)" << endl;
+    for (int zones = 1; zones <= max_zones; zones *= 4) {
+        stringstream code;
+        code << "process = par(i, " << zones << ", hslider(\"c%i\", 0, 0, 1, 0.01)) :> _;";
+
+        string       error_msg;
+        dsp_factory* factory = createInterpreterDSPFactoryFromString("timed", code.str(), 0, NULL, error_msg);
+        if (!factory) {
+            cerr << error_msg;
+            return 1;
+        }
+
+        dsp* plain = factory->createDSPInstance();
+        plain->init(44100);
+        double plain_duration = measure(plain, NULL, buffers, events);
+        delete plain;
+
+        timed_dsp* timed = new timed_dsp(factory->createDSPInstance());
+        TimedUI*   ui    = new TimedUI();
+        timed->buildUserInterface(ui);
+        timed->init(44100);
+        double timed_duration = measure(timed, ui, buffers, events);
+        delete timed;
+        delete ui;
+
+        cout << zones << "\t" << plain_duration << "\t" << timed_duration << "\t" << (timed_duration - plain_duration)
+             << endl;
+        deleteInterpreterDSPFactory(static_cast<interpreter_dsp_factory*>(factory));
+    }
+
+    return 0;
+}